@@ -0,0 +1,63 @@
+#ifndef INCLUDE_CMDKIT_BENCH
+#define INCLUDE_CMDKIT_BENCH
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A small self-contained benchmark harness. Suites register cases from their own translation
+// units; main.cpp times them, counts heap allocations through a replaced operator new and
+// prints text, CSV or JSON.
+namespace cmdkit::bench
+{
+	// Runs the measured operation `iterations` times.
+	using Body = std::function<void(size_t iterations)>;
+
+	// Builds the case's fixture and returns its body. Only called for cases that are selected,
+	// and never timed.
+	using Factory = std::function<Body()>;
+
+	struct Case
+	{
+		std::string suite;
+		std::string name;
+		Factory factory;
+		size_t bytes_per_op = 0;
+	};
+
+	inline std::vector<Case>& registry() { static std::vector<Case> cases; return cases; }
+
+	inline bool add(std::string suite, std::string name, Factory factory, size_t bytes_per_op = 0)
+	{
+		registry().push_back(Case{ std::move(suite), std::move(name), std::move(factory), bytes_per_op });
+		return true;
+	}
+
+	// Heap allocations made by this process so far; maintained by main.cpp's operator new.
+	size_t allocation_count();
+
+	// Keeps the compiler from discarding a value computed inside the timed loop.
+	template<typename T>
+	inline void do_not_optimize(T&& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif
+	}
+}
+
+#define CMDKIT_BENCH_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#define CMDKIT_BENCH_CONCAT(lhs, rhs) CMDKIT_BENCH_CONCAT_IMPL(lhs, rhs)
+
+// Registers cases at static initialisation: `CMDKIT_BENCH_REGISTER { bench::add(...); }`.
+#define CMDKIT_BENCH_REGISTER \
+	static void CMDKIT_BENCH_CONCAT(cmdkit_bench_register_, __LINE__)(); \
+	static const bool CMDKIT_BENCH_CONCAT(cmdkit_bench_registered_, __LINE__) = (CMDKIT_BENCH_CONCAT(cmdkit_bench_register_, __LINE__)(), true); \
+	static void CMDKIT_BENCH_CONCAT(cmdkit_bench_register_, __LINE__)()
+
+#endif // INCLUDE_CMDKIT_BENCH
\ No newline at end of file
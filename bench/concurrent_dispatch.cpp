@@ -0,0 +1,84 @@
+#include "concurrent_terminal.hpp"
+#include "terminal.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+Command make_command(const std::string& name)
+{
+	return Command(name, [](const CommandArgsView& args) { return args.has_flag("fail") ? R::err("fail") : R::ok(nullptr); });
+}
+
+// Dispatch threads hammer one command while a writer registers a new command every millisecond.
+template<typename InvokeFn, typename RegisterFn>
+double dispatches_per_second(size_t readers, InvokeFn&& invoke, RegisterFn&& register_command)
+{
+	std::atomic<bool> stop{ false };
+	std::atomic<size_t> total{ 0 };
+
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < readers; ++idx)
+		threads.emplace_back([&]()
+			{
+				const std::string line = "status --region eu-west-1 --verbose";
+				size_t count = 0;
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					ParseContext& context = ParseContext::local();
+					ParseContext::Scope scope(context);
+					invoke(context.parse(line));
+					count++;
+				}
+				total += count;
+			});
+
+	const auto duration = std::chrono::milliseconds(300);
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t idx = 0; std::chrono::steady_clock::now() - start < duration; ++idx)
+	{
+		register_command(make_command("generated_" + std::to_string(idx)));
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	stop = true;
+	for (auto& thread : threads) thread.join();
+
+	return total / std::chrono::duration<double>(duration).count();
+}
+
+int main()
+{
+	std::printf("%-8s %16s %16s %16s\n", "readers", "rcu snapshot", "shared_mutex", "mutex");
+	for (size_t readers : { 1, 2, 4, 8, 16 })
+	{
+		ConcurrentTerminal concurrent;
+		concurrent.register_command(make_command("status"));
+		const double rcu = dispatches_per_second(readers,
+			[&](const CommandArgsView& args) { concurrent.invoke(args); },
+			[&](Command cmd) { concurrent.register_command(std::move(cmd)); });
+
+		Terminal shared_terminal;
+		std::shared_mutex shared_mutex;
+		shared_terminal.register_command(make_command("status"));
+		const double shared = dispatches_per_second(readers,
+			[&](const CommandArgsView& args) { std::shared_lock<std::shared_mutex> lock(shared_mutex); shared_terminal.invoke(args); },
+			[&](Command cmd) { std::unique_lock<std::shared_mutex> lock(shared_mutex); shared_terminal.register_command(std::move(cmd)); });
+
+		Terminal locked_terminal;
+		std::mutex mutex;
+		locked_terminal.register_command(make_command("status"));
+		const double locked = dispatches_per_second(readers,
+			[&](const CommandArgsView& args) { std::lock_guard<std::mutex> lock(mutex); locked_terminal.invoke(args); },
+			[&](Command cmd) { std::lock_guard<std::mutex> lock(mutex); locked_terminal.register_command(std::move(cmd)); });
+
+		std::printf("%-8zu %10.2f Mop/s %10.2f Mop/s %10.2f Mop/s\n", readers, rcu / 1e6, shared / 1e6, locked / 1e6);
+	}
+}
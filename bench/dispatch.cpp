@@ -0,0 +1,81 @@
+#include "bench.hpp"
+#include "concurrent_terminal.hpp"
+#include "terminal.hpp"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+namespace
+{
+	std::string command_name(size_t idx) { return "cmd_" + std::to_string(idx * 2654435761u % 1000003u); }
+
+	template<typename TerminalT>
+	void fill(TerminalT& terminal, size_t size)
+	{
+		for (size_t idx = 0; idx < size; ++idx)
+			terminal.register_command(Command(command_name(idx), [](const CommandArgsView& args) { return args.has_flag("fail") ? R::err("fail") : R::ok(nullptr); }));
+	}
+
+	// Lines naming random registered commands, so lookups do not stay on one hot path.
+	std::vector<std::string> make_lines(size_t size)
+	{
+		std::mt19937 rng(11);
+		std::vector<std::string> lines;
+		for (size_t idx = 0; idx < 256; ++idx) lines.push_back(command_name(rng() % size) + " alpha --level 3 --verbose");
+		return lines;
+	}
+
+	template<typename TerminalT, typename Invoke>
+	bench::Body dispatch_body(size_t size, Invoke invoke)
+	{
+		auto terminal = std::make_shared<TerminalT>();
+		fill(*terminal, size);
+		return [terminal, lines = make_lines(size), invoke](size_t iterations)
+			{
+				for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(invoke(*terminal, lines[idx & 255]));
+			};
+	}
+}
+
+CMDKIT_BENCH_REGISTER
+{
+	for (size_t size : { 10, 100, 1000, 10000, 100000 })
+	{
+		const std::string suffix = "/" + std::to_string(size);
+
+		bench::add("dispatch", "Terminal::invoke(line)" + suffix, [size]()
+			{
+				return dispatch_body<Terminal>(size, [](const Terminal& terminal, const std::string& line) { return terminal.invoke(line); });
+			});
+
+		bench::add("dispatch", "Terminal::invoke(CommandArgs::parse)" + suffix, [size]()
+			{
+				return dispatch_body<Terminal>(size, [](const Terminal& terminal, const std::string& line) { return terminal.invoke(CommandArgs::parse(line)); });
+			});
+
+		bench::add("dispatch", "Terminal::find" + suffix, [size]() -> bench::Body
+			{
+				auto terminal = std::make_shared<Terminal>();
+				fill(*terminal, size);
+				std::vector<std::string> names;
+				for (const auto& line : make_lines(size)) names.push_back(line.substr(0, line.find(' ')));
+				return [terminal, names](size_t iterations)
+					{
+						for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(terminal->find(names[idx & 255]));
+					};
+			});
+	}
+
+	for (size_t size : { 10, 100000 })
+	{
+		bench::add("dispatch", "ConcurrentTerminal::invoke(line)/" + std::to_string(size), [size]()
+			{
+				return dispatch_body<ConcurrentTerminal>(size, [](const ConcurrentTerminal& terminal, const std::string& line) { return terminal.invoke(line); });
+			});
+	}
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "bench.hpp"
+#include "command.hpp"
+
+#include <array>
+#include <functional>
+#include <string>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+namespace
+{
+	R counting_handler(void* context, const CommandArgsView& args)
+	{
+		*static_cast<size_t*>(context) += args.get_positional().size();
+		return R::ok(nullptr);
+	}
+
+	template<typename Handler>
+	bench::Body call_body(std::function<Handler(size_t&)> make)
+	{
+		struct Fixture
+		{
+			CommandArgsView args = CommandArgsView::parse("status alpha beta --verbose");
+			size_t counter = 0;
+			Handler handler;
+		};
+		auto fixture = std::make_shared<Fixture>();
+		fixture->handler = make(fixture->counter);
+		return [fixture](size_t iterations)
+			{
+				for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(fixture->handler(fixture->args));
+			};
+	}
+}
+
+CMDKIT_BENCH_REGISTER
+{
+	using StdHandler = std::function<R(const CommandArgsView&)>;
+	using InplaceHandler = Command::ViewHandler;
+
+	auto small = [](size_t& counter) { return [&counter](const CommandArgsView& args) { counter += args.get_positional().size(); return R::ok(nullptr); }; };
+	auto wide = [](size_t& counter)
+		{
+			std::array<size_t, 8> padding{};
+			return [&counter, padding](const CommandArgsView& args) { counter += args.get_positional().size() + padding[0]; return R::ok(nullptr); };
+		};
+
+	bench::add("handler", "std::function, 8-byte capture", [small]() { return call_body<StdHandler>([small](size_t& counter) { return StdHandler(small(counter)); }); });
+	bench::add("handler", "InplaceFunction, 8-byte capture", [small]() { return call_body<InplaceHandler>([small](size_t& counter) { return InplaceHandler(small(counter)); }); });
+	bench::add("handler", "std::function, 72-byte capture", [wide]() { return call_body<StdHandler>([wide](size_t& counter) { return StdHandler(wide(counter)); }); });
+	bench::add("handler", "InplaceFunction, 72-byte capture", [wide]() { return call_body<InplaceHandler>([wide](size_t& counter) { return InplaceHandler(wide(counter)); }); });
+	bench::add("handler", "InplaceFunction, fn pointer + context", []() { return call_body<InplaceHandler>([](size_t& counter) { return InplaceHandler(&counting_handler, &counter); }); });
+}
\ No newline at end of file
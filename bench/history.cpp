@@ -0,0 +1,102 @@
+#include "bench.hpp"
+#include "history.hpp"
+#include "terminal.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+using namespace cmdkit;
+
+namespace
+{
+	using R = Result<void*, std::string>;
+
+	// A history in a fresh temporary file, removed when the fixture goes away.
+	struct TempHistory
+	{
+		std::string path;
+		std::shared_ptr<CommandHistory> history;
+
+		explicit TempHistory(size_t entries)
+		{
+			static size_t counter = 0;
+			path = (std::filesystem::temp_directory_path() / ("cmdkit_bench_history_" + std::to_string(counter++) + ".log")).string();
+			std::remove(path.c_str());
+
+			HistoryOptions options;
+			options.max_bytes = size_t(256) << 20;
+			history = CommandHistory::open(path, options).unwrap();
+			for (size_t idx = 0; idx < entries; ++idx)
+				history->record("deploy --service svc" + std::to_string(idx % 5000) + " --region eu-west-" + std::to_string(idx % 7) + " --build " + std::to_string(idx));
+		}
+
+		~TempHistory()
+		{
+			history.reset();
+			std::remove(path.c_str());
+		}
+	};
+
+	std::shared_ptr<Terminal> make_terminal()
+	{
+		auto terminal = std::make_shared<Terminal>();
+		terminal->register_command(Command("status", [](const CommandArgsView& args) { return args.has_flag("fail") ? R::err("fail") : R::ok(nullptr); }));
+		return terminal;
+	}
+}
+
+// Recording cost inside Terminal::invoke, and Ctrl-R style searches over a million entries:
+// a recent hit, a miss the block signatures rule out, and a prefix that matches nothing.
+CMDKIT_BENCH_REGISTER
+{
+	bench::add("history", "invoke", []() -> bench::Body
+		{
+			auto terminal = make_terminal();
+			return [terminal](size_t iterations)
+				{
+					const std::string line = "status --region eu-west-1 --verbose";
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(terminal->invoke(line));
+				};
+		});
+
+	bench::add("history", "invoke + record", []() -> bench::Body
+		{
+			auto terminal = make_terminal();
+			auto temp = std::make_shared<TempHistory>(0);
+			terminal->set_history(temp->history);
+			return [terminal, temp](size_t iterations)
+				{
+					const std::string lines[] = { "status --region eu-west-1 --verbose", "status --region eu-west-2 --verbose" };
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(terminal->invoke(lines[idx & 1]));
+				};
+		});
+
+	bench::add("history", "search 1M (recent hit)", []() -> bench::Body
+		{
+			auto temp = std::make_shared<TempHistory>(1000000);
+			return [temp](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(temp->history->search("svc4321 "));
+				};
+		});
+
+	bench::add("history", "search 1M (miss)", []() -> bench::Body
+		{
+			auto temp = std::make_shared<TempHistory>(1000000);
+			return [temp](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(temp->history->search("kubectl"));
+				};
+		});
+
+	bench::add("history", "search_prefix 1M (miss)", []() -> bench::Body
+		{
+			auto temp = std::make_shared<TempHistory>(1000000);
+			return [temp](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(temp->history->search_prefix("status"));
+				};
+		});
+}
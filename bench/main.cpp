@@ -0,0 +1,210 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+size_t cmdkit::bench::allocation_count() { return allocations.load(std::memory_order_relaxed); }
+
+namespace
+{
+	using namespace cmdkit::bench;
+	using Clock = std::chrono::steady_clock;
+
+	enum class Format { text, csv, json };
+
+	struct Options
+	{
+		Format format = Format::text;
+		std::string filter;
+		double min_time = 0.2;
+		size_t repetitions = 3;
+		bool list = false;
+	};
+
+	struct Measurement
+	{
+		const Case* bench = nullptr;
+		size_t iterations = 0;
+		double ns_per_op = 0;
+		double allocs_per_op = 0;
+
+		double ops_per_second() const { return ns_per_op > 0 ? 1e9 / ns_per_op : 0; }
+		double bytes_per_second() const { return bench->bytes_per_op * ops_per_second(); }
+	};
+
+	double seconds_for(const Body& body, size_t iterations)
+	{
+		auto start = Clock::now();
+		body(iterations);
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Grows the iteration count until one run takes min_time, then keeps the fastest of
+	// `repetitions` runs of that size.
+	Measurement measure(const Case& bench, const Options& options)
+	{
+		Body body = bench.factory();
+
+		size_t iterations = 1;
+		double elapsed = seconds_for(body, iterations);
+		while (elapsed < options.min_time && iterations < (size_t(1) << 40))
+		{
+			const double scale = elapsed > 0 ? std::min(10.0, std::max(2.0, 1.2 * options.min_time / elapsed)) : 10.0;
+			iterations = size_t(iterations * scale);
+			elapsed = seconds_for(body, iterations);
+		}
+
+		Measurement result{ &bench, iterations };
+		double best = elapsed;
+		size_t allocated = 0;
+		for (size_t rep = 0; rep < options.repetitions; ++rep)
+		{
+			const size_t before = allocation_count();
+			best = std::min(best, seconds_for(body, iterations));
+			allocated = allocation_count() - before;
+		}
+		result.ns_per_op = best * 1e9 / iterations;
+		result.allocs_per_op = double(allocated) / iterations;
+		return result;
+	}
+
+	std::string json_escape(std::string_view str)
+	{
+		std::string out;
+		for (char ch : str)
+		{
+			if (ch == '"' || ch == '\\') out += '\\';
+			out += ch;
+		}
+		return out;
+	}
+
+	std::string csv_quote(std::string_view str)
+	{
+		std::string out = "\"";
+		for (char ch : str)
+		{
+			if (ch == '"') out += '"';
+			out += ch;
+		}
+		return out + "\"";
+	}
+
+	void print_header(const Options& options)
+	{
+		if (options.format == Format::text)
+			std::printf("%-12s %-44s %14s %12s %14s %12s\n", "suite", "case", "iterations", "ns/op", "ops/s", "allocs/op");
+		else if (options.format == Format::csv)
+			std::printf("suite,case,iterations,ns_per_op,ops_per_second,allocs_per_op,bytes_per_second\n");
+		else
+		{
+			std::printf("{\n  \"context\": {\"compiler\": \"%s\", \"cplusplus\": %ld, \"build_type\": \"%s\"},\n  \"benchmarks\": [",
+				json_escape(
+#if defined(__clang__)
+					"clang " __clang_version__
+#elif defined(__GNUC__)
+					"gcc " __VERSION__
+#elif defined(_MSC_VER)
+					"msvc"
+#else
+					"unknown"
+#endif
+				).c_str(), long(__cplusplus), CMDKIT_BENCH_BUILD_TYPE);
+		}
+	}
+
+	void print(const Measurement& m, const Options& options, bool first)
+	{
+		const Case& bench = *m.bench;
+		if (options.format == Format::text)
+		{
+			std::printf("%-12s %-44s %14zu %12.2f %14.0f %12.2f", bench.suite.c_str(), bench.name.c_str(), m.iterations, m.ns_per_op, m.ops_per_second(), m.allocs_per_op);
+			if (bench.bytes_per_op) std::printf("  %.0f MB/s", m.bytes_per_second() / (1 << 20));
+			std::printf("\n");
+		}
+		else if (options.format == Format::csv)
+			std::printf("%s,%s,%zu,%.3f,%.1f,%.3f,%.1f\n", csv_quote(bench.suite).c_str(), csv_quote(bench.name).c_str(), m.iterations, m.ns_per_op, m.ops_per_second(), m.allocs_per_op, m.bytes_per_second());
+		else
+			std::printf("%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, \"ops_per_second\": %.1f, \"allocs_per_op\": %.3f, \"bytes_per_second\": %.1f}",
+				first ? "" : ",", json_escape(bench.suite).c_str(), json_escape(bench.name).c_str(), m.iterations, m.ns_per_op, m.ops_per_second(), m.allocs_per_op, m.bytes_per_second());
+		std::fflush(stdout);
+	}
+
+	void print_footer(const Options& options)
+	{
+		if (options.format == Format::json) std::printf("\n  ]\n}\n");
+	}
+
+	bool parse_options(int argc, char** argv, Options& options)
+	{
+		for (int idx = 1; idx < argc; ++idx)
+		{
+			const std::string_view arg = argv[idx];
+			auto value_of = [&arg](std::string_view key) { return arg.substr(key.size()); };
+
+			if (arg == "--list") options.list = true;
+			else if (arg.rfind("--filter=", 0) == 0) options.filter = std::string(value_of("--filter="));
+			else if (arg.rfind("--min-time=", 0) == 0) options.min_time = std::atof(std::string(value_of("--min-time=")).c_str());
+			else if (arg.rfind("--repetitions=", 0) == 0) options.repetitions = std::max(1, std::atoi(std::string(value_of("--repetitions=")).c_str()));
+			else if (arg == "--format=text") options.format = Format::text;
+			else if (arg == "--format=csv") options.format = Format::csv;
+			else if (arg == "--format=json") options.format = Format::json;
+			else
+			{
+				std::fprintf(stderr,
+					"usage: %s [--list] [--filter=SUBSTRING] [--format=text|csv|json] [--min-time=SECONDS] [--repetitions=N]\n", argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options)) return 2;
+
+	std::vector<const Case*> selected;
+	for (const Case& bench : registry())
+		if ((bench.suite + "/" + bench.name).find(options.filter) != std::string::npos) selected.push_back(&bench);
+	std::stable_sort(selected.begin(), selected.end(), [](const Case* lhs, const Case* rhs) { return lhs->suite < rhs->suite; });
+
+	if (options.list)
+	{
+		for (const Case* bench : selected) std::printf("%s/%s\n", bench->suite.c_str(), bench->name.c_str());
+		return 0;
+	}
+
+	print_header(options);
+	bool first = true;
+	for (const Case* bench : selected)
+	{
+		print(measure(*bench, options), options, first);
+		first = false;
+	}
+	print_footer(options);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "bench.hpp"
+#include "metrics.hpp"
+
+#include <chrono>
+#include <memory>
+
+using namespace cmdkit;
+
+// The cost Terminal adds per dispatch when built with CMDKIT_ENABLE_METRICS: two clock reads
+// and one CommandMetrics::record.
+CMDKIT_BENCH_REGISTER
+{
+	bench::add("metrics", "CommandMetrics::record", []() -> bench::Body
+		{
+			auto metrics = std::make_shared<CommandMetrics>();
+			return [metrics](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) metrics->record(200 + (idx & 1023), (idx & 15) != 0);
+				};
+		});
+
+	bench::add("metrics", "steady_clock::now x2", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						const auto start = std::chrono::steady_clock::now();
+						bench::do_not_optimize(std::chrono::steady_clock::now() - start);
+					}
+				};
+		});
+}
\ No newline at end of file
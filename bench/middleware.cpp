@@ -0,0 +1,55 @@
+#include "bench.hpp"
+#include "terminal.hpp"
+
+#include <memory>
+#include <string>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+namespace
+{
+	struct NoopLayer
+	{
+		void before(const Command&, CommandArgsView&) const {}
+		void after(const Command&, const CommandArgsView&, R&) const {}
+	};
+
+	template<typename TerminalT, typename Setup>
+	bench::Body invoke_body(Setup setup)
+	{
+		auto terminal = std::make_shared<TerminalT>();
+		terminal->register_command(Command("status", [](const CommandArgsView& args) { return args.has_flag("fail") ? R::err("fail") : R::ok(nullptr); }));
+		setup(*terminal);
+		return [terminal](size_t iterations)
+			{
+				const std::string line = "status alpha --level 3 --verbose";
+				for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(terminal->invoke(line));
+			};
+	}
+}
+
+// What the middleware chain costs per dispatch: nothing but an emptiness check when there
+// are no layers, the inlined hook bodies for compile-time layers, and two indirect calls
+// per runtime interceptor.
+CMDKIT_BENCH_REGISTER
+{
+	bench::add("middleware", "Terminal, empty chain", []() { return invoke_body<Terminal>([](Terminal&) {}); });
+
+	bench::add("middleware", "BasicTerminal<NoopLayer>", []() { return invoke_body<BasicTerminal<NoopLayer>>([](BasicTerminal<NoopLayer>&) {}); });
+
+	bench::add("middleware", "BasicTerminal<NoopLayer x4>", []()
+		{
+			using T = BasicTerminal<NoopLayer, NoopLayer, NoopLayer, NoopLayer>;
+			return invoke_body<T>([](T&) {});
+		});
+
+	bench::add("middleware", "Terminal, 1 noop interceptor", []()
+		{
+			return invoke_body<Terminal>([](Terminal& terminal)
+				{
+					terminal.add_interceptor({ [](const Command&, CommandArgsView&) { return Result<void, std::string>::ok(); },
+						[](const Command&, const CommandArgsView&, R&) {} });
+				});
+		});
+}
\ No newline at end of file
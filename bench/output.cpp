@@ -0,0 +1,61 @@
+#include "bench.hpp"
+#include "output.hpp"
+
+#include <memory>
+#include <string_view>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace cmdkit;
+
+namespace
+{
+	constexpr std::string_view line = "resize photo.png -> 640x480 (ratio kept)\n";
+
+	int open_null()
+	{
+#if defined(_WIN32)
+		return _open("NUL", _O_WRONLY);
+#else
+		return ::open("/dev/null", O_WRONLY);
+#endif
+	}
+}
+
+// One line of handler output: a write(2) per line, as std::endl does, against the buffered
+// sink that batches lines into one writev per block.
+CMDKIT_BENCH_REGISTER
+{
+	bench::add("output", "write per line", []() -> bench::Body
+		{
+			const int fd = open_null();
+			return [fd](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(detail::write_fd(fd, &line, 1));
+				};
+		}, line.size());
+
+	bench::add("output", "OutputSink::write", []() -> bench::Body
+		{
+			auto sink = std::make_shared<OutputSink>(open_null());
+			return [sink](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) sink->write(line);
+				};
+		}, line.size());
+
+	bench::add("output", "OutputSink << value", []() -> bench::Body
+		{
+			auto sink = std::make_shared<OutputSink>(open_null());
+			return [sink](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) *sink << "id " << idx << ' ' << 0.5 << '\n';
+				};
+		});
+}
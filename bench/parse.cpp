@@ -0,0 +1,96 @@
+#include "bench.hpp"
+#include "command.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cmdkit;
+
+namespace
+{
+	// A command line of roughly `size` bytes mixing positionals, options and flags.
+	std::string make_command_line(size_t size)
+	{
+		static const char* words[] = { "--region", "eu-west-1", "--dry-run", "path/to/file.txt", "--retries", "3", "alpha", "--verbose" };
+		std::mt19937 rng(7);
+		std::string line = "deploy";
+		while (line.size() < size)
+		{
+			line += ' ';
+			line += words[rng() % 8];
+		}
+		return line;
+	}
+
+	std::vector<std::string> split(const std::string& line)
+	{
+		std::vector<std::string> tokens;
+		detail::tokenize(line, [&tokens](std::string_view token) { tokens.emplace_back(token); });
+		return tokens;
+	}
+}
+
+CMDKIT_BENCH_REGISTER
+{
+	for (size_t size : { 16, 64, 256, 1024 })
+	{
+		const std::string suffix = "/" + std::to_string(size) + "B";
+
+		bench::add("parse", "CommandArgs::parse(string)" + suffix, [size]() -> bench::Body
+			{
+				return [line = make_command_line(size)](size_t iterations)
+					{
+						for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(CommandArgs::parse(line));
+					};
+			}, size);
+
+		bench::add("parse", "CommandArgs::parse(vector)" + suffix, [size]() -> bench::Body
+			{
+				return [tokens = split(make_command_line(size))](size_t iterations)
+					{
+						for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(CommandArgs::parse(tokens));
+					};
+			}, size);
+
+		bench::add("parse", "ParseContext::parse" + suffix, [size]() -> bench::Body
+			{
+				return [line = make_command_line(size), context = ParseContext()](size_t iterations) mutable
+					{
+						for (size_t idx = 0; idx < iterations; ++idx)
+						{
+							ParseContext::Scope scope(context);
+							bench::do_not_optimize(context.parse(line));
+						}
+					};
+			}, size);
+	}
+
+	// Quotes, escapes, `--key=value` and a bundle; the quoted and escaped tokens take the
+	// byte-at-a-time path through the grammar DFAs.
+	bench::add("parse", "ParseContext::parse/quoted", []() -> bench::Body
+		{
+			return [line = std::string(R"(deploy --region "eu west 1" --name='my app' -vf path/to/my\ file.txt --retries=3)"), context = ParseContext()](size_t iterations) mutable
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						ParseContext::Scope scope(context);
+						bench::do_not_optimize(context.parse(line));
+					}
+				};
+		}, 80);
+
+	bench::add("parse", "ArgSchema::parse/64B", []() -> bench::Body
+		{
+			auto schema = std::make_shared<ArgSchema>();
+			schema->option("region").option("retries").flag("dry-run").flag("verbose");
+			return [schema, line = std::string("deploy alpha --region eu-west-1 --dry-run --retries 3 --verbose"), context = ParseContext()](size_t iterations) mutable
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						ParseContext::Scope scope(context);
+						bench::do_not_optimize(schema->parse(line, context.resource()));
+					}
+				};
+		}, 64);
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "bench.hpp"
+#include "result.hpp"
+
+#include <string>
+
+using namespace cmdkit;
+
+namespace
+{
+	using R = Result<int, std::string>;
+	using Small = Result<int, unsigned>;
+
+	R checked_half(int val) { return val % 2 == 0 ? R::ok(val / 2) : R::err("odd"); }
+	Small checked_half_small(int val) { return val % 2 == 0 ? Small::ok(val / 2) : Small::err(1u); }
+}
+
+CMDKIT_BENCH_REGISTER
+{
+	bench::add("result", "map x4 <int, string>", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						auto val = R::ok(int(idx)).map([](int x) { return x + 1; }).map([](int x) { return x * 3; }).map([](int x) { return x - 2; }).map([](int x) { return x ^ 5; });
+						bench::do_not_optimize(val);
+					}
+				};
+		});
+
+	bench::add("result", "and_then x3 <int, string>", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						auto val = R::ok(int(idx) << 3).and_then(checked_half).and_then(checked_half).and_then(checked_half);
+						bench::do_not_optimize(val);
+					}
+				};
+		});
+
+	bench::add("result", "and_then x3 error path <int, string>", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						auto val = R::ok(int(idx) | 1).and_then(checked_half).and_then(checked_half).and_then(checked_half);
+						bench::do_not_optimize(val);
+					}
+				};
+		});
+
+	bench::add("result", "and_then x3 <int, unsigned>", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						auto val = Small::ok(int(idx) << 3).and_then(checked_half_small).and_then(checked_half_small).and_then(checked_half_small);
+						bench::do_not_optimize(val);
+					}
+				};
+		});
+
+	bench::add("result", "map + and_then + match <int, string>", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						int val = R::ok(int(idx)).map([](int x) { return x * 2; }).and_then(checked_half)
+							.match([](int x) { return x; }, [](const std::string& err) { return int(err.size()); });
+						bench::do_not_optimize(val);
+					}
+				};
+		});
+
+	bench::add("result", "map to void <void, string>", []() -> bench::Body
+		{
+			return [](size_t iterations)
+				{
+					int sum = 0;
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(R::ok(int(idx)).map([&sum](int x) { sum += x; }));
+					bench::do_not_optimize(sum);
+				};
+		});
+}
\ No newline at end of file
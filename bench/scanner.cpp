@@ -0,0 +1,79 @@
+#include "bench.hpp"
+#include "scanner.hpp"
+
+#include <cctype>
+#include <random>
+#include <string>
+
+using namespace cmdkit;
+
+namespace
+{
+	// The per-byte std::isspace loop the bitmap tokenizer replaced.
+	template<typename Fn>
+	void tokenize_isspace(std::string_view args_str, Fn&& on_token)
+	{
+		size_t pos = 0;
+		while (pos < args_str.size())
+		{
+			while (pos < args_str.size() && std::isspace(static_cast<unsigned char>(args_str[pos]))) pos++;
+			if (pos >= args_str.size()) break;
+
+			size_t start = pos;
+			while (pos < args_str.size() && !std::isspace(static_cast<unsigned char>(args_str[pos]))) pos++;
+			on_token(args_str.substr(start, pos - start));
+		}
+	}
+
+	std::string make_line(size_t size)
+	{
+		static const char* words[] = { "deploy", "--region", "eu-west-1", "--dry-run", "path/to/file.txt", "--retries", "3", "x" };
+		std::mt19937 rng(42);
+		std::string line;
+		while (line.size() < size)
+		{
+			line += words[rng() % 8];
+			line += (rng() % 4 == 0) ? "\t" : " ";
+		}
+		line.resize(size);
+		return line;
+	}
+
+	template<typename Tokenize>
+	bench::Body tokenize_body(size_t size, Tokenize tokenize)
+	{
+		return [line = make_line(size), tokenize](size_t iterations)
+			{
+				size_t tokens = 0;
+				auto count = [&tokens](std::string_view token) { tokens += token.size() != 0; };
+				for (size_t idx = 0; idx < iterations; ++idx) tokenize(line, count);
+				bench::do_not_optimize(tokens);
+			};
+	}
+}
+
+CMDKIT_BENCH_REGISTER
+{
+	using Isa = StructuralScanner::Isa;
+
+	for (size_t size : { 32, 256, 4096, 65536 })
+	{
+		const std::string suffix = "/" + std::to_string(size) + "B";
+
+		bench::add("scanner", "isspace" + suffix, [size]()
+			{
+				return tokenize_body(size, [](std::string_view str, auto& fn) { tokenize_isspace(str, fn); });
+			}, size);
+
+		for (Isa isa : { Isa::scalar, Isa::sse2, Isa::avx2 })
+		{
+			if (isa > StructuralScanner::detected_isa()) continue;
+			const char* isa_name = isa == Isa::scalar ? "scalar" : isa == Isa::sse2 ? "sse2" : "avx2";
+			bench::add("scanner", std::string(isa_name) + suffix, [size, isa]()
+				{
+					const auto scan_fn = StructuralScanner::select(isa);
+					return tokenize_body(size, [scan_fn](std::string_view str, auto& fn) { detail::tokenize(str, scan_fn, fn); });
+				}, size);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "server.hpp"
+#include "terminal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	struct Options
+	{
+		size_t connections = 1000;
+		size_t depth = 4;
+		double seconds = 2.0;
+		std::string socket;
+		std::string command = "status --region eu-west-1 --verbose";
+	};
+
+	struct Client
+	{
+		int fd = -1;
+		std::deque<Clock::time_point> in_flight;
+		std::string outbox;
+		uint32_t events = EPOLLIN;
+		bool at_line_start = true;
+	};
+
+	bool parse_options(int argc, char** argv, Options& options)
+	{
+		for (int idx = 1; idx < argc; ++idx)
+		{
+			const std::string_view arg = argv[idx];
+			auto value = [&arg](std::string_view key) { return arg.substr(key.size()); };
+			if (arg.rfind("--connections=", 0) == 0) options.connections = std::strtoull(value("--connections=").data(), nullptr, 10);
+			else if (arg.rfind("--depth=", 0) == 0) options.depth = std::strtoull(value("--depth=").data(), nullptr, 10);
+			else if (arg.rfind("--seconds=", 0) == 0) options.seconds = std::strtod(value("--seconds=").data(), nullptr);
+			else if (arg.rfind("--socket=", 0) == 0) options.socket = std::string(value("--socket="));
+			else if (arg.rfind("--command=", 0) == 0) options.command = std::string(value("--command="));
+			else
+			{
+				std::fprintf(stderr,
+					"usage: bench_server_load [--connections=N] [--depth=N] [--seconds=S] [--socket=PATH] [--command=LINE]\n"
+					"Without --socket, an in-process TerminalServer with a no-op `status` command is measured.\n"
+					"The command must print nothing, so that each reply is one status line.\n");
+				return false;
+			}
+		}
+		return options.connections > 0 && options.depth > 0;
+	}
+
+	void raise_fd_limit()
+	{
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	int connect_to(const std::string& path)
+	{
+		const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::memcpy(address.sun_path, path.c_str(), std::min(path.size() + 1, sizeof(address.sun_path) - 1));
+		if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			if (fd >= 0) ::close(fd);
+			return -1;
+		}
+		::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+		return fd;
+	}
+
+	// Polls for EPOLLOUT only while requests are stuck in the outbox.
+	void update_events(int poller, Client& client)
+	{
+		const uint32_t wanted = uint32_t(EPOLLIN) | (client.outbox.empty() ? 0u : uint32_t(EPOLLOUT));
+		if (wanted == client.events) return;
+
+		epoll_event event{};
+		event.events = wanted;
+		event.data.ptr = &client;
+		::epoll_ctl(poller, EPOLL_CTL_MOD, client.fd, &event);
+		client.events = wanted;
+	}
+
+	// Queues count requests and writes as much of the outbox as the socket takes.
+	bool submit(int poller, Client& client, const std::string& request, size_t count)
+	{
+		const Clock::time_point now = Clock::now();
+		for (size_t idx = 0; idx < count; ++idx)
+		{
+			client.outbox += request;
+			client.in_flight.push_back(now);
+		}
+
+		while (!client.outbox.empty())
+		{
+			const ssize_t written = ::send(client.fd, client.outbox.data(), client.outbox.size(), MSG_NOSIGNAL);
+			if (written < 0)
+			{
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+				return false;
+			}
+			client.outbox.erase(0, size_t(written));
+		}
+		update_events(poller, client);
+		return true;
+	}
+
+	double percentile(const std::vector<uint64_t>& sorted, double fraction)
+	{
+		if (sorted.empty()) return 0.0;
+		return double(sorted[std::min(sorted.size() - 1, size_t(fraction * double(sorted.size())))]) / 1e3;
+	}
+}
+
+// Opens the connections, keeps `depth` requests in flight on each from one epoll loop and
+// reports replies per second and reply latency.
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options)) return 1;
+	raise_fd_limit();
+
+	Terminal terminal;
+	terminal.register_command(Command("status", [](const CommandArgsView& args) { return args.has_flag("fail") ? R::err("fail") : R::ok(nullptr); }));
+	TerminalServer server(terminal);
+	std::thread serving;
+	if (options.socket.empty())
+	{
+		options.socket = "/tmp/cmdkit_server_load_" + std::to_string(::getpid()) + ".sock";
+		if (auto listening = server.listen(options.socket); listening.is_err())
+		{
+			std::fprintf(stderr, "%s\n", listening.unwrap_err().c_str());
+			return 1;
+		}
+		serving = std::thread([&server]() { server.run(); });
+	}
+	auto finish = [&server, &serving](int code)
+		{
+			if (serving.joinable()) { server.stop(); serving.join(); }
+			return code;
+		};
+
+	const int poller = ::epoll_create1(EPOLL_CLOEXEC);
+	std::vector<Client> clients(options.connections);
+	for (Client& client : clients)
+	{
+		client.fd = connect_to(options.socket);
+		if (client.fd < 0)
+		{
+			std::fprintf(stderr, "Can't connect to %s: %s\n", options.socket.c_str(), std::strerror(errno));
+			return finish(1);
+		}
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.ptr = &client;
+		::epoll_ctl(poller, EPOLL_CTL_ADD, client.fd, &event);
+	}
+
+	const std::string request = options.command + "\n";
+	std::vector<uint64_t> latencies;
+	size_t errors = 0;
+
+	const Clock::time_point start = Clock::now();
+	const Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+	for (Client& client : clients) submit(poller, client, request, options.depth);
+
+	std::vector<epoll_event> events(256);
+	char buffer[64 * 1024];
+	while (Clock::now() < deadline)
+	{
+		const int count = ::epoll_wait(poller, events.data(), int(events.size()), 50);
+		for (int idx = 0; idx < count; ++idx)
+		{
+			Client& client = *static_cast<Client*>(events[idx].data.ptr);
+			if (events[idx].events & EPOLLOUT) submit(poller, client, request, 0);
+			if (!(events[idx].events & EPOLLIN)) continue;
+
+			const ssize_t size = ::read(client.fd, buffer, sizeof(buffer));
+			if (size <= 0)
+			{
+				if (size < 0 && errno == EAGAIN) continue;
+				std::fprintf(stderr, "Server closed a connection\n");
+				return finish(1);
+			}
+
+			const Clock::time_point now = Clock::now();
+			size_t replies = 0;
+			for (ssize_t pos = 0; pos < size; ++pos)
+			{
+				if (client.at_line_start && buffer[pos] == 'e') errors++;
+				client.at_line_start = buffer[pos] == '\n';
+				if (!client.at_line_start || client.in_flight.empty()) continue;
+				latencies.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - client.in_flight.front()).count()));
+				client.in_flight.pop_front();
+				replies++;
+			}
+			if (replies && now < deadline) submit(poller, client, request, replies);
+		}
+	}
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	for (Client& client : clients) ::close(client.fd);
+	::close(poller);
+	finish(0);
+
+	std::sort(latencies.begin(), latencies.end());
+	std::printf("connections %zu, depth %zu, %.2f s\n", options.connections, options.depth, elapsed);
+	std::printf("%-12s %14s %10s %10s %10s %10s %10s\n", "replies", "cmds/s", "p50_us", "p99_us", "p999_us", "max_us", "errors");
+	std::printf("%-12zu %14.0f %10.1f %10.1f %10.1f %10.1f %10zu\n", latencies.size(), double(latencies.size()) / elapsed,
+		percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999),
+		latencies.empty() ? 0.0 : double(latencies.back()) / 1e3, errors);
+	return 0;
+}
+#else
+int main()
+{
+	std::fprintf(stderr, "bench_server_load needs epoll (Linux)\n");
+	return 1;
+}
+#endif
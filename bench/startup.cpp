@@ -0,0 +1,138 @@
+#include "startup_commands.hpp"
+#include "terminal.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace cmdkit;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	enum class Mode { eager, lazy, plugin };
+
+	struct Sample
+	{
+		double ready_us;
+		double first_us;
+		long rss_kib;
+	};
+
+	long resident_kib()
+	{
+		long pages = 0, resident = 0;
+		FILE* statm = std::fopen("/proc/self/statm", "r");
+		if (!statm) return 0;
+		if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+		std::fclose(statm);
+		return resident * (sysconf(_SC_PAGESIZE) / 1024);
+	}
+
+	double micros(Clock::duration elapsed) { return std::chrono::duration<double, std::micro>(elapsed).count(); }
+
+	// Registers count commands the given way, then dispatches one of them. "Ready" is the
+	// time to the first prompt; RSS is what the process grew by until then.
+	Sample run(Mode mode, size_t count)
+	{
+		const long rss_before = resident_kib();
+		const auto start = Clock::now();
+
+		auto terminal = new Terminal();
+		if (mode == Mode::eager)
+		{
+			for (size_t idx = 0; idx < count; ++idx) terminal->register_command(startup::make_command(startup::command_name(idx), startup::command_description(idx)));
+		}
+		else if (mode == Mode::lazy)
+		{
+			for (size_t idx = 0; idx < count; ++idx)
+			{
+				std::string name = startup::command_name(idx);
+				std::string description = startup::command_description(idx);
+				terminal->register_lazy_command(name, description, [name, description]() { return startup::make_command(name, description); });
+			}
+		}
+		else
+		{
+			std::vector<PluginCommand> commands;
+			commands.reserve(count);
+			for (size_t idx = 0; idx < count; ++idx) commands.push_back(PluginCommand{ startup::command_name(idx), startup::command_description(idx) });
+			terminal->register_plugin(CMDKIT_BENCH_PLUGIN, commands);
+		}
+
+		const auto ready = Clock::now();
+		const long rss_ready = resident_kib();
+		const bool ok = terminal->invoke(startup::command_name(count / 2) + " --region eu-west-1 --verbose").is_ok();
+		const auto first = Clock::now();
+		if (!ok) std::fprintf(stderr, "first command failed\n");
+
+		// The process exits right after; the terminal is left for the OS to reclaim, as a CLI would.
+		return Sample{ micros(ready - start), micros(first - ready), rss_ready - rss_before };
+	}
+
+	// Each mode runs in a fresh process, so allocator state and loaded libraries don't carry over.
+	bool sample(Mode mode, size_t count, Sample& out)
+	{
+		int fds[2];
+		if (pipe(fds) != 0) return false;
+
+		const pid_t pid = fork();
+		if (pid == 0)
+		{
+			close(fds[0]);
+			const Sample result = run(mode, count);
+			const bool written = write(fds[1], &result, sizeof(result)) == ssize_t(sizeof(result));
+			_exit(written ? 0 : 1);
+		}
+
+		close(fds[1]);
+		const bool read_ok = pid > 0 && read(fds[0], &out, sizeof(out)) == ssize_t(sizeof(out));
+		close(fds[0]);
+		if (pid > 0) waitpid(pid, nullptr, 0);
+		return read_ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<size_t> counts = { 100, 1000, 10000 };
+	if (argc > 1)
+	{
+		counts.clear();
+		for (int idx = 1; idx < argc; ++idx)
+		{
+			const std::string_view arg = argv[idx];
+			if (arg.rfind("--commands=", 0) != 0)
+			{
+				std::fprintf(stderr, "usage: bench_startup [--commands=N]...\n");
+				return 1;
+			}
+			counts.push_back(std::strtoull(arg.substr(11).data(), nullptr, 10));
+		}
+	}
+
+	std::printf("%-10s %-8s %16s %16s %12s\n", "commands", "mode", "first prompt", "first command", "startup RSS");
+	for (size_t count : counts)
+		for (auto [mode, label] : { std::pair{ Mode::eager, "eager" }, std::pair{ Mode::lazy, "lazy" }, std::pair{ Mode::plugin, "plugin" } })
+		{
+			Sample result;
+			if (!sample(mode, count, result)) { std::fprintf(stderr, "%s run failed\n", label); return 1; }
+			std::printf("%-10zu %-8s %13.1f us %13.1f us %8ld KiB\n", count, label, result.ready_us, result.first_us, result.rss_kib);
+		}
+	return 0;
+}
+#else
+int main()
+{
+	std::fprintf(stderr, "bench_startup needs fork and /proc (Linux)\n");
+	return 1;
+}
+#endif
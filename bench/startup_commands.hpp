@@ -0,0 +1,48 @@
+#ifndef CMDKIT_BENCH_STARTUP_COMMANDS
+#define CMDKIT_BENCH_STARTUP_COMMANDS
+
+#include "command.hpp"
+
+#include <string>
+#include <vector>
+
+// The command set of bench_startup, shared with its plugin library: names like
+// "deploy-route-12", each with a schema of a few options and a handler that owns some state,
+// as a real command built at startup would.
+namespace startup
+{
+	inline std::string command_name(size_t idx)
+	{
+		static const char* const verbs[] = { "get", "set", "list", "delete", "create", "describe", "deploy", "restart", "scale", "watch" };
+		static const char* const nouns[] = { "user", "cluster", "node", "volume", "secret", "service", "route", "quota", "image", "job", "policy", "bucket" };
+		return std::string(verbs[idx % 10]) + "-" + nouns[(idx / 10) % 12] + "-" + std::to_string(idx / 120);
+	}
+
+	inline std::string command_description(size_t idx) { return "Runs " + command_name(idx) + " against the current context"; }
+
+	inline cmdkit::Command make_command(const std::string& name, const std::string& description)
+	{
+		using R = cmdkit::Result<void*, std::string>;
+
+		std::vector<std::string> defaults;
+		for (const char* key : { "region", "namespace", "output", "timeout", "selector", "context" })
+			defaults.push_back(name + "." + key);
+
+		cmdkit::Command cmd(name, description, [defaults = std::move(defaults)](const cmdkit::CommandArgsView& args)
+			{
+				return args.has_flag("fail") ? R::err(defaults.front()) : R::ok(nullptr);
+			});
+		cmdkit::ArgSchema schema;
+		schema.option("region", "Region to act on")
+			.option("namespace", "Namespace to act on")
+			.option("output", "Output format")
+			.option("timeout", "Timeout in seconds")
+			.option("selector", "Label selector")
+			.flag("fail", "Fail on purpose")
+			.flag("verbose", "Print more");
+		cmd.set_schema(std::move(schema));
+		return cmd;
+	}
+}
+
+#endif // CMDKIT_BENCH_STARTUP_COMMANDS
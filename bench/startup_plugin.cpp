@@ -0,0 +1,9 @@
+#include "plugin.hpp"
+#include "startup_commands.hpp"
+
+// The plugin bench_startup loads: every name it is asked for is one of its commands.
+CMDKIT_PLUGIN_EXPORT bool cmdkit_make_command(const char* name, cmdkit::Command* out)
+{
+	*out = startup::make_command(name, "");
+	return true;
+}
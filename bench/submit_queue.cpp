@@ -0,0 +1,79 @@
+#include "dispatcher.hpp"
+#include "terminal.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+Command make_command(const std::string& name)
+{
+	return Command(name, [](const CommandArgsView& args) { return args.has_flag("fail") ? R::err("fail") : R::ok(nullptr); });
+}
+
+// Producer threads each submit `per_producer` commands through submit_fn and the clock stops
+// once every one of them has completed.
+template<typename SubmitFn>
+double submissions_per_second(size_t producers, size_t per_producer, std::atomic<size_t>& completed, SubmitFn&& submit_fn)
+{
+	completed = 0;
+	std::atomic<bool> go{ false };
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < producers; ++idx)
+		threads.emplace_back([&]()
+			{
+				while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+				for (size_t count = 0; count < per_producer; ++count) submit_fn();
+			});
+
+	const auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& thread : threads) thread.join();
+	while (completed.load(std::memory_order_acquire) < producers * per_producer) std::this_thread::yield();
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return double(producers * per_producer) / elapsed;
+}
+
+int main()
+{
+	constexpr size_t per_producer = 200000;
+	const std::string line = "status --fast";
+	const CommandArgs parsed = CommandArgs::parse(line);
+
+	std::printf("%-10s %18s %18s %18s\n", "producers", "ring (lines)", "ring (CommandArgs)", "mutex + invoke");
+	for (size_t producers : { 1, 2, 4, 8, 16 })
+	{
+		Terminal terminal;
+		terminal.register_command(make_command("status"));
+		std::atomic<size_t> completed{ 0 };
+		auto done = [&completed](R) { completed.fetch_add(1, std::memory_order_release); };
+
+		TerminalDispatcher<Terminal> dispatcher(terminal);
+		const double lines = submissions_per_second(producers, per_producer, completed,
+			[&]() { dispatcher.submit(line, done); });
+		const double args = submissions_per_second(producers, per_producer, completed,
+			[&]() { dispatcher.submit(parsed, done); });
+		dispatcher.stop();
+
+		std::mutex mutex;
+		const double locked = submissions_per_second(producers, per_producer, completed,
+			[&]()
+			{
+				R result = R::ok(nullptr);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					result = terminal.invoke(line);
+				}
+				done(std::move(result));
+			});
+
+		std::printf("%-10zu %12.2f Mop/s %12.2f Mop/s %12.2f Mop/s\n", producers, lines / 1e6, args / 1e6, locked / 1e6);
+	}
+}
@@ -0,0 +1,76 @@
+#include "bench.hpp"
+#include "suggest.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace cmdkit;
+
+namespace
+{
+	// Command-like names: "get-user-17", "delete-cluster-4031", ...
+	std::vector<std::string> make_names(size_t count)
+	{
+		static const char* const verbs[] = { "get", "set", "list", "delete", "create", "describe", "deploy", "restart", "scale", "watch" };
+		static const char* const nouns[] = { "user", "cluster", "node", "volume", "secret", "service", "route", "quota", "image", "job", "policy", "bucket" };
+		std::vector<std::string> names;
+		names.reserve(count);
+		for (size_t idx = 0; idx < count; ++idx)
+			names.push_back(std::string(verbs[idx % 10]) + "-" + nouns[(idx / 10) % 12] + "-" + std::to_string(idx / 120));
+		return names;
+	}
+
+	std::shared_ptr<NameIndex> make_index(size_t count)
+	{
+		auto index = std::make_shared<NameIndex>();
+		for (const std::string& name : make_names(count)) index->add(name);
+		return index;
+	}
+}
+
+// Completion and "did you mean" over 50k command names: a typo with near neighbours, a
+// string close to nothing, a prefix completion, and the cost of adding one name.
+CMDKIT_BENCH_REGISTER
+{
+	bench::add("suggest", "suggest 50k (typo)", []() -> bench::Body
+		{
+			auto index = make_index(50000);
+			return [index](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(index->suggest("delet-clustr-123", 5));
+				};
+		});
+
+	bench::add("suggest", "suggest 50k (no match)", []() -> bench::Body
+		{
+			auto index = make_index(50000);
+			return [index](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(index->suggest("kubectl-apply", 5));
+				};
+		});
+
+	bench::add("suggest", "complete 50k", []() -> bench::Body
+		{
+			auto index = make_index(50000);
+			return [index](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx) bench::do_not_optimize(index->complete("deploy-route-", 10));
+				};
+		});
+
+	bench::add("suggest", "add", []() -> bench::Body
+		{
+			auto names = std::make_shared<std::vector<std::string>>(make_names(50000));
+			auto index = std::make_shared<NameIndex>();
+			return [names, index](size_t iterations)
+				{
+					for (size_t idx = 0; idx < iterations; ++idx)
+					{
+						if (idx % names->size() == 0) *index = NameIndex();
+						index->add((*names)[idx % names->size()]);
+					}
+				};
+		});
+}
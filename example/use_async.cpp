@@ -0,0 +1,77 @@
+#include "async.hpp"
+#include "terminal.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace cmdkit;
+using namespace std::chrono_literals;
+using R = Result<void*, std::string>;
+using C = Command;
+using T = Terminal;
+
+int main()
+{
+	T terminal;
+
+	// Coroutine command: waits without blocking the terminal
+	C waiter(
+		"wait",
+		make_async_handler([](CommandArgs args, EventLoop& loop) -> Task<R>
+			{
+				// current() is only the terminal's sink until the first suspension
+				OutputSink& out = OutputSink::current();
+				const int ms = std::stoi(args[1]);
+				co_await sleep_for(loop, std::chrono::milliseconds(ms));
+				out << "Waited " << ms << "ms\n";
+				co_return R::ok(nullptr);
+			})
+	);
+	terminal.register_command(std::move(waiter));
+
+	// Blocking work runs on its own thread and resumes on the loop
+	C loader(
+		"load",
+		make_async_handler([](CommandArgs args, EventLoop& loop) -> Task<R>
+			{
+				OutputSink& out = OutputSink::current();
+				const std::string name = args[1];
+				auto read_file = [name]()
+					{
+						std::this_thread::sleep_for(30ms);
+						return name.size() * 1024;
+					};
+				size_t size = co_await offload(loop, std::move(read_file));
+				out << "Loaded " << name << ": " << size << " bytes\n";
+				co_return R::ok(nullptr);
+			})
+	);
+	terminal.register_command(std::move(loader));
+
+	// Synchronous commands share the same table
+	C printer(
+		"print",
+		[](const CommandArgs& args)
+		{
+			OutputSink::current() << "Print: " << args[1] << '\n';
+			return R::ok(nullptr);
+		}
+	);
+	terminal.register_command(std::move(printer));
+
+	auto report = [&terminal](R result) { if (result.is_err()) terminal.get_output() << "Error: " << result.unwrap_err() << '\n'; };
+	terminal.invoke_async("wait 50", report);
+	terminal.invoke_async("load archive.tar", report);
+	terminal.invoke_async("wait 10", report);
+	terminal.invoke_async("print immediately", report);
+	terminal.invoke_async("help", report);
+	terminal.run(); // Output: Print, Error, Waited 10ms, Loaded, Waited 50ms
+
+	// Async commands can still be invoked synchronously
+	terminal.invoke("wait 5");
+
+	terminal.prompt("Press Enter to exit");
+	getchar();
+}
@@ -15,25 +15,26 @@ int main()
 		"log_str",
 		[](const CommandArgs& args)
 		{
-			std::cout << "Log string: " << args[1] << std::endl;
+			OutputSink::current() << "Log string: " << args[1] << '\n';
 			return R::ok(nullptr);
 		}
 	);
-	terminal.register_command(string_logger);
+	terminal.register_command(std::move(string_logger));
 
 	// Muiltiple arguments usage of command
 	C string_linker(
 		"link_str",
 		[](const CommandArgs& args)
 		{
-			std::cout << "Link strings: ";
+			OutputSink& out = OutputSink::current();
+			out << "Link strings: ";
 			const auto& vec = args.get_positional();
-			for (size_t idx = 1; idx < vec.size(); ++idx) std::cout << vec[idx];
-			std::cout << std::endl;
+			for (size_t idx = 1; idx < vec.size(); ++idx) out << vec[idx];
+			out << '\n';
 			return R::ok(nullptr);
 		}
 	);
-	terminal.register_command(string_linker);
+	terminal.register_command(std::move(string_linker));
 
 	// Using flag and options in command, handling errors
 	C string_stringer(
@@ -43,20 +44,21 @@ int main()
 
 			if (args.has_flag("able"))
 			{
-				std::cout << "String strings: ";
+				OutputSink& out = OutputSink::current();
+				out << "String strings: ";
 				const auto& vec = args.get_positional();
 				const std::string ch = args.get_option("divide", "-");
 
 				for (size_t idx = 1; idx < vec.size(); ++idx)
-					std::cout << (idx == 1 ? "" : ch) << vec[idx];
-				std::cout << std::endl;
+					out << (idx == 1 ? "" : ch) << vec[idx];
+				out << '\n';
 				return R::ok(nullptr);
 			}
 			else return R::err("Not able to string strs!");
 
 		}
 	);
-	terminal.register_command(string_stringer);
+	terminal.register_command(std::move(string_stringer));
 
 	// Tips: use command with closure
 	int var1 = 1;
@@ -64,20 +66,36 @@ int main()
 		"change_var",
 		[&var1](const CommandArgs& args)
 		{
-			std::cout << "Change var : ";
-			std::cout << var1 << " to ";
-			var1 = std::stoi(args[1]);
-			std::cout << var1 << std::endl;
+			auto val = parse_value<int>(args[1]);
+			if (val.is_err()) return R::err("Not a number: " + args[1]);
+
+			OutputSink& out = OutputSink::current();
+			out << "Change var : ";
+			out << var1 << " to ";
+			var1 = val.unwrap();
+			out << var1 << '\n';
+			return R::ok(nullptr);
+		}
+	);
+	terminal.register_command(std::move(variable_changer));
+
+	// Typed options: `repeat Hi --times 3 --delay 10ms`
+	C string_repeater(
+		"repeat",
+		[](const CommandArgs& args)
+		{
+			auto times = args.get_option<int>("times");
+			if (times.is_err()) return R::err(times.unwrap_err().message());
+			OutputSink& out = OutputSink::current();
+			for (int idx = 0; idx < times.unwrap(); ++idx) out << args[1];
+			out << '\n';
 			return R::ok(nullptr);
 		}
 	);
-	terminal.register_command(variable_changer);
+	terminal.register_command(std::move(string_repeater));
 
-	auto func = []() {std::cout << "Can't find command!" << std::endl; };
+	auto func = [&terminal]() { terminal.get_output() << "Can't find command!\n"; };
 	std::string input;
-	while (true)
-	{
-		std::getline(std::cin, input);
+	while (terminal.prompt("> ").is_ok() && std::getline(std::cin, input))
 		terminal.invoke(input, func);
-	}
 }
\ No newline at end of file
@@ -82,6 +82,34 @@ int main()
 	variable_changer.invoke("change_var 2");
 	std::cout << "Outside the closure, var1 = " << var1 << std::endl;
 
+	// Zero-copy usage: tokens are string_views into the invoked line
+	C view_logger(
+		"log_view",
+		[](const CommandArgsView& args)
+		{
+			std::cout << "Log view: " << args[1] << " " << args.get_option("suffix", "!") << std::endl;
+			return R::ok(nullptr);
+		}
+	);
+	view_logger.invoke("log_view Hello_view --suffix ?");
+
+	// Declared arguments: options and flags are read by slot, bad input never reaches the handler
+	ArgSchema resize_schema;
+	resize_schema.required_option("width").option("height").flag("keep_ratio").positional(1, 1);
+
+	C image_resizer(
+		"resize",
+		[](const CommandArgsView& args)
+		{
+			std::cout << "Resize " << args[1] << " to " << args.slot(0) << "x" << (args.has_slot(1) ? args.slot(1) : "auto")
+				<< (args.has_slot(2) ? " keeping ratio" : "") << std::endl;
+			return R::ok(nullptr);
+		}
+	);
+	image_resizer.set_schema(std::move(resize_schema));
+	image_resizer.invoke("resize photo.png --width 640 --keep_ratio");
+	assert(image_resizer.invoke("resize photo.png").unwrap_err() == "Missing option --width");
+
 	std::cout << "Command examples all passed!" << std::endl;
 	getchar();
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "server.hpp"
+
+#include <cstdio>
+#include <string>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+// Serves the terminal on stdin and on a Unix socket, e.g. `use_server /tmp/cmdkit.sock`, then
+// `printf 'greet Ada\nsum 1 2 3\n' | nc -U /tmp/cmdkit.sock` from another shell.
+int main(int argc, char** argv)
+{
+	Terminal terminal;
+	terminal.register_command(Command("greet", [](const CommandArgsView& args)
+		{
+			if (args.get_positional().size() < 2) return R::err("Usage: greet NAME");
+			OutputSink::current() << "Hello, " << args[1] << "!\n";
+			return R::ok(nullptr);
+		}));
+	terminal.register_command(Command("sum", [](const CommandArgsView& args)
+		{
+			long long total = 0;
+			for (size_t idx = 1; idx < args.get_positional().size(); ++idx)
+			{
+				auto val = parse_value<long long>(args[idx]);
+				if (val.is_err()) return R::err("Not a number: " + std::string(args[idx]));
+				total += val.unwrap();
+			}
+			OutputSink::current() << total << '\n';
+			return R::ok(nullptr);
+		}));
+
+	TerminalServer server(terminal);
+	terminal.register_command(Command("shutdown", [&server](const CommandArgsView&) { server.stop(); return R::ok(nullptr); }));
+
+	const std::string path = argc > 1 ? argv[1] : "/tmp/cmdkit.sock";
+	if (auto listening = server.listen(path); listening.is_err())
+	{
+		std::fprintf(stderr, "%s\n", listening.unwrap_err().c_str());
+		return 1;
+	}
+	if (auto reading = server.serve_stdin(); reading.is_err()) std::fprintf(stderr, "%s\n", reading.unwrap_err().c_str());
+
+	auto served = server.run();
+	if (served.is_err()) std::fprintf(stderr, "%s\n", served.unwrap_err().c_str());
+	return served.is_ok() ? 0 : 1;
+}
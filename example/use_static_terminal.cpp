@@ -0,0 +1,39 @@
+#include "static_terminal.hpp"
+
+#include <iostream>
+#include <string>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+using SC = StaticCommand;
+
+// The table and its perfect hash are built by the compiler; nothing is registered at startup.
+static constexpr auto commands = make_static_commands(
+	SC("print", [](const CommandArgsView& args)
+		{
+			const auto& vec = args.get_positional();
+			for (size_t idx = 1; idx < vec.size(); ++idx) std::cout << vec[idx] << " ";
+			std::cout << std::endl;
+			return R::ok(nullptr);
+		}),
+	SC("greet", "Greet someone", [](const CommandArgs& args)
+		{
+			std::cout << "Hello, " << args.get_option("name", "world") << "!" << std::endl;
+			return R::ok(nullptr);
+		})
+);
+
+static_assert(StaticTerminal<commands>::find("print") != nullptr);
+static_assert(StaticTerminal<commands>::find("help") == nullptr);
+
+int main()
+{
+	StaticTerminal<commands> terminal;
+
+	auto func = []() {std::cout << "Can't find command!" << std::endl; };
+	terminal.invoke("print Hello world C++!", func);
+	terminal.invoke("greet --name cmdkit", func);
+	terminal.invoke("help", func);
+
+	getchar();
+}
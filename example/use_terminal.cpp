@@ -1,6 +1,5 @@
 #include "terminal.hpp"
 
-#include <iostream>
 #include <string>
 #include <vector>
 
@@ -12,22 +11,44 @@ using T = Terminal;
 int main()
 {
 	T terminal;
+	OutputSink& out = terminal.get_output();
 
+	// Handlers write to the sink of the dispatching terminal; lines are batched into few writes
 	C str_printer(
 		"print",
 		[](const CommandArgs& args)
 		{
 			const auto& vec = args.get_positional();
-			for (size_t idx = 1; idx < vec.size(); ++idx) std::cout << vec[idx] << " ";
-			std::cout << std::endl;
+			for (size_t idx = 1; idx < vec.size(); ++idx) OutputSink::current() << vec[idx] << " ";
+			OutputSink::current() << '\n';
 			return R::ok(nullptr);
 		}
 	);
 
-	auto func = []() {std::cout << "Can't find command!" << std::endl; };
-	terminal.register_command(str_printer);
+	auto func = [&out]() { out << "Can't find command!\n"; };
+	terminal.register_command(std::move(str_printer));
 	terminal.invoke("print Hello world C++!", func);
 	terminal.invoke("help", func);
 
+	// Unique prefixes resolve to their command, and names can be listed by prefix
+	terminal.set_abbreviation(true);
+	terminal.invoke("pri Abbreviated!", func);
+	for (const auto& name : terminal.list_commands("p")) out << name << '\n';
+
+	// Pipelines move each stage's value into the next one
+	terminal.register_command(C("count", make_stage<void>([](const CommandArgsView& args)
+		{
+			return Result<int, std::string>::ok(int(args.get_positional().size()) - 1);
+		})));
+	terminal.register_command(C("twice", make_stage<int>([](const CommandArgsView&, int val)
+		{
+			return Result<int, std::string>::ok(val * 2);
+		})));
+	auto piped = terminal.pipe("count a b c | twice | twice");
+	if (piped.is_ok()) out << *piped.unwrap().get<int>() << '\n'; // Output: 12
+	out << terminal.pipe("print Not a number | twice").unwrap_err() << '\n'; // Output: Pipeline stage got an empty payload
+
+	// Flushes everything above before waiting for input
+	terminal.prompt("Press enter to exit");
 	getchar();
-}
\ No newline at end of file
+}
@@ -0,0 +1,189 @@
+#ifndef INCLUDE_CMDKIT_ASYNC
+#define INCLUDE_CMDKIT_ASYNC
+
+#include "command.hpp"
+#include "event_loop.hpp"
+
+// Coroutine handlers need C++20; the rest of cmdkit stays C++17.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace cmdkit
+{
+	// Lazily started coroutine producing a T. Awaiting it starts it and resumes the awaiter
+	// when it finishes.
+	template<typename T>
+	class Task
+	{
+	public:
+		struct promise_type
+		{
+			std::optional<T> value;
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+
+			Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+
+			auto final_suspend() noexcept
+			{
+				struct Awaiter
+				{
+					bool await_ready() noexcept { return false; }
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+					{
+						auto next = handle.promise().continuation;
+						return next ? next : std::noop_coroutine();
+					}
+					void await_resume() noexcept {}
+				};
+				return Awaiter{};
+			}
+
+			template<typename U>
+			void return_value(U&& val) { value.emplace(std::forward<U>(val)); }
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		Task& operator=(Task&& other) noexcept { if (this != &other) { reset(); handle = std::exchange(other.handle, nullptr); } return *this; }
+		~Task() { reset(); }
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+		{
+			handle.promise().continuation = awaiter;
+			return handle;
+		}
+		T await_resume()
+		{
+			if (handle.promise().error) std::rethrow_exception(handle.promise().error);
+			return std::move(*handle.promise().value);
+		}
+
+	private:
+		explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+		void reset() { if (handle) handle.destroy(); handle = nullptr; }
+
+	private:
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	namespace detail
+	{
+		// Eagerly started, self-destroying coroutine used to drive a Task to completion.
+		struct Detached
+		{
+			struct promise_type
+			{
+				Detached get_return_object() noexcept { return {}; }
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
+				void return_void() noexcept {}
+				void unhandled_exception() noexcept { std::terminate(); }
+			};
+		};
+
+		// An exception from done can't leave a detached coroutine, so it is rethrown from the
+		// loop's run() instead, as one from any other callback would be.
+		inline Detached drive(Task<Result<void*, std::string>> task, EventLoop& loop, Command::Completion done)
+		{
+			std::optional<Result<void*, std::string>> result;
+			try { result.emplace(co_await task); }
+			catch (const std::exception& e) { result.emplace(Result<void*, std::string>::err(e.what())); }
+			catch (...) { result.emplace(Result<void*, std::string>::err("Unknown exception")); }
+
+			try { done(std::move(*result)); }
+			catch (...) { loop.post([error = std::current_exception()]() { std::rethrow_exception(error); }); }
+		}
+	}
+
+	// Adapts `Task<Result<void*, std::string>>(CommandArgs, EventLoop&)` coroutines to Command::AsyncHandler.
+	template<typename Fn>
+	Command::AsyncHandler make_async_handler(Fn fn)
+	{
+		return [fn = std::move(fn)](CommandArgs args, EventLoop& loop, Command::Completion done)
+			{
+				detail::drive(fn(std::move(args), loop), loop, std::move(done));
+			};
+	}
+
+	// co_await sleep_for(loop, 10ms): resumes on the loop after the delay.
+	template<typename Rep, typename Period>
+	auto sleep_for(EventLoop& loop, std::chrono::duration<Rep, Period> delay)
+	{
+		struct Awaiter
+		{
+			EventLoop& loop;
+			std::chrono::duration<Rep, Period> delay;
+
+			bool await_ready() const noexcept { return delay.count() <= 0; }
+			void await_suspend(std::coroutine_handle<> handle) { loop.call_after(delay, [handle]() { handle.resume(); }); }
+			void await_resume() const noexcept {}
+		};
+		return Awaiter{ loop, delay };
+	}
+
+	// co_await yield(loop): lets other ready work run before continuing.
+	inline auto yield(EventLoop& loop)
+	{
+		struct Awaiter
+		{
+			EventLoop& loop;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { loop.post([handle]() { handle.resume(); }); }
+			void await_resume() const noexcept {}
+		};
+		return Awaiter{ loop };
+	}
+
+	// co_await offload(loop, fn): runs a blocking fn (disk, waitpid, ...) on its own thread and
+	// resumes on the loop with its result. The loop stays alive until the result is posted back.
+	// Pass a named callable: GCC 12 destroys capturing lambda temporaries in co_await operands twice.
+	template<typename Fn>
+	auto offload(EventLoop& loop, Fn fn)
+	{
+		using T = std::invoke_result_t<Fn&>;
+		static_assert(!std::is_void_v<T>, "offload: fn must return a value");
+
+		struct State
+		{
+			Fn fn;
+			std::optional<T> value;
+			std::exception_ptr error;
+		};
+
+		struct Awaiter
+		{
+			EventLoop& loop;
+			std::shared_ptr<State> state;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				loop.hold();
+				std::thread([loop = &loop, state = state, handle]()
+					{
+						try { state->value.emplace(state->fn()); }
+						catch (...) { state->error = std::current_exception(); }
+						loop->post([loop, handle]() { loop->release(); handle.resume(); });
+					}).detach();
+			}
+			T await_resume()
+			{
+				if (state->error) std::rethrow_exception(state->error);
+				return std::move(*state->value);
+			}
+		};
+		return Awaiter{ loop, std::make_shared<State>(State{ std::move(fn), std::nullopt, nullptr }) };
+	}
+}
+#endif
+
+#endif // INCLUDE_CMDKIT_ASYNC
\ No newline at end of file
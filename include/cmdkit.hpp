@@ -3,13 +3,44 @@
 
 #include <type_traits>
 #include <stdexcept>
-#include <variant>
 #include <string>
+#include <variant>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <algorithm>
+#include <array>
+#include <optional>
 #include <vector>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <system_error>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <typeinfo>
+#include <atomic>
+#include <memory>
+#include <cstdio>
 #include <unordered_set>
 #include <unordered_map>
-#include <functional>
-#include <map>
+#include <memory_resource>
+#include <tuple>
+#include <list>
+#include <thread>
+#include <climits>
+#include <exception>
+#include <future>
 
 // result.hpp
 namespace cmdkit
@@ -39,49 +70,53 @@ namespace cmdkit
 		using ErrType = E;
 
 	private:
-		bool ok_flag;
+		// The variant index is the only discriminant: 0 holds T, 1 holds E. Trivially copyable
+		// T and E keep the whole Result trivially copyable, so small results travel in registers.
 		std::variant<T, E> data;
 
-		Result(const T& val) : data(val), ok_flag(true) {}
-		Result(T&& val) noexcept : data(std::move(val)), ok_flag(true) {}
+		template<size_t I, typename... Args>
+		constexpr explicit Result(std::in_place_index_t<I> tag, Args&&... args) : data(tag, std::forward<Args>(args)...) {}
 
-		Result(const E& val) : data(val), ok_flag(false) {}
-		Result(E&& val) noexcept : data(std::move(val)), ok_flag(false) {}
+		template<typename, typename>
+		friend class Result;
 
 	public:
-		static Result<T, E> ok(const T& val) { return Result<T, E>(val); }
-		static Result<T, E> ok(T&& val) noexcept { return Result<T, E>(std::move(val)); }
+		static constexpr Result<T, E> ok(const T& val) { return Result<T, E>(std::in_place_index<0>, val); }
+		static constexpr Result<T, E> ok(T&& val) noexcept(std::is_nothrow_move_constructible_v<T>) { return Result<T, E>(std::in_place_index<0>, std::move(val)); }
 
-		static Result<T, E> err(const E& val) { return Result<T, E>(val); }
-		static Result<T, E> err(E&& val) noexcept { return Result<T, E>(std::move(val)); }
+		static constexpr Result<T, E> err(const E& val) { return Result<T, E>(std::in_place_index<1>, val); }
+		static constexpr Result<T, E> err(E&& val) noexcept(std::is_nothrow_move_constructible_v<E>) { return Result<T, E>(std::in_place_index<1>, std::move(val)); }
 
-		~Result() = default;
-
-	public:
-		Result& operator=(const Result& other) { ok_flag = other.ok_flag, data = other.data; return *this; }
+		// A Result<void, E> converts to a null pointer result, so handlers may return either.
+		template<typename U = T, typename std::enable_if_t<std::is_pointer_v<U>, int> = 0>
+		constexpr Result(Result<void, E> other) : Result(other.is_ok() ? ok(nullptr) : err(std::move(other).unwrap_err())) {}
 
-		Result& operator=(Result&& other) noexcept { ok_flag = other.ok_flag, data = std::move(other.data); return *this; }
+		Result(const Result&) = default;
+		Result(Result&&) = default;
+		Result& operator=(const Result&) = default;
+		Result& operator=(Result&&) = default;
+		~Result() = default;
 
 	public:
-		bool is_ok() const noexcept { return ok_flag; }
-		bool is_err() const noexcept { return !ok_flag; }
-		operator bool() const { return is_ok(); }
+		constexpr bool is_ok() const noexcept { return data.index() == 0; }
+		constexpr bool is_err() const noexcept { return data.index() == 1; }
+		constexpr operator bool() const { return is_ok(); }
 
 	public:
-		T& unwrap()& { if (is_ok()) return std::get<T>(data); else throw bad_result_access("unwrap called on an error Result"); }
-		const T& unwrap() const& { if (is_ok()) return std::get<T>(data); else throw bad_result_access("unwrap called on an error Result"); }
-		T unwrap()&& { if (is_ok()) return std::move(std::get<T>(data)); else throw bad_result_access("unwrap called on an error Result"); }
+		constexpr T& unwrap()& { if (is_ok()) return std::get<0>(data); else throw bad_result_access("unwrap called on an error Result"); }
+		constexpr const T& unwrap() const& { if (is_ok()) return std::get<0>(data); else throw bad_result_access("unwrap called on an error Result"); }
+		constexpr T unwrap()&& { if (is_ok()) return std::move(std::get<0>(data)); else throw bad_result_access("unwrap called on an error Result"); }
 
-		E& unwrap_err()& { if (is_err()) return std::get<E>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
-		const E& unwrap_err() const& { if (is_err()) return std::get<E>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
-		E unwrap_err()&& { if (is_err()) return std::move(std::get<E>(data)); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr E& unwrap_err()& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr const E& unwrap_err() const& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr E unwrap_err()&& { if (is_err()) return std::move(std::get<1>(data)); else throw bad_result_access("unwrap_err called on an okay Result"); }
 
 	public:
-		T& unwrap_or(const T& default_val) & noexcept { return is_ok() ? unwrap() : default_val; }
+		const T& unwrap_or(const T& default_val) & noexcept { return is_ok() ? unwrap() : default_val; }
 		const T& unwrap_or(const T& default_val) const& noexcept { return is_ok() ? unwrap() : default_val; }
 		T unwrap_or(T default_val) && noexcept { return is_ok() ? std::move(unwrap()) : default_val; }
 
-		E& unwrap_err_or(const E& default_val) & noexcept { return is_err() ? unwrap_err() : default_val; }
+		const E& unwrap_err_or(const E& default_val) & noexcept { return is_err() ? unwrap_err() : default_val; }
 		const E& unwrap_err_or(const E& default_val) const& noexcept { return is_err() ? unwrap_err() : default_val; }
 		E unwrap_err_or(E default_val) && noexcept { return is_err() ? std::move(unwrap_err()) : default_val; }
 
@@ -93,9 +128,10 @@ namespace cmdkit
 			Result<decltype(f(std::declval<const T&>())), E>
 			>
 		{
-			using U = decltype(f(std::declval<const T&&>()));
-			if (is_ok()) return Result<U, E>::ok(f(unwrap()));
-			else return Result<U, E>::err(std::move(unwrap_err()));
+			using U = decltype(f(std::declval<const T&>()));
+			if (is_err()) return Result<U, E>::err(unwrap_err());
+			if constexpr (std::is_void_v<U>) { f(unwrap()); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f(unwrap()));
 		}
 
 		template<typename F>
@@ -106,8 +142,9 @@ namespace cmdkit
 			>
 		{
 			using U = decltype(f(std::declval<T&&>()));
-			if (is_ok()) return Result<U, E>::ok(f(std::move(unwrap())));
-			else return Result<U, E>::err(std::move(unwrap_err()));
+			if (is_err()) return Result<U, E>::err(std::move(unwrap_err()));
+			if constexpr (std::is_void_v<U>) { f(std::move(unwrap())); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f(std::move(unwrap())));
 		}
 
 	public:
@@ -187,136 +224,6545 @@ namespace cmdkit
 			else return std::invoke(std::forward<ErrFn>(err_func), std::move(unwrap_err()));
 		}
 	};
-}
 
-// command.hpp
-namespace cmdkit
-{
-	class CommandArgs
+	// Result of an operation that produces nothing on success.
+	template<typename E>
+	class Result<void, E>
 	{
+	public:
+		using OkType = void;
+		using ErrType = E;
+
 	private:
-		std::unordered_map<std::string, std::string> options;
-		std::unordered_set<std::string> flags;
-		std::vector<std::string> positional;
+		std::variant<std::monostate, E> data;
+
+		template<size_t I, typename... Args>
+		constexpr explicit Result(std::in_place_index_t<I> tag, Args&&... args) : data(tag, std::forward<Args>(args)...) {}
 
 	public:
-		static CommandArgs parse(const std::vector<std::string>& args)
+		static constexpr Result<void, E> ok() noexcept { return Result<void, E>(std::in_place_index<0>); }
+
+		static constexpr Result<void, E> err(const E& val) { return Result<void, E>(std::in_place_index<1>, val); }
+		static constexpr Result<void, E> err(E&& val) noexcept(std::is_nothrow_move_constructible_v<E>) { return Result<void, E>(std::in_place_index<1>, std::move(val)); }
+
+		Result(const Result&) = default;
+		Result(Result&&) = default;
+		Result& operator=(const Result&) = default;
+		Result& operator=(Result&&) = default;
+		~Result() = default;
+
+	public:
+		constexpr bool is_ok() const noexcept { return data.index() == 0; }
+		constexpr bool is_err() const noexcept { return data.index() == 1; }
+		constexpr operator bool() const { return is_ok(); }
+
+	public:
+		constexpr void unwrap() const { if (is_err()) throw bad_result_access("unwrap called on an error Result"); }
+
+		constexpr E& unwrap_err()& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr const E& unwrap_err() const& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr E unwrap_err()&& { if (is_err()) return std::move(std::get<1>(data)); else throw bad_result_access("unwrap_err called on an okay Result"); }
+
+		const E& unwrap_err_or(const E& default_val) const& noexcept { return is_err() ? unwrap_err() : default_val; }
+		E unwrap_err_or(E default_val) && noexcept { return is_err() ? std::move(unwrap_err()) : default_val; }
+
+	public:
+		template<typename F>
+		auto map(F&& f) const& ->
+			std::enable_if_t<
+			std::is_invocable_v<F>,
+			Result<decltype(f()), E>
+			>
 		{
-			CommandArgs result;
+			using U = decltype(f());
+			if (is_err()) return Result<U, E>::err(unwrap_err());
+			if constexpr (std::is_void_v<U>) { f(); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f());
+		}
 
-			for (size_t idx = 0; idx < args.size(); ++idx)
-			{
-				const auto& arg = args[idx];
-				if (args.size() > 2 && arg[0] == '-' && arg[1] == '-')
-				{
-					std::string key = arg.substr(2);
-					
-					if (idx == args.size() - 1 || (args[idx + 1].size() > 2 && args[idx + 1][0] == '-' && args[idx + 1][1] == '-'))
-						result.flags.insert(key);
-					else result.options[key] = args[++idx];
-				}
-				else result.positional.push_back(arg);
-			}
+		template<typename F>
+		auto map(F&& f) && ->
+			std::enable_if_t<
+			std::is_invocable_v<F>,
+			Result<decltype(f()), E>
+			>
+		{
+			using U = decltype(f());
+			if (is_err()) return Result<U, E>::err(std::move(unwrap_err()));
+			if constexpr (std::is_void_v<U>) { f(); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f());
+		}
 
-			return result;
+	public:
+		template<typename F>
+		auto map_err(F&& f) const& ->
+			std::enable_if_t<
+			std::is_invocable_v<F, const E&>,
+			Result<void, decltype(f(std::declval<const E&>()))>
+			>
+		{
+			using U = decltype(f(std::declval<const E&>()));
+			if (is_err()) return Result<void, U>::err(f(unwrap_err()));
+			else return Result<void, U>::ok();
 		}
 
-		static CommandArgs parse(const std::string& args_str)
+		template<typename F>
+		auto map_err(F&& f) && ->
+			std::enable_if_t<
+			std::is_invocable_v<F, E&&>,
+			Result<void, decltype(f(std::declval<E&&>()))>
+			>
 		{
-			std::vector<std::string> vec;
-			size_t pos = 0;
-			while (pos < args_str.size())
-			{
-				while (pos < args_str.size() && std::isspace(args_str[pos])) pos++;
-				if (pos >= args_str.size()) break;
+			using U = decltype(f(std::declval<E&&>()));
+			if (is_err()) return Result<void, U>::err(f(std::move(unwrap_err())));
+			else return Result<void, U>::ok();
+		}
 
-				size_t start = pos;
-				while (pos < args_str.size() && !std::isspace(args_str[pos])) pos++;
-				vec.emplace_back(args_str.substr(start, pos - start));
-			}
+	public:
+		template<typename F>
+		auto and_then(F&& f) const& ->
+			std::enable_if_t<
+			is_result<std::invoke_result_t<F>>::value
+			&& std::is_same_v<E, typename std::invoke_result_t<F>::ErrType>,
+			std::invoke_result_t<F>
+			>
+		{
+			using Ret = std::invoke_result_t<F>;
+			if (is_ok()) return std::invoke(std::forward<F>(f));
+			else return Ret::err(unwrap_err());
+		}
 
-			return parse(vec);
+		template<typename F>
+		auto and_then(F&& f) && ->
+			std::enable_if_t<
+			is_result<std::invoke_result_t<F>>::value
+			&& std::is_same_v<E, typename std::invoke_result_t<F>::ErrType>,
+			std::invoke_result_t<F>
+			>
+		{
+			using Ret = std::invoke_result_t<F>;
+			if (is_ok()) return std::invoke(std::forward<F>(f));
+			else return Ret::err(std::move(unwrap_err()));
 		}
 
-		std::string get_option(const std::string& key, const std::string& default_val = "") const
+	public:
+		template<
+			typename OkFn, typename ErrFn,
+			typename OkRet = std::invoke_result_t<OkFn>,
+			typename ErrRet = std::invoke_result_t<ErrFn, const E&>,
+			typename std::enable_if_t<std::is_same_v<OkRet, ErrRet>, int> = 0
+		>
+		decltype(auto) match(OkFn&& ok_func, ErrFn&& err_func) const&
 		{
-			auto it = options.find(key);
-			return it != options.end() ? it->second : default_val;
+			if (is_ok()) return std::invoke(std::forward<OkFn>(ok_func));
+			else return std::invoke(std::forward<ErrFn>(err_func), unwrap_err());
 		}
 
-		bool has_flag(const std::string& name) const { return flags.count(name); }
+		template<
+			typename OkFn, typename ErrFn,
+			typename OkRet = std::invoke_result_t<OkFn>,
+			typename ErrRet = std::invoke_result_t<ErrFn, E&&>,
+			typename std::enable_if_t<std::is_same_v<OkRet, ErrRet>, int> = 0
+		>
+		decltype(auto) match(OkFn&& ok_func, ErrFn&& err_func)&&
+		{
+			if (is_ok()) return std::invoke(std::forward<OkFn>(ok_func));
+			else return std::invoke(std::forward<ErrFn>(err_func), std::move(unwrap_err()));
+		}
+	};
+}
 
-		const std::vector<std::string>& get_positional() const { return positional; }
+// scanner.hpp
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CMDKIT_SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CMDKIT_TARGET_AVX2
+#else
+#define CMDKIT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
 
-	public:
-		std::string& operator[](size_t idx) { return positional[idx]; }
-		const std::string& operator[](size_t idx) const { return positional[idx]; }
+namespace cmdkit
+{
+	// One bit per byte of a 64-byte block, bit i describing block[i].
+	struct StructuralMasks
+	{
+		uint64_t whitespace = 0;
+		uint64_t dash = 0;
+		uint64_t quote = 0;
+		uint64_t equals = 0;
+		uint64_t escape = 0;
 	};
 
-	class Command
+	class StructuralScanner
 	{
 	public:
-		using Handler = std::function<Result<void*, std::string>(const CommandArgs&)>;
+		enum class Isa { scalar, sse2, avx2 };
 
-		Command() = default;
-		Command(const std::string& name, Handler handler) : name(name), description(""), handler(handler) {}
-		Command(const std::string& name, const std::string& description, Handler handler) : name(name), description(description), handler(handler) {}
+		static constexpr size_t block_size = 64;
 
-	public:
-		Result<void*, std::string> invoke(const CommandArgs& args) const { return handler(args); }
-		Result<void*, std::string> invoke(const std::string& args_str) const { return handler(CommandArgs::parse(args_str)); }
+		using ScanFn = StructuralMasks(*)(const char*);
+
+		// Scans up to 64 bytes. Bytes past `size` are reported as whitespace.
+		static StructuralMasks scan(const char* block, size_t size) { return scan(active(), block, size); }
+
+		static StructuralMasks scan(ScanFn fn, const char* block, size_t size)
+		{
+			if (size >= block_size) return fn(block);
+
+			char padded[block_size] = {};
+			std::memcpy(padded, block, size);
+			StructuralMasks masks = fn(padded);
+			masks.whitespace |= ~0ull << size;
+			return masks;
+		}
+
+		static ScanFn active() { static const ScanFn fn = select(detected_isa()); return fn; }
+
+		static Isa detected_isa()
+		{
+#if CMDKIT_SCANNER_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuidex(info, 0, 0);
+			if (info[0] >= 7)
+			{
+				__cpuidex(info, 1, 0);
+				bool os_avx = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+				__cpuidex(info, 7, 0);
+				if (os_avx && (info[1] & (1 << 5))) return Isa::avx2;
+			}
+			return Isa::sse2;
+#else
+			return __builtin_cpu_supports("avx2") ? Isa::avx2 : Isa::sse2;
+#endif
+#else
+			return Isa::scalar;
+#endif
+		}
+
+		static ScanFn select(Isa isa)
+		{
+#if CMDKIT_SCANNER_X86
+			if (isa == Isa::avx2) return &scan_avx2;
+			if (isa == Isa::sse2) return &scan_sse2;
+#endif
+			return &scan_scalar;
+		}
 
 	public:
-		const std::string& get_name() const { return name; }
-		void get_name(const std::string& val) { name = val; }
+		static StructuralMasks scan_scalar(const char* block)
+		{
+			StructuralMasks masks;
+			for (size_t idx = 0; idx < block_size; ++idx)
+			{
+				const unsigned char ch = static_cast<unsigned char>(block[idx]);
+				const uint64_t bit = 1ull << idx;
+				if (ch == ' ' || unsigned(ch - '\t') <= unsigned('\r' - '\t')) masks.whitespace |= bit;
+				else if (ch == '-') masks.dash |= bit;
+				else if (ch == '"' || ch == '\'') masks.quote |= bit;
+				else if (ch == '=') masks.equals |= bit;
+				else if (ch == '\\') masks.escape |= bit;
+			}
+			return masks;
+		}
 
-		const std::string& get_description() const { return description; }
-		void get_description(const std::string& val) { description = val; }
+#if CMDKIT_SCANNER_X86
+		static StructuralMasks scan_sse2(const char* block)
+		{
+			StructuralMasks masks;
+			for (size_t idx = 0; idx < block_size; idx += 16)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + idx));
+				const __m128i control = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+				const __m128i ws = _mm_or_si128(
+					_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+					_mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control));
+				const __m128i quote = _mm_or_si128(
+					_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+					_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\'')));
 
-	private:
-		std::string name;
-		std::string description;
-		Handler handler;
+				masks.whitespace |= uint64_t(uint16_t(_mm_movemask_epi8(ws))) << idx;
+				masks.dash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('-'))))) << idx;
+				masks.quote |= uint64_t(uint16_t(_mm_movemask_epi8(quote))) << idx;
+				masks.equals |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('='))))) << idx;
+				masks.escape |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))))) << idx;
+			}
+			return masks;
+		}
+
+		CMDKIT_TARGET_AVX2 static StructuralMasks scan_avx2(const char* block)
+		{
+			StructuralMasks masks;
+			for (size_t idx = 0; idx < block_size; idx += 32)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + idx));
+				const __m256i control = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+				const __m256i ws = _mm256_or_si256(
+					_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+					_mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control));
+				const __m256i quote = _mm256_or_si256(
+					_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+					_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\'')));
+
+				masks.whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << idx;
+				masks.dash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('-'))))) << idx;
+				masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(quote))) << idx;
+				masks.equals |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('='))))) << idx;
+				masks.escape |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))))) << idx;
+			}
+			return masks;
+		}
+#endif
 	};
+
+	namespace detail
+	{
+		inline unsigned count_trailing_zeros(uint64_t val)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long idx;
+			_BitScanForward64(&idx, val);
+			return unsigned(idx);
+#else
+			return unsigned(__builtin_ctzll(val));
+#endif
+		}
+
+		// Splits on whitespace using the scanner's bitmap: token boundaries are the edges of the
+		// non-whitespace mask, visited with count-trailing-zeros instead of a per-byte loop.
+		template<typename Fn>
+		void tokenize(std::string_view args_str, StructuralScanner::ScanFn scan_fn, Fn&& on_token)
+		{
+			const char* data = args_str.data();
+			const size_t size = args_str.size();
+
+			uint64_t carry = 0; // 1 if the previous block ended inside a token
+			size_t start = 0;
+			for (size_t base = 0; base < size; base += StructuralScanner::block_size)
+			{
+				const uint64_t word = ~StructuralScanner::scan(scan_fn, data + base, size - base).whitespace;
+				const uint64_t shifted = (word << 1) | carry;
+				uint64_t events = (word & ~shifted) | (~word & shifted);
+				carry = word >> 63;
+
+				while (events)
+				{
+					const unsigned bit = count_trailing_zeros(events);
+					if (word >> bit & 1) start = base + bit;
+					else on_token(std::string_view(data + start, base + bit - start));
+					events &= events - 1;
+				}
+			}
+			if (carry) on_token(std::string_view(data + start, size - start));
+		}
+
+		template<typename Fn>
+		void tokenize(std::string_view args_str, Fn&& on_token) { tokenize(args_str, StructuralScanner::active(), std::forward<Fn>(on_token)); }
+	}
 }
 
-// terminal.hpp
+// grammar.hpp
 namespace cmdkit
 {
-	class Terminal
+	namespace detail
 	{
-	public:
-		void register_command(const std::string& name, Command cmd) { command_table[name] = cmd; }
-		void register_command(Command cmd) { command_table[cmd.get_name()] = cmd; }
+		inline bool is_space(char ch) { return ch == ' ' || unsigned(ch - '\t') <= unsigned('\r' - '\t'); }
+
+		// What a token is, from its first bytes and its first '=' (quotes removed):
+		//   word          anything else, including "-", "-5" and "-.5"
+		//   long_key      --key
+		//   long_value    --key=value
+		//   bundle        -abc
+		//   bundle_value  -abc=value
+		//   terminator    --, after which every token is a word
+		enum class ArgShape : uint8_t { word, long_key, long_value, bundle, bundle_value, terminator };
+
+		struct ArgToken
+		{
+			std::string_view text;
+			ArgShape shape;
+			size_t equals; // position of the first '=' in text; only meaningful for long_value and bundle_value
+		};
+
+		// GNU/POSIX command line grammar as two small DFAs over byte classes. The lexical one
+		// tracks quoting: whitespace separates tokens, '...' is literal, "..." is literal except
+		// for \" and \\, and a backslash outside quotes takes the next byte literally. The shape
+		// one reads the unquoted bytes of a token and classifies it (see ArgShape). Both are
+		// tables; nothing is looked at twice.
+		struct ArgGrammar
+		{
+			enum Class : uint8_t { ordinary, dash, equals, digit, space, single_quote, double_quote, backslash, class_count };
+			enum Mode : uint8_t { unquoted, in_single, in_double, escaped, in_double_escaped, mode_count };
+			enum Action : uint8_t { content, drop, end, escaped_content };
+			enum State : uint8_t { start, dash1, dash2, long_key, long_value, short_key, short_value, word, state_count };
+
+			// Shape transitions carry this bit when they consume the first '=' of an option.
+			static constexpr uint8_t marks_equals = 0x80;
+			// The shape class of a byte past the end of a token.
+			static constexpr uint8_t past_end = 4;
+
+			static constexpr std::array<uint8_t, 256> make_classes()
+			{
+				std::array<uint8_t, 256> classes{};
+				classes[' '] = classes['\t'] = classes['\n'] = classes['\v'] = classes['\f'] = classes['\r'] = space;
+				classes['-'] = dash;
+				classes['='] = equals;
+				classes['.'] = digit;
+				for (char ch = '0'; ch <= '9'; ++ch) classes[uint8_t(ch)] = digit;
+				classes['\''] = single_quote;
+				classes['"'] = double_quote;
+				classes['\\'] = backslash;
+				return classes;
+			}
+
+			// The classes the shape DFA reads: quotes, backslashes and spaces that reach it were
+			// quoted or escaped, so they read as ordinary.
+			static constexpr std::array<uint8_t, 256> make_shape_classes()
+			{
+				std::array<uint8_t, 256> classes = make_classes();
+				for (uint8_t& cls : classes)
+					if (cls >= space) cls = ordinary;
+				return classes;
+			}
+
+			// The same, but whitespace reads as past_end, for bytes just after an unquoted token.
+			static constexpr std::array<uint8_t, 256> make_delimited_classes()
+			{
+				std::array<uint8_t, 256> classes = make_shape_classes();
+				const std::array<uint8_t, 256> lexical = make_classes();
+				for (size_t ch = 0; ch < classes.size(); ++ch)
+					if (lexical[ch] == space) classes[ch] = past_end;
+				return classes;
+			}
+
+			static constexpr uint8_t lex_entry(Mode mode, Action action) { return uint8_t(mode << 4 | action); }
+
+			static constexpr std::array<std::array<uint8_t, class_count>, mode_count> make_lexer()
+			{
+				std::array<std::array<uint8_t, class_count>, mode_count> table{};
+				for (uint8_t cls = 0; cls < class_count; ++cls)
+				{
+					table[unquoted][cls] = lex_entry(unquoted, content);
+					table[in_single][cls] = lex_entry(in_single, content);
+					table[in_double][cls] = lex_entry(in_double, content);
+					table[escaped][cls] = lex_entry(unquoted, content);
+					table[in_double_escaped][cls] = lex_entry(in_double, escaped_content);
+				}
+				table[unquoted][space] = lex_entry(unquoted, end);
+				table[unquoted][single_quote] = lex_entry(in_single, drop);
+				table[unquoted][double_quote] = lex_entry(in_double, drop);
+				table[unquoted][backslash] = lex_entry(escaped, drop);
+				table[in_single][single_quote] = lex_entry(unquoted, drop);
+				table[in_double][double_quote] = lex_entry(unquoted, drop);
+				table[in_double][backslash] = lex_entry(in_double_escaped, drop);
+				table[in_double_escaped][double_quote] = lex_entry(in_double, content);
+				table[in_double_escaped][backslash] = lex_entry(in_double, content);
+				return table;
+			}
+
+			// Indexed by the shape classes (ordinary, dash, equals, digit).
+			static constexpr std::array<std::array<uint8_t, 4>, state_count> make_shapes()
+			{
+				std::array<std::array<uint8_t, 4>, state_count> table{};
+				auto row = [&table](State state, uint8_t on_ordinary, uint8_t on_dash, uint8_t on_equals, uint8_t on_digit)
+					{
+						table[state] = { on_ordinary, on_dash, on_equals, on_digit };
+					};
+				row(start, word, dash1, word, word);
+				row(dash1, short_key, dash2, word, word);
+				row(dash2, long_key, long_key, word, long_key);
+				row(long_key, long_key, long_key, long_value | marks_equals, long_key);
+				row(long_value, long_value, long_value, long_value, long_value);
+				row(short_key, short_key, short_key, short_value | marks_equals, short_key);
+				row(short_value, short_value, short_value, short_value, short_value);
+				row(word, word, word, word, word);
+				return table;
+			}
+
+			static constexpr ArgShape final_shape(uint8_t state)
+			{
+				constexpr ArgShape shapes[state_count] = {
+					ArgShape::word, ArgShape::word, ArgShape::terminator, ArgShape::long_key,
+					ArgShape::long_value, ArgShape::bundle, ArgShape::bundle_value, ArgShape::word
+				};
+				return shapes[state];
+			}
+
+			static constexpr std::array<ArgShape, state_count> make_final_shapes()
+			{
+				std::array<ArgShape, state_count> table{};
+				for (uint8_t state = 0; state < state_count; ++state) table[state] = final_shape(state);
+				return table;
+			}
+
+			// The first three bytes decide a token's shape up to its first '=', so the shape DFA
+			// over them is folded into one table, indexed by their shape classes (or past_end).
+			// An entry holds the shape in its low nibble, and the shape if an '=' follows in its
+			// high nibble.
+			static constexpr std::array<uint8_t, 4 * 5 * 5> make_prefixes()
+			{
+				constexpr std::array<std::array<uint8_t, 4>, state_count> shapes = make_shapes();
+				std::array<uint8_t, 4 * 5 * 5> table{};
+				for (uint8_t idx = 0; idx < table.size(); ++idx)
+				{
+					const uint8_t classes[3] = { uint8_t(idx / 25), uint8_t(idx / 5 % 5), uint8_t(idx % 5) };
+					uint8_t state = start;
+					for (uint8_t cls : classes)
+					{
+						if (cls == past_end || state >= long_key) break;
+						state = shapes[state][cls] & ~marks_equals;
+					}
+					const uint8_t valued = state == long_key ? uint8_t(long_value) : state == short_key ? uint8_t(short_value) : state;
+					table[idx] = uint8_t(uint8_t(final_shape(state)) | uint8_t(final_shape(valued)) << 4);
+				}
+				return table;
+			}
+		};
 
+		// The tables, built at compile time.
+		inline constexpr std::array<uint8_t, 256> arg_classes = ArgGrammar::make_classes();
+		inline constexpr std::array<uint8_t, 256> arg_shape_classes = ArgGrammar::make_shape_classes();
+		inline constexpr std::array<uint8_t, 256> arg_delimited_classes = ArgGrammar::make_delimited_classes();
+		inline constexpr std::array<std::array<uint8_t, ArgGrammar::class_count>, ArgGrammar::mode_count> arg_lexer = ArgGrammar::make_lexer();
+		inline constexpr std::array<std::array<uint8_t, 4>, ArgGrammar::state_count> arg_shapes = ArgGrammar::make_shapes();
+		inline constexpr std::array<ArgShape, ArgGrammar::state_count> arg_final_shape = ArgGrammar::make_final_shapes();
+		inline constexpr std::array<uint8_t, 4 * 5 * 5> arg_prefixes = ArgGrammar::make_prefixes();
 
-		void invoke(const CommandArgs& command) const
+		inline uint8_t arg_class_of(char ch) { return arg_classes[static_cast<unsigned char>(ch)]; }
+		inline uint8_t arg_shape_class_of(char ch) { return arg_shape_classes[static_cast<unsigned char>(ch)]; }
+
+		// The arg_prefixes entry for the first bytes of a token.
+		inline uint8_t arg_prefix(const char* text, size_t size)
 		{
-			invoke(command, []() { throw std::runtime_error("Not find command!"); });
+			if (size == 0) return arg_prefixes[ArgGrammar::ordinary * 25];
+			const uint8_t first = arg_shape_class_of(text[0]);
+			const uint8_t second = size > 1 ? arg_shape_class_of(text[1]) : ArgGrammar::past_end;
+			const uint8_t third = size > 2 ? arg_shape_class_of(text[2]) : ArgGrammar::past_end;
+			return arg_prefixes[(first * 5 + second) * 5 + third];
 		}
 
-		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
-		void invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		// The same for an unquoted token in a line, with at least three bytes of the line from
+		// text on: the whitespace after a shorter token marks its end.
+		inline uint8_t arg_delimited_prefix(const char* text)
 		{
-			auto it = command_table.find(command[0]);
-			if (it != command_table.end()) (it->second).invoke(command);
-			else std::invoke(std::forward<Fn>(not_find_callback));
+			const auto cls = [text](size_t pos) { return arg_delimited_classes[static_cast<unsigned char>(text[pos])]; };
+			return arg_prefixes[(cls(0) * 5 + cls(1)) * 5 + cls(2)];
 		}
 
-		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
-		void invoke(const std::string& command, Fn&& not_find_callback) const
+		// A token's shape from its prefix entry and the position of its first '=' past the prefix.
+		inline ArgToken make_arg_token(std::string_view text, uint8_t prefix, size_t equals)
 		{
-			return invoke(CommandArgs::parse(command), not_find_callback);
+			const ArgShape shape = ArgShape(equals == std::string_view::npos ? prefix & 0xf : prefix >> 4);
+			return ArgToken{ text, shape, equals };
 		}
 
-		void invoke(const std::string& command) const
+		// Classifies a token that needs no unquoting, such as an argv element.
+		inline ArgToken classify_arg(std::string_view text)
 		{
-			return invoke(CommandArgs::parse(command), []() { throw std::runtime_error("Not find command!"); });
+			const uint8_t prefix = arg_prefix(text.data(), text.size());
+			const ArgShape shape = ArgShape(prefix & 0xf);
+			size_t equals = std::string_view::npos;
+			if (shape == ArgShape::long_key || shape == ArgShape::bundle) equals = text.find('=', shape == ArgShape::long_key ? 3 : 2);
+			return make_arg_token(text, prefix, equals);
 		}
 
-	private:
-		std::map<std::string, Command> command_table;
-	};
+		// Runs both DFAs a byte at a time over one token starting at pos, for tokens with quotes
+		// or escapes. Returns the position of the whitespace that ends it (or the end of line).
+		// Content is copied a run at a time, between the quotes and backslashes the lexer drops,
+		// and the text stays a view of data while there is only one run, as in "abc".
+		template<typename Store, typename Fn>
+		size_t lex_quoted_arg(const char* data, size_t size, size_t pos, bool& closed, std::string& scratch, Store& store, Fn& on_token)
+		{
+			using G = ArgGrammar;
+
+			uint8_t mode = G::unquoted;
+			uint8_t state = G::start;
+			size_t equals = 0;
+			size_t run = pos; // start of the content run in progress
+			size_t length = 0; // content bytes before run
+			size_t begin = pos, end = pos; // the first run, while there is only one
+			bool copying = false;
+
+			auto flush = [&](size_t to)
+				{
+					if (run == to) return;
+					if (copying) scratch.append(data + run, to - run);
+					else if (length == 0) { begin = run; end = to; }
+					else
+					{
+						copying = true;
+						scratch.assign(data + begin, end - begin);
+						scratch.append(data + run, to - run);
+					}
+					length += to - run;
+				};
+			auto advance = [&](size_t at)
+				{
+					const uint8_t next = arg_shapes[state][arg_shape_class_of(data[at])];
+					if (next & G::marks_equals) equals = length + (at - run);
+					state = next & ~G::marks_equals;
+				};
+
+			for (; pos < size; ++pos)
+			{
+				const uint8_t entry = arg_lexer[mode][arg_class_of(data[pos])];
+				const uint8_t action = entry & 0xf;
+				mode = entry >> 4;
+				if (action == G::content) { advance(pos); continue; }
+				if (action == G::end) break;
+
+				flush(pos);
+				if (action == G::escaped_content)
+				{
+					// Inside double quotes, a backslash before anything but " or \ is kept.
+					run = pos - 1;
+					advance(pos - 1);
+					advance(pos);
+					continue;
+				}
+				run = pos + 1;
+			}
+
+			// A trailing backslash escapes nothing and is kept.
+			if (mode == G::escaped)
+			{
+				run = size - 1;
+				advance(size - 1);
+				mode = G::unquoted;
+			}
+			flush(pos);
+			closed = closed && mode == G::unquoted;
+
+			const std::string_view text = copying ? std::string_view(store(std::string_view(scratch))) : std::string_view(data + begin, end - begin);
+			on_token(ArgToken{ text, arg_final_shape[state], equals });
+			return pos;
+		}
+
+		// Emits the tokens of line from pos on that need no unquoting, and stops at the first
+		// one with quotes or escapes: returns where it starts, or npos at the end of the line.
+		// Token bounds are the edges of the structural scanner's whitespace bitmap, as in
+		// tokenize, and the same window's quote, escape and '=' bitmaps give the rest, so a
+		// token costs a few bit operations and one prefix lookup.
+		template<typename Fn>
+		size_t lex_plain_args(std::string_view line, size_t pos, StructuralScanner::ScanFn scan_fn, Fn& on_token)
+		{
+			const char* data = line.data();
+			const size_t size = line.size();
+
+			// The token in progress: where it starts, and its first '=' so far, relative to start.
+			bool in_token = false;
+			size_t start = 0;
+			size_t equals = std::string_view::npos;
+
+			auto emit = [&](size_t end)
+				{
+					const uint8_t prefix = start + 3 <= size ? arg_delimited_prefix(data + start) : arg_prefix(data + start, end - start);
+					on_token(make_arg_token(std::string_view(data + start, end - start), prefix, equals));
+				};
+
+			for (size_t base = pos; base < size; base += StructuralScanner::block_size)
+			{
+				const StructuralMasks masks = StructuralScanner::scan(scan_fn, data + base, size - base);
+				const uint64_t word = ~masks.whitespace;
+				const uint64_t shifted = word << 1 | uint64_t(in_token);
+				uint64_t events = (word & ~shifted) | (~word & shifted);
+				const bool plain = !(masks.quote | masks.escape | masks.equals);
+
+				// Checks the token's bytes in this window below bit `to`; false if it needs unquoting.
+				auto note = [&](uint64_t to)
+					{
+						const uint64_t span = to & (~0ull << (start > base ? unsigned(start - base) : 0));
+						const uint64_t found = masks.equals & span;
+						if (found && equals == std::string_view::npos) equals = base + count_trailing_zeros(found) - start;
+						return !((masks.quote | masks.escape) & span);
+					};
+
+				for (; events; events &= events - 1)
+				{
+					const unsigned bit = count_trailing_zeros(events);
+					if (word >> bit & 1)
+					{
+						in_token = true;
+						start = base + bit;
+						equals = std::string_view::npos;
+						continue;
+					}
+
+					if (!plain && !note((1ull << bit) - 1)) return start;
+					emit(base + bit);
+					in_token = false;
+				}
+
+				// A token still open runs on into the next window.
+				if (in_token && !plain && !note(~0ull)) return start;
+			}
+			if (in_token) emit(size);
+			return std::string_view::npos;
+		}
+
+		// Splits a line into classified tokens in one pass: runs of plain tokens go through
+		// lex_plain_args, and each token with quotes or escapes through the byte-at-a-time DFAs.
+		//
+		// A token's text points into line unless quotes or escapes split it; then it is built
+		// in a scratch buffer and store(std::string_view) must return a copy that lives as long
+		// as the caller needs it. Returns false if the line ends inside quotes; the last token
+		// is still emitted, up to the end of the line.
+		template<typename Store, typename Fn>
+		bool lex_args(std::string_view line, StructuralScanner::ScanFn scan_fn, Store&& store, Fn&& on_token)
+		{
+			bool closed = true;
+			std::string scratch;
+			for (size_t pos = 0; (pos = lex_plain_args(line, pos, scan_fn, on_token)) != std::string_view::npos;)
+				pos = lex_quoted_arg(line.data(), line.size(), pos, closed, scratch, store, on_token);
+			return closed;
+		}
+
+		template<typename Store, typename Fn>
+		bool lex_args(std::string_view line, Store&& store, Fn&& on_token)
+		{
+			return lex_args(line, StructuralScanner::active(), std::forward<Store>(store), std::forward<Fn>(on_token));
+		}
+
+		// Position of the next `|` that stands alone as a token outside quotes, at or after from
+		// (which must not be inside quotes); npos if none.
+		inline size_t find_pipe(std::string_view line, size_t from = 0)
+		{
+			using G = ArgGrammar;
+
+			size_t pos = line.find('|', from);
+			if (pos == std::string_view::npos) return pos;
+
+			uint8_t mode = G::unquoted;
+			for (size_t idx = from; idx < line.size(); ++idx)
+			{
+				if (line[idx] == '|' && mode == G::unquoted && (idx == 0 || is_space(line[idx - 1])) && (idx + 1 == line.size() || is_space(line[idx + 1])))
+					return idx;
+				mode = arg_lexer[mode][arg_class_of(line[idx])] >> 4;
+			}
+			return std::string_view::npos;
+		}
+
+		// The first token of line, without lexing the rest; nullopt for a blank line. A plain
+		// token is a view of line, one with quotes or escapes is unquoted into scratch.
+		inline std::optional<std::string_view> first_arg(std::string_view line, std::string& scratch)
+		{
+			using G = ArgGrammar;
+
+			size_t start = 0;
+			while (start < line.size() && is_space(line[start])) start++;
+			if (start == line.size()) return std::nullopt;
+
+			size_t end = start;
+			while (end < line.size() && arg_class_of(line[end]) < G::space) end++;
+			if (end == line.size() || arg_class_of(line[end]) == G::space) return line.substr(start, end - start);
+
+			bool closed = true;
+			std::string buffer;
+			std::string_view first;
+			auto store = [&scratch](std::string_view text) { return std::string_view(scratch = text); };
+			auto on_token = [&first](const ArgToken& token) { first = token.text; };
+			lex_quoted_arg(line.data(), line.size(), start, closed, buffer, store, on_token);
+			return first;
+		}
+
+		// Streams tokens into positional / option / flag callbacks with one token of lookahead:
+		// `--key value` is an option, `--key` followed by another option or the end is a flag.
+		// Without a schema, every letter of a bundle is a flag, except that `-abc=value` gives
+		// c the value.
+		template<typename Positional, typename Option, typename Flag>
+		class ArgClassifier
+		{
+		public:
+			ArgClassifier(Positional& on_positional, Option& on_option, Flag& on_flag)
+				: on_positional(on_positional), on_option(on_option), on_flag(on_flag) {}
+
+			void push(const ArgToken& token)
+			{
+				// Words and --key come first and inline; the rest is kept out of the common path.
+				const std::string_view text = token.text;
+				if (token.shape == ArgShape::word || terminated)
+				{
+					if (has_pending) { on_option(pending, text); has_pending = false; }
+					else on_positional(text);
+					return;
+				}
+
+				if (token.shape == ArgShape::long_key)
+				{
+					if (has_pending) on_flag(pending);
+					pending = text.substr(2);
+					has_pending = true;
+					return;
+				}
+				push_rare(token);
+			}
+
+			void finish()
+			{
+				if (has_pending) on_flag(pending);
+				has_pending = false;
+			}
+
+		private:
+			// --key=value, --, and bundles.
+			void push_rare(const ArgToken& token)
+			{
+				const std::string_view text = token.text;
+				finish();
+				if (token.shape == ArgShape::long_value) on_option(text.substr(2, token.equals - 2), text.substr(token.equals + 1));
+				else if (token.shape == ArgShape::terminator) terminated = true;
+				else push_bundle(text, token.shape == ArgShape::bundle_value ? token.equals : text.size());
+			}
+
+			// Letters before `end` are flags; with `-abc=value`, end is the '=' and c takes the value.
+			void push_bundle(std::string_view text, size_t end)
+			{
+				const size_t flags = end < text.size() ? end - 1 : end;
+				for (size_t idx = 1; idx < flags; ++idx) on_flag(text.substr(idx, 1));
+				if (end < text.size()) on_option(text.substr(end - 1, 1), text.substr(end + 1));
+			}
+
+			Positional& on_positional;
+			Option& on_option;
+			Flag& on_flag;
+			std::string_view pending;
+			bool has_pending = false;
+			bool terminated = false;
+		};
+	}
+}
+
+// suggest.hpp
+namespace cmdkit
+{
+	struct Suggestion
+	{
+		std::string name;
+		size_t distance;
+	};
+
+	namespace detail
+	{
+		// Which of 64 character classes occur in text (byte value mod 64), and which of 64
+		// hashed classes of adjacent byte pairs. An edit adds at most one character class and
+		// removes at most one; for pairs it is two and two.
+		struct NameSignature
+		{
+			uint64_t chars = 0;
+			uint64_t bigrams = 0;
+
+			explicit NameSignature(std::string_view text)
+			{
+				for (size_t idx = 0; idx < text.size(); ++idx)
+				{
+					chars |= uint64_t(1) << (static_cast<unsigned char>(text[idx]) & 63);
+					if (idx + 1 == text.size()) break;
+					const uint32_t pair = uint32_t(static_cast<unsigned char>(text[idx])) | uint32_t(static_cast<unsigned char>(text[idx + 1])) << 8;
+					bigrams |= uint64_t(1) << ((pair * 2654435761u) >> 26);
+				}
+			}
+
+			// False when more than edits edits separate the two texts.
+			bool within(const NameSignature& other, size_t edits) const
+			{
+				// Each pair of counts is combined without a branch; most names fail on characters.
+				const bool chars_ok = (popcount(chars & ~other.chars) <= edits) & (popcount(other.chars & ~chars) <= edits);
+				if (!chars_ok) return false;
+				return (popcount(bigrams & ~other.bigrams) <= 2 * edits) & (popcount(other.bigrams & ~bigrams) <= 2 * edits);
+			}
+
+			// Inline even where the compiler would call a library routine for __builtin_popcountll.
+			static size_t popcount(uint64_t bits)
+			{
+#if defined(__POPCNT__) || (defined(_MSC_VER) && defined(__AVX__))
+				return size_t(__builtin_popcountll(bits));
+#else
+				bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+				bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+				bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+				return size_t((bits * 0x0101010101010101ull) >> 56);
+#endif
+			}
+		};
+
+		inline size_t common_prefix(std::string_view lhs, std::string_view rhs)
+		{
+			const size_t size = std::min(lhs.size(), rhs.size());
+			size_t pos = 0;
+			while (pos < size && lhs[pos] == rhs[pos]) pos++;
+			return pos;
+		}
+
+		// Levenshtein distance from a fixed pattern to many texts. Patterns of up to 64 bytes use
+		// Myers' bit-parallel algorithm (in Hyyrö's formulation): one column of the DP matrix is
+		// a pair of bit vectors, advanced by a dozen word operations per text byte. Longer
+		// patterns fall back to the two-row DP.
+		class EditDistance
+		{
+		public:
+			explicit EditDistance(std::string_view pattern) : pattern(pattern)
+			{
+				if (pattern.size() > 64) return;
+				for (size_t idx = 0; idx < pattern.size(); ++idx) peq[static_cast<unsigned char>(pattern[idx])] |= uint64_t(1) << idx;
+			}
+
+			// The distance, or a value above limit once it is certain to exceed it.
+			size_t operator()(std::string_view text, size_t limit) const
+			{
+				const size_t size = pattern.size();
+				if (size == 0) return text.size();
+				if (size > 64) return dynamic(text);
+
+				const uint64_t last = uint64_t(1) << (size - 1);
+				uint64_t pv = ~uint64_t(0);
+				uint64_t mv = 0;
+				size_t score = size;
+				for (size_t idx = 0; idx < text.size(); ++idx)
+				{
+					const uint64_t eq = peq[static_cast<unsigned char>(text[idx])];
+					const uint64_t xv = eq | mv;
+					const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+					uint64_t ph = mv | ~(xh | pv);
+					uint64_t mh = pv & xh;
+					if (ph & last) score++;
+					else if (mh & last) score--;
+
+					// Each remaining byte lowers the score by one at most.
+					if (score > limit + (text.size() - idx - 1)) return limit + 1;
+
+					ph = (ph << 1) | 1;
+					mh <<= 1;
+					pv = mh | ~(xv | ph);
+					mv = ph & xv;
+				}
+				return score;
+			}
+
+		private:
+			size_t dynamic(std::string_view text) const
+			{
+				std::vector<size_t> row(text.size() + 1);
+				for (size_t col = 0; col <= text.size(); ++col) row[col] = col;
+				for (size_t line = 1; line <= pattern.size(); ++line)
+				{
+					size_t diagonal = row[0];
+					row[0] = line;
+					for (size_t col = 1; col <= text.size(); ++col)
+					{
+						const size_t above = row[col];
+						row[col] = std::min({ above + 1, row[col - 1] + 1, diagonal + (pattern[line - 1] == text[col - 1] ? 0 : 1) });
+						diagonal = above;
+					}
+				}
+				return row[text.size()];
+			}
+
+		private:
+			std::string_view pattern;
+			std::array<uint64_t, 256> peq{};
+		};
+	}
+
+	// Names for completion and "did you mean" suggestions, grouped by length. Each length keeps
+	// its names back to back in one pool, next to a signature of the characters and character
+	// pairs in each. Once there are enough names, every bigram and trigram also gets a posting
+	// list of the names containing it. Adding a name appends to its group and its postings, so
+	// the index is never rebuilt.
+	//
+	// A suggestion query cuts the query into one piece more than the edits allowed; a name
+	// within that many edits contains at least one piece unchanged, so it is in the posting
+	// list of that piece's rarest gram. Only those names are candidates (short queries scan
+	// their length groups instead). Candidates whose length or signature shows more edits
+	// than allowed are dropped before the edit distance runs.
+	class NameIndex
+	{
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		// The caller keeps names unique.
+		void add(std::string_view name)
+		{
+			if (name.size() >= groups.size()) groups.resize(name.size() + 1);
+			Group& group = groups[name.size()];
+			locations.push_back(Location{ uint32_t(name.size()), uint32_t(group.signatures.size()) });
+			group.pool.append(name);
+			group.signatures.emplace_back(name);
+
+			if (!postings.empty()) post(uint32_t(locations.size() - 1));
+			else if (locations.size() == posting_threshold)
+			{
+				postings.resize(posting_buckets);
+				for (uint32_t id = 0; id < locations.size(); ++id) post(id);
+			}
+		}
+
+		size_t size() const { return locations.size(); }
+
+		// Up to limit names starting with prefix, shortest first, then in byte order.
+		std::vector<std::string> complete(std::string_view prefix, size_t limit = 10) const
+		{
+			std::vector<std::string> result;
+			std::vector<std::string_view> found;
+			for (size_t length = prefix.size(); length < groups.size() && result.size() < limit; ++length)
+			{
+				const Group& group = groups[length];
+				found.clear();
+				for (size_t idx = 0; idx < group.signatures.size(); ++idx)
+				{
+					const std::string_view name(group.pool.data() + idx * length, length);
+					if (name.compare(0, prefix.size(), prefix) == 0) found.push_back(name);
+				}
+				std::sort(found.begin(), found.end());
+				for (size_t idx = 0; idx < found.size() && result.size() < limit; ++idx) result.emplace_back(found[idx]);
+			}
+			return result;
+		}
+
+		// Up to limit names within max_distance edits of query, closest first; ties prefer a
+		// longer common prefix, then a length nearer to the query's. By default a third of the
+		// query's length is allowed, between one and three edits.
+		std::vector<Suggestion> suggest(std::string_view query, size_t limit = 3, size_t max_distance = npos) const
+		{
+			if (limit == 0) return {};
+			if (max_distance == npos) max_distance = std::clamp<size_t>(query.size() / 3, 1, 3);
+
+			std::vector<Candidate> best;
+			const detail::EditDistance distance(query);
+			const detail::NameSignature query_signature(query);
+			auto consider = [&](size_t length, size_t idx)
+				{
+					// Once the list is full, only names that can beat its last entry are worth a look.
+					const size_t allowed = best.size() < limit ? max_distance : best.back().distance;
+					const size_t length_gap = length > query.size() ? length - query.size() : query.size() - length;
+					if (length_gap > allowed || !groups[length].signatures[idx].within(query_signature, allowed)) return;
+
+					const std::string_view name(groups[length].pool.data() + idx * length, length);
+					const size_t dist = distance(name, allowed);
+					if (dist > allowed) return;
+
+					const Candidate candidate{ name, dist, detail::common_prefix(query, name), length_gap };
+					if (best.size() == limit && !(candidate < best.back())) return;
+					if (best.size() == limit) best.pop_back();
+					best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+				};
+
+			std::vector<const std::vector<uint32_t>*> lists;
+			if (select_postings(query, max_distance, lists)) merge(lists, [&](uint32_t id) { consider(locations[id].length, locations[id].index); });
+			else
+			{
+				const size_t shortest = query.size() > max_distance ? query.size() - max_distance : 0;
+				for (size_t length = shortest; length < groups.size() && length <= query.size() + max_distance; ++length)
+					for (size_t idx = 0; idx < groups[length].signatures.size(); ++idx) consider(length, idx);
+			}
+
+			std::vector<Suggestion> result;
+			result.reserve(best.size());
+			for (const Candidate& candidate : best) result.push_back(Suggestion{ std::string(candidate.name), candidate.distance });
+			return result;
+		}
+
+	private:
+		static constexpr size_t posting_threshold = 256;
+		static constexpr size_t posting_buckets = 1 << 14;
+
+		struct Group
+		{
+			std::string pool;
+			std::vector<detail::NameSignature> signatures;
+		};
+
+		struct Location
+		{
+			uint32_t length;
+			uint32_t index;
+		};
+
+		struct Candidate
+		{
+			std::string_view name;
+			size_t distance;
+			size_t prefix;
+			size_t length_gap;
+
+			bool operator<(const Candidate& other) const
+			{
+				if (distance != other.distance) return distance < other.distance;
+				if (prefix != other.prefix) return prefix > other.prefix;
+				if (length_gap != other.length_gap) return length_gap < other.length_gap;
+				return name < other.name;
+			}
+		};
+
+		// Posting bucket of the bigram (size 2) or trigram (size 3) at text.
+		static size_t bucket_of(const char* text, size_t size)
+		{
+			uint32_t key = uint32_t(static_cast<unsigned char>(text[0])) | uint32_t(static_cast<unsigned char>(text[1])) << 8;
+			key |= size == 3 ? uint32_t(static_cast<unsigned char>(text[2])) << 16 : 0xff000000u;
+			return (key * 2654435761u) >> (32 - 14);
+		}
+
+		// Lists are in id order, so a name seen twice is at the back of the list already.
+		void post(uint32_t id)
+		{
+			const Location location = locations[id];
+			const char* name = groups[location.length].pool.data() + size_t(location.index) * location.length;
+			for (size_t pos = 0; pos + 2 <= location.length; ++pos)
+				for (size_t size = 2; size <= 3 && pos + size <= location.length; ++size)
+				{
+					std::vector<uint32_t>& list = postings[bucket_of(name + pos, size)];
+					if (list.empty() || list.back() != id) list.push_back(id);
+				}
+		}
+
+		// For each of the max_distance + 1 pieces of query, the shortest posting list among its
+		// grams. False when there are no postings or a piece is shorter than two bytes.
+		bool select_postings(std::string_view query, size_t max_distance, std::vector<const std::vector<uint32_t>*>& lists) const
+		{
+			const size_t pieces = max_distance + 1;
+			const size_t piece = query.size() / pieces;
+			if (postings.empty() || piece < 2) return false;
+
+			for (size_t idx = 0; idx < pieces; ++idx)
+			{
+				const size_t begin = idx * piece;
+				const size_t end = idx + 1 == pieces ? query.size() : begin + piece;
+				const size_t size = end - begin >= 3 ? 3 : 2;
+				const std::vector<uint32_t>* shortest = nullptr;
+				for (size_t pos = begin; pos + size <= end; ++pos)
+				{
+					const std::vector<uint32_t>& list = postings[bucket_of(query.data() + pos, size)];
+					if (!shortest || list.size() < shortest->size()) shortest = &list;
+				}
+				lists.push_back(shortest);
+			}
+			return true;
+		}
+
+		// Visits the union of the sorted lists in id order, each id once.
+		template<typename Fn>
+		static void merge(const std::vector<const std::vector<uint32_t>*>& lists, Fn&& fn)
+		{
+			std::vector<size_t> cursors(lists.size(), 0);
+			while (true)
+			{
+				uint32_t next = UINT32_MAX;
+				for (size_t idx = 0; idx < lists.size(); ++idx)
+					if (cursors[idx] < lists[idx]->size()) next = std::min(next, (*lists[idx])[cursors[idx]]);
+				if (next == UINT32_MAX) return;
+
+				fn(next);
+				for (size_t idx = 0; idx < lists.size(); ++idx)
+					if (cursors[idx] < lists[idx]->size() && (*lists[idx])[cursors[idx]] == next) cursors[idx]++;
+			}
+		}
+
+	private:
+		std::vector<Group> groups;
+		std::vector<Location> locations;
+		std::vector<std::vector<uint32_t>> postings;
+	};
+}
+
+// convert.hpp
+namespace cmdkit
+{
+	enum class ParseErrc { missing, invalid, out_of_range };
+
+	struct ParseError
+	{
+		ParseErrc code = ParseErrc::invalid;
+		std::string key;
+
+		std::string message() const
+		{
+			switch (code)
+			{
+			case ParseErrc::missing: return "Missing option --" + key;
+			case ParseErrc::out_of_range: return "Value out of range for option --" + key;
+			default: return "Invalid value for option --" + key;
+			}
+		}
+	};
+
+	// A byte count written as `512`, `64K`, `1.5MiB`, `2GB`... Suffixes are binary (K = 1024).
+	struct ByteSize
+	{
+		uint64_t bytes = 0;
+
+		friend constexpr bool operator==(ByteSize lhs, ByteSize rhs) { return lhs.bytes == rhs.bytes; }
+		friend constexpr bool operator!=(ByteSize lhs, ByteSize rhs) { return lhs.bytes != rhs.bytes; }
+	};
+
+	// Specialize with `static Result<T, ParseErrc> convert(std::string_view)` to read other types.
+	template<typename T, typename Enable = void>
+	struct OptionConverter;
+
+	template<typename T>
+	Result<T, ParseErrc> parse_value(std::string_view text) { return OptionConverter<T>::convert(text); }
+
+	namespace detail
+	{
+		inline ParseErrc to_parse_errc(std::errc ec) { return ec == std::errc::result_out_of_range ? ParseErrc::out_of_range : ParseErrc::invalid; }
+
+		// Parses a leading number and returns the unparsed suffix through `rest`.
+		inline std::errc parse_double(std::string_view text, double& val, std::string_view& rest)
+		{
+			if (!text.empty() && text[0] == '+') text.remove_prefix(1);
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+			auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), val);
+			if (ec != std::errc()) return ec;
+			rest = text.substr(size_t(ptr - text.data()));
+			return std::errc();
+#else
+			// No floating-point from_chars: strtod on a bounded, NUL-terminated copy.
+			char buffer[64];
+			if (text.empty() || text.size() >= sizeof(buffer) || std::isspace(static_cast<unsigned char>(text[0]))) return std::errc::invalid_argument;
+			std::memcpy(buffer, text.data(), text.size());
+			buffer[text.size()] = '\0';
+			char* end = nullptr;
+			errno = 0;
+			val = std::strtod(buffer, &end);
+			if (end == buffer) return std::errc::invalid_argument;
+			if (errno == ERANGE) return std::errc::result_out_of_range;
+			rest = text.substr(size_t(end - buffer));
+			return std::errc();
+#endif
+		}
+
+		inline bool iequals(std::string_view lhs, std::string_view rhs)
+		{
+			if (lhs.size() != rhs.size()) return false;
+			for (size_t idx = 0; idx < lhs.size(); ++idx)
+				if ((lhs[idx] | 0x20) != (rhs[idx] | 0x20)) return false;
+			return true;
+		}
+
+		template<typename T>
+		inline constexpr char type_tag = 0;
+
+		// A few converted values per args object, keyed by option name and requested type.
+		// Copies start empty: cached keys point into storage the copy does not share.
+		class ConversionCache
+		{
+		public:
+			static constexpr size_t slot_count = 4;
+			static constexpr size_t value_size = 24;
+
+			template<typename T>
+			static constexpr bool cacheable = std::is_trivially_copyable_v<Result<T, ParseErrc>>
+				&& sizeof(Result<T, ParseErrc>) <= value_size
+				&& alignof(Result<T, ParseErrc>) <= alignof(uint64_t);
+
+			ConversionCache() = default;
+			ConversionCache(const ConversionCache&) {}
+			ConversionCache& operator=(const ConversionCache&) { clear(); return *this; }
+
+			template<typename T>
+			const Result<T, ParseErrc>* find(std::string_view key) const
+			{
+				for (const auto& slot : slots)
+					if (slot.type == &type_tag<T> && slot.key == key) return std::launder(reinterpret_cast<const Result<T, ParseErrc>*>(slot.value));
+				return nullptr;
+			}
+
+			// `key` must stay valid as long as this cache does.
+			template<typename T>
+			void store(std::string_view key, const Result<T, ParseErrc>& val)
+			{
+				Slot& slot = slots[next++ % slot_count];
+				slot.type = &type_tag<T>;
+				slot.key = key;
+				::new (static_cast<void*>(slot.value)) Result<T, ParseErrc>(val);
+			}
+
+			void clear() { slots = {}; next = 0; }
+
+		private:
+			struct Slot
+			{
+				const void* type = nullptr;
+				std::string_view key;
+				alignas(uint64_t) unsigned char value[value_size];
+			};
+
+			std::array<Slot, slot_count> slots{};
+			unsigned next = 0;
+		};
+
+		// Looks `key` up through `find_value` (returning a pointer to a string_view-convertible value
+		// whose key outlives the cache, or nullptr) and converts it, consulting the cache first.
+		template<typename T, typename FindFn>
+		Result<T, ParseError> get_option_as(ConversionCache& cache, std::string_view key, FindFn&& find_value)
+		{
+			auto to_error = [key](ParseErrc code) { return Result<T, ParseError>::err(ParseError{ code, std::string(key) }); };
+			auto finish = [&](const Result<T, ParseErrc>& val) { return val.is_ok() ? Result<T, ParseError>::ok(val.unwrap()) : to_error(val.unwrap_err()); };
+
+			if constexpr (ConversionCache::cacheable<T>)
+				if (const auto* hit = cache.find<T>(key)) return finish(*hit);
+
+			std::string_view stored_key;
+			std::string_view text;
+			if (!find_value(stored_key, text)) return to_error(ParseErrc::missing);
+
+			Result<T, ParseErrc> val = parse_value<T>(text);
+			if constexpr (ConversionCache::cacheable<T>) cache.store<T>(stored_key, val);
+			return finish(val);
+		}
+	}
+
+	template<typename T>
+	struct OptionConverter<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+	{
+		static Result<T, ParseErrc> convert(std::string_view text)
+		{
+			if (!text.empty() && text[0] == '+') text.remove_prefix(1);
+			int base = 10;
+			if (text.size() > 2 && text[0] == '0' && (text[1] | 0x20) == 'x') { text.remove_prefix(2); base = 16; }
+
+			T val{};
+			auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), val, base);
+			if (ec != std::errc()) return Result<T, ParseErrc>::err(detail::to_parse_errc(ec));
+			if (ptr != text.data() + text.size()) return Result<T, ParseErrc>::err(ParseErrc::invalid);
+			return Result<T, ParseErrc>::ok(val);
+		}
+	};
+
+	template<typename T>
+	struct OptionConverter<T, std::enable_if_t<std::is_floating_point_v<T>>>
+	{
+		static Result<T, ParseErrc> convert(std::string_view text)
+		{
+			double val = 0;
+			std::string_view rest;
+			if (auto ec = detail::parse_double(text, val, rest); ec != std::errc()) return Result<T, ParseErrc>::err(detail::to_parse_errc(ec));
+			if (!rest.empty()) return Result<T, ParseErrc>::err(ParseErrc::invalid);
+			if (std::isfinite(val) && std::fabs(val) > double(std::numeric_limits<T>::max())) return Result<T, ParseErrc>::err(ParseErrc::out_of_range);
+			return Result<T, ParseErrc>::ok(static_cast<T>(val));
+		}
+	};
+
+	template<>
+	struct OptionConverter<bool>
+	{
+		static Result<bool, ParseErrc> convert(std::string_view text)
+		{
+			for (std::string_view word : { "true", "yes", "on", "1" }) if (detail::iequals(text, word)) return Result<bool, ParseErrc>::ok(true);
+			for (std::string_view word : { "false", "no", "off", "0" }) if (detail::iequals(text, word)) return Result<bool, ParseErrc>::ok(false);
+			return Result<bool, ParseErrc>::err(ParseErrc::invalid);
+		}
+	};
+
+	// `250ms`, `1.5s`, `2h`... A bare number counts in the target duration's own unit.
+	template<typename Rep, typename Period>
+	struct OptionConverter<std::chrono::duration<Rep, Period>>
+	{
+		using Duration = std::chrono::duration<Rep, Period>;
+
+		static Result<Duration, ParseErrc> convert(std::string_view text)
+		{
+			double count = 0;
+			std::string_view unit;
+			if (auto ec = detail::parse_double(text, count, unit); ec != std::errc()) return Result<Duration, ParseErrc>::err(detail::to_parse_errc(ec));
+
+			double seconds_per_unit = 0;
+			if (unit.empty()) seconds_per_unit = double(Period::num) / double(Period::den);
+			else if (unit == "ns") seconds_per_unit = 1e-9;
+			else if (unit == "us") seconds_per_unit = 1e-6;
+			else if (unit == "ms") seconds_per_unit = 1e-3;
+			else if (unit == "s") seconds_per_unit = 1;
+			else if (unit == "m" || unit == "min") seconds_per_unit = 60;
+			else if (unit == "h") seconds_per_unit = 3600;
+			else return Result<Duration, ParseErrc>::err(ParseErrc::invalid);
+
+			const double ticks = unit.empty() ? count : count * seconds_per_unit * double(Period::den) / double(Period::num);
+			if constexpr (std::is_integral_v<Rep>)
+			{
+				const double rounded = std::round(ticks);
+				if (!(rounded >= double(std::numeric_limits<Rep>::min()) && rounded < double(std::numeric_limits<Rep>::max())))
+					return Result<Duration, ParseErrc>::err(ParseErrc::out_of_range);
+				return Result<Duration, ParseErrc>::ok(Duration(static_cast<Rep>(rounded)));
+			}
+			else return Result<Duration, ParseErrc>::ok(Duration(static_cast<Rep>(ticks)));
+		}
+	};
+
+	template<>
+	struct OptionConverter<ByteSize>
+	{
+		static Result<ByteSize, ParseErrc> convert(std::string_view text)
+		{
+			double count = 0;
+			std::string_view unit;
+			if (auto ec = detail::parse_double(text, count, unit); ec != std::errc()) return Result<ByteSize, ParseErrc>::err(detail::to_parse_errc(ec));
+			if (count < 0) return Result<ByteSize, ParseErrc>::err(ParseErrc::invalid);
+
+			double multiplier = 1;
+			if (!unit.empty() && !detail::iequals(unit, "b"))
+			{
+				static constexpr std::string_view prefixes = "kmgt";
+				const size_t power = prefixes.find(char(unit[0] | 0x20));
+				const std::string_view tail = unit.substr(1);
+				if (power == std::string_view::npos || !(tail.empty() || detail::iequals(tail, "b") || detail::iequals(tail, "ib")))
+					return Result<ByteSize, ParseErrc>::err(ParseErrc::invalid);
+				multiplier = std::ldexp(1.0, int(10 * (power + 1)));
+			}
+
+			const double bytes = std::round(count * multiplier);
+			if (!(bytes < 18446744073709551616.0)) return Result<ByteSize, ParseErrc>::err(ParseErrc::out_of_range);
+			return Result<ByteSize, ParseErrc>::ok(ByteSize{ static_cast<uint64_t>(bytes) });
+		}
+	};
+
+	template<>
+	struct OptionConverter<std::string_view>
+	{
+		static Result<std::string_view, ParseErrc> convert(std::string_view text) { return Result<std::string_view, ParseErrc>::ok(text); }
+	};
+
+	template<>
+	struct OptionConverter<std::string>
+	{
+		static Result<std::string, ParseErrc> convert(std::string_view text) { return Result<std::string, ParseErrc>::ok(std::string(text)); }
+	};
+}
+
+// event_loop.hpp
+namespace cmdkit
+{
+	// Single-threaded event loop. Callbacks and timers run on the thread calling run(); post()
+	// may be called from any thread. Outstanding work that will post back later (a background
+	// job, a child process) keeps the loop alive through hold() / release().
+	class EventLoop
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		EventLoop() = default;
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+	public:
+		void post(std::function<void()> fn)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				inbox.push_back(std::move(fn));
+			}
+			wake.notify_one();
+		}
+
+		void call_at(Clock::time_point when, std::function<void()> fn)
+		{
+			post([this, when, fn = std::move(fn)]() mutable { timers.push(Timer{ when, sequence++, std::move(fn) }); });
+		}
+
+		template<typename Rep, typename Period>
+		void call_after(std::chrono::duration<Rep, Period> delay, std::function<void()> fn) { call_at(Clock::now() + delay, std::move(fn)); }
+
+		void hold() { std::lock_guard<std::mutex> lock(mutex); holds++; }
+		void release()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				holds--;
+			}
+			wake.notify_one();
+		}
+
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+		}
+
+		// Runs until stop() is called or nothing is ready, scheduled or held. Returns the number
+		// of callbacks executed.
+		size_t run()
+		{
+			size_t executed = 0;
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					while (inbox.empty())
+					{
+						if (stopping) { stopping = false; return executed; }
+						if (!ready.empty()) break;
+
+						if (!timers.empty())
+						{
+							if (timers.top().when <= Clock::now()) break;
+							wake.wait_until(lock, timers.top().when);
+						}
+						else if (holds > 0) wake.wait(lock);
+						else return executed;
+					}
+					for (auto& fn : inbox) ready.push_back(std::move(fn));
+					inbox.clear();
+				}
+
+				const auto now = Clock::now();
+				while (!timers.empty() && timers.top().when <= now)
+				{
+					ready.push_back(std::move(const_cast<Timer&>(timers.top()).fn));
+					timers.pop();
+				}
+
+				while (!ready.empty())
+				{
+					auto fn = std::move(ready.front());
+					ready.pop_front();
+					fn();
+					executed++;
+				}
+			}
+		}
+
+	private:
+		struct Timer
+		{
+			Clock::time_point when;
+			size_t sequence;
+			std::function<void()> fn;
+
+			bool operator>(const Timer& other) const { return when != other.when ? when > other.when : sequence > other.sequence; }
+		};
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::vector<std::function<void()>> inbox;
+		std::deque<std::function<void()>> ready;
+		std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+		size_t sequence = 0;
+		size_t holds = 0;
+		bool stopping = false;
+	};
+}
+
+// function.hpp
+#ifndef CMDKIT_HANDLER_BUFFER_SIZE
+#define CMDKIT_HANDLER_BUFFER_SIZE 32
+#endif
+
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define CMDKIT_HAS_RTTI 1
+#else
+#define CMDKIT_HAS_RTTI 0
+#endif
+
+namespace cmdkit
+{
+	namespace detail
+	{
+		// Type-erased storage for one object: inline in a buffer of Capacity bytes when it fits,
+		// on the heap otherwise. The ops table moves and destroys the object, and since there is
+		// one table per stored type it also tells the type apart. A plugin loaded with
+		// RTLD_LOCAL has its own copies of the tables, so when RTTI is on the table also carries
+		// the typeid to fall back on; without RTTI, values made on one side of a plugin
+		// boundary are not recognized on the other.
+		template<size_t Capacity>
+		class InplaceStorage
+		{
+		public:
+			template<typename T>
+			static constexpr bool fits_inline = sizeof(T) <= Capacity
+				&& alignof(T) <= alignof(void*)
+				&& std::is_nothrow_move_constructible_v<T>;
+
+			InplaceStorage() noexcept = default;
+
+			InplaceStorage(InplaceStorage&& other) noexcept { take(other); }
+			InplaceStorage& operator=(InplaceStorage&& other) noexcept
+			{
+				if (this != &other) { reset(); take(other); }
+				return *this;
+			}
+			~InplaceStorage() { reset(); }
+
+			InplaceStorage(const InplaceStorage&) = delete;
+			InplaceStorage& operator=(const InplaceStorage&) = delete;
+
+		public:
+			template<typename T, typename... Args>
+			T& emplace(Args&&... args)
+			{
+				reset();
+				if constexpr (fits_inline<T>)
+				{
+					target = ::new (static_cast<void*>(buffer)) T(std::forward<Args>(args)...);
+					ops = &inline_ops<T>;
+				}
+				else
+				{
+					target = new T(std::forward<Args>(args)...);
+					ops = &heap_ops<T>;
+				}
+				return *static_cast<T*>(target);
+			}
+
+			// Points at an object owned elsewhere, which is passed along on moves and never destroyed.
+			void set_unowned(void* ptr) noexcept
+			{
+				reset();
+				target = ptr;
+			}
+
+			void reset() noexcept
+			{
+				if (ops) ops->destroy(target);
+				target = nullptr;
+				ops = nullptr;
+			}
+
+			void* get() const noexcept { return target; }
+			bool has_value() const noexcept { return ops != nullptr; }
+
+			template<typename T>
+			bool holds() const noexcept
+			{
+				const Ops* expected;
+				if constexpr (fits_inline<T>) expected = &inline_ops<T>;
+				else expected = &heap_ops<T>;
+				if (ops == expected) return true;
+				return ops && ops->type && ops->inline_storage == expected->inline_storage && *ops->type == *expected->type;
+			}
+
+			// True when the object lives in the buffer (or there is none).
+			bool is_inline() const noexcept { return !ops || ops->inline_storage; }
+
+		private:
+			struct Ops
+			{
+				void (*move)(InplaceStorage& dst, InplaceStorage& src) noexcept;
+				void (*destroy)(void* target) noexcept;
+				bool inline_storage;
+				// Null without RTTI.
+				const std::type_info* type;
+			};
+
+			template<typename T>
+			static void move_inline(InplaceStorage& dst, InplaceStorage& src) noexcept
+			{
+				dst.target = ::new (static_cast<void*>(dst.buffer)) T(std::move(*static_cast<T*>(src.target)));
+				static_cast<T*>(src.target)->~T();
+			}
+
+			static void move_heap(InplaceStorage& dst, InplaceStorage& src) noexcept { dst.target = src.target; }
+
+			template<typename T>
+			static void destroy_inline(void* target) noexcept { static_cast<T*>(target)->~T(); }
+
+			template<typename T>
+			static void destroy_heap(void* target) noexcept { delete static_cast<T*>(target); }
+
+			template<typename T>
+			static constexpr const std::type_info* type_of() noexcept
+			{
+#if CMDKIT_HAS_RTTI
+				return &typeid(T);
+#else
+				return nullptr;
+#endif
+			}
+
+			template<typename T>
+			static constexpr Ops inline_ops = { &move_inline<T>, &destroy_inline<T>, true, type_of<T>() };
+
+			template<typename T>
+			static constexpr Ops heap_ops = { &move_heap, &destroy_heap<T>, false, type_of<T>() };
+
+			void take(InplaceStorage& other) noexcept
+			{
+				ops = other.ops;
+				if (ops) ops->move(*this, other);
+				else target = other.target;
+				other.target = nullptr;
+				other.ops = nullptr;
+			}
+
+		private:
+			void* target = nullptr;
+			const Ops* ops = nullptr;
+			alignas(void*) unsigned char buffer[Capacity];
+		};
+	}
+
+	template<typename Sig, size_t Capacity = CMDKIT_HANDLER_BUFFER_SIZE>
+	class InplaceFunction;
+
+	// Move-only callable that stores callables of up to Capacity bytes inline and larger ones on
+	// the heap. A call is a single indirect jump: the thunk receives the stored object (or, for
+	// a raw function pointer plus context, the context itself) as its first argument.
+	template<typename R, typename... Args, size_t Capacity>
+	class InplaceFunction<R(Args...), Capacity>
+	{
+	public:
+		using Thunk = R(*)(void*, Args...);
+
+		template<typename F>
+		static constexpr bool fits_inline = detail::InplaceStorage<Capacity>::template fits_inline<F>;
+
+		InplaceFunction() noexcept = default;
+		InplaceFunction(std::nullptr_t) noexcept {}
+
+		// Raw function pointer plus context: `fn(context, args...)` with no thunk in between.
+		InplaceFunction(Thunk fn, void* context) noexcept : invoke(fn) { storage.set_unowned(context); }
+
+		template<
+			typename F, typename D = std::decay_t<F>,
+			typename std::enable_if_t<!std::is_same_v<D, InplaceFunction> && std::is_invocable_r_v<R, D&, Args...>, int> = 0
+		>
+		InplaceFunction(F&& fn)
+		{
+			if constexpr (std::is_pointer_v<D> || std::is_member_pointer_v<D>) { if (!fn) return; }
+
+			storage.template emplace<D>(std::forward<F>(fn));
+			invoke = &call<D>;
+		}
+
+		InplaceFunction(InplaceFunction&& other) noexcept : storage(std::move(other.storage)), invoke(std::exchange(other.invoke, nullptr)) {}
+		InplaceFunction& operator=(InplaceFunction&& other) noexcept
+		{
+			if (this != &other)
+			{
+				storage = std::move(other.storage);
+				invoke = std::exchange(other.invoke, nullptr);
+			}
+			return *this;
+		}
+		InplaceFunction& operator=(std::nullptr_t) noexcept
+		{
+			storage.reset();
+			invoke = nullptr;
+			return *this;
+		}
+
+		InplaceFunction(const InplaceFunction&) = delete;
+		InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+	public:
+		R operator()(Args... args) const
+		{
+			if (!invoke) throw std::bad_function_call();
+			return invoke(storage.get(), std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const noexcept { return invoke != nullptr; }
+
+		// True when the callable lives in the inline buffer (or no storage is needed at all).
+		bool is_inline() const noexcept { return storage.is_inline(); }
+
+	private:
+		template<typename D>
+		static R call(void* target, Args... args) { return std::invoke(*static_cast<D*>(target), std::forward<Args>(args)...); }
+
+	private:
+		detail::InplaceStorage<Capacity> storage;
+		Thunk invoke = nullptr;
+	};
+}
+
+// mpsc_ring.hpp
+namespace cmdkit
+{
+	// Bounded ring for many producers and one consumer. Every cell carries a sequence number
+	// that says whose turn it is: producers claim a slot with one CAS on the tail and publish
+	// it by bumping the cell's sequence, and the consumer reads cells in order without any
+	// read-modify-write. No locks are taken, and a full ring makes try_push fail instead of
+	// waiting. close() marks the tail so that later pushes fail too; pushes that claimed a
+	// slot before it still land, and drained() tells the consumer when it has them all. The
+	// capacity is rounded up to a power of two.
+	template<typename T>
+	class MpscRing
+	{
+	public:
+		explicit MpscRing(size_t capacity)
+		{
+			size_t size = 2;
+			while (size < capacity) size *= 2;
+			mask = size - 1;
+			cells = std::make_unique<Cell[]>(size);
+			for (size_t idx = 0; idx < size; ++idx) cells[idx].sequence.store(idx, std::memory_order_relaxed);
+		}
+
+		~MpscRing() { while (try_pop([](T&&) {})) {} }
+
+		MpscRing(const MpscRing&) = delete;
+		MpscRing& operator=(const MpscRing&) = delete;
+
+	public:
+		// Moves from val only when it returns true. Fails when the ring is full or closed.
+		bool try_push(T& val)
+		{
+			size_t pos = tail.load(std::memory_order_relaxed);
+			Cell* cell;
+			while (true)
+			{
+				if (pos & closed_bit) return false;
+				cell = &cells[pos & mask];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+				if (diff == 0)
+				{
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				}
+				else if (diff < 0) return false;
+				else pos = tail.load(std::memory_order_relaxed);
+			}
+
+			::new (static_cast<void*>(cell->storage)) T(std::move(val));
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer only. Hands the oldest value to fn as an rvalue and frees its cell.
+		template<typename Fn>
+		bool try_pop(Fn&& fn)
+		{
+			Cell& cell = cells[head & mask];
+			if (cell.sequence.load(std::memory_order_acquire) != head + 1) return false;
+
+			T* val = std::launder(reinterpret_cast<T*>(cell.storage));
+			struct Release
+			{
+				Cell& cell;
+				T* val;
+				size_t next;
+				~Release()
+				{
+					val->~T();
+					cell.sequence.store(next, std::memory_order_release);
+				}
+			} release{ cell, val, head + mask + 1 };
+			++head;
+			fn(std::move(*val));
+			return true;
+		}
+
+		// Consumer only. Pops up to max values; returns how many.
+		template<typename Fn>
+		size_t drain(Fn&& fn, size_t max)
+		{
+			size_t count = 0;
+			while (count < max && try_pop(fn)) ++count;
+			return count;
+		}
+
+		// Consumer only: true when the next cell has not been published yet.
+		bool empty() const { return cells[head & mask].sequence.load(std::memory_order_acquire) != head + 1; }
+
+		void close() { tail.fetch_or(closed_bit); }
+
+		bool closed() const { return tail.load() & closed_bit; }
+
+		// Consumer only: closed, and every push that got in before close() has been popped.
+		bool drained() const
+		{
+			const size_t pos = tail.load();
+			return (pos & closed_bit) && head == (pos & ~closed_bit);
+		}
+
+		size_t capacity() const { return mask + 1; }
+
+	private:
+		static constexpr size_t closed_bit = ~(~size_t(0) >> 1);
+
+		// Cells sit on their own cache lines so producers filling neighbours do not contend.
+		struct alignas(64) Cell
+		{
+			std::atomic<size_t> sequence{ 0 };
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		size_t mask = 0;
+		alignas(64) std::atomic<size_t> tail{ 0 };
+		alignas(64) size_t head = 0;
+	};
+}
+
+// payload.hpp
+#ifndef CMDKIT_PAYLOAD_BUFFER_SIZE
+#define CMDKIT_PAYLOAD_BUFFER_SIZE 32
+#endif
+
+namespace cmdkit
+{
+	// Move-only value of any type, handed from one pipeline stage to the next. Values of up to
+	// CMDKIT_PAYLOAD_BUFFER_SIZE bytes are stored inline and larger ones on the heap; moving a
+	// payload moves the value (or just the pointer to it), never copies it. The storage is the
+	// one InplaceFunction uses (see function.hpp): types are told apart by its ops tables, and
+	// by typeid for values that cross a plugin boundary.
+	class Payload
+	{
+	public:
+		template<typename T>
+		static constexpr bool fits_inline = detail::InplaceStorage<CMDKIT_PAYLOAD_BUFFER_SIZE>::fits_inline<T>;
+
+		Payload() noexcept = default;
+
+		template<
+			typename T, typename D = std::decay_t<T>,
+			typename std::enable_if_t<!std::is_same_v<D, Payload> && !is_result<D>::value, int> = 0
+		>
+		Payload(T&& val) { emplace<D>(std::forward<T>(val)); }
+
+	public:
+		template<typename T, typename... Args>
+		static Payload make(Args&&... args)
+		{
+			Payload result;
+			result.emplace<T>(std::forward<Args>(args)...);
+			return result;
+		}
+
+		template<typename T, typename... Args>
+		T& emplace(Args&&... args)
+		{
+			static_assert(std::is_same_v<T, std::decay_t<T>>, "Payload holds values, not references");
+			return storage.emplace<T>(std::forward<Args>(args)...);
+		}
+
+		void reset() noexcept { storage.reset(); }
+
+	public:
+		bool has_value() const noexcept { return storage.has_value(); }
+		explicit operator bool() const noexcept { return has_value(); }
+
+		template<typename T>
+		bool is() const noexcept { return storage.holds<T>(); }
+
+		// Null when the payload is empty or holds another type.
+		template<typename T>
+		T* get() noexcept { return is<T>() ? static_cast<T*>(storage.get()) : nullptr; }
+
+		template<typename T>
+		const T* get() const noexcept { return is<T>() ? static_cast<const T*>(storage.get()) : nullptr; }
+
+		// Moves the value out and leaves the payload empty; nullopt if it holds no T.
+		template<typename T>
+		std::optional<T> take()
+		{
+			T* val = get<T>();
+			if (!val) return std::nullopt;
+			std::optional<T> result(std::move(*val));
+			reset();
+			return result;
+		}
+
+		// True when the value lives in the inline buffer (or there is none).
+		bool is_inline() const noexcept { return storage.is_inline(); }
+
+	private:
+		detail::InplaceStorage<CMDKIT_PAYLOAD_BUFFER_SIZE> storage;
+	};
+}
+
+// trie.hpp
+namespace cmdkit
+{
+	// Compact radix tree keyed by strings. Edge labels live in one shared pool (a split only
+	// re-slices it), nodes link to their first child and next sibling in byte order, and values
+	// sit in a deque so their addresses stay stable while the tree grows.
+	template<typename V>
+	class RadixTree
+	{
+	public:
+		V* find(std::string_view key) { return value_at(find_node(key, false).node); }
+		const V* find(std::string_view key) const { return value_at(find_node(key, false).node); }
+
+		// The exact match if there is one, otherwise the only value whose key starts with prefix.
+		const V* find_unique_prefix(std::string_view prefix) const
+		{
+			const Position pos = find_node(prefix, true);
+			uint32_t node = pos.node;
+			if (node == npos) return nullptr;
+			if (!pos.partial && nodes[node].value != npos) return &values[nodes[node].value];
+			if (nodes[node].count != 1) return nullptr;
+
+			while (nodes[node].value == npos) node = nodes[node].first_child;
+			return &values[nodes[node].value];
+		}
+
+		// Visits (key, value) for every key starting with prefix, in lexicographic order.
+		template<typename Fn>
+		void for_each_prefix(std::string_view prefix, Fn&& fn) const
+		{
+			const Position pos = find_node(prefix, true);
+			if (pos.node == npos) return;
+
+			std::string key(prefix.substr(0, prefix.size() - pos.consumed));
+			visit(pos.node, key, fn);
+		}
+
+		template<typename Fn>
+		void for_each(Fn&& fn) const { for_each_prefix({}, std::forward<Fn>(fn)); }
+
+		size_t size() const { return nodes[root].count; }
+		bool empty() const { return size() == 0; }
+
+		V& insert_or_assign(std::string_view key, V value)
+		{
+			if (V* existing = find(key)) return *existing = std::move(value);
+
+			uint32_t node = root;
+			size_t pos = 0;
+			nodes[node].count++;
+			while (pos < key.size())
+			{
+				uint32_t child = find_child(node, key[pos]);
+				if (child == npos)
+				{
+					child = make_node(uint32_t(labels.size()), uint32_t(key.size() - pos), key[pos]);
+					labels.append(key.substr(pos));
+					link_child(node, child);
+					node = child;
+					nodes[node].count++;
+					break;
+				}
+
+				const std::string_view label = label_of(child);
+				const std::string_view rest = key.substr(pos);
+				size_t common = 0;
+				while (common < label.size() && common < rest.size() && label[common] == rest[common]) common++;
+
+				if (common < label.size()) child = split(node, child, uint32_t(common));
+				node = child;
+				nodes[node].count++;
+				pos += common;
+			}
+
+			nodes[node].value = uint32_t(values.size());
+			values.push_back(std::move(value));
+			return values.back();
+		}
+
+	private:
+		static constexpr uint32_t npos = ~uint32_t(0);
+		static constexpr uint32_t root = 0;
+
+		struct Node
+		{
+			uint32_t label_offset;
+			uint32_t label_length;
+			uint32_t first_child;
+			uint32_t next_sibling;
+			uint32_t value;
+			uint32_t count; // values in this subtree
+			char first;
+		};
+
+		std::string_view label_of(uint32_t node) const { return std::string_view(labels).substr(nodes[node].label_offset, nodes[node].label_length); }
+
+		V* value_at(uint32_t node) { return node != npos && nodes[node].value != npos ? &values[nodes[node].value] : nullptr; }
+		const V* value_at(uint32_t node) const { return node != npos && nodes[node].value != npos ? &values[nodes[node].value] : nullptr; }
+
+		uint32_t make_node(uint32_t offset, uint32_t length, char first)
+		{
+			nodes.push_back(Node{ offset, length, npos, npos, npos, 0, first });
+			return uint32_t(nodes.size() - 1);
+		}
+
+		uint32_t find_child(uint32_t node, char ch) const
+		{
+			for (uint32_t child = nodes[node].first_child; child != npos; child = nodes[child].next_sibling)
+				if (nodes[child].first == ch) return child;
+			return npos;
+		}
+
+		void link_child(uint32_t parent, uint32_t child)
+		{
+			const unsigned char ch = static_cast<unsigned char>(nodes[child].first);
+			uint32_t* link = &nodes[parent].first_child;
+			while (*link != npos && static_cast<unsigned char>(nodes[*link].first) < ch) link = &nodes[*link].next_sibling;
+			nodes[child].next_sibling = *link;
+			*link = child;
+		}
+
+		// Inserts a node holding the first `common` bytes of child's label between parent and child.
+		uint32_t split(uint32_t parent, uint32_t child, uint32_t common)
+		{
+			const Node old = nodes[child];
+			const uint32_t mid = make_node(old.label_offset, common, old.first);
+			nodes[mid].count = old.count;
+			nodes[mid].first_child = child;
+			nodes[mid].next_sibling = old.next_sibling;
+
+			nodes[child].label_offset += common;
+			nodes[child].label_length -= common;
+			nodes[child].first = labels[nodes[child].label_offset];
+			nodes[child].next_sibling = npos;
+
+			uint32_t* link = &nodes[parent].first_child;
+			while (*link != child) link = &nodes[*link].next_sibling;
+			*link = mid;
+			return mid;
+		}
+
+		struct Position
+		{
+			uint32_t node;
+			size_t consumed; // bytes of the node's own label covered by the key
+			bool partial; // the key ended inside the node's label
+		};
+
+		// Walks key from the root. With allow_partial the key may end inside an edge, in which
+		// case the node below that edge is returned.
+		Position find_node(std::string_view key, bool allow_partial) const
+		{
+			Position result{ root, 0, false };
+			size_t pos = 0;
+			while (pos < key.size())
+			{
+				result.node = find_child(result.node, key[pos]);
+				if (result.node == npos) return result;
+
+				const std::string_view label = label_of(result.node);
+				const std::string_view rest = key.substr(pos);
+				if (rest.size() < label.size())
+				{
+					if (!allow_partial || label.substr(0, rest.size()) != rest) return Position{ npos, 0, false };
+					result.consumed = rest.size();
+					result.partial = true;
+					return result;
+				}
+				if (rest.substr(0, label.size()) != label) return Position{ npos, 0, false };
+				result.consumed = label.size();
+				pos += label.size();
+			}
+			return result;
+		}
+
+		template<typename Fn>
+		void visit(uint32_t node, std::string& key, Fn& fn) const
+		{
+			const size_t length = key.size();
+			if (node != root) key.append(label_of(node));
+			if (nodes[node].value != npos) fn(std::string_view(key), values[nodes[node].value]);
+			for (uint32_t child = nodes[node].first_child; child != npos; child = nodes[child].next_sibling) visit(child, key, fn);
+			key.resize(length);
+		}
+
+	private:
+		std::vector<Node> nodes{ Node{ 0, 0, npos, npos, npos, 0, '\0' } };
+		std::string labels;
+		std::deque<V> values;
+	};
+}
+
+// metrics.hpp
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Terminal records per-command metrics only when this is non-zero; otherwise the recording
+// code is compiled out and Command/Terminal carry no extra state.
+#ifndef CMDKIT_ENABLE_METRICS
+#define CMDKIT_ENABLE_METRICS 0
+#endif
+
+namespace cmdkit
+{
+	// Log-linear latency buckets: four per power of two from 64 ns up to ~137 s, so any
+	// recorded value is off by at most a quarter of its octave. Bucket 0 holds everything
+	// below 64 ns and the last bucket everything above the range.
+	struct LatencyBuckets
+	{
+		static constexpr unsigned sub_bits = 2;
+		static constexpr unsigned min_shift = 6;
+		static constexpr unsigned octaves = 31;
+		static constexpr size_t count = 1 + (size_t(octaves) << sub_bits);
+
+		static size_t index_of(uint64_t ns)
+		{
+			if (ns < (uint64_t(1) << min_shift)) return 0;
+			const unsigned log2 = floor_log2(ns);
+			const size_t sub = size_t(ns >> (log2 - sub_bits)) & ((1u << sub_bits) - 1);
+			return std::min(count - 1, 1 + (size_t(log2 - min_shift) << sub_bits) + sub);
+		}
+
+		static uint64_t lower_bound(size_t idx)
+		{
+			if (idx == 0) return 0;
+			const size_t octave = (idx - 1) >> sub_bits;
+			const size_t sub = (idx - 1) & ((1u << sub_bits) - 1);
+			return uint64_t((1u << sub_bits) + sub) << (octave + min_shift - sub_bits);
+		}
+
+		static uint64_t upper_bound(size_t idx) { return lower_bound(idx + 1); }
+
+		static unsigned floor_log2(uint64_t val)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return 63u - unsigned(__builtin_clzll(val));
+#elif defined(_MSC_VER) && defined(_M_X64)
+			unsigned long idx;
+			_BitScanReverse64(&idx, val);
+			return unsigned(idx);
+#else
+			unsigned log2 = 0;
+			while (val >>= 1) log2++;
+			return log2;
+#endif
+		}
+	};
+
+	struct CommandStats
+	{
+		std::string name;
+		uint64_t calls = 0;
+		uint64_t ok = 0;
+		uint64_t err = 0;
+		uint64_t total_ns = 0;
+		uint64_t max_ns = 0;
+		std::array<uint64_t, LatencyBuckets::count> histogram{};
+
+		double mean_ns() const { return calls ? double(total_ns) / double(calls) : 0.0; }
+		double error_rate() const { return calls ? double(err) / double(calls) : 0.0; }
+
+		// Upper edge of the bucket holding the q-th quantile (0 < q <= 1), capped at max_ns.
+		uint64_t percentile_ns(double q) const
+		{
+			const uint64_t rank = uint64_t(q * double(calls) + 0.5);
+			uint64_t seen = 0;
+			for (size_t idx = 0; idx < histogram.size(); ++idx)
+			{
+				seen += histogram[idx];
+				if (seen >= std::max<uint64_t>(rank, 1)) return std::min(max_ns, LatencyBuckets::upper_bound(idx));
+			}
+			return max_ns;
+		}
+	};
+
+	struct MetricsSnapshot
+	{
+		std::vector<CommandStats> commands;
+
+		std::string to_text() const
+		{
+			std::string out;
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-24s %10s %10s %10s %12s %12s %12s %12s\n", "command", "calls", "ok", "err", "mean_ns", "p50_ns", "p99_ns", "max_ns");
+			out += line;
+			for (const auto& stats : commands)
+			{
+				std::snprintf(line, sizeof(line), "%-24s %10llu %10llu %10llu %12.0f %12llu %12llu %12llu\n", stats.name.c_str(),
+					(unsigned long long)stats.calls, (unsigned long long)stats.ok, (unsigned long long)stats.err, stats.mean_ns(),
+					(unsigned long long)stats.percentile_ns(0.5), (unsigned long long)stats.percentile_ns(0.99), (unsigned long long)stats.max_ns);
+				out += line;
+			}
+			return out;
+		}
+
+		// Histograms are exported sparsely as [upper_bound_ns, count] pairs.
+		std::string to_json() const
+		{
+			std::string out = "{\"commands\":[";
+			for (size_t pos = 0; pos < commands.size(); ++pos)
+			{
+				const auto& stats = commands[pos];
+				if (pos) out += ',';
+				out += "{\"name\":\"";
+				for (char ch : stats.name)
+				{
+					if (ch == '"' || ch == '\\') out += '\\';
+					out += ch;
+				}
+				out += "\",\"calls\":" + std::to_string(stats.calls) + ",\"ok\":" + std::to_string(stats.ok) + ",\"err\":" + std::to_string(stats.err)
+					+ ",\"total_ns\":" + std::to_string(stats.total_ns) + ",\"max_ns\":" + std::to_string(stats.max_ns)
+					+ ",\"p50_ns\":" + std::to_string(stats.percentile_ns(0.5)) + ",\"p90_ns\":" + std::to_string(stats.percentile_ns(0.9))
+					+ ",\"p99_ns\":" + std::to_string(stats.percentile_ns(0.99)) + ",\"histogram\":[";
+				bool first = true;
+				for (size_t idx = 0; idx < stats.histogram.size(); ++idx)
+				{
+					if (!stats.histogram[idx]) continue;
+					if (!first) out += ',';
+					out += '[' + std::to_string(LatencyBuckets::upper_bound(idx)) + ',' + std::to_string(stats.histogram[idx]) + ']';
+					first = false;
+				}
+				out += "]}";
+			}
+			return out + "]}";
+		}
+	};
+
+	// Counters for one command, split into cache-line-sized shards that threads pick round-robin
+	// on first use, so concurrent invocations rarely write the same line. Recording is a handful
+	// of relaxed atomic adds (the call count is the histogram total); snapshots sum the shards.
+	class CommandMetrics
+	{
+	public:
+		static constexpr size_t shard_count = 4;
+
+		void record(uint64_t ns, bool ok)
+		{
+			Shard& shard = shards[shard_index()];
+			shard.buckets[LatencyBuckets::index_of(ns)].fetch_add(1, std::memory_order_relaxed);
+			shard.total_ns.fetch_add(ns, std::memory_order_relaxed);
+			if (!ok) shard.errors.fetch_add(1, std::memory_order_relaxed);
+
+			uint64_t max = shard.max_ns.load(std::memory_order_relaxed);
+			while (ns > max && !shard.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+		}
+
+		CommandStats snapshot(std::string name) const
+		{
+			CommandStats stats;
+			stats.name = std::move(name);
+			for (const Shard& shard : shards)
+			{
+				stats.err += shard.errors.load(std::memory_order_relaxed);
+				stats.total_ns += shard.total_ns.load(std::memory_order_relaxed);
+				stats.max_ns = std::max(stats.max_ns, shard.max_ns.load(std::memory_order_relaxed));
+				for (size_t idx = 0; idx < LatencyBuckets::count; ++idx) stats.histogram[idx] += shard.buckets[idx].load(std::memory_order_relaxed);
+			}
+			for (uint64_t count : stats.histogram) stats.calls += count;
+			stats.ok = stats.calls >= stats.err ? stats.calls - stats.err : 0;
+			return stats;
+		}
+
+		void reset()
+		{
+			for (Shard& shard : shards)
+			{
+				shard.errors.store(0, std::memory_order_relaxed);
+				shard.total_ns.store(0, std::memory_order_relaxed);
+				shard.max_ns.store(0, std::memory_order_relaxed);
+				for (auto& bucket : shard.buckets) bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> errors{ 0 };
+			std::atomic<uint64_t> total_ns{ 0 };
+			std::atomic<uint64_t> max_ns{ 0 };
+			std::array<std::atomic<uint64_t>, LatencyBuckets::count> buckets{};
+		};
+
+		static size_t shard_index()
+		{
+			static std::atomic<size_t> next{ 0 };
+			thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+			return index;
+		}
+
+		std::array<Shard, shard_count> shards;
+	};
+
+	namespace detail
+	{
+		// Owns a command's metrics, created on the first recorded call so idle commands cost one
+		// pointer. Moves are only expected while the command is not being invoked.
+		class MetricsSlot
+		{
+		public:
+			MetricsSlot() = default;
+			MetricsSlot(MetricsSlot&& other) noexcept : metrics(other.metrics.exchange(nullptr)) {}
+			MetricsSlot& operator=(MetricsSlot&& other) noexcept
+			{
+				if (this != &other) delete metrics.exchange(other.metrics.exchange(nullptr));
+				return *this;
+			}
+			~MetricsSlot() { delete metrics.load(); }
+
+			CommandMetrics* get() const { return metrics.load(std::memory_order_acquire); }
+
+			CommandMetrics& get_or_create() const
+			{
+				if (CommandMetrics* current = metrics.load(std::memory_order_acquire)) return *current;
+				CommandMetrics* created = new CommandMetrics();
+				CommandMetrics* expected = nullptr;
+				if (metrics.compare_exchange_strong(expected, created, std::memory_order_acq_rel)) return *created;
+				delete created;
+				return *expected;
+			}
+
+		private:
+			mutable std::atomic<CommandMetrics*> metrics{ nullptr };
+		};
+	}
+}
+
+// command.hpp
+namespace cmdkit
+{
+	namespace detail
+	{
+		inline std::string_view copy_text(std::string_view text, std::pmr::memory_resource* resource)
+		{
+			if (text.empty()) return text.substr(0, 0);
+			char* copy = static_cast<char*>(resource->allocate(text.size(), 1));
+			std::memcpy(copy, text.data(), text.size());
+			return std::string_view(copy, text.size());
+		}
+
+		constexpr uint64_t fnv1a(std::string_view str, uint64_t hash = 0xcbf29ce484222325ull)
+		{
+			for (char ch : str) hash = (hash ^ static_cast<unsigned char>(ch)) * 0x100000001b3ull;
+			return hash;
+		}
+
+		constexpr uint64_t mix64(uint64_t val)
+		{
+			val ^= val >> 33;
+			val *= 0xff51afd7ed558ccdull;
+			val ^= val >> 33;
+			val *= 0xc4ceb9fe1a85ec53ull;
+			val ^= val >> 33;
+			return val;
+		}
+
+		// Seeded per role, so the same text as a key, a value or a flag hashes apart.
+		inline uint64_t hash_text(std::string_view text, uint64_t seed)
+		{
+			return mix64(fnv1a(text, 0xcbf29ce484222325ull ^ mix64(seed + 1)) ^ text.size());
+		}
+
+		// Positional arguments hash in order; options and flags are summed so their order does
+		// not matter. The result depends only on the text, not on the process or the platform.
+		template<typename Args>
+		uint64_t canonical_hash(const Args& args)
+		{
+			uint64_t h = mix64(args.get_positional().size());
+			for (const auto& arg : args.get_positional()) h = mix64(h ^ hash_text(arg, 1));
+
+			uint64_t options = 0, flags = 0;
+			args.for_each_option([&options](std::string_view key, std::string_view val) { options += mix64(hash_text(key, 2) + 3 * hash_text(val, 3)); });
+			args.for_each_flag([&flags](std::string_view name) { flags += hash_text(name, 4); });
+			return mix64(h ^ mix64(options + 0x9e3779b97f4a7c15ull) ^ (mix64(flags + 0x632be59bd9b4e019ull) << 1));
+		}
+
+		template<typename A, typename B>
+		bool args_equal(const A& a, const B& b)
+		{
+			const auto& lhs = a.get_positional();
+			const auto& rhs = b.get_positional();
+			if (lhs.size() != rhs.size()) return false;
+			for (size_t idx = 0; idx < lhs.size(); ++idx) if (std::string_view(lhs[idx]) != std::string_view(rhs[idx])) return false;
+
+			bool same = true;
+			size_t count = 0;
+			a.for_each_option([&](std::string_view key, std::string_view val)
+				{
+					++count;
+					if (!same) return;
+					const std::optional<std::string_view> other = b.find_option(key);
+					same = other && *other == val;
+				});
+			b.for_each_option([&count](std::string_view, std::string_view) { --count; });
+			if (!same || count != 0) return false;
+
+			a.for_each_flag([&](std::string_view name) { ++count; same = same && b.has_flag(std::string(name)); });
+			b.for_each_flag([&count](std::string_view) { --count; });
+			return same && count == 0;
+		}
+	}
+
+	class CommandArgsView;
+	class ArgSchema;
+
+	class CommandArgs
+	{
+	private:
+		std::unordered_map<std::string, std::string> options;
+		std::unordered_set<std::string> flags;
+		std::vector<std::string> positional;
+		mutable detail::ConversionCache cache;
+
+		template<typename Fn>
+		static CommandArgs parse_tokens(Fn&& for_each_token)
+		{
+			CommandArgs result;
+
+			auto on_positional = [&result](std::string_view arg) { result.positional.emplace_back(arg); };
+			auto on_option = [&result](std::string_view key, std::string_view val) { result.options[std::string(key)] = std::string(val); };
+			auto on_flag = [&result](std::string_view key) { result.flags.emplace(key); };
+
+			detail::ArgClassifier classifier(on_positional, on_option, on_flag);
+			for_each_token([&classifier](const detail::ArgToken& token) { classifier.push(token); });
+			classifier.finish();
+
+			return result;
+		}
+
+	public:
+		// Elements are taken as they are, like argv after the shell removed quotes.
+		static CommandArgs parse(const std::vector<std::string>& args)
+		{
+			return parse_tokens([&args](auto&& push) { for (const auto& arg : args) push(detail::classify_arg(arg)); });
+		}
+
+		// Quotes and escapes are removed as a POSIX shell would (see ArgGrammar). An unterminated
+		// quote runs to the end of the line.
+		static CommandArgs parse(const std::string& args_str)
+		{
+			std::byte buffer[256];
+			std::pmr::monotonic_buffer_resource unquoted(buffer, sizeof(buffer));
+			return parse_tokens([&](auto&& push) { detail::lex_args(args_str, [&unquoted](std::string_view text) { return detail::copy_text(text, &unquoted); }, push); });
+		}
+
+		std::string get_option(const std::string& key, const std::string& default_val = "") const 
+		{
+			auto it = options.find(key);
+			return it != options.end() ? it->second : default_val;
+		}
+
+		// Converts the option in place (see convert.hpp) and caches the result per key and type.
+		// The cache makes concurrent get_option<T> calls on one shared CommandArgs unsafe.
+		template<typename T>
+		Result<T, ParseError> get_option(const std::string& key) const
+		{
+			return detail::get_option_as<T>(cache, key,
+				[this, &key](std::string_view& stored_key, std::string_view& text)
+				{
+					auto it = options.find(key);
+					if (it == options.end()) return false;
+					stored_key = it->first;
+					text = it->second;
+					return true;
+				});
+		}
+
+		bool has_flag(const std::string& name) const { return flags.count(name); }
+
+		std::optional<std::string_view> find_option(std::string_view key) const
+		{
+			auto it = options.find(std::string(key));
+			if (it == options.end()) return std::nullopt;
+			return std::string_view(it->second);
+		}
+
+		const std::vector<std::string>& get_positional() const { return positional; }
+
+		// Options as (key, value) and flags by name, in no particular order.
+		template<typename Fn>
+		void for_each_option(Fn&& fn) const { for (const auto& [k, v] : options) fn(std::string_view(k), std::string_view(v)); }
+
+		template<typename Fn>
+		void for_each_flag(Fn&& fn) const { for (const auto& flag : flags) fn(std::string_view(flag)); }
+
+		// Canonical hash and equality: positional arguments are ordered, options and flags are
+		// sets. Both agree with CommandArgsView's for the same arguments.
+		uint64_t hash() const { return detail::canonical_hash(*this); }
+
+		friend bool operator==(const CommandArgs& a, const CommandArgs& b) { return detail::args_equal(a, b); }
+		friend bool operator!=(const CommandArgs& a, const CommandArgs& b) { return !(a == b); }
+
+		CommandArgsView view(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+	public:
+		std::string& operator[](size_t idx) { return positional[idx]; }
+		const std::string& operator[](size_t idx) const { return positional[idx]; }
+
+		friend class CommandArgsView;
+	};
+
+	// Declares a command's options, flags and positional arity. Each option or flag gets a slot,
+	// numbered in declaration order, and its key goes into a radix-tree table as it is declared.
+	// Parsing with a schema fills the slots in one pass: a declared option always takes the next
+	// token (or `--key=value`) as its value, and unknown keys, missing values, missing required
+	// options or a wrong argument count are reported before any handler runs. Single-letter
+	// names are also short options, GNU style: `-v`, `-xvf archive`, `-ofile`.
+	class ArgSchema
+	{
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		ArgSchema& option(const std::string& name, const std::string& description = "") { return declare(name, description, false, false); }
+		ArgSchema& required_option(const std::string& name, const std::string& description = "") { return declare(name, description, false, true); }
+		ArgSchema& flag(const std::string& name, const std::string& description = "") { return declare(name, description, true, false); }
+
+		// Bounds on the number of arguments after the command name.
+		ArgSchema& positional(size_t min_count, size_t max_count = npos)
+		{
+			if (min_count > max_count) throw std::logic_error("ArgSchema: positional minimum exceeds maximum");
+			min_positional = min_count;
+			max_positional = max_count;
+			return *this;
+		}
+
+	public:
+		size_t slot_of(std::string_view name) const
+		{
+			const uint32_t* slot = table.find(name);
+			return slot ? *slot : npos;
+		}
+
+		size_t slot_count() const { return entries.size(); }
+		const std::string& name_of(size_t slot) const { return entries[slot].name; }
+		const std::string& description_of(size_t slot) const { return entries[slot].description; }
+		bool is_flag(size_t slot) const { return entries[slot].flag; }
+		bool is_required(size_t slot) const { return entries[slot].required; }
+
+		size_t min_positional_count() const { return min_positional; }
+		size_t max_positional_count() const { return max_positional; }
+
+		// Declared option and flag names, without the dashes, for completion and suggestions.
+		const NameIndex& get_names() const { return names; }
+
+	public:
+		// The returned view borrows from line, which must outlive it.
+		Result<CommandArgsView, std::string> parse(std::string_view line, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+		// Re-classifies arguments parsed without this schema. A declared flag that was read as
+		// `--flag value` keeps its value as a trailing positional argument.
+		Result<CommandArgsView, std::string> bind(const CommandArgsView& args) const;
+
+	private:
+		struct Entry
+		{
+			std::string name;
+			std::string description;
+			bool flag = false;
+			bool required = false;
+		};
+
+		ArgSchema& declare(const std::string& name, const std::string& description, bool flag, bool required)
+		{
+			if (name.empty() || table.find(name)) throw std::logic_error("ArgSchema: duplicate or empty key --" + name);
+			table.insert_or_assign(name, uint32_t(entries.size()));
+			entries.push_back(Entry{ name, description, flag, required });
+			names.add(name);
+			return *this;
+		}
+
+		std::string unknown_option(std::string_view key) const
+		{
+			std::string message = "Unknown option --" + std::string(key);
+			if (auto near = names.suggest(key, 1); !near.empty()) message += ", did you mean --" + near.front().name + "?";
+			return message;
+		}
+
+		std::optional<std::string> validate(const CommandArgsView& args) const;
+
+	private:
+		std::vector<Entry> entries;
+		RadixTree<uint32_t> table;
+		NameIndex names;
+		size_t min_positional = 0;
+		size_t max_positional = npos;
+	};
+
+	class CommandArgsView
+	{
+	private:
+		std::pmr::vector<std::pair<std::string_view, std::string_view>> options;
+		std::pmr::vector<std::string_view> flags;
+		std::pmr::vector<std::string_view> positional;
+		std::pmr::vector<std::string_view> slots;
+		const ArgSchema* schema = nullptr;
+		std::string_view source;
+		mutable detail::ConversionCache cache;
+
+	public:
+		explicit CommandArgsView(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: options(resource), flags(resource), positional(resource), slots(resource) {}
+
+		// Copies other's tables into resource; the strings they point to are shared, not copied.
+		CommandArgsView(const CommandArgsView& other, std::pmr::memory_resource* resource)
+			: options(other.options, resource), flags(other.flags, resource), positional(other.positional, resource),
+			slots(other.slots, resource), schema(other.schema), source(other.source) {}
+
+		// The returned view borrows from args_str, which must outlive it.
+		static CommandArgsView parse(std::string_view args_str, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		{
+			CommandArgsView result(resource);
+			result.source = args_str;
+
+			auto on_positional = [&result](std::string_view arg) { result.positional.push_back(arg); };
+			auto on_option = [&result](std::string_view key, std::string_view val) { result.set_option(key, val); };
+			auto on_flag = [&result](std::string_view key) { result.set_flag(key); };
+
+			detail::ArgClassifier classifier(on_positional, on_option, on_flag);
+			detail::lex_args(args_str, [&result](std::string_view text) { return result.store(text); }, [&classifier](const detail::ArgToken& token) { classifier.push(token); });
+			classifier.finish();
+
+			return result;
+		}
+
+		std::string_view get_option(std::string_view key, std::string_view default_val = {}) const
+		{
+			std::string_view stored_key, val;
+			return find_option(key, stored_key, val) ? val : default_val;
+		}
+
+		template<typename T>
+		Result<T, ParseError> get_option(std::string_view key) const
+		{
+			return detail::get_option_as<T>(cache, key,
+				[this, key](std::string_view& stored_key, std::string_view& text) { return find_option(key, stored_key, text); });
+		}
+
+		bool has_flag(std::string_view name) const
+		{
+			if (schema)
+			{
+				const size_t slot = schema->slot_of(name);
+				return slot != ArgSchema::npos && schema->is_flag(slot) && has_slot(slot);
+			}
+			for (const auto& flag : flags) if (flag == name) return true;
+			return false;
+		}
+
+		// Slot access for views parsed with an ArgSchema; slots follow declaration order.
+		// An absent slot reads as an empty view, a present flag as an empty but non-null one.
+		std::string_view slot(size_t idx) const { return idx < slots.size() ? slots[idx] : std::string_view(); }
+		bool has_slot(size_t idx) const { return idx < slots.size() && slots[idx].data() != nullptr; }
+		const ArgSchema* get_schema() const { return schema; }
+
+		// The line this view was parsed from; empty for views built from a CommandArgs.
+		std::string_view get_source() const { return source; }
+
+		std::optional<std::string_view> find_option(std::string_view key) const
+		{
+			std::string_view stored_key, val;
+			if (!find_option(key, stored_key, val)) return std::nullopt;
+			return val;
+		}
+
+		const std::pmr::vector<std::string_view>& get_positional() const { return positional; }
+
+		// Options as (key, value) and flags by name, including those held in schema slots.
+		template<typename Fn>
+		void for_each_option(Fn&& fn) const
+		{
+			if (!schema) { for (const auto& [k, v] : options) fn(k, v); return; }
+			for (size_t idx = 0; idx < slots.size(); ++idx)
+				if (has_slot(idx) && !schema->is_flag(idx)) fn(std::string_view(schema->name_of(idx)), slots[idx]);
+		}
+
+		template<typename Fn>
+		void for_each_flag(Fn&& fn) const
+		{
+			if (!schema) { for (const auto& flag : flags) fn(flag); return; }
+			for (size_t idx = 0; idx < slots.size(); ++idx)
+				if (has_slot(idx) && schema->is_flag(idx)) fn(std::string_view(schema->name_of(idx)));
+		}
+
+		uint64_t hash() const { return detail::canonical_hash(*this); }
+
+		friend bool operator==(const CommandArgsView& a, const CommandArgsView& b) { return detail::args_equal(a, b); }
+		friend bool operator==(const CommandArgsView& a, const CommandArgs& b) { return detail::args_equal(a, b); }
+		friend bool operator==(const CommandArgs& a, const CommandArgsView& b) { return detail::args_equal(a, b); }
+		friend bool operator!=(const CommandArgsView& a, const CommandArgsView& b) { return !(a == b); }
+		friend bool operator!=(const CommandArgsView& a, const CommandArgs& b) { return !(a == b); }
+		friend bool operator!=(const CommandArgs& a, const CommandArgsView& b) { return !(a == b); }
+
+		CommandArgs to_owned() const
+		{
+			CommandArgs result;
+			result.positional.assign(positional.begin(), positional.end());
+			for (const auto& [k, v] : options) result.options.emplace(k, v);
+			for (const auto& flag : flags) result.flags.emplace(flag);
+			for (size_t idx = 0; schema && idx < slots.size(); ++idx)
+			{
+				if (!has_slot(idx)) continue;
+				if (schema->is_flag(idx)) result.flags.emplace(schema->name_of(idx));
+				else result.options.emplace(schema->name_of(idx), slots[idx]);
+			}
+			return result;
+		}
+
+		std::pmr::memory_resource* resource() const { return positional.get_allocator().resource(); }
+
+	public:
+		// Rewriting, used by middleware. The view stores string_views only, so new values must
+		// outlive it; store() copies text into the view's memory resource for that.
+		std::string_view store(std::string_view text) { return detail::copy_text(text, resource()); }
+
+		// On a view with a schema, the key must be a declared option or flag.
+		void set_option(std::string_view key, std::string_view val)
+		{
+			cache.clear();
+			if (schema)
+			{
+				slots[schema_slot(key, false)] = val.data() ? val : std::string_view("", 0);
+				return;
+			}
+			for (auto& [k, v] : options) if (k == key) { v = val; return; }
+			options.emplace_back(key, val);
+		}
+
+		void set_flag(std::string_view key)
+		{
+			if (schema)
+			{
+				const size_t slot = schema_slot(key, true);
+				slots[slot] = std::string_view(schema->name_of(slot)).substr(0, 0);
+				return;
+			}
+			if (!has_flag(key)) flags.push_back(key);
+		}
+
+		void set_positional(size_t idx, std::string_view val) { positional.at(idx) = val; }
+		void push_positional(std::string_view val) { positional.push_back(val); }
+
+	public:
+		std::string_view operator[](size_t idx) const { return positional[idx]; }
+
+	private:
+		size_t schema_slot(std::string_view key, bool flag) const
+		{
+			const size_t slot = schema->slot_of(key);
+			if (slot == ArgSchema::npos || schema->is_flag(slot) != flag)
+				throw std::invalid_argument("CommandArgsView: --" + std::string(key) + " is not a declared " + (flag ? "flag" : "option"));
+			return slot;
+		}
+
+		bool find_option(std::string_view key, std::string_view& stored_key, std::string_view& val) const
+		{
+			if (schema)
+			{
+				const size_t slot = schema->slot_of(key);
+				if (slot == ArgSchema::npos || schema->is_flag(slot) || !has_slot(slot)) return false;
+				stored_key = schema->name_of(slot);
+				val = slots[slot];
+				return true;
+			}
+			for (const auto& [k, v] : options) if (k == key) { stored_key = k; val = v; return true; }
+			return false;
+		}
+
+		friend class CommandArgs;
+		friend class ArgSchema;
+	};
+
+	inline Result<CommandArgsView, std::string> ArgSchema::parse(std::string_view line, std::pmr::memory_resource* resource) const
+	{
+		using R = Result<CommandArgsView, std::string>;
+
+		CommandArgsView result(resource);
+		result.schema = this;
+		result.source = line;
+		result.slots.resize(entries.size());
+
+		// A declared option takes the next token as its value, whatever it looks like. In a
+		// bundle, letters are flags up to the first option, which takes the rest of the bundle
+		// (after an optional '=') or else the next token.
+		size_t pending = npos;
+		bool terminated = false;
+		std::optional<std::string> error;
+		const bool closed = detail::lex_args(line, [&result](std::string_view text) { return result.store(text); }, [&](const detail::ArgToken& token)
+			{
+				if (error) return;
+				const std::string_view text = token.text;
+				if (pending != npos) { result.slots[pending] = text; pending = npos; return; }
+				if (terminated || token.shape == detail::ArgShape::word) { result.positional.push_back(text); return; }
+
+				switch (token.shape)
+				{
+				case detail::ArgShape::long_key:
+				case detail::ArgShape::long_value:
+				{
+					const bool has_value = token.shape == detail::ArgShape::long_value;
+					const std::string_view key = text.substr(2, has_value ? token.equals - 2 : std::string_view::npos);
+					const uint32_t* slot = table.find(key);
+					if (!slot) error = unknown_option(key);
+					else if (entries[*slot].flag)
+					{
+						if (has_value) error = "Flag --" + std::string(key) + " takes no value";
+						else result.slots[*slot] = text.substr(text.size());
+					}
+					else if (has_value) result.slots[*slot] = text.substr(token.equals + 1);
+					else pending = *slot;
+					break;
+				}
+				case detail::ArgShape::bundle:
+				case detail::ArgShape::bundle_value:
+					for (size_t idx = 1; idx < text.size(); ++idx)
+					{
+						const std::string_view key = text.substr(idx, 1);
+						const uint32_t* slot = key == "=" ? nullptr : table.find(key);
+						if (!slot) { error = key == "=" ? "Flag -" + std::string(text.substr(idx - 1, 1)) + " takes no value" : "Unknown option -" + std::string(key); break; }
+						if (entries[*slot].flag) { result.slots[*slot] = text.substr(text.size()); continue; }
+
+						std::string_view rest = text.substr(idx + 1);
+						if (!rest.empty() && rest[0] == '=') rest.remove_prefix(1);
+						if (idx + 1 < text.size()) result.slots[*slot] = rest;
+						else pending = *slot;
+						break;
+					}
+					break;
+				case detail::ArgShape::terminator: terminated = true; break;
+				case detail::ArgShape::word: break;
+				}
+			});
+
+		if (!error && !closed) error = "Unterminated quote";
+		if (!error && pending != npos) error = "Missing value for option --" + entries[pending].name;
+		if (!error) error = validate(result);
+		return error ? R::err(std::move(*error)) : R::ok(std::move(result));
+	}
+
+	inline Result<CommandArgsView, std::string> ArgSchema::bind(const CommandArgsView& args) const
+	{
+		using R = Result<CommandArgsView, std::string>;
+
+		CommandArgsView result(args.resource());
+		result.schema = this;
+		result.source = args.source;
+		result.slots.resize(entries.size());
+		result.positional.assign(args.positional.begin(), args.positional.end());
+
+		for (const auto& [key, val] : args.options)
+		{
+			const uint32_t* slot = table.find(key);
+			if (!slot) return R::err(unknown_option(key));
+			if (entries[*slot].flag)
+			{
+				result.slots[*slot] = key.substr(key.size());
+				result.positional.push_back(val);
+			}
+			else result.slots[*slot] = val;
+		}
+		for (const auto& key : args.flags)
+		{
+			const uint32_t* slot = table.find(key);
+			if (!slot) return R::err(unknown_option(key));
+			if (!entries[*slot].flag) return R::err("Missing value for option --" + std::string(key));
+			result.slots[*slot] = key.substr(key.size());
+		}
+
+		if (auto error = validate(result)) return R::err(std::move(*error));
+		return R::ok(std::move(result));
+	}
+
+	inline std::optional<std::string> ArgSchema::validate(const CommandArgsView& args) const
+	{
+		for (size_t idx = 0; idx < entries.size(); ++idx)
+			if (entries[idx].required && !args.has_slot(idx)) return "Missing option --" + entries[idx].name;
+
+		const size_t count = args.positional.empty() ? 0 : args.positional.size() - 1;
+		if (count < min_positional) return "Expected at least " + std::to_string(min_positional) + " argument(s), got " + std::to_string(count);
+		if (count > max_positional) return "Expected at most " + std::to_string(max_positional) + " argument(s), got " + std::to_string(count);
+		return std::nullopt;
+	}
+
+	inline CommandArgsView CommandArgs::view(std::pmr::memory_resource* resource) const
+	{
+		CommandArgsView result(resource);
+		result.positional.assign(positional.begin(), positional.end());
+		result.options.assign(options.begin(), options.end());
+		result.flags.assign(flags.begin(), flags.end());
+		return result;
+	}
+
+	// Owns a monotonic arena that CommandArgsView parses draw from. Views handed out by parse()
+	// stay valid until the outermost Scope ends, which rewinds the arena for the next line.
+	// If a line overflows the arena, the next reset grows it so steady-state parses stay in place,
+	// up to max_capacity; past that, a huge line borrows from the heap instead of pinning memory.
+	class ParseContext
+	{
+	public:
+		explicit ParseContext(size_t capacity = 4096) : buffer(capacity) { arena.emplace(buffer.data(), buffer.size(), &overflow); }
+		ParseContext(const ParseContext& other) : ParseContext(other.capacity()) {}
+		ParseContext& operator=(const ParseContext&) { return *this; }
+
+	public:
+		class Scope
+		{
+		public:
+			explicit Scope(ParseContext& context) : context(context) { context.depth++; }
+			~Scope() { if (--context.depth == 0) context.reset(); }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			ParseContext& context;
+		};
+
+		CommandArgsView parse(std::string_view args_str) { return CommandArgsView::parse(args_str, resource()); }
+
+		static constexpr size_t max_capacity = 64 << 10;
+
+		// A context per thread; terminals parse lines in it, so concurrent invokes don't share one.
+		static ParseContext& local() { thread_local ParseContext context; return context; }
+
+		std::pmr::memory_resource* resource() { return &*arena; }
+
+		void reset()
+		{
+			arena->release();
+			if (overflow.bytes == 0) return;
+
+			const size_t grown = std::min(2 * (buffer.size() + overflow.bytes), std::max(max_capacity, buffer.size()));
+			overflow.bytes = 0;
+			if (grown == buffer.size()) return;
+			buffer.resize(grown);
+			arena.emplace(buffer.data(), buffer.size(), &overflow);
+		}
+
+		size_t capacity() const { return buffer.size(); }
+
+	private:
+		class OverflowResource : public std::pmr::memory_resource
+		{
+		public:
+			size_t bytes = 0;
+
+		private:
+			void* do_allocate(size_t size, size_t align) override { bytes += size; return std::pmr::new_delete_resource()->allocate(size, align); }
+			void do_deallocate(void* ptr, size_t size, size_t align) override { std::pmr::new_delete_resource()->deallocate(ptr, size, align); }
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		};
+
+		std::vector<std::byte> buffer;
+		OverflowResource overflow;
+		std::optional<std::pmr::monotonic_buffer_resource> arena;
+		unsigned depth = 0;
+	};
+
+	// Commands own their handler in inline storage and are move-only; register them with std::move.
+	class Command
+	{
+	public:
+		using Handler = InplaceFunction<Result<void*, std::string>(const CommandArgs&)>;
+		using ViewHandler = InplaceFunction<Result<void*, std::string>(const CommandArgsView&)>;
+
+		// Async handlers own their arguments and report through the completion, possibly after
+		// yielding to the event loop; see async.hpp for coroutine handlers.
+		using Completion = std::function<void(Result<void*, std::string>)>;
+		using AsyncHandler = InplaceFunction<void(CommandArgs, EventLoop&, Completion)>;
+
+		// Pipeline stages receive the previous stage's value and produce the next one; see
+		// Terminal::pipe. Called on its own, a stage gets an empty input.
+		using PipeHandler = InplaceFunction<Result<Payload, std::string>(const CommandArgsView&, Payload&&)>;
+
+		Command() = default;
+		Command(const std::string& name, Handler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, Handler handler) : name(name), description(description), handler(std::move(handler)) {}
+		Command(const std::string& name, ViewHandler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, ViewHandler handler) : name(name), description(description), handler(std::move(handler)) {}
+		Command(const std::string& name, AsyncHandler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, AsyncHandler handler) : name(name), description(description), handler(std::move(handler)) {}
+		Command(const std::string& name, PipeHandler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, PipeHandler handler) : name(name), description(description), handler(std::move(handler)) {}
+
+		Command(Command&&) = default;
+		Command& operator=(Command&&) = default;
+		Command(const Command&) = delete;
+		Command& operator=(const Command&) = delete;
+
+	public:
+		Result<void*, std::string> invoke(const CommandArgs& args) const
+		{
+			if (schema) return invoke(args.view());
+			if (auto h = std::get_if<Handler>(&handler); h && *h) return (*h)(args);
+			if (auto h = std::get_if<ViewHandler>(&handler); h && *h) return (*h)(args.view());
+			if (auto h = std::get_if<PipeHandler>(&handler); h && *h) return invoke_handler(args.view());
+			return invoke_blocking(args);
+		}
+
+		// Arguments not yet parsed with this command's schema are re-parsed from their source
+		// line (or re-bound), and validation errors are returned without calling the handler.
+		Result<void*, std::string> invoke(const CommandArgsView& args) const
+		{
+			if (schema && args.get_schema() != schema.get())
+			{
+				auto bound = bind_schema(args);
+				if (bound.is_err()) return Result<void*, std::string>::err(std::move(bound).unwrap_err());
+				return invoke_handler(bound.unwrap());
+			}
+			return invoke_handler(args);
+		}
+
+		// Re-reads args parsed without this command's schema, from their source line when
+		// they have one. Requires a schema.
+		Result<CommandArgsView, std::string> bind_schema(const CommandArgsView& args) const
+		{
+			return args.get_source().data() ? schema->parse(args.get_source(), args.resource()) : schema->bind(args);
+		}
+
+		// Parses a line for this command in one pass; with a schema, straight into its slots.
+		// A line that fails validation gets the generic parse instead, so that middleware still
+		// sees the call, and invoking the command with it reports the error.
+		CommandArgsView parse_args(std::string_view line, std::pmr::memory_resource* resource) const
+		{
+			if (schema)
+				if (auto bound = schema->parse(line, resource); bound.is_ok()) return std::move(bound).unwrap();
+			return CommandArgsView::parse(line, resource);
+		}
+
+		Result<void*, std::string> invoke(const std::string& args_str) const
+		{
+			// Unquoted tokens are copied; the thread's arena holds them for the length of the call.
+			ParseContext& local = ParseContext::local();
+			ParseContext::Scope scope(local);
+			if (!schema) return invoke(CommandArgsView::parse(args_str, local.resource()));
+			auto args = schema->parse(args_str, local.resource());
+			if (args.is_err()) return Result<void*, std::string>::err(std::move(args).unwrap_err());
+			return invoke_handler(args.unwrap());
+		}
+
+		// Runs the command as a pipeline stage. Stages consume input; other commands ignore it,
+		// and their non-null pointer result is passed on as a void*.
+		Result<Payload, std::string> pipe(const CommandArgsView& args, Payload&& input) const
+		{
+			if (schema && args.get_schema() != schema.get())
+			{
+				auto bound = bind_schema(args);
+				if (bound.is_err()) return Result<Payload, std::string>::err(std::move(bound).unwrap_err());
+				return pipe_handler(bound.unwrap(), std::move(input));
+			}
+			return pipe_handler(args, std::move(input));
+		}
+
+		// Starts the command on the loop. Synchronous commands complete before this returns.
+		void invoke_async(CommandArgs args, EventLoop& loop, Completion done) const
+		{
+			if (!is_async()) { done(invoke(args)); return; }
+			if (schema)
+			{
+				auto bound = schema->bind(args.view());
+				if (bound.is_err()) { done(Result<void*, std::string>::err(std::move(bound).unwrap_err())); return; }
+				args = bound.unwrap().to_owned();
+			}
+			std::get<AsyncHandler>(handler)(std::move(args), loop, std::move(done));
+		}
+
+		bool is_async() const
+		{
+			auto h = std::get_if<AsyncHandler>(&handler);
+			return h && *h;
+		}
+
+		// False for a default-constructed command, such as the placeholder of a lazily
+		// registered one.
+		bool has_handler() const { return !std::holds_alternative<std::monostate>(handler); }
+
+	public:
+		const std::string& get_name() const { return name; }
+		void get_name(const std::string& val) { name = val; }
+
+		const std::string& get_description() const { return description; }
+		void get_description(const std::string& val) { description = val; }
+
+		// Parallel-safe commands may run concurrently with each other in Terminal::invoke_batch.
+		bool is_parallel_safe() const { return parallel_safe; }
+		void set_parallel_safe(bool val) { parallel_safe = val; }
+
+		// Idempotent commands are pure functions of their arguments; Terminal memoizes their
+		// successful results (see memo.hpp).
+		bool is_idempotent() const { return idempotent; }
+		void set_idempotent(bool val) { idempotent = val; }
+
+		// Declares the arguments this command accepts; see ArgSchema.
+		void set_schema(ArgSchema val) { schema = std::make_unique<const ArgSchema>(std::move(val)); }
+		const ArgSchema* get_schema() const { return schema.get(); }
+
+		// Call counts and latencies recorded by Terminal when CMDKIT_ENABLE_METRICS is set;
+		// null until the first recorded call.
+		const CommandMetrics* get_metrics() const
+		{
+#if CMDKIT_ENABLE_METRICS
+			return metrics.get();
+#else
+			return nullptr;
+#endif
+		}
+
+		void record_call([[maybe_unused]] uint64_t ns, [[maybe_unused]] bool ok) const
+		{
+#if CMDKIT_ENABLE_METRICS
+			metrics.get_or_create().record(ns, ok);
+#endif
+		}
+
+		void reset_metrics() const
+		{
+#if CMDKIT_ENABLE_METRICS
+			if (CommandMetrics* stats = metrics.get()) stats->reset();
+#endif
+		}
+
+	private:
+		Result<void*, std::string> invoke_handler(const CommandArgsView& args) const
+		{
+			if (auto h = std::get_if<ViewHandler>(&handler); h && *h) return (*h)(args);
+			if (auto h = std::get_if<Handler>(&handler); h && *h) return (*h)(args.to_owned());
+			if (auto h = std::get_if<PipeHandler>(&handler); h && *h)
+			{
+				auto result = (*h)(args, Payload());
+				if (result.is_err()) return Result<void*, std::string>::err(std::move(result).unwrap_err());
+				void* const* ptr = result.unwrap().get<void*>();
+				return Result<void*, std::string>::ok(ptr ? *ptr : nullptr);
+			}
+			return invoke_blocking(args.to_owned());
+		}
+
+		Result<Payload, std::string> pipe_handler(const CommandArgsView& args, Payload&& input) const
+		{
+			if (auto h = std::get_if<PipeHandler>(&handler); h && *h) return (*h)(args, std::move(input));
+
+			auto result = invoke_handler(args);
+			if (result.is_err()) return Result<Payload, std::string>::err(std::move(result).unwrap_err());
+			void* ptr = result.unwrap();
+			return Result<Payload, std::string>::ok(ptr ? Payload(ptr) : Payload());
+		}
+
+		// Called synchronously, an async command runs on a private loop until it completes.
+		Result<void*, std::string> invoke_blocking(CommandArgs args) const
+		{
+			if (!is_async()) return Result<void*, std::string>::err("Command has no handler");
+
+			EventLoop loop;
+			std::optional<Result<void*, std::string>> result;
+			std::get<AsyncHandler>(handler)(std::move(args), loop, [&result](Result<void*, std::string> val) { result.emplace(std::move(val)); });
+			loop.run();
+			return result ? std::move(*result) : Result<void*, std::string>::err("Async command did not complete");
+		}
+
+	private:
+		std::string name;
+		std::string description;
+		// A command has exactly one kind of handler, so they share storage.
+		std::variant<std::monostate, Handler, ViewHandler, AsyncHandler, PipeHandler> handler;
+		std::unique_ptr<const ArgSchema> schema;
+#if CMDKIT_ENABLE_METRICS
+		detail::MetricsSlot metrics;
+#endif
+		bool parallel_safe = false;
+		bool idempotent = false;
+	};
+
+	// Builds a command when it is first needed; see Terminal::register_lazy_command.
+	using CommandFactory = InplaceFunction<Command()>;
+
+	// Adapts `Out(const CommandArgsView&, In)` to Command::PipeHandler. The input is taken as an
+	// In, and the stage fails if the previous one produced anything else; with In = void the
+	// stage is called without it. Out may be a plain value or a Result<Out, std::string>, and its
+	// value is moved on to the next stage.
+	template<typename In, typename Fn>
+	Command::PipeHandler make_stage(Fn fn)
+	{
+		return [fn = std::move(fn)](const CommandArgsView& args, Payload&& input) -> Result<Payload, std::string>
+			{
+				auto forward = [](auto&& out) -> Result<Payload, std::string>
+					{
+						using Out = std::decay_t<decltype(out)>;
+						if constexpr (!is_result<Out>::value) return Result<Payload, std::string>::ok(Payload(std::move(out)));
+						else if (out.is_err()) return Result<Payload, std::string>::err(std::move(out).unwrap_err());
+						else if constexpr (std::is_void_v<typename Out::OkType>) return Result<Payload, std::string>::ok(Payload());
+						else return Result<Payload, std::string>::ok(Payload(std::move(out).unwrap()));
+					};
+
+				if constexpr (std::is_void_v<In>) return forward(fn(args));
+				else
+				{
+					std::optional<In> value = input.take<In>();
+					if (!value) return Result<Payload, std::string>::err(input.has_value() ? "Pipeline stage got an unexpected payload type" : "Pipeline stage got an empty payload");
+					return forward(fn(args, std::move(*value)));
+				}
+			};
+	}
+}
+
+namespace std
+{
+	template<>
+	struct hash<cmdkit::CommandArgs>
+	{
+		size_t operator()(const cmdkit::CommandArgs& args) const { return size_t(args.hash()); }
+	};
+
+	template<>
+	struct hash<cmdkit::CommandArgsView>
+	{
+		size_t operator()(const cmdkit::CommandArgsView& args) const { return size_t(args.hash()); }
+	};
+}
+
+// middleware.hpp
+namespace cmdkit
+{
+	// A middleware layer is any type with one or both of
+	//   Result<void, std::string> before(const Command& cmd, CommandArgsView& args) const;
+	//   void after(const Command& cmd, const CommandArgsView& args, Result<void*, std::string>& result) const;
+	// before() may also return void. It runs ahead of the handler and may rewrite args or
+	// stop the call by returning an error, which becomes the command's result. after() runs
+	// once a result exists and may replace it. Layers are entered in order and left in reverse
+	// order; a layer is left only if its own before() passed, so outer layers also see the
+	// errors of inner ones.
+	//
+	// Interceptor is the runtime form, for hooks added while the program runs. Either member
+	// may be empty.
+	struct Interceptor
+	{
+		using Before = InplaceFunction<Result<void, std::string>(const Command&, CommandArgsView&)>;
+		using After = InplaceFunction<void(const Command&, const CommandArgsView&, Result<void*, std::string>&)>;
+
+		Before before;
+		After after;
+	};
+
+	namespace detail
+	{
+		template<typename Layer, typename = void>
+		struct has_before : std::false_type {};
+
+		template<typename Layer>
+		struct has_before<Layer, std::void_t<decltype(std::declval<const Layer&>().before(std::declval<const Command&>(), std::declval<CommandArgsView&>()))>> : std::true_type {};
+
+		template<typename Layer, typename = void>
+		struct has_after : std::false_type {};
+
+		template<typename Layer>
+		struct has_after<Layer, std::void_t<decltype(std::declval<const Layer&>().after(std::declval<const Command&>(),
+			std::declval<const CommandArgsView&>(), std::declval<Result<void*, std::string>&>()))>> : std::true_type {};
+	}
+
+	// Compile-time layers followed by runtime interceptors. The layers are fixed by the type,
+	// so their hooks inline into the dispatch; with no layers and no interceptors, empty() is
+	// the only cost. Hooks are called through const references and may run concurrently from
+	// Terminal::invoke_batch.
+	template<typename... Middleware>
+	class MiddlewareChain
+	{
+		static_assert(((detail::has_before<Middleware>::value || detail::has_after<Middleware>::value) && ...),
+			"a middleware layer needs a before() or after() member");
+
+	public:
+		using R = Result<void*, std::string>;
+
+		MiddlewareChain() = default;
+
+		template<typename... Layers, std::enable_if_t<sizeof...(Layers) != 0 && std::is_constructible_v<std::tuple<Middleware...>, Layers&&...>, int> = 0>
+		explicit MiddlewareChain(Layers&&... middleware) : layers(std::forward<Layers>(middleware)...) {}
+
+		bool empty() const
+		{
+			if constexpr (sizeof...(Middleware) == 0) return interceptors.empty();
+			else return false;
+		}
+
+		void add(Interceptor hook) { interceptors.push_back(std::move(hook)); }
+		void clear() { interceptors.clear(); }
+		size_t interceptor_count() const { return interceptors.size(); }
+
+		template<size_t I>
+		auto& layer() { return std::get<I>(layers); }
+
+		template<size_t I>
+		const auto& layer() const { return std::get<I>(layers); }
+
+	public:
+		template<typename Invoke>
+		R run(const Command& cmd, CommandArgsView& args, Invoke&& invoke) const
+		{
+			std::optional<R> result;
+			const size_t entered = enter(cmd, args, result);
+			if (!result) result.emplace(invoke(static_cast<const CommandArgsView&>(args)));
+			leave(entered, cmd, args, *result);
+			return std::move(*result);
+		}
+
+		// The two halves of run(), for calls that complete later. Returns how many layers
+		// passed; a failing before() leaves its error in shortcut.
+		size_t enter(const Command& cmd, CommandArgsView& args, std::optional<R>& shortcut) const
+		{
+			size_t entered = 0;
+			if constexpr (sizeof...(Middleware) != 0)
+			{
+				auto step = [&](const auto& layer)
+					{
+						if (shortcut) return;
+						if (before(layer, cmd, args, shortcut)) ++entered;
+					};
+				std::apply([&step](const auto&... layer) { (step(layer), ...); }, layers);
+				if (shortcut) return entered;
+			}
+			for (const Interceptor& hook : interceptors)
+			{
+				if (hook.before)
+				{
+					Result<void, std::string> passed = hook.before(cmd, args);
+					if (passed.is_err()) { shortcut.emplace(R::err(std::move(passed).unwrap_err())); return entered; }
+				}
+				++entered;
+			}
+			return entered;
+		}
+
+		void leave(size_t entered, const Command& cmd, const CommandArgsView& args, R& result) const
+		{
+			constexpr size_t fixed = sizeof...(Middleware);
+			for (size_t idx = entered; idx > fixed; --idx)
+				if (const Interceptor::After& after = interceptors[idx - fixed - 1].after) after(cmd, args, result);
+			if constexpr (fixed != 0) leave_layers(entered, cmd, args, result, std::make_index_sequence<fixed>());
+		}
+
+	private:
+		template<typename Layer>
+		static bool before(const Layer& layer, const Command& cmd, CommandArgsView& args, std::optional<R>& shortcut)
+		{
+			if constexpr (!detail::has_before<Layer>::value) return true;
+			else if constexpr (std::is_void_v<decltype(layer.before(cmd, args))>) { layer.before(cmd, args); return true; }
+			else
+			{
+				Result<void, std::string> passed = layer.before(cmd, args);
+				if (passed.is_ok()) return true;
+				shortcut.emplace(R::err(std::move(passed).unwrap_err()));
+				return false;
+			}
+		}
+
+		template<size_t... I>
+		void leave_layers(size_t entered, const Command& cmd, const CommandArgsView& args, R& result, std::index_sequence<I...>) const
+		{
+			constexpr size_t last = sizeof...(I) - 1;
+			auto step = [&](const auto& layer, size_t idx)
+				{
+					using Layer = std::decay_t<decltype(layer)>;
+					if constexpr (detail::has_after<Layer>::value) if (idx < entered) layer.after(cmd, args, result);
+				};
+			(step(std::get<last - I>(layers), last - I), ...);
+		}
+
+	private:
+		std::tuple<Middleware...> layers;
+		std::vector<Interceptor> interceptors;
+	};
+}
+
+// memo.hpp
+namespace cmdkit
+{
+	struct MemoStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t expirations = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+
+		double hit_rate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+	};
+
+	// Bounded LRU of successful results, keyed on a command and the canonical hash of its
+	// arguments; entries are compared in full, so hash collisions cannot return a wrong
+	// result. Sizes are estimates of the heap an entry holds. A ttl of zero keeps entries
+	// until they are evicted or invalidated. All members are safe to call concurrently.
+	class MemoCache
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr size_t default_max_bytes = size_t(1) << 20;
+
+		explicit MemoCache(size_t max_bytes = default_max_bytes, Clock::duration ttl = Clock::duration::zero())
+			: max_bytes(max_bytes), ttl(ttl) {}
+
+		// A copy starts empty with the same limits.
+		MemoCache(const MemoCache& other) : MemoCache(other.get_max_bytes(), other.get_ttl()) {}
+		MemoCache& operator=(const MemoCache& other)
+		{
+			if (this == &other) return *this;
+			clear();
+			set_limits(other.get_max_bytes(), other.get_ttl());
+			return *this;
+		}
+
+	public:
+		void set_limits(size_t max_bytes_val, Clock::duration ttl_val = Clock::duration::zero())
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			max_bytes = max_bytes_val;
+			ttl = ttl_val;
+			shrink();
+		}
+
+		size_t get_max_bytes() const { std::lock_guard<std::mutex> lock(mutex); return max_bytes; }
+		Clock::duration get_ttl() const { std::lock_guard<std::mutex> lock(mutex); return ttl; }
+
+		template<typename Args>
+		std::optional<void*> find(const Command& cmd, const Args& args, uint64_t hash)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto [begin, end] = index.equal_range(hash);
+			for (auto it = begin; it != end; ++it)
+			{
+				const auto entry = it->second;
+				if (entry->command != &cmd || entry->args != args) continue;
+				if (entry->expires && *entry->expires <= Clock::now())
+				{
+					counters.expirations++;
+					erase(it);
+					break;
+				}
+				lru.splice(lru.begin(), lru, entry);
+				counters.hits++;
+				return entry->value;
+			}
+			counters.misses++;
+			return std::nullopt;
+		}
+
+		template<typename Args>
+		void insert(const Command& cmd, const Args& args, uint64_t hash, void* value)
+		{
+			CommandArgs owned = to_owned(args);
+			const size_t bytes = footprint(owned);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (bytes > max_bytes) return;
+
+			auto [begin, end] = index.equal_range(hash);
+			for (auto it = begin; it != end; ++it)
+			{
+				if (it->second->command == &cmd && it->second->args == owned) { erase(it); break; }
+			}
+
+			std::optional<Clock::time_point> expires;
+			if (ttl != Clock::duration::zero()) expires = Clock::now() + ttl;
+			lru.push_front(Entry{ &cmd, hash, std::move(owned), value, expires, bytes });
+			index.emplace(hash, lru.begin());
+			used += bytes;
+			shrink();
+		}
+
+		// Drops every entry of one command, e.g. after the state it reads has changed.
+		void invalidate(const Command& cmd)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = index.begin(); it != index.end();)
+			{
+				if (it->second->command == &cmd) it = erase(it);
+				else ++it;
+			}
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			index.clear();
+			lru.clear();
+			used = 0;
+		}
+
+		MemoStats stats() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			MemoStats result = counters;
+			result.entries = lru.size();
+			result.bytes = used;
+			return result;
+		}
+
+		void reset_stats()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			counters = MemoStats();
+		}
+
+	private:
+		struct Entry
+		{
+			const Command* command;
+			uint64_t hash;
+			CommandArgs args;
+			void* value;
+			std::optional<Clock::time_point> expires;
+			size_t bytes;
+		};
+
+		using List = std::list<Entry>;
+		using Index = std::unordered_multimap<uint64_t, List::iterator>;
+
+		static CommandArgs to_owned(const CommandArgs& args) { return args; }
+		static CommandArgs to_owned(const CommandArgsView& args) { return args.to_owned(); }
+
+		// An entry, its list node and index node, and the strings and hash nodes of its args.
+		static size_t footprint(const CommandArgs& args)
+		{
+			constexpr size_t node = 2 * sizeof(void*);
+			size_t bytes = sizeof(Entry) + node + sizeof(Index::value_type) + node;
+			for (const auto& arg : args.get_positional()) bytes += sizeof(std::string) + arg.size();
+			args.for_each_option([&bytes](std::string_view key, std::string_view val) { bytes += node + 2 * sizeof(std::string) + key.size() + val.size(); });
+			args.for_each_flag([&bytes](std::string_view name) { bytes += node + sizeof(std::string) + name.size(); });
+			return bytes;
+		}
+
+		Index::iterator erase(Index::iterator it)
+		{
+			used -= it->second->bytes;
+			lru.erase(it->second);
+			return index.erase(it);
+		}
+
+		void shrink()
+		{
+			while (used > max_bytes && !lru.empty())
+			{
+				const Entry& victim = lru.back();
+				auto [begin, end] = index.equal_range(victim.hash);
+				for (auto it = begin; it != end; ++it)
+				{
+					if (&*it->second == &victim) { erase(it); break; }
+				}
+				counters.evictions++;
+			}
+		}
+
+	private:
+		mutable std::mutex mutex;
+		List lru;
+		Index index;
+		size_t used = 0;
+		size_t max_bytes;
+		Clock::duration ttl;
+		MemoStats counters;
+	};
+}
+
+// mapped_file.hpp
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cmdkit
+{
+	// Read-only memory mapping of a whole file.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(MappedFile&& other) noexcept { swap(other); }
+		MappedFile& operator=(MappedFile&& other) noexcept { MappedFile(std::move(other)).swap(*this); return *this; }
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	public:
+		static Result<MappedFile, std::string> open(const std::string& path)
+		{
+			MappedFile file;
+#if defined(_WIN32)
+			HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (handle == INVALID_HANDLE_VALUE) return Result<MappedFile, std::string>::err("Can't open file: " + path);
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(handle, &size)) { CloseHandle(handle); return Result<MappedFile, std::string>::err("Can't stat file: " + path); }
+
+			if (size.QuadPart > 0)
+			{
+				HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping) file.data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				if (mapping) CloseHandle(mapping);
+				if (!file.data) { CloseHandle(handle); return Result<MappedFile, std::string>::err("Can't map file: " + path); }
+				file.size = size_t(size.QuadPart);
+			}
+			CloseHandle(handle);
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return Result<MappedFile, std::string>::err("Can't open file: " + path);
+
+			struct stat info;
+			if (fstat(fd, &info) != 0) { ::close(fd); return Result<MappedFile, std::string>::err("Can't stat file: " + path); }
+
+			if (info.st_size > 0)
+			{
+				void* ptr = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (ptr == MAP_FAILED) { ::close(fd); return Result<MappedFile, std::string>::err("Can't map file: " + path); }
+				madvise(ptr, size_t(info.st_size), MADV_SEQUENTIAL);
+				file.data = static_cast<const char*>(ptr);
+				file.size = size_t(info.st_size);
+			}
+			::close(fd);
+#endif
+			return Result<MappedFile, std::string>::ok(std::move(file));
+		}
+
+		std::string_view view() const { return std::string_view(data, size); }
+
+		void close()
+		{
+			if (!data) return;
+#if defined(_WIN32)
+			UnmapViewOfFile(data);
+#else
+			munmap(const_cast<char*>(data), size);
+#endif
+			data = nullptr;
+			size = 0;
+		}
+
+	private:
+		void swap(MappedFile& other) noexcept
+		{
+			std::swap(data, other.data);
+			std::swap(size, other.size);
+		}
+
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+	};
+}
+
+// history.hpp
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cmdkit
+{
+	struct HistoryOptions
+	{
+		// When the log grows past this, a background thread drops the oldest entries (and older
+		// copies of repeated lines) until it is half this size. The log is compacted on open as
+		// well. The file is mapped at twice this size up front and trimmed when it is closed.
+		size_t max_bytes = 16 << 20;
+		// Skips a line equal to the one recorded just before it.
+		bool ignore_duplicates = true;
+	};
+
+	namespace detail
+	{
+		// Read-write shared mapping of a file, sized when it is opened. The file is locked for the
+		// lifetime of the object, so only one process appends to it.
+		class LogFile
+		{
+		public:
+			LogFile() = default;
+			~LogFile() { release(); }
+
+			LogFile(const LogFile&) = delete;
+			LogFile& operator=(const LogFile&) = delete;
+
+		public:
+			Result<void, std::string> open(const std::string& path, size_t min_capacity)
+			{
+				using R = Result<void, std::string>;
+#if defined(_WIN32)
+				handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (handle == INVALID_HANDLE_VALUE) return R::err("Can't open history file: " + path);
+
+				LARGE_INTEGER size;
+				if (!GetFileSizeEx(handle, &size)) return R::err("Can't stat history file: " + path);
+				file_size = size_t(size.QuadPart);
+#else
+				fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+				if (fd < 0) return R::err("Can't open history file: " + path);
+				if (::flock(fd, LOCK_EX | LOCK_NB) != 0) return R::err("Can't lock history file, another process is using it: " + path);
+
+				struct stat info;
+				if (fstat(fd, &info) != 0) return R::err("Can't stat history file: " + path);
+				file_size = size_t(info.st_size);
+#endif
+				return map(std::max(file_size, min_capacity)) ? R::ok() : R::err("Can't map history file: " + path);
+			}
+
+			// Trims the file to size bytes and closes it. A file that was never mapped is left alone.
+			void close(size_t size)
+			{
+				if (!data) { release(); return; }
+				unmap();
+#if defined(_WIN32)
+				LARGE_INTEGER end;
+				end.QuadPart = LONGLONG(size);
+				if (SetFilePointerEx(handle, end, nullptr, FILE_BEGIN)) SetEndOfFile(handle);
+#else
+				[[maybe_unused]] const int truncated = ::ftruncate(fd, off_t(size));
+#endif
+				release();
+			}
+
+			// Asks the OS to write the first size bytes back to disk.
+			bool sync(size_t size)
+			{
+				if (!data || !size) return true;
+#if defined(_WIN32)
+				return FlushViewOfFile(data, size) != 0;
+#else
+				return msync(data, size, MS_SYNC) == 0;
+#endif
+			}
+
+			char* get_data() const { return data; }
+			size_t get_capacity() const { return capacity; }
+			// Size of the file when it was opened, including any zero tail left by a crash.
+			size_t get_file_size() const { return file_size; }
+
+		private:
+			void release()
+			{
+				unmap();
+#if defined(_WIN32)
+				if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+				handle = INVALID_HANDLE_VALUE;
+#else
+				if (fd >= 0) ::close(fd);
+				fd = -1;
+#endif
+			}
+
+			bool map(size_t size)
+			{
+				size = std::max<size_t>(size, 4096);
+#if defined(_WIN32)
+				mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size & 0xffffffffu), nullptr);
+				if (!mapping) return false;
+				data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+				if (!data) { CloseHandle(mapping); mapping = nullptr; return false; }
+#else
+				if (size > file_size && ::ftruncate(fd, off_t(size)) != 0) return false;
+				file_size = std::max(file_size, size);
+				void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				if (ptr == MAP_FAILED) return false;
+				data = static_cast<char*>(ptr);
+#endif
+				capacity = size;
+				return true;
+			}
+
+			void unmap()
+			{
+				if (!data) return;
+#if defined(_WIN32)
+				UnmapViewOfFile(data);
+				CloseHandle(mapping);
+				mapping = nullptr;
+#else
+				munmap(data, capacity);
+#endif
+				data = nullptr;
+				capacity = 0;
+			}
+
+		private:
+#if defined(_WIN32)
+			HANDLE handle = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#else
+			int fd = -1;
+#endif
+			char* data = nullptr;
+			size_t capacity = 0;
+			size_t file_size = 0;
+		};
+	}
+
+	// Command history kept in an append-only text file, one line per entry, oldest first. The
+	// file is mapped at twice max_bytes when it is opened, so recording a line is a copy into
+	// the mapping and an index update; the OS writes the pages back. Compaction runs on a
+	// background thread, which record wakes once each time the log passes max_bytes, and
+	// record waits for it only if lines come faster than it frees space. In memory there is an offset
+	// per entry and, per block of 64 entries, a 2048-bit signature of the bigrams and trigrams
+	// in them. Searches walk the blocks from newest to oldest and skip any whose signature
+	// lacks one of the needle's trigrams (or its bigram, for two characters), so a search for a
+	// rare string reads only a few blocks. Signatures are brought up to date by the next search
+	// rather than by record, which keeps recording off the dispatch path's profile.
+	// Entries are numbered from 0, the oldest. Safe to use from several threads.
+	class CommandHistory
+	{
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		static Result<std::shared_ptr<CommandHistory>, std::string> open(const std::string& path, HistoryOptions options = {})
+		{
+			using R = Result<std::shared_ptr<CommandHistory>, std::string>;
+			std::shared_ptr<CommandHistory> history(new CommandHistory(options));
+			if (auto opened = history->file.open(path, 2 * options.max_bytes); opened.is_err()) return R::err(std::move(opened).unwrap_err());
+
+			history->load();
+			if (history->used > options.max_bytes) history->rewrite();
+			history->sign();
+			history->compactor = std::thread([raw = history.get()]() { raw->compact_loop(); });
+			return R::ok(std::move(history));
+		}
+
+		~CommandHistory()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			if (compactor.joinable()) compactor.join();
+			file.close(used);
+		}
+
+		CommandHistory(const CommandHistory&) = delete;
+		CommandHistory& operator=(const CommandHistory&) = delete;
+
+	public:
+		// Appends line; blank lines are skipped, and newlines in it become spaces.
+		void record(std::string_view line)
+		{
+			while (!line.empty() && is_blank(line.back())) line.remove_suffix(1);
+			while (!line.empty() && is_blank(line.front())) line.remove_prefix(1);
+			if (line.empty()) return;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (options.ignore_duplicates && !offsets.empty() && entry_view(offsets.size() - 1) == line) return;
+
+			// A line that doesn't fit once the compactor is done is dropped.
+			const size_t size = line.size() + 1;
+			if (used + size > file.get_capacity()) room.wait(lock, [this, size]() { return used + size <= file.get_capacity() || !compaction_due; });
+			if (used + size > file.get_capacity()) return;
+
+			char* dst = file.get_data() + used;
+			std::memcpy(dst, line.data(), line.size());
+			if (std::memchr(dst, '\n', line.size())) std::replace(dst, dst + line.size(), '\n', ' ');
+			dst[line.size()] = '\n';
+			offsets.push_back(used);
+			used += size;
+
+			if (used > options.max_bytes && !compaction_due)
+			{
+				compaction_due = true;
+				wake.notify_one();
+			}
+		}
+
+		size_t size() const { std::lock_guard<std::mutex> lock(mutex); return offsets.size(); }
+
+		// Bytes of the log in use.
+		size_t bytes() const { std::lock_guard<std::mutex> lock(mutex); return used; }
+
+		std::string entry(size_t idx) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return idx < offsets.size() ? std::string(entry_view(idx)) : std::string();
+		}
+
+		// The newest entry before `before` that contains needle, as Ctrl-R finds it; pass the
+		// previous hit as `before` to continue further back.
+		std::optional<size_t> search(std::string_view needle, size_t before = npos) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return find_back(needle, before, [needle](std::string_view text) { return text.find(needle) != std::string_view::npos; });
+		}
+
+		// The newest entry before `before` that starts with prefix.
+		std::optional<size_t> search_prefix(std::string_view prefix, size_t before = npos) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return find_back(prefix, before, [prefix](std::string_view text) { return text.substr(0, prefix.size()) == prefix; });
+		}
+
+		// Rewrites the log with the newest entries that fit in half of max_bytes, keeping only
+		// the latest copy of each line. The background thread does this on its own; calling it
+		// is only needed to shrink the log sooner.
+		void compact()
+		{
+			rewrite();
+			std::lock_guard<std::mutex> lock(mutex);
+			if (used <= options.max_bytes) compaction_due = false;
+			room.notify_all();
+		}
+
+		// Flushes the log to disk. Without this, recorded lines survive a crash of the process
+		// but not of the machine.
+		Result<void, std::string> sync()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (file.sync(used)) return Result<void, std::string>::ok();
+			return Result<void, std::string>::err("Can't sync history file");
+		}
+
+	private:
+		static constexpr size_t block_size = 64;
+		static constexpr size_t signature_bits = 2048;
+
+		using Signature = std::array<uint64_t, signature_bits / 64>;
+
+		explicit CommandHistory(HistoryOptions options) : options(options) {}
+
+		static bool is_blank(char ch) { return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'; }
+
+		// Signature bit of the bigram or trigram at text; the top byte keeps the two apart.
+		static size_t gram(const char* text, size_t length)
+		{
+			uint32_t key = uint32_t(uint8_t(text[0])) | uint32_t(uint8_t(text[1])) << 8;
+			key |= length == 3 ? uint32_t(uint8_t(text[2])) << 16 : 0xff000000u;
+			return (key * 2654435761u) >> (32 - 11);
+		}
+
+		std::string_view entry_view(size_t idx) const
+		{
+			const char* begin = file.get_data() + offsets[idx];
+			const char* end = static_cast<const char*>(std::memchr(begin, '\n', used - offsets[idx]));
+			return std::string_view(begin, size_t(end - begin));
+		}
+
+		// Adds the entries recorded since the last search to their blocks' signatures.
+		void sign() const
+		{
+			for (; signed_entries < offsets.size(); ++signed_entries)
+			{
+				if (signed_entries % block_size == 0) signatures.emplace_back();
+				Signature& signature = signatures.back();
+				const std::string_view text = entry_view(signed_entries);
+				for (size_t pos = 0; pos + 2 <= text.size(); ++pos)
+				{
+					const size_t bigram = gram(text.data() + pos, 2);
+					signature[bigram / 64] |= uint64_t(1) << (bigram % 64);
+					if (pos + 3 > text.size()) continue;
+					const size_t trigram = gram(text.data() + pos, 3);
+					signature[trigram / 64] |= uint64_t(1) << (trigram % 64);
+				}
+			}
+		}
+
+		// Indexes the lines already in the file; blank lines are skipped. A crash can leave
+		// zeros after the last line (the file is grown ahead of the data) and a partly written
+		// line before them; both are cut off.
+		void load()
+		{
+			char* data = file.get_data();
+			size_t written = file.get_file_size();
+			while (written > 0 && data[written - 1] == '\0') written--;
+			used = written;
+			while (used > 0 && data[used - 1] != '\n') used--;
+
+			for (size_t pos = 0; pos < used;)
+			{
+				const char* newline = static_cast<const char*>(std::memchr(data + pos, '\n', used - pos));
+				const size_t length = size_t(newline - (data + pos));
+				if (length) offsets.push_back(pos);
+				pos += length + 1;
+			}
+			std::memset(data + used, 0, written - used);
+		}
+
+		template<typename Match>
+		std::optional<size_t> find_back(std::string_view needle, size_t before, Match&& match) const
+		{
+			size_t idx = std::min(before, offsets.size());
+			if (needle.empty()) return idx ? std::optional<size_t>(idx - 1) : std::nullopt;
+			sign();
+
+			// Up to 16 trigrams of a longer needle are plenty to rule a block out; a
+			// two-character needle is its own bigram.
+			std::array<size_t, 16> bits;
+			size_t count = 0;
+			for (size_t pos = 0; pos + 3 <= needle.size() && count < bits.size(); ++pos) bits[count++] = gram(needle.data() + pos, 3);
+			if (needle.size() == 2) bits[count++] = gram(needle.data(), 2);
+
+			while (idx > 0)
+			{
+				const size_t block = (idx - 1) / block_size;
+				const Signature& signature = signatures[block];
+				const bool candidate = std::all_of(bits.begin(), bits.begin() + count, [&signature](size_t bit) { return signature[bit / 64] >> (bit % 64) & 1; });
+				if (!candidate) { idx = block * block_size; continue; }
+
+				for (; idx > block * block_size; --idx)
+					if (match(entry_view(idx - 1))) return idx - 1;
+			}
+			return std::nullopt;
+		}
+
+		void compact_loop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;)
+			{
+				wake.wait(lock, [this]() { return stopping || compaction_due; });
+				if (stopping) return;
+				lock.unlock();
+				compact();
+				lock.lock();
+			}
+		}
+
+		// The kept lines are picked from the log without the lock: nothing below `used` changes
+		// until the next rewrite, and the mapping never moves. The lock is held only to copy
+		// them back, together with the lines recorded in the meantime.
+		void rewrite()
+		{
+			std::lock_guard<std::mutex> rewriting(compacting);
+			size_t end, count;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				end = used;
+				count = offsets.size();
+			}
+
+			char* data = file.get_data();
+			const size_t budget = options.max_bytes / 2;
+			std::vector<std::string_view> kept;
+			std::unordered_set<std::string_view> seen;
+			size_t total = 0;
+			for (size_t stop = end; stop > 0;)
+			{
+				size_t start = stop - 1;
+				while (start > 0 && data[start - 1] != '\n') start--;
+				const std::string_view text(data + start, stop - 1 - start);
+				stop = start;
+				if (text.empty()) continue;
+				if (total + text.size() + 1 > budget) break;
+				if (!seen.insert(text).second) continue;
+				kept.push_back(text);
+				total += text.size() + 1;
+			}
+
+			std::string content;
+			std::vector<uint64_t> kept_offsets;
+			content.reserve(total);
+			kept_offsets.reserve(kept.size());
+			for (auto it = kept.rbegin(); it != kept.rend(); ++it)
+			{
+				kept_offsets.push_back(content.size());
+				content.append(it->data(), it->size()).push_back('\n');
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			const size_t tail = used - end;
+			std::memmove(data + content.size(), data + end, tail);
+			std::memcpy(data, content.data(), content.size());
+			std::memset(data + content.size() + tail, 0, used - content.size() - tail);
+
+			for (size_t idx = count; idx < offsets.size(); ++idx) kept_offsets.push_back(offsets[idx] - end + content.size());
+			offsets.swap(kept_offsets);
+			signatures.clear();
+			signed_entries = 0;
+			used = content.size() + tail;
+		}
+
+	private:
+		HistoryOptions options;
+		detail::LogFile file;
+		mutable std::mutex mutex;
+		size_t used = 0;
+		std::vector<uint64_t> offsets;
+		mutable std::vector<Signature> signatures;
+		mutable size_t signed_entries = 0;
+
+		std::mutex compacting;
+		std::condition_variable wake;
+		std::condition_variable room;
+		bool compaction_due = false;
+		bool stopping = false;
+		std::thread compactor;
+	};
+}
+
+// plugin.hpp
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define CMDKIT_PLUGIN_EXPORT extern "C" __declspec(dllexport)
+#else
+#include <dlfcn.h>
+#define CMDKIT_PLUGIN_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// A plugin is a shared library built against the same cmdkit headers and settings as the
+// program loading it. It exports one entry point, which builds the command called name:
+//
+//     CMDKIT_PLUGIN_EXPORT bool cmdkit_make_command(const char* name, cmdkit::Command* out)
+//
+// and returns false for names it does not provide. See Terminal::register_plugin. Pipeline
+// payloads made on one side are recognized on the other only when RTTI is on.
+#define CMDKIT_PLUGIN_ENTRY "cmdkit_make_command"
+
+namespace cmdkit
+{
+	// A command a plugin provides, as registered before the plugin is loaded.
+	struct PluginCommand
+	{
+		std::string name;
+		std::string description;
+	};
+
+	// A loaded plugin library. Commands it made must be destroyed before it is.
+	class PluginLibrary
+	{
+	public:
+		using Entry = bool (*)(const char* name, Command* out);
+
+		~PluginLibrary()
+		{
+#if defined(_WIN32)
+			FreeLibrary(handle);
+#else
+			dlclose(handle);
+#endif
+		}
+
+		PluginLibrary(const PluginLibrary&) = delete;
+		PluginLibrary& operator=(const PluginLibrary&) = delete;
+
+	public:
+		static Result<std::shared_ptr<PluginLibrary>, std::string> open(const std::string& path)
+		{
+			using R = Result<std::shared_ptr<PluginLibrary>, std::string>;
+
+#if defined(_WIN32)
+			HMODULE handle = LoadLibraryA(path.c_str());
+			if (!handle) return R::err("Can't load plugin: " + path);
+			Entry entry = reinterpret_cast<Entry>(GetProcAddress(handle, CMDKIT_PLUGIN_ENTRY));
+			if (!entry) { FreeLibrary(handle); return R::err("Can't find " CMDKIT_PLUGIN_ENTRY " in plugin: " + path); }
+#else
+			void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+			if (!handle) return R::err(std::string("Can't load plugin: ") + dlerror());
+			Entry entry = reinterpret_cast<Entry>(dlsym(handle, CMDKIT_PLUGIN_ENTRY));
+			if (!entry) { dlclose(handle); return R::err("Can't find " CMDKIT_PLUGIN_ENTRY " in plugin: " + path); }
+#endif
+			return R::ok(std::shared_ptr<PluginLibrary>(new PluginLibrary(handle, entry)));
+		}
+
+		Result<Command, std::string> make_command(const std::string& name) const
+		{
+			Command cmd;
+			if (!entry(name.c_str(), &cmd)) return Result<Command, std::string>::err("Plugin has no command: " + name);
+			return Result<Command, std::string>::ok(std::move(cmd));
+		}
+
+	private:
+#if defined(_WIN32)
+		using Handle = HMODULE;
+#else
+		using Handle = void*;
+#endif
+
+		PluginLibrary(Handle handle, Entry entry) : handle(handle), entry(entry) {}
+
+	private:
+		Handle handle;
+		Entry entry;
+	};
+
+	namespace detail
+	{
+		// A plugin opened by the first of its commands to be dispatched. A plugin that fails to
+		// load is not retried; its commands report the error instead.
+		class LazyPlugin
+		{
+		public:
+			explicit LazyPlugin(std::string path) : path(std::move(path)) {}
+
+			Command make_command(const std::string& name, const std::string& description)
+			{
+				std::call_once(opened, [this]()
+					{
+						auto result = PluginLibrary::open(path);
+						if (result.is_ok()) library = std::move(result).unwrap();
+						else error = std::move(result).unwrap_err();
+					});
+
+				auto cmd = library ? library->make_command(name) : Result<Command, std::string>::err(error);
+				if (cmd.is_ok()) return std::move(cmd).unwrap();
+
+				using R = Result<void*, std::string>;
+				return Command(name, description, [message = std::move(cmd).unwrap_err()](const CommandArgsView&) { return R::err(message); });
+			}
+
+		private:
+			std::string path;
+			std::once_flag opened;
+			std::shared_ptr<PluginLibrary> library;
+			std::string error;
+		};
+	}
+}
+
+// output.hpp
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace cmdkit
+{
+	struct FlushPolicy
+	{
+		// Size of the reusable block; a write that does not fit flushes it first.
+		size_t buffer_size = 64 * 1024;
+		// Once this long has passed since the last flush, the block is flushed by the next write
+		// that ends a line or by the end of the next dispatch (an OutputSink::Scope); zero
+		// disables it. Output that waits for input should go through prompt().
+		std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100);
+	};
+
+	struct OutputStats
+	{
+		uint64_t bytes = 0;
+		uint64_t flushes = 0;
+	};
+
+	namespace detail
+	{
+		// Writes all parts to fd with as few writev calls as partial writes allow.
+		inline Result<void, std::string> write_fd(int fd, const std::string_view* parts, size_t count)
+		{
+			constexpr size_t batch = 16;
+			for (size_t first = 0; first < count; first += batch)
+			{
+				std::string_view pending[batch];
+				const size_t size = std::min(batch, count - first);
+				std::copy(parts + first, parts + first + size, pending);
+
+				for (size_t head = 0; head < size;)
+				{
+#if defined(_WIN32)
+					const unsigned chunk = unsigned(std::min<size_t>(pending[head].size(), INT_MAX));
+					const int written = chunk ? _write(fd, pending[head].data(), chunk) : 0;
+#else
+					struct iovec vec[batch];
+					for (size_t idx = head; idx < size; ++idx) vec[idx - head] = { const_cast<char*>(pending[idx].data()), pending[idx].size() };
+					const ssize_t written = ::writev(fd, vec, int(size - head));
+#endif
+					if (written < 0)
+					{
+						if (errno == EINTR) continue;
+						return Result<void, std::string>::err("Can't write output: " + std::string(std::strerror(errno)));
+					}
+
+					size_t left = size_t(written);
+					while (head < size && left >= pending[head].size()) left -= pending[head++].size();
+					if (head < size) pending[head].remove_prefix(left);
+				}
+			}
+			return Result<void, std::string>::ok();
+		}
+	}
+
+	// Buffers handler output in one reusable block and hands it to the target in batches:
+	// when the block fills, when the flush interval has passed (checked as a line ends and as
+	// a dispatch returns), on prompt(), and when
+	// Terminal finishes a script or batch. Writes at least half a block long skip the copy and
+	// go out together with the buffered bytes in one target call (a single writev for file
+	// descriptors). Writes are serialized by a lock, so one sink may be shared by
+	// Terminal::invoke_batch workers; output written straight to std::cout is not ordered
+	// with it.
+	class OutputSink
+	{
+	public:
+		// Receives the pieces to write, in order.
+		using Target = InplaceFunction<Result<void, std::string>(const std::string_view* parts, size_t count)>;
+
+		explicit OutputSink(int fd = 1, FlushPolicy policy = {})
+			: OutputSink(Target([fd](const std::string_view* parts, size_t count) { return detail::write_fd(fd, parts, count); }), policy) {}
+
+		explicit OutputSink(Target target, FlushPolicy policy = {})
+			: target(std::move(target)), policy(policy), last_flush(std::chrono::steady_clock::now())
+		{
+			buffer.reserve(policy.buffer_size);
+		}
+
+		~OutputSink() { flush(); }
+
+		OutputSink(const OutputSink&) = delete;
+		OutputSink& operator=(const OutputSink&) = delete;
+
+	public:
+		void write(std::string_view text)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (buffer.size() + text.size() > policy.buffer_size)
+			{
+				if (2 * text.size() >= policy.buffer_size) { emit(text); return; }
+				emit({});
+			}
+			buffer.insert(buffer.end(), text.begin(), text.end());
+			if (!text.empty() && text.back() == '\n' && due()) emit({});
+		}
+
+		OutputSink& operator<<(std::string_view text) { write(text); return *this; }
+		OutputSink& operator<<(const char* text) { write(text); return *this; }
+		OutputSink& operator<<(const std::string& text) { write(text); return *this; }
+		OutputSink& operator<<(char ch) { write(std::string_view(&ch, 1)); return *this; }
+
+		template<typename T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>, int> = 0>
+		OutputSink& operator<<(T val)
+		{
+			char text[64];
+			const auto [end, ec] = std::to_chars(text, text + sizeof(text), val);
+			write(std::string_view(text, ec == std::errc() ? size_t(end - text) : 0));
+			return *this;
+		}
+
+		OutputSink& operator<<(bool val) { write(val ? "true" : "false"); return *this; }
+
+	public:
+		// Hands the buffered bytes to the target. Returns the first error since the last flush.
+		Result<void, std::string> flush()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			emit({});
+			return take_error();
+		}
+
+		// Flushes the block only if the interval has passed since the last flush.
+		void flush_if_due()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (due()) emit({});
+		}
+
+		// Writes text and flushes, so it is visible before the program waits for input.
+		Result<void, std::string> prompt(std::string_view text)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			emit(text);
+			return take_error();
+		}
+
+		size_t buffered() const { std::lock_guard<std::mutex> lock(mutex); return buffer.size(); }
+
+		OutputStats stats() const { std::lock_guard<std::mutex> lock(mutex); return counters; }
+
+		const FlushPolicy& get_policy() const { return policy; }
+
+	public:
+		// The sink of the Terminal dispatching on this thread, or standard() outside of one.
+		static OutputSink& current()
+		{
+			OutputSink* sink = current_slot();
+			return sink ? *sink : standard();
+		}
+
+		// The sink installed on this thread by a Scope, if any.
+		static OutputSink* installed() { return current_slot(); }
+
+		// Buffered standard output, flushed at exit.
+		static OutputSink& standard() { static OutputSink sink(1); return sink; }
+
+		// Makes sink this thread's current() until the scope ends, and then flushes it if the
+		// interval is due, so a command's last words do not wait for someone else's newline.
+		class Scope
+		{
+		public:
+			explicit Scope(OutputSink& sink) : sink(sink), previous(current_slot()) { current_slot() = &sink; }
+			~Scope()
+			{
+				current_slot() = previous;
+				sink.flush_if_due();
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			OutputSink& sink;
+			OutputSink* previous;
+		};
+
+	private:
+		static OutputSink*& current_slot() { thread_local OutputSink* sink = nullptr; return sink; }
+
+		// Sends the block followed by extra in one target call. Called with the lock held.
+		void emit(std::string_view extra)
+		{
+			const std::string_view parts[] = { std::string_view(buffer.data(), buffer.size()), extra };
+			const size_t first = buffer.empty() ? 1 : 0;
+			const size_t count = extra.empty() ? 1 - first : 2 - first;
+			if (count == 0) return;
+			last_flush = std::chrono::steady_clock::now();
+
+			if (auto result = target(parts + first, count); result.is_err() && !error) error = std::move(result).unwrap_err();
+			counters.bytes += buffer.size() + extra.size();
+			counters.flushes++;
+			buffer.clear();
+		}
+
+		// Called with the lock held.
+		bool due() const
+		{
+			return policy.interval.count() > 0 && !buffer.empty() && std::chrono::steady_clock::now() - last_flush >= policy.interval;
+		}
+
+		Result<void, std::string> take_error()
+		{
+			if (!error) return Result<void, std::string>::ok();
+			Result<void, std::string> result = Result<void, std::string>::err(std::move(*error));
+			error.reset();
+			return result;
+		}
+
+	private:
+		Target target;
+		FlushPolicy policy;
+		mutable std::mutex mutex;
+		std::vector<char> buffer;
+		std::chrono::steady_clock::time_point last_flush;
+		std::optional<std::string> error;
+		OutputStats counters;
+	};
+}
+
+// thread_pool.hpp
+namespace cmdkit
+{
+	// Fixed-size pool where each worker owns a deque: it pops its own newest task and, when
+	// empty, steals the oldest task of another worker. Threads waiting on a TaskGroup run
+	// queued tasks instead of sleeping, so nested batches never starve the pool.
+	class WorkStealingPool
+	{
+	public:
+		class TaskGroup
+		{
+		public:
+			bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+		private:
+			std::atomic<size_t> pending{ 0 };
+			friend class WorkStealingPool;
+		};
+
+		explicit WorkStealingPool(size_t thread_count = std::thread::hardware_concurrency())
+		{
+			if (thread_count == 0) thread_count = 1;
+			for (size_t idx = 0; idx < thread_count; ++idx) queues.push_back(std::make_unique<Queue>());
+			for (size_t idx = 0; idx < thread_count; ++idx) workers.emplace_back([this, idx]() { worker_loop(idx); });
+		}
+
+		~WorkStealingPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (auto& worker : workers) worker.join();
+		}
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	public:
+		size_t size() const { return workers.size(); }
+
+		void submit(std::function<void()> task)
+		{
+			const size_t home = current_pool == this ? current_worker : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+			{
+				std::lock_guard<std::mutex> lock(queues[home]->mutex);
+				queues[home]->tasks.push_back(std::move(task));
+			}
+			queued.fetch_add(1, std::memory_order_release);
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+			}
+			wake.notify_one();
+		}
+
+		void submit(TaskGroup& group, std::function<void()> task)
+		{
+			group.pending.fetch_add(1, std::memory_order_relaxed);
+			submit([this, &group, task = std::move(task)]()
+				{
+					struct Done
+					{
+						WorkStealingPool& pool;
+						TaskGroup& group;
+						~Done() { if (group.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) pool.notify_all(); }
+					} done{ *this, group };
+					task();
+				});
+		}
+
+		// Runs queued tasks on the calling thread until every task of the group has finished.
+		void wait(TaskGroup& group)
+		{
+			const size_t home = current_pool == this ? current_worker : 0;
+			while (!group.done())
+			{
+				if (try_run_one(home)) continue;
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				wake.wait_for(lock, std::chrono::milliseconds(1), [&]() { return queued.load(std::memory_order_acquire) > 0 || group.done(); });
+			}
+		}
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void notify_all()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+			}
+			wake.notify_all();
+		}
+
+		bool try_run_one(size_t home)
+		{
+			std::function<void()> task;
+			if (!pop(home, task))
+			{
+				bool stolen = false;
+				for (size_t offset = 1; offset < queues.size() && !stolen; ++offset) stolen = steal((home + offset) % queues.size(), task);
+				if (!stolen) return false;
+			}
+
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			task();
+			return true;
+		}
+
+		bool pop(size_t idx, std::function<void()>& task)
+		{
+			std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+			if (queues[idx]->tasks.empty()) return false;
+			task = std::move(queues[idx]->tasks.back());
+			queues[idx]->tasks.pop_back();
+			return true;
+		}
+
+		bool steal(size_t idx, std::function<void()>& task)
+		{
+			std::unique_lock<std::mutex> lock(queues[idx]->mutex, std::try_to_lock);
+			if (!lock.owns_lock() || queues[idx]->tasks.empty()) return false;
+			task = std::move(queues[idx]->tasks.front());
+			queues[idx]->tasks.pop_front();
+			return true;
+		}
+
+		void worker_loop(size_t idx)
+		{
+			current_pool = this;
+			current_worker = idx;
+			while (true)
+			{
+				if (try_run_one(idx)) continue;
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+				if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+			}
+		}
+
+	private:
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> queued{ 0 };
+		std::atomic<size_t> next_queue{ 0 };
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		static inline thread_local WorkStealingPool* current_pool = nullptr;
+		static inline thread_local size_t current_worker = 0;
+	};
+}
+
+// terminal.hpp
+namespace cmdkit
+{
+	enum class ScriptPolicy { stop_on_error, continue_on_error };
+
+	struct ScriptError
+	{
+		size_t line;
+		std::string message;
+	};
+
+	struct ScriptReport
+	{
+		size_t lines = 0;
+		size_t executed = 0;
+		std::vector<ScriptError> errors;
+
+		bool ok() const { return errors.empty(); }
+	};
+
+	// Terminal whose dispatch runs through the given compile-time middleware layers (see
+	// middleware.hpp). Terminal itself has none; runtime interceptors work on either.
+	template<typename... Middleware>
+	class BasicTerminal
+	{
+	public:
+		BasicTerminal() = default;
+
+		template<typename... Layers, std::enable_if_t<sizeof...(Layers) != 0 && std::is_constructible_v<MiddlewareChain<Middleware...>, Layers&&...>, int> = 0>
+		explicit BasicTerminal(Layers&&... middleware) : chain(std::forward<Layers>(middleware)...) {}
+
+		void register_command(const std::string& name, Command cmd)
+		{
+			if (const Command* old = command_table.find(name); old && !lazy.empty())
+				if (auto entry = lazy.find(old); entry != lazy.end()) entry->second.built = true;
+			insert(name, std::move(cmd));
+		}
+
+		void register_command(Command cmd)
+		{
+			const std::string name = cmd.get_name();
+			register_command(name, std::move(cmd));
+		}
+
+		// Registers a placeholder with the name and description only; factory builds the real
+		// command when the name is first looked up for dispatch, and it replaces the placeholder
+		// in place, keeping the placeholder's description if it has none. Listings show the
+		// placeholder until then. If the factory throws, the next lookup calls it again.
+		void register_lazy_command(const std::string& name, const std::string& description, CommandFactory factory)
+		{
+			Command stub;
+			stub.get_name(name);
+			stub.get_description(description);
+			Command& slot = insert(name, std::move(stub));
+			lazy.insert_or_assign(&slot, LazyCommand{ &slot, std::move(factory), false });
+		}
+
+		// Registers the commands of a plugin library (see plugin.hpp) without loading it. The
+		// library is opened when one of them is first dispatched, and stays loaded for the
+		// lifetime of the terminal. If it can't be loaded, its commands fail with the reason.
+		void register_plugin(const std::string& path, const std::vector<PluginCommand>& commands)
+		{
+			auto plugin = std::make_shared<detail::LazyPlugin>(path);
+			for (const PluginCommand& command : commands)
+				register_lazy_command(command.name, command.description, [plugin, command]() { return plugin->make_command(command.name, command.description); });
+		}
+
+		// When enabled, a name that is not registered resolves to the only command it is a prefix of.
+		void set_abbreviation(bool enabled) { abbreviation = enabled; }
+		bool get_abbreviation() const { return abbreviation; }
+
+
+		Result<void*, std::string> invoke(const CommandArgs& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); } );
+		}
+		
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgsView& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgsView& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		// A line with a standalone `|` runs as a pipeline (see pipe); its result is the last
+		// stage's value if that is a void*, and null otherwise.
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const std::string& command, Fn&& not_find_callback) const
+		{
+			if (history) history->record(command);
+			if (detail::find_pipe(command) != std::string::npos)
+			{
+				auto result = run_pipeline(command, std::forward<Fn>(not_find_callback));
+				if (result.is_err()) return Result<void*, std::string>::err(std::move(result).unwrap_err());
+				void* const* ptr = result.unwrap().template get<void*>();
+				return Result<void*, std::string>::ok(ptr ? *ptr : nullptr);
+			}
+
+			const Command* cmd = find_first_token(command);
+			if (!cmd)
+			{
+				std::invoke(std::forward<Fn>(not_find_callback));
+				return Result<void*, std::string>::err("Not find command!");
+			}
+
+			ParseContext& context = ParseContext::local();
+			ParseContext::Scope scope(context);
+			CommandArgsView args = cmd->parse_args(command, context.resource());
+			OutputSink::Scope redirect(dispatch_output());
+			return execute(*cmd, args);
+		}
+
+		Result<void*, std::string> invoke(const std::string& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+	public:
+		// Runs `cmdA args | cmdB args | ...`: each stage's value is moved into the next stage
+		// (see Command::PipeHandler), and the first error ends the pipeline. Stages are parsed
+		// and run one at a time, each in a fresh scope of the parse context, so a payload must
+		// not borrow from its stage's arguments other than the line itself. A single stage
+		// without `|` is a pipeline of one.
+		Result<Payload, std::string> pipe(std::string_view line) const
+		{
+			return run_pipeline(line, []() {});
+		}
+
+	public:
+		// Runs one command per line of a memory-mapped file. Blank lines and lines starting
+		// with '#' are skipped; failures are collected with their 1-based line numbers.
+		Result<ScriptReport, std::string> run_script(const std::string& path, ScriptPolicy policy = ScriptPolicy::stop_on_error) const
+		{
+			auto file = MappedFile::open(path);
+			if (file.is_err()) return Result<ScriptReport, std::string>::err(std::move(file).unwrap_err());
+			return Result<ScriptReport, std::string>::ok(run_lines(file.unwrap().view(), policy));
+		}
+
+		ScriptReport run_lines(std::string_view script, ScriptPolicy policy = ScriptPolicy::stop_on_error) const
+		{
+			OutputSink& sink = dispatch_output();
+			OutputSink::Scope redirect(sink);
+			ScriptReport report;
+			std::string unquoted;
+			size_t pos = 0;
+			while (pos < script.size())
+			{
+				const char* newline = static_cast<const char*>(std::memchr(script.data() + pos, '\n', script.size() - pos));
+				const size_t end = newline ? size_t(newline - script.data()) : script.size();
+				const std::string_view line = script.substr(pos, end - pos);
+				pos = end + 1;
+				report.lines++;
+
+				const std::optional<std::string_view> first = detail::first_arg(line, unquoted);
+				if (!first || first->substr(0, 1) == "#") continue;
+
+				const Command* cmd = find(*first);
+				report.executed++;
+
+				std::optional<std::string> error;
+				if (!cmd) error = not_found(*first);
+				else
+				{
+					ParseContext& context = ParseContext::local();
+					ParseContext::Scope scope(context);
+					CommandArgsView args = cmd->parse_args(line, context.resource());
+					if (auto result = execute(*cmd, args); result.is_err()) error = std::move(result).unwrap_err();
+				}
+
+				if (!error) continue;
+				report.errors.push_back(ScriptError{ report.lines, std::move(*error) });
+				if (policy == ScriptPolicy::stop_on_error) break;
+			}
+			sink.flush();
+			return report;
+		}
+
+	public:
+		// Runs independent commands on the thread pool and returns their results in input order.
+		// Parallel-safe commands are spread across workers; once they have all finished, the
+		// others run one at a time, in input order, on the calling thread, so they never overlap
+		// with a parallel one. Exceptions from handlers become error results.
+		std::vector<Result<void*, std::string>> invoke_batch(const std::vector<std::string>& lines) const
+		{
+			return run_batch(lines.size(), [this, &lines](size_t idx) { return find_first_token(lines[idx]); },
+				[this, &lines](const Command& cmd, size_t idx)
+				{
+					ParseContext& local = ParseContext::local();
+					ParseContext::Scope scope(local);
+					CommandArgsView args = cmd.parse_args(lines[idx], local.resource());
+					return execute(cmd, args);
+				});
+		}
+
+		std::vector<Result<void*, std::string>> invoke_batch(const std::vector<CommandArgs>& commands) const
+		{
+			return run_batch(commands.size(),
+				[this, &commands](size_t idx) { return commands[idx].get_positional().empty() ? nullptr : find(commands[idx][0]); },
+				[this, &commands](const Command& cmd, size_t idx) { return execute(cmd, commands[idx]); });
+		}
+
+		void set_thread_pool(std::shared_ptr<WorkStealingPool> val) { pool = std::move(val); }
+		const std::shared_ptr<WorkStealingPool>& get_thread_pool() const { if (!pool) pool = std::make_shared<WorkStealingPool>(); return pool; }
+
+	public:
+		// Queues the line on the terminal's event loop; it is parsed and dispatched by run().
+		// Async commands interleave on the loop thread, synchronous ones complete in place.
+		void invoke_async(const std::string& command, Command::Completion done) const
+		{
+			EventLoop& loop = get_event_loop();
+			loop.post([this, &loop, command, done = std::move(done)]() mutable
+				{
+					OutputSink::Scope redirect(dispatch_output());
+					CommandArgs args = CommandArgs::parse(command);
+					const Command* cmd = args.get_positional().empty() ? nullptr : find(args[0]);
+					if (!cmd) done(Result<void*, std::string>::err("Not find command!"));
+					else if (chain.empty()) cmd->invoke_async(std::move(args), loop, measured_completion(*cmd, std::move(done)));
+					else execute_async(*cmd, args, loop, std::move(done));
+				});
+		}
+
+		size_t run() const { return get_event_loop().run(); }
+
+		EventLoop& get_event_loop() const { if (!event_loop) event_loop = std::make_shared<EventLoop>(); return *event_loop; }
+
+	public:
+		// Where handlers write: OutputSink::current() is this sink while the terminal dispatches
+		// on a thread, including batch workers, unless the caller installed one first (as
+		// TerminalServer does per connection). Scripts and batches flush it when they finish;
+		// a REPL should ask for input through prompt(). Defaults to OutputSink::standard().
+		// Async handlers that resume later should hold on to get_output() themselves.
+		void set_output(std::shared_ptr<OutputSink> val) { output = std::move(val); }
+		OutputSink& get_output() const { return output ? *output : OutputSink::standard(); }
+
+		Result<void, std::string> prompt(std::string_view text) const { return get_output().prompt(text); }
+
+	public:
+		// Lines passed to invoke(std::string) are recorded here before they run, whether or not
+		// they succeed; script lines and pre-parsed CommandArgs are not. Off (null) by default.
+		void set_history(std::shared_ptr<CommandHistory> val) { history = std::move(val); }
+		const std::shared_ptr<CommandHistory>& get_history() const { return history; }
+
+	private:
+		OutputSink& dispatch_output() const
+		{
+			OutputSink* installed = OutputSink::installed();
+			return installed ? *installed : get_output();
+		}
+
+	public:
+		// Completes the last word of line: a command name when it is the first word (of the
+		// last pipeline stage), or a declared --option of that stage's command. Returns whole
+		// words, shortest first.
+		std::vector<std::string> complete(std::string_view line, size_t limit = 10) const
+		{
+			for (size_t bar; (bar = detail::find_pipe(line)) != std::string_view::npos;) line.remove_prefix(bar + 1);
+
+			size_t word = line.size();
+			while (word > 0 && !detail::is_space(line[word - 1])) word--;
+			const std::string_view prefix = line.substr(word);
+
+			size_t first = 0;
+			while (first < word && detail::is_space(line[first])) first++;
+			if (first == word) return command_names.complete(prefix, limit);
+
+			size_t first_end = first;
+			while (first_end < word && !detail::is_space(line[first_end])) first_end++;
+			const Command* cmd = prefix.empty() || prefix[0] != '-' ? nullptr : find(line.substr(first, first_end - first));
+			if (!cmd || !cmd->get_schema()) return {};
+
+			std::vector<std::string> words = cmd->get_schema()->get_names().complete(prefix.substr(prefix.size() > 1 && prefix[1] == '-' ? 2 : 1), limit);
+			for (std::string& name : words) name.insert(0, "--");
+			return words;
+		}
+
+		// Registered commands within a few edits of name, closest first, for "did you mean".
+		std::vector<Suggestion> suggest(std::string_view name, size_t limit = 3) const { return command_names.suggest(name, limit); }
+
+	public:
+		// Builds the command first if it was registered lazily.
+		const Command* find(std::string_view name) const
+		{
+			const Command* cmd = command_table.find(name);
+			if (!cmd && abbreviation) cmd = command_table.find_unique_prefix(name);
+			return cmd && !cmd->has_handler() ? materialize(*cmd) : cmd;
+		}
+
+		const Command* resolve(std::string_view prefix) const
+		{
+			const Command* cmd = command_table.find_unique_prefix(prefix);
+			return cmd && !cmd->has_handler() ? materialize(*cmd) : cmd;
+		}
+
+		std::vector<std::string> list_commands(std::string_view prefix = {}) const
+		{
+			std::vector<std::string> names;
+			for_each_command(prefix, [&names](std::string_view name, const Command&) { names.emplace_back(name); });
+			return names;
+		}
+
+		template<typename Fn>
+		void for_each_command(std::string_view prefix, Fn&& fn) const { command_table.for_each_prefix(prefix, std::forward<Fn>(fn)); }
+
+		size_t size() const { return command_table.size(); }
+
+	public:
+		// Runtime middleware, run after the compile-time layers. Like register_command, these
+		// are not synchronized with dispatch and belong to setup.
+		void add_interceptor(Interceptor hook) { chain.add(std::move(hook)); }
+		void clear_interceptors() { chain.clear(); }
+		size_t interceptor_count() const { return chain.interceptor_count(); }
+
+		template<size_t I>
+		auto& middleware() { return chain.template layer<I>(); }
+
+		template<size_t I>
+		const auto& middleware() const { return chain.template layer<I>(); }
+
+	public:
+		// Results of idempotent commands, reused while their arguments compare equal. Only
+		// synchronous dispatch is memoized, and only successful results; a hit still passes
+		// through the middleware chain but skips the handler and its metrics.
+		void set_memo_limits(size_t max_bytes, MemoCache::Clock::duration ttl = MemoCache::Clock::duration::zero()) { memo.set_limits(max_bytes, ttl); }
+
+		bool invalidate(std::string_view name)
+		{
+			const Command* cmd = command_table.find(name);
+			if (cmd) memo.invalidate(*cmd);
+			return cmd != nullptr;
+		}
+
+		void invalidate_all() { memo.clear(); }
+
+		MemoStats memo_stats() const { return memo.stats(); }
+		void reset_memo_stats() { memo.reset_stats(); }
+
+	public:
+		// Per-command call counts, ok/err counts and latency histograms, recorded around every
+		// dispatch when built with CMDKIT_ENABLE_METRICS. Without it these are no-ops and
+		// the snapshot is empty.
+		void set_metrics_enabled([[maybe_unused]] bool enabled)
+		{
+#if CMDKIT_ENABLE_METRICS
+			metrics_enabled = enabled;
+#endif
+		}
+
+		bool get_metrics_enabled() const
+		{
+#if CMDKIT_ENABLE_METRICS
+			return metrics_enabled;
+#else
+			return false;
+#endif
+		}
+
+		// Commands that have been called at least once, in name order.
+		MetricsSnapshot metrics() const
+		{
+			MetricsSnapshot snapshot;
+			command_table.for_each([&snapshot](std::string_view name, const Command& cmd)
+				{
+					if (const CommandMetrics* stats = cmd.get_metrics()) snapshot.commands.push_back(stats->snapshot(std::string(name)));
+				});
+			return snapshot;
+		}
+
+		void reset_metrics()
+		{
+			command_table.for_each([](std::string_view, const Command& cmd) { cmd.reset_metrics(); });
+		}
+
+	private:
+		template<typename Fn>
+		std::invoke_result_t<Fn> measured([[maybe_unused]] const Command& cmd, Fn&& fn) const
+		{
+#if CMDKIT_ENABLE_METRICS
+			if (metrics_enabled)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				auto elapsed = [&start]() { return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()); };
+				try
+				{
+					std::invoke_result_t<Fn> result = fn();
+					cmd.record_call(elapsed(), result.is_ok());
+					return result;
+				}
+				catch (...)
+				{
+					cmd.record_call(elapsed(), false);
+					throw;
+				}
+			}
+#endif
+			return fn();
+		}
+
+		// Async commands are timed from dispatch to completion.
+		Command::Completion measured_completion([[maybe_unused]] const Command& cmd, Command::Completion done) const
+		{
+#if CMDKIT_ENABLE_METRICS
+			if (metrics_enabled)
+			{
+				return [&cmd, start = std::chrono::steady_clock::now(), done = std::move(done)](Result<void*, std::string> result)
+					{
+						cmd.record_call(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), result.is_ok());
+						done(std::move(result));
+					};
+			}
+#endif
+			return done;
+		}
+
+		// Middleware works on a mutable view. Views the terminal parsed itself are passed as is;
+		// a caller's args are copied into the thread's parse context first, and only when the
+		// chain is not empty. Commands with a schema are bound before the chain so that
+		// rewrites land in their slots; args that fail validation go through unbound and the
+		// command reports the error.
+		Result<void*, std::string> execute(const Command& cmd, CommandArgsView& args) const
+		{
+			if (chain.empty()) return call(cmd, static_cast<const CommandArgsView&>(args));
+
+			return with_schema(cmd, args, [this, &cmd](CommandArgsView& view)
+				{
+					return chain.run(cmd, view, [this, &cmd](const CommandArgsView& rewritten) { return call(cmd, rewritten); });
+				});
+		}
+
+		template<typename Run>
+		static auto with_schema(const Command& cmd, CommandArgsView& args, Run&& run)
+		{
+			if (const ArgSchema* schema = cmd.get_schema(); schema && args.get_schema() != schema)
+			{
+				if (auto bound = cmd.bind_schema(args); bound.is_ok())
+				{
+					CommandArgsView view = std::move(bound).unwrap();
+					return run(view);
+				}
+			}
+			return run(args);
+		}
+
+		// A stage passes through the middleware chain like a command. after() hooks see its
+		// result as a null pointer or the error; one that turns it into an error stops the
+		// pipeline, one that clears an error passes on an empty payload. Stages are not memoized.
+		Result<Payload, std::string> execute_stage(const Command& cmd, CommandArgsView& args, Payload&& input) const
+		{
+			using P = Result<Payload, std::string>;
+			if (chain.empty()) return measured(cmd, [&]() { return cmd.pipe(args, std::move(input)); });
+
+			return with_schema(cmd, args, [this, &cmd, &input](CommandArgsView& view)
+				{
+					std::optional<Result<void*, std::string>> status;
+					std::optional<P> result;
+					const size_t entered = chain.enter(cmd, view, status);
+					if (!status)
+					{
+						result.emplace(measured(cmd, [&]() { return cmd.pipe(view, std::move(input)); }));
+						status.emplace(result->is_ok() ? Result<void*, std::string>::ok(nullptr) : Result<void*, std::string>::err(result->unwrap_err()));
+					}
+					chain.leave(entered, cmd, view, *status);
+
+					if (status->is_err()) return P::err(std::move(*status).unwrap_err());
+					return result && result->is_ok() ? std::move(*result) : P::ok(Payload());
+				});
+		}
+
+		template<typename Fn>
+		Result<Payload, std::string> run_pipeline(std::string_view line, Fn&& not_find_callback) const
+		{
+			using P = Result<Payload, std::string>;
+
+			OutputSink::Scope redirect(dispatch_output());
+			Payload value;
+			std::string unquoted;
+			for (size_t pos = 0;;)
+			{
+				const size_t bar = detail::find_pipe(line, pos);
+				const std::string_view stage = line.substr(pos, bar == std::string_view::npos ? bar : bar - pos);
+
+				const std::optional<std::string_view> first = detail::first_arg(stage, unquoted);
+				if (!first) return P::err("Empty pipeline stage");
+
+				const Command* cmd = find(*first);
+				if (!cmd)
+				{
+					std::invoke(not_find_callback);
+					return P::err(not_found(*first));
+				}
+
+				ParseContext& context = ParseContext::local();
+				ParseContext::Scope scope(context);
+				CommandArgsView args = cmd->parse_args(stage, context.resource());
+				P result = execute_stage(*cmd, args, std::move(value));
+				if (result.is_err() || bar == std::string_view::npos) return result;
+				value = std::move(result).unwrap();
+				pos = bar + 1;
+			}
+		}
+
+		template<typename Args>
+		Result<void*, std::string> execute(const Command& cmd, const Args& args) const
+		{
+			if (chain.empty()) return call(cmd, args);
+
+			ParseContext& local = ParseContext::local();
+			ParseContext::Scope scope(local);
+			CommandArgsView view = copy_view(args, local.resource());
+			return execute(cmd, view);
+		}
+
+		template<typename Args>
+		Result<void*, std::string> call(const Command& cmd, const Args& args) const
+		{
+			if (!cmd.is_idempotent()) return measured(cmd, [&]() { return cmd.invoke(args); });
+
+			const uint64_t key = args.hash();
+			if (std::optional<void*> hit = memo.find(cmd, args, key)) return Result<void*, std::string>::ok(*hit);
+			Result<void*, std::string> result = measured(cmd, [&]() { return cmd.invoke(args); });
+			if (result.is_ok()) memo.insert(cmd, args, key, result.unwrap());
+			return result;
+		}
+
+		static CommandArgsView copy_view(const CommandArgs& args, std::pmr::memory_resource* resource) { return args.view(resource); }
+		static CommandArgsView copy_view(const CommandArgsView& args, std::pmr::memory_resource* resource) { return CommandArgsView(args, resource); }
+
+		// Async commands leave the chain when they complete, with the args as rewritten on entry.
+		void execute_async(const Command& cmd, const CommandArgs& args, EventLoop& loop, Command::Completion done) const
+		{
+			ParseContext& local = ParseContext::local();
+			ParseContext::Scope scope(local);
+			CommandArgsView view = args.view(local.resource());
+
+			std::optional<Result<void*, std::string>> shortcut;
+			const size_t entered = chain.enter(cmd, view, shortcut);
+			if (shortcut)
+			{
+				chain.leave(entered, cmd, view, *shortcut);
+				done(std::move(*shortcut));
+				return;
+			}
+
+			auto rewritten = std::make_shared<const CommandArgs>(view.to_owned());
+			cmd.invoke_async(*rewritten, loop, measured_completion(cmd, [this, &cmd, entered, rewritten, done = std::move(done)](Result<void*, std::string> result)
+				{
+					ParseContext& local = ParseContext::local();
+					ParseContext::Scope scope(local);
+					chain.leave(entered, cmd, rewritten->view(local.resource()), result);
+					done(std::move(result));
+				}));
+		}
+
+		template<typename Args, typename Fn>
+		Result<void*, std::string> dispatch(Args& command, Fn&& not_find_callback) const
+		{
+			const Command* cmd = command.get_positional().empty() ? nullptr : find(command[0]);
+			if (cmd)
+			{
+				OutputSink::Scope redirect(dispatch_output());
+				return execute(*cmd, command);
+			}
+
+			std::invoke(std::forward<Fn>(not_find_callback));
+			return Result<void*, std::string>::err("Not find command!");
+		}
+
+		Command& insert(const std::string& name, Command cmd)
+		{
+			// The replacement takes over the old command's address, so its results must go.
+			if (const Command* old = command_table.find(name)) memo.invalidate(*old);
+			else command_names.add(name);
+			return command_table.insert_or_assign(name, std::move(cmd));
+		}
+
+		// Like dispatch, this is not synchronized: lookups from several threads at once must not
+		// race on a command that is still a placeholder.
+		const Command* materialize(const Command& stub) const
+		{
+			auto entry = lazy.find(&stub);
+			if (entry == lazy.end() || entry->second.built) return &stub;
+
+			LazyCommand& lazy_command = entry->second;
+			Command cmd = lazy_command.factory();
+			cmd.get_name(stub.get_name());
+			if (cmd.get_description().empty()) cmd.get_description(stub.get_description());
+			*lazy_command.slot = std::move(cmd);
+			lazy_command.built = true;
+			return lazy_command.slot;
+		}
+
+		std::string not_found(std::string_view name) const
+		{
+			std::string message = "Not find command: " + std::string(name);
+			if (auto near = command_names.suggest(name, 1); !near.empty()) message += ", did you mean " + near.front().name + "?";
+			return message;
+		}
+
+		// Lines are dispatched on their first token, which is all that is lexed to find the command.
+		const Command* find_first_token(std::string_view line) const
+		{
+			std::string unquoted;
+			const std::optional<std::string_view> first = detail::first_arg(line, unquoted);
+			return first ? find(*first) : nullptr;
+		}
+
+		template<typename FindFn, typename RunFn>
+		std::vector<Result<void*, std::string>> run_batch(size_t count, FindFn&& find_command, RunFn&& run) const
+		{
+			using R = Result<void*, std::string>;
+
+			std::vector<const Command*> targets(count);
+			std::vector<size_t> parallel, serial;
+			for (size_t idx = 0; idx < count; ++idx)
+			{
+				targets[idx] = find_command(idx);
+				if (targets[idx]) (targets[idx]->is_parallel_safe() ? parallel : serial).push_back(idx);
+			}
+
+			std::vector<std::optional<R>> slots(count);
+			auto execute = [&](size_t idx)
+				{
+					try { slots[idx].emplace(measured(*targets[idx], [&]() { return run(*targets[idx], idx); })); }
+					catch (const std::exception& e) { slots[idx].emplace(R::err(e.what())); }
+					catch (...) { slots[idx].emplace(R::err("Unknown exception")); }
+				};
+
+			OutputSink& sink = dispatch_output();
+			WorkStealingPool& workers = *get_thread_pool();
+			WorkStealingPool::TaskGroup group;
+			const size_t chunk = std::max<size_t>(1, parallel.size() / (workers.size() * 4));
+			for (size_t begin = 0; begin < parallel.size(); begin += chunk)
+			{
+				const size_t end = std::min(parallel.size(), begin + chunk);
+				workers.submit(group, [&, begin, end]() { OutputSink::Scope redirect(sink); for (size_t pos = begin; pos < end; ++pos) execute(parallel[pos]); });
+			}
+			workers.wait(group);
+
+			if (!serial.empty())
+			{
+				OutputSink::Scope redirect(sink);
+				for (size_t idx : serial) execute(idx);
+			}
+			sink.flush();
+
+			std::vector<R> results;
+			results.reserve(count);
+			for (auto& slot : slots) results.push_back(slot ? std::move(*slot) : R::err("Not find command!"));
+			return results;
+		}
+
+	private:
+		struct LazyCommand
+		{
+			Command* slot;
+			CommandFactory factory;
+			bool built;
+		};
+
+		// Keyed by the placeholder's slot in the table. Declared before the table so that
+		// factories, and the plugin libraries they hold, outlive the commands they built.
+		mutable std::unordered_map<const Command*, LazyCommand> lazy;
+		RadixTree<Command> command_table;
+		NameIndex command_names;
+		bool abbreviation = false;
+		MiddlewareChain<Middleware...> chain;
+		mutable MemoCache memo;
+#if CMDKIT_ENABLE_METRICS
+		bool metrics_enabled = true;
+#endif
+		mutable std::shared_ptr<WorkStealingPool> pool;
+		mutable std::shared_ptr<EventLoop> event_loop;
+		std::shared_ptr<OutputSink> output;
+		std::shared_ptr<CommandHistory> history;
+	};
+
+	using Terminal = BasicTerminal<>;
+}
+
+// server.hpp
+// epoll is Linux-only; elsewhere TerminalServer is not available.
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace cmdkit
+{
+	struct ServerLimits
+	{
+		// A request line longer than this closes its connection.
+		size_t max_line = 64 * 1024;
+		// A connection stops being read once this much output is queued for it, and resumes
+		// when the queue drains below low_watermark.
+		size_t high_watermark = 1 << 20;
+		size_t low_watermark = 64 * 1024;
+		// Clients accepted beyond this are closed at once.
+		size_t max_connections = 4096;
+	};
+
+	struct ServerStats
+	{
+		uint64_t accepted = 0;
+		uint64_t closed = 0;
+		uint64_t requests = 0;
+		uint64_t errors = 0;
+		uint64_t paused = 0;
+		size_t connections = 0;
+	};
+
+	// Serves a terminal to stdin and to any number of Unix-domain socket clients from one
+	// epoll loop. Each request is a line; its reply is whatever the handler wrote to
+	// OutputSink::current() followed by a status line, `ok` or `err <message>`. Blank lines get
+	// no reply. Clients may pipeline requests: lines are run in order as they arrive and the
+	// replies queue in a per-connection buffer. A client whose queue passes the high watermark
+	// is not read from until it drains, so a slow reader cannot grow the server's memory.
+	// Commands run on the loop thread, one at a time. TerminalT is a BasicTerminal.
+	template<typename TerminalT>
+	class TerminalServer
+	{
+	public:
+		explicit TerminalServer(const TerminalT& terminal, ServerLimits limits = {}) : terminal(terminal), limits(limits) {}
+
+		~TerminalServer()
+		{
+			for (auto& [fd, conn] : connections) close_connection(*conn);
+			if (listener >= 0) { ::close(listener); ::unlink(socket_path.c_str()); }
+			if (wakeup >= 0) ::close(wakeup);
+			if (poller >= 0) ::close(poller);
+		}
+
+		TerminalServer(const TerminalServer&) = delete;
+		TerminalServer& operator=(const TerminalServer&) = delete;
+
+	public:
+		// Listens on a Unix-domain socket at path, replacing a stale socket file.
+		Result<void, std::string> listen(const std::string& path)
+		{
+			using R = Result<void, std::string>;
+			if (auto ready = init(); ready.is_err()) return ready;
+			if (listener >= 0) return R::err("Server is already listening on " + socket_path);
+
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			if (path.size() >= sizeof(address.sun_path)) return R::err("Socket path too long: " + path);
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+			const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0) return R::err("Can't create socket: " + std::string(std::strerror(errno)));
+
+			::unlink(path.c_str());
+			if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0)
+			{
+				const int error = errno;
+				::close(fd);
+				return R::err("Can't listen on " + path + ": " + std::strerror(error));
+			}
+			if (!watch(fd, EPOLLIN))
+			{
+				::close(fd);
+				return R::err("Can't poll socket: " + std::string(std::strerror(errno)));
+			}
+
+			listener = fd;
+			socket_path = path;
+			return R::ok();
+		}
+
+		// Reads requests from fd 0 and writes replies to fd 1. Replies to stdin are written
+		// with blocking writes; stdin must be pollable (a terminal or a pipe, not a file).
+		Result<void, std::string> serve_stdin()
+		{
+			using R = Result<void, std::string>;
+			if (auto ready = init(); ready.is_err()) return ready;
+			if (connections.count(0)) return R::err("Server already reads stdin");
+			if (!watch(0, EPOLLIN)) return R::err("Can't poll stdin: " + std::string(std::strerror(errno)));
+			add_connection(0, 1);
+			return R::ok();
+		}
+
+		// Serves until stop() is called, or until stdin closes when there is no listener.
+		Result<void, std::string> run()
+		{
+			using R = Result<void, std::string>;
+			if (auto ready = init(); ready.is_err()) return ready;
+
+			epoll_event events[64];
+			while (!stopping && (listener >= 0 || !connections.empty()))
+			{
+				const int count = ::epoll_wait(poller, events, 64, -1);
+				if (count < 0)
+				{
+					if (errno == EINTR) continue;
+					return R::err("epoll_wait failed: " + std::string(std::strerror(errno)));
+				}
+
+				for (int idx = 0; idx < count; ++idx)
+				{
+					const int fd = events[idx].data.fd;
+					if (fd == wakeup) { drain_wakeup(); continue; }
+					if (fd == listener) { accept_clients(); continue; }
+
+					auto it = connections.find(fd);
+					if (it == connections.end()) continue;
+					Connection& conn = *it->second;
+					if (events[idx].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) send(conn);
+					if (!conn.closed && (events[idx].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !conn.paused) receive(conn);
+					if (conn.closed) erase(fd);
+				}
+			}
+			stopping = false;
+			return R::ok();
+		}
+
+		// Makes run() return after the current event; safe from any thread and from handlers.
+		void stop()
+		{
+			stopping = true;
+			if (wakeup >= 0)
+			{
+				const uint64_t one = 1;
+				[[maybe_unused]] const ssize_t written = ::write(wakeup, &one, sizeof(one));
+			}
+		}
+
+		ServerStats stats() const
+		{
+			ServerStats result = counters;
+			result.connections = connections.size();
+			return result;
+		}
+
+		const std::string& get_socket_path() const { return socket_path; }
+
+	private:
+		struct Connection
+		{
+			int in_fd;
+			int out_fd;
+			std::string input;
+			std::string output;
+			size_t sent = 0;
+			bool eof = false;
+			bool paused = false;
+			bool closed = false;
+			uint32_t interest = EPOLLIN;
+			// Handler output and status lines land in output through this sink.
+			std::unique_ptr<OutputSink> sink;
+
+			size_t queued() const { return output.size() - sent; }
+		};
+
+		Result<void, std::string> init()
+		{
+			if (poller >= 0) return Result<void, std::string>::ok();
+			poller = ::epoll_create1(EPOLL_CLOEXEC);
+			if (poller < 0) return Result<void, std::string>::err("Can't create epoll: " + std::string(std::strerror(errno)));
+			wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (wakeup < 0 || !watch(wakeup, EPOLLIN)) return Result<void, std::string>::err("Can't create eventfd: " + std::string(std::strerror(errno)));
+			return Result<void, std::string>::ok();
+		}
+
+		bool watch(int fd, uint32_t events)
+		{
+			epoll_event event{};
+			event.events = events;
+			event.data.fd = fd;
+			return ::epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) == 0;
+		}
+
+		void drain_wakeup()
+		{
+			uint64_t count;
+			while (::read(wakeup, &count, sizeof(count)) > 0) {}
+		}
+
+		Connection& add_connection(int in_fd, int out_fd)
+		{
+			auto conn = std::make_unique<Connection>();
+			conn->in_fd = in_fd;
+			conn->out_fd = out_fd;
+			Connection* raw = conn.get();
+			conn->sink = std::make_unique<OutputSink>(OutputSink::Target([raw](const std::string_view* parts, size_t count)
+				{
+					for (size_t idx = 0; idx < count; ++idx) raw->output.append(parts[idx]);
+					return Result<void, std::string>::ok();
+				}), FlushPolicy{ 16 * 1024, {} });
+			return *connections.emplace(in_fd, std::move(conn)).first->second;
+		}
+
+		void accept_clients()
+		{
+			while (true)
+			{
+				const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+				if (fd < 0)
+				{
+					if (errno == EINTR || errno == ECONNABORTED) continue;
+					return;
+				}
+				counters.accepted++;
+				if (connections.size() >= limits.max_connections || !watch(fd, EPOLLIN))
+				{
+					::close(fd);
+					counters.closed++;
+					continue;
+				}
+				add_connection(fd, fd);
+			}
+		}
+
+		// Reads one chunk per event so that busy clients take turns, then runs every complete
+		// line it finished.
+		void receive(Connection& conn)
+		{
+			char chunk[64 * 1024];
+			const ssize_t size = ::read(conn.in_fd, chunk, sizeof(chunk));
+			if (size < 0 && (errno == EAGAIN || errno == EINTR)) return;
+			if (size <= 0) conn.eof = true;
+			else conn.input.append(chunk, size_t(size));
+			process(conn);
+		}
+
+		// Runs complete lines until the output queue reaches the high watermark, and keeps going
+		// for as long as the socket drains it below the low one.
+		void process(Connection& conn)
+		{
+			while (!conn.closed)
+			{
+				run_lines(conn);
+				if (conn.closed || !transmit(conn)) return;
+				if (!conn.paused || conn.queued() >= limits.low_watermark) break;
+				conn.paused = false;
+			}
+			settle(conn);
+		}
+
+		void run_lines(Connection& conn)
+		{
+			size_t consumed = 0;
+			while (true)
+			{
+				if (conn.queued() >= limits.high_watermark)
+				{
+					conn.paused = true;
+					counters.paused++;
+					break;
+				}
+
+				const size_t newline = conn.input.find('\n', consumed);
+				if (newline == std::string::npos)
+				{
+					if (conn.input.size() - consumed > limits.max_line) { close_connection(conn); return; }
+					if (conn.eof && consumed < conn.input.size()) { handle(conn, std::string_view(conn.input).substr(consumed)); consumed = conn.input.size(); }
+					break;
+				}
+
+				std::string_view line = std::string_view(conn.input).substr(consumed, newline - consumed);
+				if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+				handle(conn, line);
+				consumed = newline + 1;
+				conn.sink->flush();
+			}
+			conn.input.erase(0, consumed);
+			conn.sink->flush();
+		}
+
+		void handle(Connection& conn, std::string_view line)
+		{
+			using R = Result<void*, std::string>;
+			if (line.find_first_not_of(" \t\r\n\v\f") == std::string_view::npos) return;
+			counters.requests++;
+
+			OutputSink::Scope redirect(*conn.sink);
+			R result = R::ok(nullptr);
+			try
+			{
+				if (detail::find_pipe(line) != std::string_view::npos)
+				{
+					auto piped = terminal.pipe(line);
+					if (piped.is_err()) result = R::err(std::move(piped).unwrap_err());
+				}
+				else
+				{
+					ParseContext& context = ParseContext::local();
+					ParseContext::Scope scope(context);
+					result = terminal.invoke(context.parse(line), []() {});
+				}
+			}
+			catch (const std::exception& e) { result = R::err(e.what()); }
+			catch (...) { result = R::err("Unknown exception"); }
+
+			if (result.is_ok()) { conn.sink->write("ok\n"); return; }
+
+			counters.errors++;
+			std::string message = std::move(result).unwrap_err();
+			for (char& ch : message) if (ch == '\n' || ch == '\r') ch = ' ';
+			*conn.sink << "err " << message << '\n';
+		}
+
+		// Called when the socket is writable again.
+		void send(Connection& conn)
+		{
+			if (conn.closed || !transmit(conn)) return;
+			if (conn.paused && conn.queued() < limits.low_watermark)
+			{
+				conn.paused = false;
+				process(conn);
+				return;
+			}
+			settle(conn);
+		}
+
+		// Writes queued output without blocking (stdin's stdout excepted). Returns false if the
+		// connection failed and was closed.
+		bool transmit(Connection& conn)
+		{
+			if (conn.in_fd == 0)
+			{
+				const std::string_view pending = std::string_view(conn.output).substr(conn.sent);
+				if (!pending.empty()) detail::write_fd(conn.out_fd, &pending, 1);
+				conn.sent = conn.output.size();
+			}
+			while (conn.queued() > 0)
+			{
+				const ssize_t written = ::send(conn.out_fd, conn.output.data() + conn.sent, conn.queued(), MSG_NOSIGNAL);
+				if (written < 0)
+				{
+					if (errno == EINTR) continue;
+					if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+					close_connection(conn);
+					return false;
+				}
+				conn.sent += size_t(written);
+			}
+
+			if (conn.queued() == 0) { conn.output.clear(); conn.sent = 0; }
+			else if (conn.sent >= limits.low_watermark) { conn.output.erase(0, conn.sent); conn.sent = 0; }
+			return true;
+		}
+
+		// Closes a connection whose client is done and fully answered; otherwise polls it for
+		// input unless paused, and for output while some is queued.
+		void settle(Connection& conn)
+		{
+			if (conn.eof && !conn.paused && conn.queued() == 0 && conn.input.empty()) { close_connection(conn); return; }
+			update_interest(conn);
+		}
+
+		void update_interest(Connection& conn)
+		{
+			if (conn.in_fd == 0) return;
+			const uint32_t wanted = (conn.paused || conn.eof ? 0u : uint32_t(EPOLLIN)) | (conn.queued() > 0 ? uint32_t(EPOLLOUT) : 0u);
+			if (wanted == conn.interest) return;
+
+			epoll_event event{};
+			event.events = wanted;
+			event.data.fd = conn.in_fd;
+			::epoll_ctl(poller, EPOLL_CTL_MOD, conn.in_fd, &event);
+			conn.interest = wanted;
+		}
+
+		// Marks the connection closed; run() erases it once its event is handled.
+		void close_connection(Connection& conn)
+		{
+			if (conn.closed) return;
+			conn.closed = true;
+			counters.closed++;
+			::epoll_ctl(poller, EPOLL_CTL_DEL, conn.in_fd, nullptr);
+			if (conn.in_fd != 0) ::close(conn.in_fd);
+		}
+
+		void erase(int fd) { connections.erase(fd); }
+
+	private:
+		const TerminalT& terminal;
+		ServerLimits limits;
+		int poller = -1;
+		int wakeup = -1;
+		int listener = -1;
+		std::string socket_path;
+		std::unordered_map<int, std::unique_ptr<Connection>> connections;
+		ServerStats counters;
+		std::atomic<bool> stopping{ false };
+	};
+}
+#endif
+
+// dispatcher.hpp
+namespace cmdkit
+{
+	struct DispatcherStats
+	{
+		uint64_t dispatched = 0;
+		uint64_t batches = 0;
+		// Times the dispatcher went to sleep on an empty queue.
+		uint64_t sleeps = 0;
+	};
+
+	// Lets any number of threads submit commands to one terminal without locking it: submissions
+	// go into a bounded lock-free ring and a dedicated thread drains it in batches, dispatching
+	// each entry in submission order and completing it with the command's result. A producer
+	// pays for a CAS on the ring's tail, a fence and, if the dispatcher is asleep, a notify.
+	// Entries are either pre-parsed CommandArgs or raw lines (which may be pipelines). Output
+	// is flushed after every batch. The terminal must not be invoked or changed from other
+	// threads while the dispatcher runs. TerminalT is a BasicTerminal.
+	//
+	// This is not a throughput win: every command still runs on the one dispatcher thread,
+	// which also pays for the hand-off. With commands as cheap as bench/submit_queue.cpp's,
+	// a mutex around Terminal::invoke completes about 1.5x as many lines per second, and 2-3x
+	// as many as CommandArgs submissions, which copy their arguments. Use it when producers
+	// must not wait while commands run.
+	template<typename TerminalT>
+	class TerminalDispatcher
+	{
+	public:
+		using R = Result<void*, std::string>;
+		// Runs on the dispatcher thread; it should hand the result off rather than block.
+		using Completion = InplaceFunction<void(R)>;
+
+		explicit TerminalDispatcher(const TerminalT& terminal, size_t capacity = 4096, size_t batch_size = 64)
+			: terminal(terminal), ring(capacity), batch_size(batch_size ? batch_size : 1)
+		{
+			worker = std::thread([this]() { dispatch_loop(); });
+		}
+
+		~TerminalDispatcher() { stop(); }
+
+		TerminalDispatcher(const TerminalDispatcher&) = delete;
+		TerminalDispatcher& operator=(const TerminalDispatcher&) = delete;
+
+	public:
+		// Waits for room when the queue is full. After stop(), done gets an error at once.
+		void submit(CommandArgs args, Completion done) { enqueue(Entry{ {}, std::make_unique<CommandArgs>(std::move(args)), std::move(done) }, true); }
+		void submit(std::string line, Completion done) { enqueue(Entry{ std::move(line), nullptr, std::move(done) }, true); }
+
+		std::future<R> submit(CommandArgs args) { return submit_future(Entry{ {}, std::make_unique<CommandArgs>(std::move(args)), nullptr }); }
+		std::future<R> submit(std::string line) { return submit_future(Entry{ std::move(line), nullptr, nullptr }); }
+
+		// Returns false and completes done with an error instead of waiting when the queue is full.
+		bool try_submit(CommandArgs args, Completion done) { return enqueue(Entry{ {}, std::make_unique<CommandArgs>(std::move(args)), std::move(done) }, false); }
+		bool try_submit(std::string line, Completion done) { return enqueue(Entry{ std::move(line), nullptr, std::move(done) }, false); }
+
+		// Runs what is already queued, then joins the dispatcher thread.
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				ring.close();
+			}
+			wake.notify_one();
+			if (worker.joinable()) worker.join();
+		}
+
+		DispatcherStats stats() const
+		{
+			DispatcherStats result;
+			result.dispatched = dispatched.load(std::memory_order_relaxed);
+			result.batches = batches.load(std::memory_order_relaxed);
+			result.sleeps = sleeps.load(std::memory_order_relaxed);
+			return result;
+		}
+
+		size_t capacity() const { return ring.capacity(); }
+
+	private:
+		// A line, or pre-parsed arguments kept out of line: CommandArgs would make every cell
+		// of the ring four times larger.
+		struct Entry
+		{
+			std::string line;
+			std::unique_ptr<CommandArgs> args;
+			Completion done;
+		};
+
+		std::future<R> submit_future(Entry entry)
+		{
+			std::promise<R> promise;
+			std::future<R> future = promise.get_future();
+			entry.done = [promise = std::move(promise)](R result) mutable { promise.set_value(std::move(result)); };
+			enqueue(std::move(entry), true);
+			return future;
+		}
+
+		// stop() closes the ring, so a push either lands before the dispatcher's final drain
+		// or fails here.
+		bool enqueue(Entry entry, bool wait)
+		{
+			while (!ring.try_push(entry))
+			{
+				if (!wait || ring.closed())
+				{
+					if (entry.done) entry.done(R::err(ring.closed() ? "Dispatcher is stopped" : "Dispatcher queue is full"));
+					return false;
+				}
+				std::this_thread::yield();
+			}
+
+			// Pairs with the fence in dispatch_loop: either the dispatcher sees the entry before
+			// sleeping, or we see it asleep and wake it.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleeping.load(std::memory_order_relaxed))
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				wake.notify_one();
+			}
+			return true;
+		}
+
+		void run(Entry&& entry) const
+		{
+			R result = R::err("Unknown exception");
+			try
+			{
+				if (entry.args) result = terminal.invoke(*entry.args, []() {});
+				else result = terminal.invoke(entry.line, []() {});
+			}
+			catch (const std::exception& e) { result = R::err(e.what()); }
+			catch (...) {}
+
+			if (!entry.done) return;
+			try { entry.done(std::move(result)); }
+			catch (...) {}
+		}
+
+		void dispatch_loop()
+		{
+			constexpr size_t spins = 64;
+			size_t idle = 0;
+			while (true)
+			{
+				const size_t count = ring.drain([this](Entry&& entry) { run(std::move(entry)); }, batch_size);
+				if (count)
+				{
+					dispatched.fetch_add(count, std::memory_order_relaxed);
+					batches.fetch_add(1, std::memory_order_relaxed);
+					if (ring.empty()) terminal.get_output().flush();
+					idle = 0;
+					continue;
+				}
+
+				if (ring.closed())
+				{
+					if (ring.drained()) break;
+					std::this_thread::yield();
+					continue;
+				}
+
+				if (++idle < spins) { std::this_thread::yield(); continue; }
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				sleeping.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (ring.empty() && !ring.closed())
+				{
+					sleeps.fetch_add(1, std::memory_order_relaxed);
+					wake.wait(lock, [this]() { return !ring.empty() || ring.closed(); });
+				}
+				sleeping.store(false, std::memory_order_relaxed);
+				idle = 0;
+			}
+			terminal.get_output().flush();
+		}
+
+	private:
+		const TerminalT& terminal;
+		MpscRing<Entry> ring;
+		size_t batch_size;
+
+		std::atomic<bool> sleeping{ false };
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+
+		std::atomic<uint64_t> dispatched{ 0 };
+		std::atomic<uint64_t> batches{ 0 };
+		std::atomic<uint64_t> sleeps{ 0 };
+
+		std::thread worker;
+	};
+}
+
+// static_terminal.hpp
+namespace cmdkit
+{
+	// A command whose name and handler are known at compile time. Handlers are plain function
+	// pointers, so captureless lambdas convert to them in constant expressions.
+	class StaticCommand
+	{
+	public:
+		using Handler = Result<void*, std::string>(*)(const CommandArgs&);
+		using ViewHandler = Result<void*, std::string>(*)(const CommandArgsView&);
+
+		constexpr StaticCommand(std::string_view name, Handler handler) : name(name), handler(handler) {}
+		constexpr StaticCommand(std::string_view name, std::string_view description, Handler handler) : name(name), description(description), handler(handler) {}
+		constexpr StaticCommand(std::string_view name, ViewHandler handler) : name(name), view_handler(handler) {}
+		constexpr StaticCommand(std::string_view name, std::string_view description, ViewHandler handler) : name(name), description(description), view_handler(handler) {}
+
+	public:
+		Result<void*, std::string> invoke(const CommandArgs& args) const { return handler ? handler(args) : view_handler(args.view()); }
+		Result<void*, std::string> invoke(const CommandArgsView& args) const { return view_handler ? view_handler(args) : handler(args.to_owned()); }
+
+	public:
+		constexpr std::string_view get_name() const { return name; }
+		constexpr std::string_view get_description() const { return description; }
+
+	private:
+		std::string_view name;
+		std::string_view description;
+		Handler handler = nullptr;
+		ViewHandler view_handler = nullptr;
+	};
+
+	namespace detail
+	{
+		constexpr size_t next_pow2(size_t val)
+		{
+			size_t result = 1;
+			while (result < val) result <<= 1;
+			return result;
+		}
+	}
+
+	// Hash-and-displace perfect hash over the command names, built during constant evaluation.
+	// A name hashes once: the high half picks a bucket, whose displacement remixes the same hash
+	// into a slot that no other name occupies. Lookup is then one hash and one compare.
+	template<size_t N>
+	class StaticCommandTable
+	{
+	public:
+		static constexpr size_t slot_count = detail::next_pow2(N * 2 > 0 ? N * 2 : 1);
+		static constexpr size_t bucket_count = N / 2 > 0 ? N / 2 : 1;
+		static constexpr uint32_t empty_slot = ~uint32_t(0);
+
+		constexpr explicit StaticCommandTable(const std::array<StaticCommand, N>& cmds) : commands(cmds)
+		{
+			std::array<uint64_t, N> hashes{};
+			std::array<size_t, bucket_count> bucket_sizes{};
+			size_t max_bucket = 0;
+
+			for (size_t idx = 0; idx < N; ++idx)
+			{
+				for (size_t other = 0; other < idx; ++other)
+					if (commands[other].get_name() == commands[idx].get_name()) throw std::logic_error("StaticCommandTable: duplicate command name");
+
+				hashes[idx] = detail::fnv1a(commands[idx].get_name());
+				size_t& bucket_size = bucket_sizes[bucket_of(hashes[idx])];
+				if (++bucket_size > max_bucket) max_bucket = bucket_size;
+			}
+
+			for (auto& slot : slots) slot = empty_slot;
+
+			// Largest buckets first, while the table is still sparse.
+			for (size_t size = max_bucket; size > 0; --size)
+				for (size_t bucket = 0; bucket < bucket_count; ++bucket)
+					if (bucket_sizes[bucket] == size) place(bucket, hashes);
+		}
+
+		constexpr const StaticCommand* find(std::string_view name) const
+		{
+			const uint64_t hash = detail::fnv1a(name);
+			const uint32_t idx = slots[slot_of(hash, displacements[bucket_of(hash)])];
+			return idx != empty_slot && commands[idx].get_name() == name ? &commands[idx] : nullptr;
+		}
+
+		constexpr size_t size() const { return N; }
+		constexpr const StaticCommand* begin() const { return commands.data(); }
+		constexpr const StaticCommand* end() const { return commands.data() + N; }
+
+	private:
+		static constexpr size_t bucket_of(uint64_t hash) { return size_t(hash >> 32) % bucket_count; }
+		static constexpr size_t slot_of(uint64_t hash, uint32_t displacement) { return size_t(detail::mix64(hash ^ (displacement * 0x9e3779b97f4a7c15ull))) & (slot_count - 1); }
+
+		constexpr void place(size_t bucket, const std::array<uint64_t, N>& hashes)
+		{
+			for (uint32_t displacement = 0; displacement < (1u << 20); ++displacement)
+			{
+				bool fits = true;
+				for (size_t idx = 0; idx < N && fits; ++idx)
+				{
+					if (bucket_of(hashes[idx]) != bucket) continue;
+					const size_t slot = slot_of(hashes[idx], displacement);
+					if (slots[slot] != empty_slot) fits = false;
+					else slots[slot] = uint32_t(idx);
+				}
+
+				if (fits) { displacements[bucket] = displacement; return; }
+
+				for (size_t idx = 0; idx < N; ++idx)
+					if (bucket_of(hashes[idx]) == bucket && slots[slot_of(hashes[idx], displacement)] == idx)
+						slots[slot_of(hashes[idx], displacement)] = empty_slot;
+			}
+			throw std::logic_error("StaticCommandTable: no perfect hash found");
+		}
+
+	private:
+		std::array<StaticCommand, N> commands;
+		std::array<uint32_t, bucket_count> displacements{};
+		std::array<uint32_t, slot_count> slots{};
+	};
+
+	template<typename... Cmds>
+	constexpr StaticCommandTable<sizeof...(Cmds)> make_static_commands(const Cmds&... cmds)
+	{
+		return StaticCommandTable<sizeof...(Cmds)>(std::array<StaticCommand, sizeof...(Cmds)>{ StaticCommand(cmds)... });
+	}
+
+	// Terminal over a command table fixed at compile time. Usage:
+	//   static constexpr auto commands = make_static_commands(StaticCommand("print", handler), ...);
+	//   StaticTerminal<commands> terminal;
+	template<const auto& Table>
+	class StaticTerminal
+	{
+	public:
+		Result<void*, std::string> invoke(const CommandArgs& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgsView& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgsView& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const std::string& command, Fn&& not_find_callback) const
+		{
+			ParseContext& context = ParseContext::local();
+			ParseContext::Scope scope(context);
+			return invoke(context.parse(command), not_find_callback);
+		}
+
+		Result<void*, std::string> invoke(const std::string& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+	public:
+		static constexpr const StaticCommand* find(std::string_view name) { return Table.find(name); }
+
+	private:
+		template<typename Args, typename Fn>
+		Result<void*, std::string> dispatch(const Args& command, Fn&& not_find_callback) const
+		{
+			const StaticCommand* cmd = command.get_positional().empty() ? nullptr : Table.find(command[0]);
+			if (cmd) return cmd->invoke(command);
+
+			std::invoke(std::forward<Fn>(not_find_callback));
+			return Result<void*, std::string>::err("Not find command!");
+		}
+	};
+}
+
+// concurrent_terminal.hpp
+namespace cmdkit
+{
+	namespace detail
+	{
+		// Epoch-based reclamation. A reader announces the global epoch in its own slot before
+		// loading a shared pointer and clears it afterwards; both are single stores, so readers
+		// never wait. A writer stamps each retired object with the epoch it was unpublished in
+		// and frees it once no slot still announces that epoch or an older one.
+		class EpochDomain
+		{
+		public:
+			struct alignas(64) Slot
+			{
+				std::atomic<uint64_t> epoch{ 0 };
+				std::atomic<bool> used{ false };
+				unsigned depth = 0;
+				Slot* next = nullptr;
+			};
+
+			class Guard
+			{
+			public:
+				explicit Guard(EpochDomain& domain) : slot(domain.local_slot())
+				{
+					if (slot->depth++ == 0) slot->epoch.store(domain.global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+				}
+				~Guard() { if (--slot->depth == 0) slot->epoch.store(0, std::memory_order_release); }
+
+				Guard(const Guard&) = delete;
+				Guard& operator=(const Guard&) = delete;
+
+			private:
+				Slot* slot;
+			};
+
+			static EpochDomain& instance() { static EpochDomain domain; return domain; }
+
+			~EpochDomain()
+			{
+				for (Slot* slot = head.load(); slot;) { Slot* next = slot->next; delete slot; slot = next; }
+			}
+
+		public:
+			// Called after the old object is no longer reachable; returns its retire epoch.
+			uint64_t advance() { return global_epoch.fetch_add(1, std::memory_order_seq_cst); }
+
+			// True once every reader that could have seen an object retired at `epoch` has left.
+			bool safe_to_free(uint64_t epoch) const
+			{
+				for (Slot* slot = head.load(std::memory_order_acquire); slot; slot = slot->next)
+				{
+					const uint64_t announced = slot->epoch.load(std::memory_order_seq_cst);
+					if (announced != 0 && announced <= epoch) return false;
+				}
+				return true;
+			}
+
+		private:
+			Slot* local_slot()
+			{
+				struct Holder
+				{
+					Slot* slot = nullptr;
+					~Holder() { if (slot) slot->used.store(false, std::memory_order_release); }
+				};
+				thread_local Holder holder;
+				if (!holder.slot) holder.slot = acquire_slot();
+				return holder.slot;
+			}
+
+			Slot* acquire_slot()
+			{
+				for (Slot* slot = head.load(std::memory_order_acquire); slot; slot = slot->next)
+				{
+					bool expected = false;
+					if (!slot->used.load(std::memory_order_relaxed) && slot->used.compare_exchange_strong(expected, true)) return slot;
+				}
+
+				Slot* slot = new Slot();
+				slot->used.store(true, std::memory_order_relaxed);
+				slot->next = head.load(std::memory_order_relaxed);
+				while (!head.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed));
+				return slot;
+			}
+
+		private:
+			std::atomic<uint64_t> global_epoch{ 1 };
+			std::atomic<Slot*> head{ nullptr };
+		};
+	}
+
+	// Terminal that can be invoked from any number of threads while commands are registered.
+	// Dispatch reads an immutable snapshot of the command table without locking; registration
+	// copies the table, publishes the copy with one atomic store and reclaims old snapshots
+	// once no reader can still hold them. Readers hold a snapshot only for the lookup.
+	class ConcurrentTerminal
+	{
+	public:
+		ConcurrentTerminal() : current(new Snapshot()) {}
+
+		~ConcurrentTerminal()
+		{
+			delete current.load();
+			for (auto& [snapshot, epoch] : retired) delete snapshot;
+		}
+
+		ConcurrentTerminal(const ConcurrentTerminal&) = delete;
+		ConcurrentTerminal& operator=(const ConcurrentTerminal&) = delete;
+
+	public:
+		void register_command(const std::string& name, Command cmd)
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+
+			Snapshot* next = new Snapshot(*current.load(std::memory_order_relaxed));
+			next->table.insert_or_assign(name, std::make_shared<const Command>(std::move(cmd)));
+			Snapshot* old = current.exchange(next, std::memory_order_seq_cst);
+
+			retired.emplace_back(old, domain.advance());
+			reclaim();
+		}
+
+		void register_command(Command cmd)
+		{
+			const std::string name = cmd.get_name();
+			register_command(name, std::move(cmd));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgs& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgsView& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgsView& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const std::string& command, Fn&& not_find_callback) const
+		{
+			std::string unquoted;
+			const std::optional<std::string_view> first = detail::first_arg(command, unquoted);
+			std::shared_ptr<const Command> cmd = first ? find(*first) : nullptr;
+			if (!cmd)
+			{
+				std::invoke(not_find_callback);
+				return Result<void*, std::string>::err("Not find command!");
+			}
+
+			ParseContext& context = ParseContext::local();
+			ParseContext::Scope scope(context);
+			return cmd->invoke(cmd->parse_args(command, context.resource()));
+		}
+
+		Result<void*, std::string> invoke(const std::string& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+	public:
+		std::shared_ptr<const Command> find(std::string_view name) const
+		{
+			detail::EpochDomain::Guard guard(domain);
+			const auto* cmd = current.load(std::memory_order_seq_cst)->table.find(name);
+			return cmd ? *cmd : nullptr;
+		}
+
+		std::vector<std::string> list_commands(std::string_view prefix = {}) const
+		{
+			detail::EpochDomain::Guard guard(domain);
+			std::vector<std::string> names;
+			current.load(std::memory_order_seq_cst)->table.for_each_prefix(prefix, [&names](std::string_view name, const auto&) { names.emplace_back(name); });
+			return names;
+		}
+
+		size_t size() const
+		{
+			detail::EpochDomain::Guard guard(domain);
+			return current.load(std::memory_order_seq_cst)->table.size();
+		}
+
+	private:
+		struct Snapshot
+		{
+			RadixTree<std::shared_ptr<const Command>> table;
+		};
+
+		template<typename Args, typename Fn>
+		Result<void*, std::string> dispatch(const Args& command, Fn&& not_find_callback) const
+		{
+			// The handler runs after the guard is released, holding its own reference to the
+			// command, so a slow handler doesn't keep retired snapshots from being reclaimed.
+			if (std::shared_ptr<const Command> cmd = command.get_positional().empty() ? nullptr : find(command[0])) return cmd->invoke(command);
+
+			std::invoke(std::forward<Fn>(not_find_callback));
+			return Result<void*, std::string>::err("Not find command!");
+		}
+
+		void reclaim()
+		{
+			size_t kept = 0;
+			for (auto& entry : retired)
+			{
+				if (domain.safe_to_free(entry.second)) delete entry.first;
+				else retired[kept++] = entry;
+			}
+			retired.resize(kept);
+		}
+
+	private:
+		detail::EpochDomain& domain = detail::EpochDomain::instance();
+		std::atomic<Snapshot*> current;
+		std::mutex writer_mutex;
+		std::vector<std::pair<Snapshot*, uint64_t>> retired;
+	};
+}
+
+// async.hpp
+// Coroutine handlers need C++20; the rest of cmdkit stays C++17.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace cmdkit
+{
+	// Lazily started coroutine producing a T. Awaiting it starts it and resumes the awaiter
+	// when it finishes.
+	template<typename T>
+	class Task
+	{
+	public:
+		struct promise_type
+		{
+			std::optional<T> value;
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+
+			Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+
+			auto final_suspend() noexcept
+			{
+				struct Awaiter
+				{
+					bool await_ready() noexcept { return false; }
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+					{
+						auto next = handle.promise().continuation;
+						return next ? next : std::noop_coroutine();
+					}
+					void await_resume() noexcept {}
+				};
+				return Awaiter{};
+			}
+
+			template<typename U>
+			void return_value(U&& val) { value.emplace(std::forward<U>(val)); }
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		Task& operator=(Task&& other) noexcept { if (this != &other) { reset(); handle = std::exchange(other.handle, nullptr); } return *this; }
+		~Task() { reset(); }
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+		{
+			handle.promise().continuation = awaiter;
+			return handle;
+		}
+		T await_resume()
+		{
+			if (handle.promise().error) std::rethrow_exception(handle.promise().error);
+			return std::move(*handle.promise().value);
+		}
+
+	private:
+		explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+		void reset() { if (handle) handle.destroy(); handle = nullptr; }
+
+	private:
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	namespace detail
+	{
+		// Eagerly started, self-destroying coroutine used to drive a Task to completion.
+		struct Detached
+		{
+			struct promise_type
+			{
+				Detached get_return_object() noexcept { return {}; }
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
+				void return_void() noexcept {}
+				void unhandled_exception() noexcept { std::terminate(); }
+			};
+		};
+
+		// An exception from done can't leave a detached coroutine, so it is rethrown from the
+		// loop's run() instead, as one from any other callback would be.
+		inline Detached drive(Task<Result<void*, std::string>> task, EventLoop& loop, Command::Completion done)
+		{
+			std::optional<Result<void*, std::string>> result;
+			try { result.emplace(co_await task); }
+			catch (const std::exception& e) { result.emplace(Result<void*, std::string>::err(e.what())); }
+			catch (...) { result.emplace(Result<void*, std::string>::err("Unknown exception")); }
+
+			try { done(std::move(*result)); }
+			catch (...) { loop.post([error = std::current_exception()]() { std::rethrow_exception(error); }); }
+		}
+	}
+
+	// Adapts `Task<Result<void*, std::string>>(CommandArgs, EventLoop&)` coroutines to Command::AsyncHandler.
+	template<typename Fn>
+	Command::AsyncHandler make_async_handler(Fn fn)
+	{
+		return [fn = std::move(fn)](CommandArgs args, EventLoop& loop, Command::Completion done)
+			{
+				detail::drive(fn(std::move(args), loop), loop, std::move(done));
+			};
+	}
+
+	// co_await sleep_for(loop, 10ms): resumes on the loop after the delay.
+	template<typename Rep, typename Period>
+	auto sleep_for(EventLoop& loop, std::chrono::duration<Rep, Period> delay)
+	{
+		struct Awaiter
+		{
+			EventLoop& loop;
+			std::chrono::duration<Rep, Period> delay;
+
+			bool await_ready() const noexcept { return delay.count() <= 0; }
+			void await_suspend(std::coroutine_handle<> handle) { loop.call_after(delay, [handle]() { handle.resume(); }); }
+			void await_resume() const noexcept {}
+		};
+		return Awaiter{ loop, delay };
+	}
+
+	// co_await yield(loop): lets other ready work run before continuing.
+	inline auto yield(EventLoop& loop)
+	{
+		struct Awaiter
+		{
+			EventLoop& loop;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { loop.post([handle]() { handle.resume(); }); }
+			void await_resume() const noexcept {}
+		};
+		return Awaiter{ loop };
+	}
+
+	// co_await offload(loop, fn): runs a blocking fn (disk, waitpid, ...) on its own thread and
+	// resumes on the loop with its result. The loop stays alive until the result is posted back.
+	// Pass a named callable: GCC 12 destroys capturing lambda temporaries in co_await operands twice.
+	template<typename Fn>
+	auto offload(EventLoop& loop, Fn fn)
+	{
+		using T = std::invoke_result_t<Fn&>;
+		static_assert(!std::is_void_v<T>, "offload: fn must return a value");
+
+		struct State
+		{
+			Fn fn;
+			std::optional<T> value;
+			std::exception_ptr error;
+		};
+
+		struct Awaiter
+		{
+			EventLoop& loop;
+			std::shared_ptr<State> state;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				loop.hold();
+				std::thread([loop = &loop, state = state, handle]()
+					{
+						try { state->value.emplace(state->fn()); }
+						catch (...) { state->error = std::current_exception(); }
+						loop->post([loop, handle]() { loop->release(); handle.resume(); });
+					}).detach();
+			}
+			T await_resume()
+			{
+				if (state->error) std::rethrow_exception(state->error);
+				return std::move(*state->value);
+			}
+		};
+		return Awaiter{ loop, std::make_shared<State>(State{ std::move(fn), std::nullopt, nullptr }) };
+	}
 }
+#endif
 
 #endif // INCLUDE_CMDKIT
\ No newline at end of file
@@ -1,60 +1,149 @@
 #ifndef INCLUDE_CMDKIT_COMMAND
 #define INCLUDE_CMDKIT_COMMAND
 
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <optional>
+#include <stdexcept>
+#include <memory>
+#include <memory_resource>
+#include <variant>
 
+#include "convert.hpp"
+#include "event_loop.hpp"
+#include "function.hpp"
+#include "grammar.hpp"
+#include "metrics.hpp"
+#include "payload.hpp"
 #include "result.hpp"
+#include "scanner.hpp"
+#include "suggest.hpp"
+#include "trie.hpp"
 
 namespace cmdkit
 {
+	namespace detail
+	{
+		inline std::string_view copy_text(std::string_view text, std::pmr::memory_resource* resource)
+		{
+			if (text.empty()) return text.substr(0, 0);
+			char* copy = static_cast<char*>(resource->allocate(text.size(), 1));
+			std::memcpy(copy, text.data(), text.size());
+			return std::string_view(copy, text.size());
+		}
+
+		constexpr uint64_t fnv1a(std::string_view str, uint64_t hash = 0xcbf29ce484222325ull)
+		{
+			for (char ch : str) hash = (hash ^ static_cast<unsigned char>(ch)) * 0x100000001b3ull;
+			return hash;
+		}
+
+		constexpr uint64_t mix64(uint64_t val)
+		{
+			val ^= val >> 33;
+			val *= 0xff51afd7ed558ccdull;
+			val ^= val >> 33;
+			val *= 0xc4ceb9fe1a85ec53ull;
+			val ^= val >> 33;
+			return val;
+		}
+
+		// Seeded per role, so the same text as a key, a value or a flag hashes apart.
+		inline uint64_t hash_text(std::string_view text, uint64_t seed)
+		{
+			return mix64(fnv1a(text, 0xcbf29ce484222325ull ^ mix64(seed + 1)) ^ text.size());
+		}
+
+		// Positional arguments hash in order; options and flags are summed so their order does
+		// not matter. The result depends only on the text, not on the process or the platform.
+		template<typename Args>
+		uint64_t canonical_hash(const Args& args)
+		{
+			uint64_t h = mix64(args.get_positional().size());
+			for (const auto& arg : args.get_positional()) h = mix64(h ^ hash_text(arg, 1));
+
+			uint64_t options = 0, flags = 0;
+			args.for_each_option([&options](std::string_view key, std::string_view val) { options += mix64(hash_text(key, 2) + 3 * hash_text(val, 3)); });
+			args.for_each_flag([&flags](std::string_view name) { flags += hash_text(name, 4); });
+			return mix64(h ^ mix64(options + 0x9e3779b97f4a7c15ull) ^ (mix64(flags + 0x632be59bd9b4e019ull) << 1));
+		}
+
+		template<typename A, typename B>
+		bool args_equal(const A& a, const B& b)
+		{
+			const auto& lhs = a.get_positional();
+			const auto& rhs = b.get_positional();
+			if (lhs.size() != rhs.size()) return false;
+			for (size_t idx = 0; idx < lhs.size(); ++idx) if (std::string_view(lhs[idx]) != std::string_view(rhs[idx])) return false;
+
+			bool same = true;
+			size_t count = 0;
+			a.for_each_option([&](std::string_view key, std::string_view val)
+				{
+					++count;
+					if (!same) return;
+					const std::optional<std::string_view> other = b.find_option(key);
+					same = other && *other == val;
+				});
+			b.for_each_option([&count](std::string_view, std::string_view) { --count; });
+			if (!same || count != 0) return false;
+
+			a.for_each_flag([&](std::string_view name) { ++count; same = same && b.has_flag(std::string(name)); });
+			b.for_each_flag([&count](std::string_view) { --count; });
+			return same && count == 0;
+		}
+	}
+
+	class CommandArgsView;
+	class ArgSchema;
+
 	class CommandArgs
 	{
 	private:
 		std::unordered_map<std::string, std::string> options;
 		std::unordered_set<std::string> flags;
 		std::vector<std::string> positional;
+		mutable detail::ConversionCache cache;
 
-	public:
-		static CommandArgs parse(const std::vector<std::string>& args)
+		template<typename Fn>
+		static CommandArgs parse_tokens(Fn&& for_each_token)
 		{
 			CommandArgs result;
 
-			for (size_t idx = 0; idx < args.size(); ++idx)
-			{
-				const auto& arg = args[idx];
-				if (args.size() > 2 && arg[0] == '-' && arg[1] == '-')
-				{
-					std::string key = arg.substr(2);
+			auto on_positional = [&result](std::string_view arg) { result.positional.emplace_back(arg); };
+			auto on_option = [&result](std::string_view key, std::string_view val) { result.options[std::string(key)] = std::string(val); };
+			auto on_flag = [&result](std::string_view key) { result.flags.emplace(key); };
 
-					if (idx == args.size() - 1 || (args[idx + 1].size() > 2 && args[idx + 1][0] == '-' && args[idx + 1][1] == '-'))
-						result.flags.insert(key);
-					else result.options[key] = args[++idx];
-				}
-				else result.positional.push_back(arg);
-			}
+			detail::ArgClassifier classifier(on_positional, on_option, on_flag);
+			for_each_token([&classifier](const detail::ArgToken& token) { classifier.push(token); });
+			classifier.finish();
 
 			return result;
 		}
 
-		static CommandArgs parse(const std::string& args_str)
+	public:
+		// Elements are taken as they are, like argv after the shell removed quotes.
+		static CommandArgs parse(const std::vector<std::string>& args)
 		{
-			std::vector<std::string> vec;
-			size_t pos = 0;
-			while (pos < args_str.size())
-			{
-				while (pos < args_str.size() && std::isspace(args_str[pos])) pos++;
-				if (pos >= args_str.size()) break;
-
-				size_t start = pos;
-				while (pos < args_str.size() && !std::isspace(args_str[pos])) pos++;
-				vec.emplace_back(args_str.substr(start, pos - start));
-			}
+			return parse_tokens([&args](auto&& push) { for (const auto& arg : args) push(detail::classify_arg(arg)); });
+		}
 
-			return parse(vec);
+		// Quotes and escapes are removed as a POSIX shell would (see ArgGrammar). An unterminated
+		// quote runs to the end of the line.
+		static CommandArgs parse(const std::string& args_str)
+		{
+			std::byte buffer[256];
+			std::pmr::monotonic_buffer_resource unquoted(buffer, sizeof(buffer));
+			return parse_tokens([&](auto&& push) { detail::lex_args(args_str, [&unquoted](std::string_view text) { return detail::copy_text(text, &unquoted); }, push); });
 		}
 
 		std::string get_option(const std::string& key, const std::string& default_val = "") const 
@@ -63,27 +152,629 @@ namespace cmdkit
 			return it != options.end() ? it->second : default_val;
 		}
 
+		// Converts the option in place (see convert.hpp) and caches the result per key and type.
+		// The cache makes concurrent get_option<T> calls on one shared CommandArgs unsafe.
+		template<typename T>
+		Result<T, ParseError> get_option(const std::string& key) const
+		{
+			return detail::get_option_as<T>(cache, key,
+				[this, &key](std::string_view& stored_key, std::string_view& text)
+				{
+					auto it = options.find(key);
+					if (it == options.end()) return false;
+					stored_key = it->first;
+					text = it->second;
+					return true;
+				});
+		}
+
 		bool has_flag(const std::string& name) const { return flags.count(name); }
 
+		std::optional<std::string_view> find_option(std::string_view key) const
+		{
+			auto it = options.find(std::string(key));
+			if (it == options.end()) return std::nullopt;
+			return std::string_view(it->second);
+		}
+
 		const std::vector<std::string>& get_positional() const { return positional; }
 
+		// Options as (key, value) and flags by name, in no particular order.
+		template<typename Fn>
+		void for_each_option(Fn&& fn) const { for (const auto& [k, v] : options) fn(std::string_view(k), std::string_view(v)); }
+
+		template<typename Fn>
+		void for_each_flag(Fn&& fn) const { for (const auto& flag : flags) fn(std::string_view(flag)); }
+
+		// Canonical hash and equality: positional arguments are ordered, options and flags are
+		// sets. Both agree with CommandArgsView's for the same arguments.
+		uint64_t hash() const { return detail::canonical_hash(*this); }
+
+		friend bool operator==(const CommandArgs& a, const CommandArgs& b) { return detail::args_equal(a, b); }
+		friend bool operator!=(const CommandArgs& a, const CommandArgs& b) { return !(a == b); }
+
+		CommandArgsView view(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
 	public:
 		std::string& operator[](size_t idx) { return positional[idx]; }
 		const std::string& operator[](size_t idx) const { return positional[idx]; }
+
+		friend class CommandArgsView;
+	};
+
+	// Declares a command's options, flags and positional arity. Each option or flag gets a slot,
+	// numbered in declaration order, and its key goes into a radix-tree table as it is declared.
+	// Parsing with a schema fills the slots in one pass: a declared option always takes the next
+	// token (or `--key=value`) as its value, and unknown keys, missing values, missing required
+	// options or a wrong argument count are reported before any handler runs. Single-letter
+	// names are also short options, GNU style: `-v`, `-xvf archive`, `-ofile`.
+	class ArgSchema
+	{
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		ArgSchema& option(const std::string& name, const std::string& description = "") { return declare(name, description, false, false); }
+		ArgSchema& required_option(const std::string& name, const std::string& description = "") { return declare(name, description, false, true); }
+		ArgSchema& flag(const std::string& name, const std::string& description = "") { return declare(name, description, true, false); }
+
+		// Bounds on the number of arguments after the command name.
+		ArgSchema& positional(size_t min_count, size_t max_count = npos)
+		{
+			if (min_count > max_count) throw std::logic_error("ArgSchema: positional minimum exceeds maximum");
+			min_positional = min_count;
+			max_positional = max_count;
+			return *this;
+		}
+
+	public:
+		size_t slot_of(std::string_view name) const
+		{
+			const uint32_t* slot = table.find(name);
+			return slot ? *slot : npos;
+		}
+
+		size_t slot_count() const { return entries.size(); }
+		const std::string& name_of(size_t slot) const { return entries[slot].name; }
+		const std::string& description_of(size_t slot) const { return entries[slot].description; }
+		bool is_flag(size_t slot) const { return entries[slot].flag; }
+		bool is_required(size_t slot) const { return entries[slot].required; }
+
+		size_t min_positional_count() const { return min_positional; }
+		size_t max_positional_count() const { return max_positional; }
+
+		// Declared option and flag names, without the dashes, for completion and suggestions.
+		const NameIndex& get_names() const { return names; }
+
+	public:
+		// The returned view borrows from line, which must outlive it.
+		Result<CommandArgsView, std::string> parse(std::string_view line, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+		// Re-classifies arguments parsed without this schema. A declared flag that was read as
+		// `--flag value` keeps its value as a trailing positional argument.
+		Result<CommandArgsView, std::string> bind(const CommandArgsView& args) const;
+
+	private:
+		struct Entry
+		{
+			std::string name;
+			std::string description;
+			bool flag = false;
+			bool required = false;
+		};
+
+		ArgSchema& declare(const std::string& name, const std::string& description, bool flag, bool required)
+		{
+			if (name.empty() || table.find(name)) throw std::logic_error("ArgSchema: duplicate or empty key --" + name);
+			table.insert_or_assign(name, uint32_t(entries.size()));
+			entries.push_back(Entry{ name, description, flag, required });
+			names.add(name);
+			return *this;
+		}
+
+		std::string unknown_option(std::string_view key) const
+		{
+			std::string message = "Unknown option --" + std::string(key);
+			if (auto near = names.suggest(key, 1); !near.empty()) message += ", did you mean --" + near.front().name + "?";
+			return message;
+		}
+
+		std::optional<std::string> validate(const CommandArgsView& args) const;
+
+	private:
+		std::vector<Entry> entries;
+		RadixTree<uint32_t> table;
+		NameIndex names;
+		size_t min_positional = 0;
+		size_t max_positional = npos;
 	};
 
+	class CommandArgsView
+	{
+	private:
+		std::pmr::vector<std::pair<std::string_view, std::string_view>> options;
+		std::pmr::vector<std::string_view> flags;
+		std::pmr::vector<std::string_view> positional;
+		std::pmr::vector<std::string_view> slots;
+		const ArgSchema* schema = nullptr;
+		std::string_view source;
+		mutable detail::ConversionCache cache;
+
+	public:
+		explicit CommandArgsView(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: options(resource), flags(resource), positional(resource), slots(resource) {}
+
+		// Copies other's tables into resource; the strings they point to are shared, not copied.
+		CommandArgsView(const CommandArgsView& other, std::pmr::memory_resource* resource)
+			: options(other.options, resource), flags(other.flags, resource), positional(other.positional, resource),
+			slots(other.slots, resource), schema(other.schema), source(other.source) {}
+
+		// The returned view borrows from args_str, which must outlive it.
+		static CommandArgsView parse(std::string_view args_str, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		{
+			CommandArgsView result(resource);
+			result.source = args_str;
+
+			auto on_positional = [&result](std::string_view arg) { result.positional.push_back(arg); };
+			auto on_option = [&result](std::string_view key, std::string_view val) { result.set_option(key, val); };
+			auto on_flag = [&result](std::string_view key) { result.set_flag(key); };
+
+			detail::ArgClassifier classifier(on_positional, on_option, on_flag);
+			detail::lex_args(args_str, [&result](std::string_view text) { return result.store(text); }, [&classifier](const detail::ArgToken& token) { classifier.push(token); });
+			classifier.finish();
+
+			return result;
+		}
+
+		std::string_view get_option(std::string_view key, std::string_view default_val = {}) const
+		{
+			std::string_view stored_key, val;
+			return find_option(key, stored_key, val) ? val : default_val;
+		}
+
+		template<typename T>
+		Result<T, ParseError> get_option(std::string_view key) const
+		{
+			return detail::get_option_as<T>(cache, key,
+				[this, key](std::string_view& stored_key, std::string_view& text) { return find_option(key, stored_key, text); });
+		}
+
+		bool has_flag(std::string_view name) const
+		{
+			if (schema)
+			{
+				const size_t slot = schema->slot_of(name);
+				return slot != ArgSchema::npos && schema->is_flag(slot) && has_slot(slot);
+			}
+			for (const auto& flag : flags) if (flag == name) return true;
+			return false;
+		}
+
+		// Slot access for views parsed with an ArgSchema; slots follow declaration order.
+		// An absent slot reads as an empty view, a present flag as an empty but non-null one.
+		std::string_view slot(size_t idx) const { return idx < slots.size() ? slots[idx] : std::string_view(); }
+		bool has_slot(size_t idx) const { return idx < slots.size() && slots[idx].data() != nullptr; }
+		const ArgSchema* get_schema() const { return schema; }
+
+		// The line this view was parsed from; empty for views built from a CommandArgs.
+		std::string_view get_source() const { return source; }
+
+		std::optional<std::string_view> find_option(std::string_view key) const
+		{
+			std::string_view stored_key, val;
+			if (!find_option(key, stored_key, val)) return std::nullopt;
+			return val;
+		}
+
+		const std::pmr::vector<std::string_view>& get_positional() const { return positional; }
+
+		// Options as (key, value) and flags by name, including those held in schema slots.
+		template<typename Fn>
+		void for_each_option(Fn&& fn) const
+		{
+			if (!schema) { for (const auto& [k, v] : options) fn(k, v); return; }
+			for (size_t idx = 0; idx < slots.size(); ++idx)
+				if (has_slot(idx) && !schema->is_flag(idx)) fn(std::string_view(schema->name_of(idx)), slots[idx]);
+		}
+
+		template<typename Fn>
+		void for_each_flag(Fn&& fn) const
+		{
+			if (!schema) { for (const auto& flag : flags) fn(flag); return; }
+			for (size_t idx = 0; idx < slots.size(); ++idx)
+				if (has_slot(idx) && schema->is_flag(idx)) fn(std::string_view(schema->name_of(idx)));
+		}
+
+		uint64_t hash() const { return detail::canonical_hash(*this); }
+
+		friend bool operator==(const CommandArgsView& a, const CommandArgsView& b) { return detail::args_equal(a, b); }
+		friend bool operator==(const CommandArgsView& a, const CommandArgs& b) { return detail::args_equal(a, b); }
+		friend bool operator==(const CommandArgs& a, const CommandArgsView& b) { return detail::args_equal(a, b); }
+		friend bool operator!=(const CommandArgsView& a, const CommandArgsView& b) { return !(a == b); }
+		friend bool operator!=(const CommandArgsView& a, const CommandArgs& b) { return !(a == b); }
+		friend bool operator!=(const CommandArgs& a, const CommandArgsView& b) { return !(a == b); }
+
+		CommandArgs to_owned() const
+		{
+			CommandArgs result;
+			result.positional.assign(positional.begin(), positional.end());
+			for (const auto& [k, v] : options) result.options.emplace(k, v);
+			for (const auto& flag : flags) result.flags.emplace(flag);
+			for (size_t idx = 0; schema && idx < slots.size(); ++idx)
+			{
+				if (!has_slot(idx)) continue;
+				if (schema->is_flag(idx)) result.flags.emplace(schema->name_of(idx));
+				else result.options.emplace(schema->name_of(idx), slots[idx]);
+			}
+			return result;
+		}
+
+		std::pmr::memory_resource* resource() const { return positional.get_allocator().resource(); }
+
+	public:
+		// Rewriting, used by middleware. The view stores string_views only, so new values must
+		// outlive it; store() copies text into the view's memory resource for that.
+		std::string_view store(std::string_view text) { return detail::copy_text(text, resource()); }
+
+		// On a view with a schema, the key must be a declared option or flag.
+		void set_option(std::string_view key, std::string_view val)
+		{
+			cache.clear();
+			if (schema)
+			{
+				slots[schema_slot(key, false)] = val.data() ? val : std::string_view("", 0);
+				return;
+			}
+			for (auto& [k, v] : options) if (k == key) { v = val; return; }
+			options.emplace_back(key, val);
+		}
+
+		void set_flag(std::string_view key)
+		{
+			if (schema)
+			{
+				const size_t slot = schema_slot(key, true);
+				slots[slot] = std::string_view(schema->name_of(slot)).substr(0, 0);
+				return;
+			}
+			if (!has_flag(key)) flags.push_back(key);
+		}
+
+		void set_positional(size_t idx, std::string_view val) { positional.at(idx) = val; }
+		void push_positional(std::string_view val) { positional.push_back(val); }
+
+	public:
+		std::string_view operator[](size_t idx) const { return positional[idx]; }
+
+	private:
+		size_t schema_slot(std::string_view key, bool flag) const
+		{
+			const size_t slot = schema->slot_of(key);
+			if (slot == ArgSchema::npos || schema->is_flag(slot) != flag)
+				throw std::invalid_argument("CommandArgsView: --" + std::string(key) + " is not a declared " + (flag ? "flag" : "option"));
+			return slot;
+		}
+
+		bool find_option(std::string_view key, std::string_view& stored_key, std::string_view& val) const
+		{
+			if (schema)
+			{
+				const size_t slot = schema->slot_of(key);
+				if (slot == ArgSchema::npos || schema->is_flag(slot) || !has_slot(slot)) return false;
+				stored_key = schema->name_of(slot);
+				val = slots[slot];
+				return true;
+			}
+			for (const auto& [k, v] : options) if (k == key) { stored_key = k; val = v; return true; }
+			return false;
+		}
+
+		friend class CommandArgs;
+		friend class ArgSchema;
+	};
+
+	inline Result<CommandArgsView, std::string> ArgSchema::parse(std::string_view line, std::pmr::memory_resource* resource) const
+	{
+		using R = Result<CommandArgsView, std::string>;
+
+		CommandArgsView result(resource);
+		result.schema = this;
+		result.source = line;
+		result.slots.resize(entries.size());
+
+		// A declared option takes the next token as its value, whatever it looks like. In a
+		// bundle, letters are flags up to the first option, which takes the rest of the bundle
+		// (after an optional '=') or else the next token.
+		size_t pending = npos;
+		bool terminated = false;
+		std::optional<std::string> error;
+		const bool closed = detail::lex_args(line, [&result](std::string_view text) { return result.store(text); }, [&](const detail::ArgToken& token)
+			{
+				if (error) return;
+				const std::string_view text = token.text;
+				if (pending != npos) { result.slots[pending] = text; pending = npos; return; }
+				if (terminated || token.shape == detail::ArgShape::word) { result.positional.push_back(text); return; }
+
+				switch (token.shape)
+				{
+				case detail::ArgShape::long_key:
+				case detail::ArgShape::long_value:
+				{
+					const bool has_value = token.shape == detail::ArgShape::long_value;
+					const std::string_view key = text.substr(2, has_value ? token.equals - 2 : std::string_view::npos);
+					const uint32_t* slot = table.find(key);
+					if (!slot) error = unknown_option(key);
+					else if (entries[*slot].flag)
+					{
+						if (has_value) error = "Flag --" + std::string(key) + " takes no value";
+						else result.slots[*slot] = text.substr(text.size());
+					}
+					else if (has_value) result.slots[*slot] = text.substr(token.equals + 1);
+					else pending = *slot;
+					break;
+				}
+				case detail::ArgShape::bundle:
+				case detail::ArgShape::bundle_value:
+					for (size_t idx = 1; idx < text.size(); ++idx)
+					{
+						const std::string_view key = text.substr(idx, 1);
+						const uint32_t* slot = key == "=" ? nullptr : table.find(key);
+						if (!slot) { error = key == "=" ? "Flag -" + std::string(text.substr(idx - 1, 1)) + " takes no value" : "Unknown option -" + std::string(key); break; }
+						if (entries[*slot].flag) { result.slots[*slot] = text.substr(text.size()); continue; }
+
+						std::string_view rest = text.substr(idx + 1);
+						if (!rest.empty() && rest[0] == '=') rest.remove_prefix(1);
+						if (idx + 1 < text.size()) result.slots[*slot] = rest;
+						else pending = *slot;
+						break;
+					}
+					break;
+				case detail::ArgShape::terminator: terminated = true; break;
+				case detail::ArgShape::word: break;
+				}
+			});
+
+		if (!error && !closed) error = "Unterminated quote";
+		if (!error && pending != npos) error = "Missing value for option --" + entries[pending].name;
+		if (!error) error = validate(result);
+		return error ? R::err(std::move(*error)) : R::ok(std::move(result));
+	}
+
+	inline Result<CommandArgsView, std::string> ArgSchema::bind(const CommandArgsView& args) const
+	{
+		using R = Result<CommandArgsView, std::string>;
+
+		CommandArgsView result(args.resource());
+		result.schema = this;
+		result.source = args.source;
+		result.slots.resize(entries.size());
+		result.positional.assign(args.positional.begin(), args.positional.end());
+
+		for (const auto& [key, val] : args.options)
+		{
+			const uint32_t* slot = table.find(key);
+			if (!slot) return R::err(unknown_option(key));
+			if (entries[*slot].flag)
+			{
+				result.slots[*slot] = key.substr(key.size());
+				result.positional.push_back(val);
+			}
+			else result.slots[*slot] = val;
+		}
+		for (const auto& key : args.flags)
+		{
+			const uint32_t* slot = table.find(key);
+			if (!slot) return R::err(unknown_option(key));
+			if (!entries[*slot].flag) return R::err("Missing value for option --" + std::string(key));
+			result.slots[*slot] = key.substr(key.size());
+		}
+
+		if (auto error = validate(result)) return R::err(std::move(*error));
+		return R::ok(std::move(result));
+	}
+
+	inline std::optional<std::string> ArgSchema::validate(const CommandArgsView& args) const
+	{
+		for (size_t idx = 0; idx < entries.size(); ++idx)
+			if (entries[idx].required && !args.has_slot(idx)) return "Missing option --" + entries[idx].name;
+
+		const size_t count = args.positional.empty() ? 0 : args.positional.size() - 1;
+		if (count < min_positional) return "Expected at least " + std::to_string(min_positional) + " argument(s), got " + std::to_string(count);
+		if (count > max_positional) return "Expected at most " + std::to_string(max_positional) + " argument(s), got " + std::to_string(count);
+		return std::nullopt;
+	}
+
+	inline CommandArgsView CommandArgs::view(std::pmr::memory_resource* resource) const
+	{
+		CommandArgsView result(resource);
+		result.positional.assign(positional.begin(), positional.end());
+		result.options.assign(options.begin(), options.end());
+		result.flags.assign(flags.begin(), flags.end());
+		return result;
+	}
+
+	// Owns a monotonic arena that CommandArgsView parses draw from. Views handed out by parse()
+	// stay valid until the outermost Scope ends, which rewinds the arena for the next line.
+	// If a line overflows the arena, the next reset grows it so steady-state parses stay in place,
+	// up to max_capacity; past that, a huge line borrows from the heap instead of pinning memory.
+	class ParseContext
+	{
+	public:
+		explicit ParseContext(size_t capacity = 4096) : buffer(capacity) { arena.emplace(buffer.data(), buffer.size(), &overflow); }
+		ParseContext(const ParseContext& other) : ParseContext(other.capacity()) {}
+		ParseContext& operator=(const ParseContext&) { return *this; }
+
+	public:
+		class Scope
+		{
+		public:
+			explicit Scope(ParseContext& context) : context(context) { context.depth++; }
+			~Scope() { if (--context.depth == 0) context.reset(); }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			ParseContext& context;
+		};
+
+		CommandArgsView parse(std::string_view args_str) { return CommandArgsView::parse(args_str, resource()); }
+
+		static constexpr size_t max_capacity = 64 << 10;
+
+		// A context per thread; terminals parse lines in it, so concurrent invokes don't share one.
+		static ParseContext& local() { thread_local ParseContext context; return context; }
+
+		std::pmr::memory_resource* resource() { return &*arena; }
+
+		void reset()
+		{
+			arena->release();
+			if (overflow.bytes == 0) return;
+
+			const size_t grown = std::min(2 * (buffer.size() + overflow.bytes), std::max(max_capacity, buffer.size()));
+			overflow.bytes = 0;
+			if (grown == buffer.size()) return;
+			buffer.resize(grown);
+			arena.emplace(buffer.data(), buffer.size(), &overflow);
+		}
+
+		size_t capacity() const { return buffer.size(); }
+
+	private:
+		class OverflowResource : public std::pmr::memory_resource
+		{
+		public:
+			size_t bytes = 0;
+
+		private:
+			void* do_allocate(size_t size, size_t align) override { bytes += size; return std::pmr::new_delete_resource()->allocate(size, align); }
+			void do_deallocate(void* ptr, size_t size, size_t align) override { std::pmr::new_delete_resource()->deallocate(ptr, size, align); }
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		};
+
+		std::vector<std::byte> buffer;
+		OverflowResource overflow;
+		std::optional<std::pmr::monotonic_buffer_resource> arena;
+		unsigned depth = 0;
+	};
+
+	// Commands own their handler in inline storage and are move-only; register them with std::move.
 	class Command
 	{
 	public:
-		using Handler = std::function<Result<void*, std::string>(const CommandArgs&)>;
+		using Handler = InplaceFunction<Result<void*, std::string>(const CommandArgs&)>;
+		using ViewHandler = InplaceFunction<Result<void*, std::string>(const CommandArgsView&)>;
+
+		// Async handlers own their arguments and report through the completion, possibly after
+		// yielding to the event loop; see async.hpp for coroutine handlers.
+		using Completion = std::function<void(Result<void*, std::string>)>;
+		using AsyncHandler = InplaceFunction<void(CommandArgs, EventLoop&, Completion)>;
+
+		// Pipeline stages receive the previous stage's value and produce the next one; see
+		// Terminal::pipe. Called on its own, a stage gets an empty input.
+		using PipeHandler = InplaceFunction<Result<Payload, std::string>(const CommandArgsView&, Payload&&)>;
 
 		Command() = default;
-		Command(const std::string& name, Handler handler) : name(name), description(""), handler(handler) {}
-		Command(const std::string& name, const std::string& description, Handler handler) : name(name), description(description), handler(handler) {}
+		Command(const std::string& name, Handler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, Handler handler) : name(name), description(description), handler(std::move(handler)) {}
+		Command(const std::string& name, ViewHandler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, ViewHandler handler) : name(name), description(description), handler(std::move(handler)) {}
+		Command(const std::string& name, AsyncHandler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, AsyncHandler handler) : name(name), description(description), handler(std::move(handler)) {}
+		Command(const std::string& name, PipeHandler handler) : name(name), description(""), handler(std::move(handler)) {}
+		Command(const std::string& name, const std::string& description, PipeHandler handler) : name(name), description(description), handler(std::move(handler)) {}
+
+		Command(Command&&) = default;
+		Command& operator=(Command&&) = default;
+		Command(const Command&) = delete;
+		Command& operator=(const Command&) = delete;
 
 	public:
-		Result<void*, std::string> invoke(const CommandArgs& args) const { return handler(args); }
-		Result<void*, std::string> invoke(const std::string& args_str) const { return handler(CommandArgs::parse(args_str)); }
+		Result<void*, std::string> invoke(const CommandArgs& args) const
+		{
+			if (schema) return invoke(args.view());
+			if (auto h = std::get_if<Handler>(&handler); h && *h) return (*h)(args);
+			if (auto h = std::get_if<ViewHandler>(&handler); h && *h) return (*h)(args.view());
+			if (auto h = std::get_if<PipeHandler>(&handler); h && *h) return invoke_handler(args.view());
+			return invoke_blocking(args);
+		}
+
+		// Arguments not yet parsed with this command's schema are re-parsed from their source
+		// line (or re-bound), and validation errors are returned without calling the handler.
+		Result<void*, std::string> invoke(const CommandArgsView& args) const
+		{
+			if (schema && args.get_schema() != schema.get())
+			{
+				auto bound = bind_schema(args);
+				if (bound.is_err()) return Result<void*, std::string>::err(std::move(bound).unwrap_err());
+				return invoke_handler(bound.unwrap());
+			}
+			return invoke_handler(args);
+		}
+
+		// Re-reads args parsed without this command's schema, from their source line when
+		// they have one. Requires a schema.
+		Result<CommandArgsView, std::string> bind_schema(const CommandArgsView& args) const
+		{
+			return args.get_source().data() ? schema->parse(args.get_source(), args.resource()) : schema->bind(args);
+		}
+
+		// Parses a line for this command in one pass; with a schema, straight into its slots.
+		// A line that fails validation gets the generic parse instead, so that middleware still
+		// sees the call, and invoking the command with it reports the error.
+		CommandArgsView parse_args(std::string_view line, std::pmr::memory_resource* resource) const
+		{
+			if (schema)
+				if (auto bound = schema->parse(line, resource); bound.is_ok()) return std::move(bound).unwrap();
+			return CommandArgsView::parse(line, resource);
+		}
+
+		Result<void*, std::string> invoke(const std::string& args_str) const
+		{
+			// Unquoted tokens are copied; the thread's arena holds them for the length of the call.
+			ParseContext& local = ParseContext::local();
+			ParseContext::Scope scope(local);
+			if (!schema) return invoke(CommandArgsView::parse(args_str, local.resource()));
+			auto args = schema->parse(args_str, local.resource());
+			if (args.is_err()) return Result<void*, std::string>::err(std::move(args).unwrap_err());
+			return invoke_handler(args.unwrap());
+		}
+
+		// Runs the command as a pipeline stage. Stages consume input; other commands ignore it,
+		// and their non-null pointer result is passed on as a void*.
+		Result<Payload, std::string> pipe(const CommandArgsView& args, Payload&& input) const
+		{
+			if (schema && args.get_schema() != schema.get())
+			{
+				auto bound = bind_schema(args);
+				if (bound.is_err()) return Result<Payload, std::string>::err(std::move(bound).unwrap_err());
+				return pipe_handler(bound.unwrap(), std::move(input));
+			}
+			return pipe_handler(args, std::move(input));
+		}
+
+		// Starts the command on the loop. Synchronous commands complete before this returns.
+		void invoke_async(CommandArgs args, EventLoop& loop, Completion done) const
+		{
+			if (!is_async()) { done(invoke(args)); return; }
+			if (schema)
+			{
+				auto bound = schema->bind(args.view());
+				if (bound.is_err()) { done(Result<void*, std::string>::err(std::move(bound).unwrap_err())); return; }
+				args = bound.unwrap().to_owned();
+			}
+			std::get<AsyncHandler>(handler)(std::move(args), loop, std::move(done));
+		}
+
+		bool is_async() const
+		{
+			auto h = std::get_if<AsyncHandler>(&handler);
+			return h && *h;
+		}
+
+		// False for a default-constructed command, such as the placeholder of a lazily
+		// registered one.
+		bool has_handler() const { return !std::holds_alternative<std::monostate>(handler); }
 
 	public:
 		const std::string& get_name() const { return name; }
@@ -92,10 +783,138 @@ namespace cmdkit
 		const std::string& get_description() const { return description; }
 		void get_description(const std::string& val) { description = val; }
 
+		// Parallel-safe commands may run concurrently with each other in Terminal::invoke_batch.
+		bool is_parallel_safe() const { return parallel_safe; }
+		void set_parallel_safe(bool val) { parallel_safe = val; }
+
+		// Idempotent commands are pure functions of their arguments; Terminal memoizes their
+		// successful results (see memo.hpp).
+		bool is_idempotent() const { return idempotent; }
+		void set_idempotent(bool val) { idempotent = val; }
+
+		// Declares the arguments this command accepts; see ArgSchema.
+		void set_schema(ArgSchema val) { schema = std::make_unique<const ArgSchema>(std::move(val)); }
+		const ArgSchema* get_schema() const { return schema.get(); }
+
+		// Call counts and latencies recorded by Terminal when CMDKIT_ENABLE_METRICS is set;
+		// null until the first recorded call.
+		const CommandMetrics* get_metrics() const
+		{
+#if CMDKIT_ENABLE_METRICS
+			return metrics.get();
+#else
+			return nullptr;
+#endif
+		}
+
+		void record_call([[maybe_unused]] uint64_t ns, [[maybe_unused]] bool ok) const
+		{
+#if CMDKIT_ENABLE_METRICS
+			metrics.get_or_create().record(ns, ok);
+#endif
+		}
+
+		void reset_metrics() const
+		{
+#if CMDKIT_ENABLE_METRICS
+			if (CommandMetrics* stats = metrics.get()) stats->reset();
+#endif
+		}
+
+	private:
+		Result<void*, std::string> invoke_handler(const CommandArgsView& args) const
+		{
+			if (auto h = std::get_if<ViewHandler>(&handler); h && *h) return (*h)(args);
+			if (auto h = std::get_if<Handler>(&handler); h && *h) return (*h)(args.to_owned());
+			if (auto h = std::get_if<PipeHandler>(&handler); h && *h)
+			{
+				auto result = (*h)(args, Payload());
+				if (result.is_err()) return Result<void*, std::string>::err(std::move(result).unwrap_err());
+				void* const* ptr = result.unwrap().get<void*>();
+				return Result<void*, std::string>::ok(ptr ? *ptr : nullptr);
+			}
+			return invoke_blocking(args.to_owned());
+		}
+
+		Result<Payload, std::string> pipe_handler(const CommandArgsView& args, Payload&& input) const
+		{
+			if (auto h = std::get_if<PipeHandler>(&handler); h && *h) return (*h)(args, std::move(input));
+
+			auto result = invoke_handler(args);
+			if (result.is_err()) return Result<Payload, std::string>::err(std::move(result).unwrap_err());
+			void* ptr = result.unwrap();
+			return Result<Payload, std::string>::ok(ptr ? Payload(ptr) : Payload());
+		}
+
+		// Called synchronously, an async command runs on a private loop until it completes.
+		Result<void*, std::string> invoke_blocking(CommandArgs args) const
+		{
+			if (!is_async()) return Result<void*, std::string>::err("Command has no handler");
+
+			EventLoop loop;
+			std::optional<Result<void*, std::string>> result;
+			std::get<AsyncHandler>(handler)(std::move(args), loop, [&result](Result<void*, std::string> val) { result.emplace(std::move(val)); });
+			loop.run();
+			return result ? std::move(*result) : Result<void*, std::string>::err("Async command did not complete");
+		}
+
 	private:
 		std::string name;
 		std::string description;
-		Handler handler;
+		// A command has exactly one kind of handler, so they share storage.
+		std::variant<std::monostate, Handler, ViewHandler, AsyncHandler, PipeHandler> handler;
+		std::unique_ptr<const ArgSchema> schema;
+#if CMDKIT_ENABLE_METRICS
+		detail::MetricsSlot metrics;
+#endif
+		bool parallel_safe = false;
+		bool idempotent = false;
+	};
+
+	// Builds a command when it is first needed; see Terminal::register_lazy_command.
+	using CommandFactory = InplaceFunction<Command()>;
+
+	// Adapts `Out(const CommandArgsView&, In)` to Command::PipeHandler. The input is taken as an
+	// In, and the stage fails if the previous one produced anything else; with In = void the
+	// stage is called without it. Out may be a plain value or a Result<Out, std::string>, and its
+	// value is moved on to the next stage.
+	template<typename In, typename Fn>
+	Command::PipeHandler make_stage(Fn fn)
+	{
+		return [fn = std::move(fn)](const CommandArgsView& args, Payload&& input) -> Result<Payload, std::string>
+			{
+				auto forward = [](auto&& out) -> Result<Payload, std::string>
+					{
+						using Out = std::decay_t<decltype(out)>;
+						if constexpr (!is_result<Out>::value) return Result<Payload, std::string>::ok(Payload(std::move(out)));
+						else if (out.is_err()) return Result<Payload, std::string>::err(std::move(out).unwrap_err());
+						else if constexpr (std::is_void_v<typename Out::OkType>) return Result<Payload, std::string>::ok(Payload());
+						else return Result<Payload, std::string>::ok(Payload(std::move(out).unwrap()));
+					};
+
+				if constexpr (std::is_void_v<In>) return forward(fn(args));
+				else
+				{
+					std::optional<In> value = input.take<In>();
+					if (!value) return Result<Payload, std::string>::err(input.has_value() ? "Pipeline stage got an unexpected payload type" : "Pipeline stage got an empty payload");
+					return forward(fn(args, std::move(*value)));
+				}
+			};
+	}
+}
+
+namespace std
+{
+	template<>
+	struct hash<cmdkit::CommandArgs>
+	{
+		size_t operator()(const cmdkit::CommandArgs& args) const { return size_t(args.hash()); }
+	};
+
+	template<>
+	struct hash<cmdkit::CommandArgsView>
+	{
+		size_t operator()(const cmdkit::CommandArgsView& args) const { return size_t(args.hash()); }
 	};
 }
 
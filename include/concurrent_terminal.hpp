@@ -0,0 +1,250 @@
+#ifndef INCLUDE_CMDKIT_CONCURRENT_TERMINAL
+#define INCLUDE_CMDKIT_CONCURRENT_TERMINAL
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "command.hpp"
+#include "trie.hpp"
+
+namespace cmdkit
+{
+	namespace detail
+	{
+		// Epoch-based reclamation. A reader announces the global epoch in its own slot before
+		// loading a shared pointer and clears it afterwards; both are single stores, so readers
+		// never wait. A writer stamps each retired object with the epoch it was unpublished in
+		// and frees it once no slot still announces that epoch or an older one.
+		class EpochDomain
+		{
+		public:
+			struct alignas(64) Slot
+			{
+				std::atomic<uint64_t> epoch{ 0 };
+				std::atomic<bool> used{ false };
+				unsigned depth = 0;
+				Slot* next = nullptr;
+			};
+
+			class Guard
+			{
+			public:
+				explicit Guard(EpochDomain& domain) : slot(domain.local_slot())
+				{
+					if (slot->depth++ == 0) slot->epoch.store(domain.global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+				}
+				~Guard() { if (--slot->depth == 0) slot->epoch.store(0, std::memory_order_release); }
+
+				Guard(const Guard&) = delete;
+				Guard& operator=(const Guard&) = delete;
+
+			private:
+				Slot* slot;
+			};
+
+			static EpochDomain& instance() { static EpochDomain domain; return domain; }
+
+			~EpochDomain()
+			{
+				for (Slot* slot = head.load(); slot;) { Slot* next = slot->next; delete slot; slot = next; }
+			}
+
+		public:
+			// Called after the old object is no longer reachable; returns its retire epoch.
+			uint64_t advance() { return global_epoch.fetch_add(1, std::memory_order_seq_cst); }
+
+			// True once every reader that could have seen an object retired at `epoch` has left.
+			bool safe_to_free(uint64_t epoch) const
+			{
+				for (Slot* slot = head.load(std::memory_order_acquire); slot; slot = slot->next)
+				{
+					const uint64_t announced = slot->epoch.load(std::memory_order_seq_cst);
+					if (announced != 0 && announced <= epoch) return false;
+				}
+				return true;
+			}
+
+		private:
+			Slot* local_slot()
+			{
+				struct Holder
+				{
+					Slot* slot = nullptr;
+					~Holder() { if (slot) slot->used.store(false, std::memory_order_release); }
+				};
+				thread_local Holder holder;
+				if (!holder.slot) holder.slot = acquire_slot();
+				return holder.slot;
+			}
+
+			Slot* acquire_slot()
+			{
+				for (Slot* slot = head.load(std::memory_order_acquire); slot; slot = slot->next)
+				{
+					bool expected = false;
+					if (!slot->used.load(std::memory_order_relaxed) && slot->used.compare_exchange_strong(expected, true)) return slot;
+				}
+
+				Slot* slot = new Slot();
+				slot->used.store(true, std::memory_order_relaxed);
+				slot->next = head.load(std::memory_order_relaxed);
+				while (!head.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed));
+				return slot;
+			}
+
+		private:
+			std::atomic<uint64_t> global_epoch{ 1 };
+			std::atomic<Slot*> head{ nullptr };
+		};
+	}
+
+	// Terminal that can be invoked from any number of threads while commands are registered.
+	// Dispatch reads an immutable snapshot of the command table without locking; registration
+	// copies the table, publishes the copy with one atomic store and reclaims old snapshots
+	// once no reader can still hold them. Readers hold a snapshot only for the lookup.
+	class ConcurrentTerminal
+	{
+	public:
+		ConcurrentTerminal() : current(new Snapshot()) {}
+
+		~ConcurrentTerminal()
+		{
+			delete current.load();
+			for (auto& [snapshot, epoch] : retired) delete snapshot;
+		}
+
+		ConcurrentTerminal(const ConcurrentTerminal&) = delete;
+		ConcurrentTerminal& operator=(const ConcurrentTerminal&) = delete;
+
+	public:
+		void register_command(const std::string& name, Command cmd)
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+
+			Snapshot* next = new Snapshot(*current.load(std::memory_order_relaxed));
+			next->table.insert_or_assign(name, std::make_shared<const Command>(std::move(cmd)));
+			Snapshot* old = current.exchange(next, std::memory_order_seq_cst);
+
+			retired.emplace_back(old, domain.advance());
+			reclaim();
+		}
+
+		void register_command(Command cmd)
+		{
+			const std::string name = cmd.get_name();
+			register_command(name, std::move(cmd));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgs& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgsView& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgsView& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const std::string& command, Fn&& not_find_callback) const
+		{
+			std::string unquoted;
+			const std::optional<std::string_view> first = detail::first_arg(command, unquoted);
+			std::shared_ptr<const Command> cmd = first ? find(*first) : nullptr;
+			if (!cmd)
+			{
+				std::invoke(not_find_callback);
+				return Result<void*, std::string>::err("Not find command!");
+			}
+
+			ParseContext& context = ParseContext::local();
+			ParseContext::Scope scope(context);
+			return cmd->invoke(cmd->parse_args(command, context.resource()));
+		}
+
+		Result<void*, std::string> invoke(const std::string& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+	public:
+		std::shared_ptr<const Command> find(std::string_view name) const
+		{
+			detail::EpochDomain::Guard guard(domain);
+			const auto* cmd = current.load(std::memory_order_seq_cst)->table.find(name);
+			return cmd ? *cmd : nullptr;
+		}
+
+		std::vector<std::string> list_commands(std::string_view prefix = {}) const
+		{
+			detail::EpochDomain::Guard guard(domain);
+			std::vector<std::string> names;
+			current.load(std::memory_order_seq_cst)->table.for_each_prefix(prefix, [&names](std::string_view name, const auto&) { names.emplace_back(name); });
+			return names;
+		}
+
+		size_t size() const
+		{
+			detail::EpochDomain::Guard guard(domain);
+			return current.load(std::memory_order_seq_cst)->table.size();
+		}
+
+	private:
+		struct Snapshot
+		{
+			RadixTree<std::shared_ptr<const Command>> table;
+		};
+
+		template<typename Args, typename Fn>
+		Result<void*, std::string> dispatch(const Args& command, Fn&& not_find_callback) const
+		{
+			// The handler runs after the guard is released, holding its own reference to the
+			// command, so a slow handler doesn't keep retired snapshots from being reclaimed.
+			if (std::shared_ptr<const Command> cmd = command.get_positional().empty() ? nullptr : find(command[0])) return cmd->invoke(command);
+
+			std::invoke(std::forward<Fn>(not_find_callback));
+			return Result<void*, std::string>::err("Not find command!");
+		}
+
+		void reclaim()
+		{
+			size_t kept = 0;
+			for (auto& entry : retired)
+			{
+				if (domain.safe_to_free(entry.second)) delete entry.first;
+				else retired[kept++] = entry;
+			}
+			retired.resize(kept);
+		}
+
+	private:
+		detail::EpochDomain& domain = detail::EpochDomain::instance();
+		std::atomic<Snapshot*> current;
+		std::mutex writer_mutex;
+		std::vector<std::pair<Snapshot*, uint64_t>> retired;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_CONCURRENT_TERMINAL
\ No newline at end of file
@@ -0,0 +1,284 @@
+#ifndef INCLUDE_CMDKIT_CONVERT
+#define INCLUDE_CMDKIT_CONVERT
+
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include "result.hpp"
+
+namespace cmdkit
+{
+	enum class ParseErrc { missing, invalid, out_of_range };
+
+	struct ParseError
+	{
+		ParseErrc code = ParseErrc::invalid;
+		std::string key;
+
+		std::string message() const
+		{
+			switch (code)
+			{
+			case ParseErrc::missing: return "Missing option --" + key;
+			case ParseErrc::out_of_range: return "Value out of range for option --" + key;
+			default: return "Invalid value for option --" + key;
+			}
+		}
+	};
+
+	// A byte count written as `512`, `64K`, `1.5MiB`, `2GB`... Suffixes are binary (K = 1024).
+	struct ByteSize
+	{
+		uint64_t bytes = 0;
+
+		friend constexpr bool operator==(ByteSize lhs, ByteSize rhs) { return lhs.bytes == rhs.bytes; }
+		friend constexpr bool operator!=(ByteSize lhs, ByteSize rhs) { return lhs.bytes != rhs.bytes; }
+	};
+
+	// Specialize with `static Result<T, ParseErrc> convert(std::string_view)` to read other types.
+	template<typename T, typename Enable = void>
+	struct OptionConverter;
+
+	template<typename T>
+	Result<T, ParseErrc> parse_value(std::string_view text) { return OptionConverter<T>::convert(text); }
+
+	namespace detail
+	{
+		inline ParseErrc to_parse_errc(std::errc ec) { return ec == std::errc::result_out_of_range ? ParseErrc::out_of_range : ParseErrc::invalid; }
+
+		// Parses a leading number and returns the unparsed suffix through `rest`.
+		inline std::errc parse_double(std::string_view text, double& val, std::string_view& rest)
+		{
+			if (!text.empty() && text[0] == '+') text.remove_prefix(1);
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+			auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), val);
+			if (ec != std::errc()) return ec;
+			rest = text.substr(size_t(ptr - text.data()));
+			return std::errc();
+#else
+			// No floating-point from_chars: strtod on a bounded, NUL-terminated copy.
+			char buffer[64];
+			if (text.empty() || text.size() >= sizeof(buffer) || std::isspace(static_cast<unsigned char>(text[0]))) return std::errc::invalid_argument;
+			std::memcpy(buffer, text.data(), text.size());
+			buffer[text.size()] = '\0';
+			char* end = nullptr;
+			errno = 0;
+			val = std::strtod(buffer, &end);
+			if (end == buffer) return std::errc::invalid_argument;
+			if (errno == ERANGE) return std::errc::result_out_of_range;
+			rest = text.substr(size_t(end - buffer));
+			return std::errc();
+#endif
+		}
+
+		inline bool iequals(std::string_view lhs, std::string_view rhs)
+		{
+			if (lhs.size() != rhs.size()) return false;
+			for (size_t idx = 0; idx < lhs.size(); ++idx)
+				if ((lhs[idx] | 0x20) != (rhs[idx] | 0x20)) return false;
+			return true;
+		}
+
+		template<typename T>
+		inline constexpr char type_tag = 0;
+
+		// A few converted values per args object, keyed by option name and requested type.
+		// Copies start empty: cached keys point into storage the copy does not share.
+		class ConversionCache
+		{
+		public:
+			static constexpr size_t slot_count = 4;
+			static constexpr size_t value_size = 24;
+
+			template<typename T>
+			static constexpr bool cacheable = std::is_trivially_copyable_v<Result<T, ParseErrc>>
+				&& sizeof(Result<T, ParseErrc>) <= value_size
+				&& alignof(Result<T, ParseErrc>) <= alignof(uint64_t);
+
+			ConversionCache() = default;
+			ConversionCache(const ConversionCache&) {}
+			ConversionCache& operator=(const ConversionCache&) { clear(); return *this; }
+
+			template<typename T>
+			const Result<T, ParseErrc>* find(std::string_view key) const
+			{
+				for (const auto& slot : slots)
+					if (slot.type == &type_tag<T> && slot.key == key) return std::launder(reinterpret_cast<const Result<T, ParseErrc>*>(slot.value));
+				return nullptr;
+			}
+
+			// `key` must stay valid as long as this cache does.
+			template<typename T>
+			void store(std::string_view key, const Result<T, ParseErrc>& val)
+			{
+				Slot& slot = slots[next++ % slot_count];
+				slot.type = &type_tag<T>;
+				slot.key = key;
+				::new (static_cast<void*>(slot.value)) Result<T, ParseErrc>(val);
+			}
+
+			void clear() { slots = {}; next = 0; }
+
+		private:
+			struct Slot
+			{
+				const void* type = nullptr;
+				std::string_view key;
+				alignas(uint64_t) unsigned char value[value_size];
+			};
+
+			std::array<Slot, slot_count> slots{};
+			unsigned next = 0;
+		};
+
+		// Looks `key` up through `find_value` (returning a pointer to a string_view-convertible value
+		// whose key outlives the cache, or nullptr) and converts it, consulting the cache first.
+		template<typename T, typename FindFn>
+		Result<T, ParseError> get_option_as(ConversionCache& cache, std::string_view key, FindFn&& find_value)
+		{
+			auto to_error = [key](ParseErrc code) { return Result<T, ParseError>::err(ParseError{ code, std::string(key) }); };
+			auto finish = [&](const Result<T, ParseErrc>& val) { return val.is_ok() ? Result<T, ParseError>::ok(val.unwrap()) : to_error(val.unwrap_err()); };
+
+			if constexpr (ConversionCache::cacheable<T>)
+				if (const auto* hit = cache.find<T>(key)) return finish(*hit);
+
+			std::string_view stored_key;
+			std::string_view text;
+			if (!find_value(stored_key, text)) return to_error(ParseErrc::missing);
+
+			Result<T, ParseErrc> val = parse_value<T>(text);
+			if constexpr (ConversionCache::cacheable<T>) cache.store<T>(stored_key, val);
+			return finish(val);
+		}
+	}
+
+	template<typename T>
+	struct OptionConverter<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+	{
+		static Result<T, ParseErrc> convert(std::string_view text)
+		{
+			if (!text.empty() && text[0] == '+') text.remove_prefix(1);
+			int base = 10;
+			if (text.size() > 2 && text[0] == '0' && (text[1] | 0x20) == 'x') { text.remove_prefix(2); base = 16; }
+
+			T val{};
+			auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), val, base);
+			if (ec != std::errc()) return Result<T, ParseErrc>::err(detail::to_parse_errc(ec));
+			if (ptr != text.data() + text.size()) return Result<T, ParseErrc>::err(ParseErrc::invalid);
+			return Result<T, ParseErrc>::ok(val);
+		}
+	};
+
+	template<typename T>
+	struct OptionConverter<T, std::enable_if_t<std::is_floating_point_v<T>>>
+	{
+		static Result<T, ParseErrc> convert(std::string_view text)
+		{
+			double val = 0;
+			std::string_view rest;
+			if (auto ec = detail::parse_double(text, val, rest); ec != std::errc()) return Result<T, ParseErrc>::err(detail::to_parse_errc(ec));
+			if (!rest.empty()) return Result<T, ParseErrc>::err(ParseErrc::invalid);
+			if (std::isfinite(val) && std::fabs(val) > double(std::numeric_limits<T>::max())) return Result<T, ParseErrc>::err(ParseErrc::out_of_range);
+			return Result<T, ParseErrc>::ok(static_cast<T>(val));
+		}
+	};
+
+	template<>
+	struct OptionConverter<bool>
+	{
+		static Result<bool, ParseErrc> convert(std::string_view text)
+		{
+			for (std::string_view word : { "true", "yes", "on", "1" }) if (detail::iequals(text, word)) return Result<bool, ParseErrc>::ok(true);
+			for (std::string_view word : { "false", "no", "off", "0" }) if (detail::iequals(text, word)) return Result<bool, ParseErrc>::ok(false);
+			return Result<bool, ParseErrc>::err(ParseErrc::invalid);
+		}
+	};
+
+	// `250ms`, `1.5s`, `2h`... A bare number counts in the target duration's own unit.
+	template<typename Rep, typename Period>
+	struct OptionConverter<std::chrono::duration<Rep, Period>>
+	{
+		using Duration = std::chrono::duration<Rep, Period>;
+
+		static Result<Duration, ParseErrc> convert(std::string_view text)
+		{
+			double count = 0;
+			std::string_view unit;
+			if (auto ec = detail::parse_double(text, count, unit); ec != std::errc()) return Result<Duration, ParseErrc>::err(detail::to_parse_errc(ec));
+
+			double seconds_per_unit = 0;
+			if (unit.empty()) seconds_per_unit = double(Period::num) / double(Period::den);
+			else if (unit == "ns") seconds_per_unit = 1e-9;
+			else if (unit == "us") seconds_per_unit = 1e-6;
+			else if (unit == "ms") seconds_per_unit = 1e-3;
+			else if (unit == "s") seconds_per_unit = 1;
+			else if (unit == "m" || unit == "min") seconds_per_unit = 60;
+			else if (unit == "h") seconds_per_unit = 3600;
+			else return Result<Duration, ParseErrc>::err(ParseErrc::invalid);
+
+			const double ticks = unit.empty() ? count : count * seconds_per_unit * double(Period::den) / double(Period::num);
+			if constexpr (std::is_integral_v<Rep>)
+			{
+				const double rounded = std::round(ticks);
+				if (!(rounded >= double(std::numeric_limits<Rep>::min()) && rounded < double(std::numeric_limits<Rep>::max())))
+					return Result<Duration, ParseErrc>::err(ParseErrc::out_of_range);
+				return Result<Duration, ParseErrc>::ok(Duration(static_cast<Rep>(rounded)));
+			}
+			else return Result<Duration, ParseErrc>::ok(Duration(static_cast<Rep>(ticks)));
+		}
+	};
+
+	template<>
+	struct OptionConverter<ByteSize>
+	{
+		static Result<ByteSize, ParseErrc> convert(std::string_view text)
+		{
+			double count = 0;
+			std::string_view unit;
+			if (auto ec = detail::parse_double(text, count, unit); ec != std::errc()) return Result<ByteSize, ParseErrc>::err(detail::to_parse_errc(ec));
+			if (count < 0) return Result<ByteSize, ParseErrc>::err(ParseErrc::invalid);
+
+			double multiplier = 1;
+			if (!unit.empty() && !detail::iequals(unit, "b"))
+			{
+				static constexpr std::string_view prefixes = "kmgt";
+				const size_t power = prefixes.find(char(unit[0] | 0x20));
+				const std::string_view tail = unit.substr(1);
+				if (power == std::string_view::npos || !(tail.empty() || detail::iequals(tail, "b") || detail::iequals(tail, "ib")))
+					return Result<ByteSize, ParseErrc>::err(ParseErrc::invalid);
+				multiplier = std::ldexp(1.0, int(10 * (power + 1)));
+			}
+
+			const double bytes = std::round(count * multiplier);
+			if (!(bytes < 18446744073709551616.0)) return Result<ByteSize, ParseErrc>::err(ParseErrc::out_of_range);
+			return Result<ByteSize, ParseErrc>::ok(ByteSize{ static_cast<uint64_t>(bytes) });
+		}
+	};
+
+	template<>
+	struct OptionConverter<std::string_view>
+	{
+		static Result<std::string_view, ParseErrc> convert(std::string_view text) { return Result<std::string_view, ParseErrc>::ok(text); }
+	};
+
+	template<>
+	struct OptionConverter<std::string>
+	{
+		static Result<std::string, ParseErrc> convert(std::string_view text) { return Result<std::string, ParseErrc>::ok(std::string(text)); }
+	};
+}
+
+#endif // INCLUDE_CMDKIT_CONVERT
\ No newline at end of file
@@ -0,0 +1,214 @@
+#ifndef INCLUDE_CMDKIT_DISPATCHER
+#define INCLUDE_CMDKIT_DISPATCHER
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "command.hpp"
+#include "function.hpp"
+#include "mpsc_ring.hpp"
+#include "result.hpp"
+#include "terminal.hpp"
+
+namespace cmdkit
+{
+	struct DispatcherStats
+	{
+		uint64_t dispatched = 0;
+		uint64_t batches = 0;
+		// Times the dispatcher went to sleep on an empty queue.
+		uint64_t sleeps = 0;
+	};
+
+	// Lets any number of threads submit commands to one terminal without locking it: submissions
+	// go into a bounded lock-free ring and a dedicated thread drains it in batches, dispatching
+	// each entry in submission order and completing it with the command's result. A producer
+	// pays for a CAS on the ring's tail, a fence and, if the dispatcher is asleep, a notify.
+	// Entries are either pre-parsed CommandArgs or raw lines (which may be pipelines). Output
+	// is flushed after every batch. The terminal must not be invoked or changed from other
+	// threads while the dispatcher runs. TerminalT is a BasicTerminal.
+	//
+	// This is not a throughput win: every command still runs on the one dispatcher thread,
+	// which also pays for the hand-off. With commands as cheap as bench/submit_queue.cpp's,
+	// a mutex around Terminal::invoke completes about 1.5x as many lines per second, and 2-3x
+	// as many as CommandArgs submissions, which copy their arguments. Use it when producers
+	// must not wait while commands run.
+	template<typename TerminalT>
+	class TerminalDispatcher
+	{
+	public:
+		using R = Result<void*, std::string>;
+		// Runs on the dispatcher thread; it should hand the result off rather than block.
+		using Completion = InplaceFunction<void(R)>;
+
+		explicit TerminalDispatcher(const TerminalT& terminal, size_t capacity = 4096, size_t batch_size = 64)
+			: terminal(terminal), ring(capacity), batch_size(batch_size ? batch_size : 1)
+		{
+			worker = std::thread([this]() { dispatch_loop(); });
+		}
+
+		~TerminalDispatcher() { stop(); }
+
+		TerminalDispatcher(const TerminalDispatcher&) = delete;
+		TerminalDispatcher& operator=(const TerminalDispatcher&) = delete;
+
+	public:
+		// Waits for room when the queue is full. After stop(), done gets an error at once.
+		void submit(CommandArgs args, Completion done) { enqueue(Entry{ {}, std::make_unique<CommandArgs>(std::move(args)), std::move(done) }, true); }
+		void submit(std::string line, Completion done) { enqueue(Entry{ std::move(line), nullptr, std::move(done) }, true); }
+
+		std::future<R> submit(CommandArgs args) { return submit_future(Entry{ {}, std::make_unique<CommandArgs>(std::move(args)), nullptr }); }
+		std::future<R> submit(std::string line) { return submit_future(Entry{ std::move(line), nullptr, nullptr }); }
+
+		// Returns false and completes done with an error instead of waiting when the queue is full.
+		bool try_submit(CommandArgs args, Completion done) { return enqueue(Entry{ {}, std::make_unique<CommandArgs>(std::move(args)), std::move(done) }, false); }
+		bool try_submit(std::string line, Completion done) { return enqueue(Entry{ std::move(line), nullptr, std::move(done) }, false); }
+
+		// Runs what is already queued, then joins the dispatcher thread.
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				ring.close();
+			}
+			wake.notify_one();
+			if (worker.joinable()) worker.join();
+		}
+
+		DispatcherStats stats() const
+		{
+			DispatcherStats result;
+			result.dispatched = dispatched.load(std::memory_order_relaxed);
+			result.batches = batches.load(std::memory_order_relaxed);
+			result.sleeps = sleeps.load(std::memory_order_relaxed);
+			return result;
+		}
+
+		size_t capacity() const { return ring.capacity(); }
+
+	private:
+		// A line, or pre-parsed arguments kept out of line: CommandArgs would make every cell
+		// of the ring four times larger.
+		struct Entry
+		{
+			std::string line;
+			std::unique_ptr<CommandArgs> args;
+			Completion done;
+		};
+
+		std::future<R> submit_future(Entry entry)
+		{
+			std::promise<R> promise;
+			std::future<R> future = promise.get_future();
+			entry.done = [promise = std::move(promise)](R result) mutable { promise.set_value(std::move(result)); };
+			enqueue(std::move(entry), true);
+			return future;
+		}
+
+		// stop() closes the ring, so a push either lands before the dispatcher's final drain
+		// or fails here.
+		bool enqueue(Entry entry, bool wait)
+		{
+			while (!ring.try_push(entry))
+			{
+				if (!wait || ring.closed())
+				{
+					if (entry.done) entry.done(R::err(ring.closed() ? "Dispatcher is stopped" : "Dispatcher queue is full"));
+					return false;
+				}
+				std::this_thread::yield();
+			}
+
+			// Pairs with the fence in dispatch_loop: either the dispatcher sees the entry before
+			// sleeping, or we see it asleep and wake it.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleeping.load(std::memory_order_relaxed))
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				wake.notify_one();
+			}
+			return true;
+		}
+
+		void run(Entry&& entry) const
+		{
+			R result = R::err("Unknown exception");
+			try
+			{
+				if (entry.args) result = terminal.invoke(*entry.args, []() {});
+				else result = terminal.invoke(entry.line, []() {});
+			}
+			catch (const std::exception& e) { result = R::err(e.what()); }
+			catch (...) {}
+
+			if (!entry.done) return;
+			try { entry.done(std::move(result)); }
+			catch (...) {}
+		}
+
+		void dispatch_loop()
+		{
+			constexpr size_t spins = 64;
+			size_t idle = 0;
+			while (true)
+			{
+				const size_t count = ring.drain([this](Entry&& entry) { run(std::move(entry)); }, batch_size);
+				if (count)
+				{
+					dispatched.fetch_add(count, std::memory_order_relaxed);
+					batches.fetch_add(1, std::memory_order_relaxed);
+					if (ring.empty()) terminal.get_output().flush();
+					idle = 0;
+					continue;
+				}
+
+				if (ring.closed())
+				{
+					if (ring.drained()) break;
+					std::this_thread::yield();
+					continue;
+				}
+
+				if (++idle < spins) { std::this_thread::yield(); continue; }
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				sleeping.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (ring.empty() && !ring.closed())
+				{
+					sleeps.fetch_add(1, std::memory_order_relaxed);
+					wake.wait(lock, [this]() { return !ring.empty() || ring.closed(); });
+				}
+				sleeping.store(false, std::memory_order_relaxed);
+				idle = 0;
+			}
+			terminal.get_output().flush();
+		}
+
+	private:
+		const TerminalT& terminal;
+		MpscRing<Entry> ring;
+		size_t batch_size;
+
+		std::atomic<bool> sleeping{ false };
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+
+		std::atomic<uint64_t> dispatched{ 0 };
+		std::atomic<uint64_t> batches{ 0 };
+		std::atomic<uint64_t> sleeps{ 0 };
+
+		std::thread worker;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_DISPATCHER
@@ -0,0 +1,127 @@
+#ifndef INCLUDE_CMDKIT_EVENT_LOOP
+#define INCLUDE_CMDKIT_EVENT_LOOP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+namespace cmdkit
+{
+	// Single-threaded event loop. Callbacks and timers run on the thread calling run(); post()
+	// may be called from any thread. Outstanding work that will post back later (a background
+	// job, a child process) keeps the loop alive through hold() / release().
+	class EventLoop
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		EventLoop() = default;
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+	public:
+		void post(std::function<void()> fn)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				inbox.push_back(std::move(fn));
+			}
+			wake.notify_one();
+		}
+
+		void call_at(Clock::time_point when, std::function<void()> fn)
+		{
+			post([this, when, fn = std::move(fn)]() mutable { timers.push(Timer{ when, sequence++, std::move(fn) }); });
+		}
+
+		template<typename Rep, typename Period>
+		void call_after(std::chrono::duration<Rep, Period> delay, std::function<void()> fn) { call_at(Clock::now() + delay, std::move(fn)); }
+
+		void hold() { std::lock_guard<std::mutex> lock(mutex); holds++; }
+		void release()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				holds--;
+			}
+			wake.notify_one();
+		}
+
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+		}
+
+		// Runs until stop() is called or nothing is ready, scheduled or held. Returns the number
+		// of callbacks executed.
+		size_t run()
+		{
+			size_t executed = 0;
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					while (inbox.empty())
+					{
+						if (stopping) { stopping = false; return executed; }
+						if (!ready.empty()) break;
+
+						if (!timers.empty())
+						{
+							if (timers.top().when <= Clock::now()) break;
+							wake.wait_until(lock, timers.top().when);
+						}
+						else if (holds > 0) wake.wait(lock);
+						else return executed;
+					}
+					for (auto& fn : inbox) ready.push_back(std::move(fn));
+					inbox.clear();
+				}
+
+				const auto now = Clock::now();
+				while (!timers.empty() && timers.top().when <= now)
+				{
+					ready.push_back(std::move(const_cast<Timer&>(timers.top()).fn));
+					timers.pop();
+				}
+
+				while (!ready.empty())
+				{
+					auto fn = std::move(ready.front());
+					ready.pop_front();
+					fn();
+					executed++;
+				}
+			}
+		}
+
+	private:
+		struct Timer
+		{
+			Clock::time_point when;
+			size_t sequence;
+			std::function<void()> fn;
+
+			bool operator>(const Timer& other) const { return when != other.when ? when > other.when : sequence > other.sequence; }
+		};
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::vector<std::function<void()>> inbox;
+		std::deque<std::function<void()>> ready;
+		std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+		size_t sequence = 0;
+		size_t holds = 0;
+		bool stopping = false;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_EVENT_LOOP
\ No newline at end of file
@@ -0,0 +1,233 @@
+#ifndef INCLUDE_CMDKIT_FUNCTION
+#define INCLUDE_CMDKIT_FUNCTION
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#ifndef CMDKIT_HANDLER_BUFFER_SIZE
+#define CMDKIT_HANDLER_BUFFER_SIZE 32
+#endif
+
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define CMDKIT_HAS_RTTI 1
+#else
+#define CMDKIT_HAS_RTTI 0
+#endif
+
+namespace cmdkit
+{
+	namespace detail
+	{
+		// Type-erased storage for one object: inline in a buffer of Capacity bytes when it fits,
+		// on the heap otherwise. The ops table moves and destroys the object, and since there is
+		// one table per stored type it also tells the type apart. A plugin loaded with
+		// RTLD_LOCAL has its own copies of the tables, so when RTTI is on the table also carries
+		// the typeid to fall back on; without RTTI, values made on one side of a plugin
+		// boundary are not recognized on the other.
+		template<size_t Capacity>
+		class InplaceStorage
+		{
+		public:
+			template<typename T>
+			static constexpr bool fits_inline = sizeof(T) <= Capacity
+				&& alignof(T) <= alignof(void*)
+				&& std::is_nothrow_move_constructible_v<T>;
+
+			InplaceStorage() noexcept = default;
+
+			InplaceStorage(InplaceStorage&& other) noexcept { take(other); }
+			InplaceStorage& operator=(InplaceStorage&& other) noexcept
+			{
+				if (this != &other) { reset(); take(other); }
+				return *this;
+			}
+			~InplaceStorage() { reset(); }
+
+			InplaceStorage(const InplaceStorage&) = delete;
+			InplaceStorage& operator=(const InplaceStorage&) = delete;
+
+		public:
+			template<typename T, typename... Args>
+			T& emplace(Args&&... args)
+			{
+				reset();
+				if constexpr (fits_inline<T>)
+				{
+					target = ::new (static_cast<void*>(buffer)) T(std::forward<Args>(args)...);
+					ops = &inline_ops<T>;
+				}
+				else
+				{
+					target = new T(std::forward<Args>(args)...);
+					ops = &heap_ops<T>;
+				}
+				return *static_cast<T*>(target);
+			}
+
+			// Points at an object owned elsewhere, which is passed along on moves and never destroyed.
+			void set_unowned(void* ptr) noexcept
+			{
+				reset();
+				target = ptr;
+			}
+
+			void reset() noexcept
+			{
+				if (ops) ops->destroy(target);
+				target = nullptr;
+				ops = nullptr;
+			}
+
+			void* get() const noexcept { return target; }
+			bool has_value() const noexcept { return ops != nullptr; }
+
+			template<typename T>
+			bool holds() const noexcept
+			{
+				const Ops* expected;
+				if constexpr (fits_inline<T>) expected = &inline_ops<T>;
+				else expected = &heap_ops<T>;
+				if (ops == expected) return true;
+				return ops && ops->type && ops->inline_storage == expected->inline_storage && *ops->type == *expected->type;
+			}
+
+			// True when the object lives in the buffer (or there is none).
+			bool is_inline() const noexcept { return !ops || ops->inline_storage; }
+
+		private:
+			struct Ops
+			{
+				void (*move)(InplaceStorage& dst, InplaceStorage& src) noexcept;
+				void (*destroy)(void* target) noexcept;
+				bool inline_storage;
+				// Null without RTTI.
+				const std::type_info* type;
+			};
+
+			template<typename T>
+			static void move_inline(InplaceStorage& dst, InplaceStorage& src) noexcept
+			{
+				dst.target = ::new (static_cast<void*>(dst.buffer)) T(std::move(*static_cast<T*>(src.target)));
+				static_cast<T*>(src.target)->~T();
+			}
+
+			static void move_heap(InplaceStorage& dst, InplaceStorage& src) noexcept { dst.target = src.target; }
+
+			template<typename T>
+			static void destroy_inline(void* target) noexcept { static_cast<T*>(target)->~T(); }
+
+			template<typename T>
+			static void destroy_heap(void* target) noexcept { delete static_cast<T*>(target); }
+
+			template<typename T>
+			static constexpr const std::type_info* type_of() noexcept
+			{
+#if CMDKIT_HAS_RTTI
+				return &typeid(T);
+#else
+				return nullptr;
+#endif
+			}
+
+			template<typename T>
+			static constexpr Ops inline_ops = { &move_inline<T>, &destroy_inline<T>, true, type_of<T>() };
+
+			template<typename T>
+			static constexpr Ops heap_ops = { &move_heap, &destroy_heap<T>, false, type_of<T>() };
+
+			void take(InplaceStorage& other) noexcept
+			{
+				ops = other.ops;
+				if (ops) ops->move(*this, other);
+				else target = other.target;
+				other.target = nullptr;
+				other.ops = nullptr;
+			}
+
+		private:
+			void* target = nullptr;
+			const Ops* ops = nullptr;
+			alignas(void*) unsigned char buffer[Capacity];
+		};
+	}
+
+	template<typename Sig, size_t Capacity = CMDKIT_HANDLER_BUFFER_SIZE>
+	class InplaceFunction;
+
+	// Move-only callable that stores callables of up to Capacity bytes inline and larger ones on
+	// the heap. A call is a single indirect jump: the thunk receives the stored object (or, for
+	// a raw function pointer plus context, the context itself) as its first argument.
+	template<typename R, typename... Args, size_t Capacity>
+	class InplaceFunction<R(Args...), Capacity>
+	{
+	public:
+		using Thunk = R(*)(void*, Args...);
+
+		template<typename F>
+		static constexpr bool fits_inline = detail::InplaceStorage<Capacity>::template fits_inline<F>;
+
+		InplaceFunction() noexcept = default;
+		InplaceFunction(std::nullptr_t) noexcept {}
+
+		// Raw function pointer plus context: `fn(context, args...)` with no thunk in between.
+		InplaceFunction(Thunk fn, void* context) noexcept : invoke(fn) { storage.set_unowned(context); }
+
+		template<
+			typename F, typename D = std::decay_t<F>,
+			typename std::enable_if_t<!std::is_same_v<D, InplaceFunction> && std::is_invocable_r_v<R, D&, Args...>, int> = 0
+		>
+		InplaceFunction(F&& fn)
+		{
+			if constexpr (std::is_pointer_v<D> || std::is_member_pointer_v<D>) { if (!fn) return; }
+
+			storage.template emplace<D>(std::forward<F>(fn));
+			invoke = &call<D>;
+		}
+
+		InplaceFunction(InplaceFunction&& other) noexcept : storage(std::move(other.storage)), invoke(std::exchange(other.invoke, nullptr)) {}
+		InplaceFunction& operator=(InplaceFunction&& other) noexcept
+		{
+			if (this != &other)
+			{
+				storage = std::move(other.storage);
+				invoke = std::exchange(other.invoke, nullptr);
+			}
+			return *this;
+		}
+		InplaceFunction& operator=(std::nullptr_t) noexcept
+		{
+			storage.reset();
+			invoke = nullptr;
+			return *this;
+		}
+
+		InplaceFunction(const InplaceFunction&) = delete;
+		InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+	public:
+		R operator()(Args... args) const
+		{
+			if (!invoke) throw std::bad_function_call();
+			return invoke(storage.get(), std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const noexcept { return invoke != nullptr; }
+
+		// True when the callable lives in the inline buffer (or no storage is needed at all).
+		bool is_inline() const noexcept { return storage.is_inline(); }
+
+	private:
+		template<typename D>
+		static R call(void* target, Args... args) { return std::invoke(*static_cast<D*>(target), std::forward<Args>(args)...); }
+
+	private:
+		detail::InplaceStorage<Capacity> storage;
+		Thunk invoke = nullptr;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_FUNCTION
\ No newline at end of file
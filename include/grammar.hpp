@@ -0,0 +1,485 @@
+#ifndef INCLUDE_CMDKIT_GRAMMAR
+#define INCLUDE_CMDKIT_GRAMMAR
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "scanner.hpp"
+
+namespace cmdkit
+{
+	namespace detail
+	{
+		inline bool is_space(char ch) { return ch == ' ' || unsigned(ch - '\t') <= unsigned('\r' - '\t'); }
+
+		// What a token is, from its first bytes and its first '=' (quotes removed):
+		//   word          anything else, including "-", "-5" and "-.5"
+		//   long_key      --key
+		//   long_value    --key=value
+		//   bundle        -abc
+		//   bundle_value  -abc=value
+		//   terminator    --, after which every token is a word
+		enum class ArgShape : uint8_t { word, long_key, long_value, bundle, bundle_value, terminator };
+
+		struct ArgToken
+		{
+			std::string_view text;
+			ArgShape shape;
+			size_t equals; // position of the first '=' in text; only meaningful for long_value and bundle_value
+		};
+
+		// GNU/POSIX command line grammar as two small DFAs over byte classes. The lexical one
+		// tracks quoting: whitespace separates tokens, '...' is literal, "..." is literal except
+		// for \" and \\, and a backslash outside quotes takes the next byte literally. The shape
+		// one reads the unquoted bytes of a token and classifies it (see ArgShape). Both are
+		// tables; nothing is looked at twice.
+		struct ArgGrammar
+		{
+			enum Class : uint8_t { ordinary, dash, equals, digit, space, single_quote, double_quote, backslash, class_count };
+			enum Mode : uint8_t { unquoted, in_single, in_double, escaped, in_double_escaped, mode_count };
+			enum Action : uint8_t { content, drop, end, escaped_content };
+			enum State : uint8_t { start, dash1, dash2, long_key, long_value, short_key, short_value, word, state_count };
+
+			// Shape transitions carry this bit when they consume the first '=' of an option.
+			static constexpr uint8_t marks_equals = 0x80;
+			// The shape class of a byte past the end of a token.
+			static constexpr uint8_t past_end = 4;
+
+			static constexpr std::array<uint8_t, 256> make_classes()
+			{
+				std::array<uint8_t, 256> classes{};
+				classes[' '] = classes['\t'] = classes['\n'] = classes['\v'] = classes['\f'] = classes['\r'] = space;
+				classes['-'] = dash;
+				classes['='] = equals;
+				classes['.'] = digit;
+				for (char ch = '0'; ch <= '9'; ++ch) classes[uint8_t(ch)] = digit;
+				classes['\''] = single_quote;
+				classes['"'] = double_quote;
+				classes['\\'] = backslash;
+				return classes;
+			}
+
+			// The classes the shape DFA reads: quotes, backslashes and spaces that reach it were
+			// quoted or escaped, so they read as ordinary.
+			static constexpr std::array<uint8_t, 256> make_shape_classes()
+			{
+				std::array<uint8_t, 256> classes = make_classes();
+				for (uint8_t& cls : classes)
+					if (cls >= space) cls = ordinary;
+				return classes;
+			}
+
+			// The same, but whitespace reads as past_end, for bytes just after an unquoted token.
+			static constexpr std::array<uint8_t, 256> make_delimited_classes()
+			{
+				std::array<uint8_t, 256> classes = make_shape_classes();
+				const std::array<uint8_t, 256> lexical = make_classes();
+				for (size_t ch = 0; ch < classes.size(); ++ch)
+					if (lexical[ch] == space) classes[ch] = past_end;
+				return classes;
+			}
+
+			static constexpr uint8_t lex_entry(Mode mode, Action action) { return uint8_t(mode << 4 | action); }
+
+			static constexpr std::array<std::array<uint8_t, class_count>, mode_count> make_lexer()
+			{
+				std::array<std::array<uint8_t, class_count>, mode_count> table{};
+				for (uint8_t cls = 0; cls < class_count; ++cls)
+				{
+					table[unquoted][cls] = lex_entry(unquoted, content);
+					table[in_single][cls] = lex_entry(in_single, content);
+					table[in_double][cls] = lex_entry(in_double, content);
+					table[escaped][cls] = lex_entry(unquoted, content);
+					table[in_double_escaped][cls] = lex_entry(in_double, escaped_content);
+				}
+				table[unquoted][space] = lex_entry(unquoted, end);
+				table[unquoted][single_quote] = lex_entry(in_single, drop);
+				table[unquoted][double_quote] = lex_entry(in_double, drop);
+				table[unquoted][backslash] = lex_entry(escaped, drop);
+				table[in_single][single_quote] = lex_entry(unquoted, drop);
+				table[in_double][double_quote] = lex_entry(unquoted, drop);
+				table[in_double][backslash] = lex_entry(in_double_escaped, drop);
+				table[in_double_escaped][double_quote] = lex_entry(in_double, content);
+				table[in_double_escaped][backslash] = lex_entry(in_double, content);
+				return table;
+			}
+
+			// Indexed by the shape classes (ordinary, dash, equals, digit).
+			static constexpr std::array<std::array<uint8_t, 4>, state_count> make_shapes()
+			{
+				std::array<std::array<uint8_t, 4>, state_count> table{};
+				auto row = [&table](State state, uint8_t on_ordinary, uint8_t on_dash, uint8_t on_equals, uint8_t on_digit)
+					{
+						table[state] = { on_ordinary, on_dash, on_equals, on_digit };
+					};
+				row(start, word, dash1, word, word);
+				row(dash1, short_key, dash2, word, word);
+				row(dash2, long_key, long_key, word, long_key);
+				row(long_key, long_key, long_key, long_value | marks_equals, long_key);
+				row(long_value, long_value, long_value, long_value, long_value);
+				row(short_key, short_key, short_key, short_value | marks_equals, short_key);
+				row(short_value, short_value, short_value, short_value, short_value);
+				row(word, word, word, word, word);
+				return table;
+			}
+
+			static constexpr ArgShape final_shape(uint8_t state)
+			{
+				constexpr ArgShape shapes[state_count] = {
+					ArgShape::word, ArgShape::word, ArgShape::terminator, ArgShape::long_key,
+					ArgShape::long_value, ArgShape::bundle, ArgShape::bundle_value, ArgShape::word
+				};
+				return shapes[state];
+			}
+
+			static constexpr std::array<ArgShape, state_count> make_final_shapes()
+			{
+				std::array<ArgShape, state_count> table{};
+				for (uint8_t state = 0; state < state_count; ++state) table[state] = final_shape(state);
+				return table;
+			}
+
+			// The first three bytes decide a token's shape up to its first '=', so the shape DFA
+			// over them is folded into one table, indexed by their shape classes (or past_end).
+			// An entry holds the shape in its low nibble, and the shape if an '=' follows in its
+			// high nibble.
+			static constexpr std::array<uint8_t, 4 * 5 * 5> make_prefixes()
+			{
+				constexpr std::array<std::array<uint8_t, 4>, state_count> shapes = make_shapes();
+				std::array<uint8_t, 4 * 5 * 5> table{};
+				for (uint8_t idx = 0; idx < table.size(); ++idx)
+				{
+					const uint8_t classes[3] = { uint8_t(idx / 25), uint8_t(idx / 5 % 5), uint8_t(idx % 5) };
+					uint8_t state = start;
+					for (uint8_t cls : classes)
+					{
+						if (cls == past_end || state >= long_key) break;
+						state = shapes[state][cls] & ~marks_equals;
+					}
+					const uint8_t valued = state == long_key ? uint8_t(long_value) : state == short_key ? uint8_t(short_value) : state;
+					table[idx] = uint8_t(uint8_t(final_shape(state)) | uint8_t(final_shape(valued)) << 4);
+				}
+				return table;
+			}
+		};
+
+		// The tables, built at compile time.
+		inline constexpr std::array<uint8_t, 256> arg_classes = ArgGrammar::make_classes();
+		inline constexpr std::array<uint8_t, 256> arg_shape_classes = ArgGrammar::make_shape_classes();
+		inline constexpr std::array<uint8_t, 256> arg_delimited_classes = ArgGrammar::make_delimited_classes();
+		inline constexpr std::array<std::array<uint8_t, ArgGrammar::class_count>, ArgGrammar::mode_count> arg_lexer = ArgGrammar::make_lexer();
+		inline constexpr std::array<std::array<uint8_t, 4>, ArgGrammar::state_count> arg_shapes = ArgGrammar::make_shapes();
+		inline constexpr std::array<ArgShape, ArgGrammar::state_count> arg_final_shape = ArgGrammar::make_final_shapes();
+		inline constexpr std::array<uint8_t, 4 * 5 * 5> arg_prefixes = ArgGrammar::make_prefixes();
+
+		inline uint8_t arg_class_of(char ch) { return arg_classes[static_cast<unsigned char>(ch)]; }
+		inline uint8_t arg_shape_class_of(char ch) { return arg_shape_classes[static_cast<unsigned char>(ch)]; }
+
+		// The arg_prefixes entry for the first bytes of a token.
+		inline uint8_t arg_prefix(const char* text, size_t size)
+		{
+			if (size == 0) return arg_prefixes[ArgGrammar::ordinary * 25];
+			const uint8_t first = arg_shape_class_of(text[0]);
+			const uint8_t second = size > 1 ? arg_shape_class_of(text[1]) : ArgGrammar::past_end;
+			const uint8_t third = size > 2 ? arg_shape_class_of(text[2]) : ArgGrammar::past_end;
+			return arg_prefixes[(first * 5 + second) * 5 + third];
+		}
+
+		// The same for an unquoted token in a line, with at least three bytes of the line from
+		// text on: the whitespace after a shorter token marks its end.
+		inline uint8_t arg_delimited_prefix(const char* text)
+		{
+			const auto cls = [text](size_t pos) { return arg_delimited_classes[static_cast<unsigned char>(text[pos])]; };
+			return arg_prefixes[(cls(0) * 5 + cls(1)) * 5 + cls(2)];
+		}
+
+		// A token's shape from its prefix entry and the position of its first '=' past the prefix.
+		inline ArgToken make_arg_token(std::string_view text, uint8_t prefix, size_t equals)
+		{
+			const ArgShape shape = ArgShape(equals == std::string_view::npos ? prefix & 0xf : prefix >> 4);
+			return ArgToken{ text, shape, equals };
+		}
+
+		// Classifies a token that needs no unquoting, such as an argv element.
+		inline ArgToken classify_arg(std::string_view text)
+		{
+			const uint8_t prefix = arg_prefix(text.data(), text.size());
+			const ArgShape shape = ArgShape(prefix & 0xf);
+			size_t equals = std::string_view::npos;
+			if (shape == ArgShape::long_key || shape == ArgShape::bundle) equals = text.find('=', shape == ArgShape::long_key ? 3 : 2);
+			return make_arg_token(text, prefix, equals);
+		}
+
+		// Runs both DFAs a byte at a time over one token starting at pos, for tokens with quotes
+		// or escapes. Returns the position of the whitespace that ends it (or the end of line).
+		// Content is copied a run at a time, between the quotes and backslashes the lexer drops,
+		// and the text stays a view of data while there is only one run, as in "abc".
+		template<typename Store, typename Fn>
+		size_t lex_quoted_arg(const char* data, size_t size, size_t pos, bool& closed, std::string& scratch, Store& store, Fn& on_token)
+		{
+			using G = ArgGrammar;
+
+			uint8_t mode = G::unquoted;
+			uint8_t state = G::start;
+			size_t equals = 0;
+			size_t run = pos; // start of the content run in progress
+			size_t length = 0; // content bytes before run
+			size_t begin = pos, end = pos; // the first run, while there is only one
+			bool copying = false;
+
+			auto flush = [&](size_t to)
+				{
+					if (run == to) return;
+					if (copying) scratch.append(data + run, to - run);
+					else if (length == 0) { begin = run; end = to; }
+					else
+					{
+						copying = true;
+						scratch.assign(data + begin, end - begin);
+						scratch.append(data + run, to - run);
+					}
+					length += to - run;
+				};
+			auto advance = [&](size_t at)
+				{
+					const uint8_t next = arg_shapes[state][arg_shape_class_of(data[at])];
+					if (next & G::marks_equals) equals = length + (at - run);
+					state = next & ~G::marks_equals;
+				};
+
+			for (; pos < size; ++pos)
+			{
+				const uint8_t entry = arg_lexer[mode][arg_class_of(data[pos])];
+				const uint8_t action = entry & 0xf;
+				mode = entry >> 4;
+				if (action == G::content) { advance(pos); continue; }
+				if (action == G::end) break;
+
+				flush(pos);
+				if (action == G::escaped_content)
+				{
+					// Inside double quotes, a backslash before anything but " or \ is kept.
+					run = pos - 1;
+					advance(pos - 1);
+					advance(pos);
+					continue;
+				}
+				run = pos + 1;
+			}
+
+			// A trailing backslash escapes nothing and is kept.
+			if (mode == G::escaped)
+			{
+				run = size - 1;
+				advance(size - 1);
+				mode = G::unquoted;
+			}
+			flush(pos);
+			closed = closed && mode == G::unquoted;
+
+			const std::string_view text = copying ? std::string_view(store(std::string_view(scratch))) : std::string_view(data + begin, end - begin);
+			on_token(ArgToken{ text, arg_final_shape[state], equals });
+			return pos;
+		}
+
+		// Emits the tokens of line from pos on that need no unquoting, and stops at the first
+		// one with quotes or escapes: returns where it starts, or npos at the end of the line.
+		// Token bounds are the edges of the structural scanner's whitespace bitmap, as in
+		// tokenize, and the same window's quote, escape and '=' bitmaps give the rest, so a
+		// token costs a few bit operations and one prefix lookup.
+		template<typename Fn>
+		size_t lex_plain_args(std::string_view line, size_t pos, StructuralScanner::ScanFn scan_fn, Fn& on_token)
+		{
+			const char* data = line.data();
+			const size_t size = line.size();
+
+			// The token in progress: where it starts, and its first '=' so far, relative to start.
+			bool in_token = false;
+			size_t start = 0;
+			size_t equals = std::string_view::npos;
+
+			auto emit = [&](size_t end)
+				{
+					const uint8_t prefix = start + 3 <= size ? arg_delimited_prefix(data + start) : arg_prefix(data + start, end - start);
+					on_token(make_arg_token(std::string_view(data + start, end - start), prefix, equals));
+				};
+
+			for (size_t base = pos; base < size; base += StructuralScanner::block_size)
+			{
+				const StructuralMasks masks = StructuralScanner::scan(scan_fn, data + base, size - base);
+				const uint64_t word = ~masks.whitespace;
+				const uint64_t shifted = word << 1 | uint64_t(in_token);
+				uint64_t events = (word & ~shifted) | (~word & shifted);
+				const bool plain = !(masks.quote | masks.escape | masks.equals);
+
+				// Checks the token's bytes in this window below bit `to`; false if it needs unquoting.
+				auto note = [&](uint64_t to)
+					{
+						const uint64_t span = to & (~0ull << (start > base ? unsigned(start - base) : 0));
+						const uint64_t found = masks.equals & span;
+						if (found && equals == std::string_view::npos) equals = base + count_trailing_zeros(found) - start;
+						return !((masks.quote | masks.escape) & span);
+					};
+
+				for (; events; events &= events - 1)
+				{
+					const unsigned bit = count_trailing_zeros(events);
+					if (word >> bit & 1)
+					{
+						in_token = true;
+						start = base + bit;
+						equals = std::string_view::npos;
+						continue;
+					}
+
+					if (!plain && !note((1ull << bit) - 1)) return start;
+					emit(base + bit);
+					in_token = false;
+				}
+
+				// A token still open runs on into the next window.
+				if (in_token && !plain && !note(~0ull)) return start;
+			}
+			if (in_token) emit(size);
+			return std::string_view::npos;
+		}
+
+		// Splits a line into classified tokens in one pass: runs of plain tokens go through
+		// lex_plain_args, and each token with quotes or escapes through the byte-at-a-time DFAs.
+		//
+		// A token's text points into line unless quotes or escapes split it; then it is built
+		// in a scratch buffer and store(std::string_view) must return a copy that lives as long
+		// as the caller needs it. Returns false if the line ends inside quotes; the last token
+		// is still emitted, up to the end of the line.
+		template<typename Store, typename Fn>
+		bool lex_args(std::string_view line, StructuralScanner::ScanFn scan_fn, Store&& store, Fn&& on_token)
+		{
+			bool closed = true;
+			std::string scratch;
+			for (size_t pos = 0; (pos = lex_plain_args(line, pos, scan_fn, on_token)) != std::string_view::npos;)
+				pos = lex_quoted_arg(line.data(), line.size(), pos, closed, scratch, store, on_token);
+			return closed;
+		}
+
+		template<typename Store, typename Fn>
+		bool lex_args(std::string_view line, Store&& store, Fn&& on_token)
+		{
+			return lex_args(line, StructuralScanner::active(), std::forward<Store>(store), std::forward<Fn>(on_token));
+		}
+
+		// Position of the next `|` that stands alone as a token outside quotes, at or after from
+		// (which must not be inside quotes); npos if none.
+		inline size_t find_pipe(std::string_view line, size_t from = 0)
+		{
+			using G = ArgGrammar;
+
+			size_t pos = line.find('|', from);
+			if (pos == std::string_view::npos) return pos;
+
+			uint8_t mode = G::unquoted;
+			for (size_t idx = from; idx < line.size(); ++idx)
+			{
+				if (line[idx] == '|' && mode == G::unquoted && (idx == 0 || is_space(line[idx - 1])) && (idx + 1 == line.size() || is_space(line[idx + 1])))
+					return idx;
+				mode = arg_lexer[mode][arg_class_of(line[idx])] >> 4;
+			}
+			return std::string_view::npos;
+		}
+
+		// The first token of line, without lexing the rest; nullopt for a blank line. A plain
+		// token is a view of line, one with quotes or escapes is unquoted into scratch.
+		inline std::optional<std::string_view> first_arg(std::string_view line, std::string& scratch)
+		{
+			using G = ArgGrammar;
+
+			size_t start = 0;
+			while (start < line.size() && is_space(line[start])) start++;
+			if (start == line.size()) return std::nullopt;
+
+			size_t end = start;
+			while (end < line.size() && arg_class_of(line[end]) < G::space) end++;
+			if (end == line.size() || arg_class_of(line[end]) == G::space) return line.substr(start, end - start);
+
+			bool closed = true;
+			std::string buffer;
+			std::string_view first;
+			auto store = [&scratch](std::string_view text) { return std::string_view(scratch = text); };
+			auto on_token = [&first](const ArgToken& token) { first = token.text; };
+			lex_quoted_arg(line.data(), line.size(), start, closed, buffer, store, on_token);
+			return first;
+		}
+
+		// Streams tokens into positional / option / flag callbacks with one token of lookahead:
+		// `--key value` is an option, `--key` followed by another option or the end is a flag.
+		// Without a schema, every letter of a bundle is a flag, except that `-abc=value` gives
+		// c the value.
+		template<typename Positional, typename Option, typename Flag>
+		class ArgClassifier
+		{
+		public:
+			ArgClassifier(Positional& on_positional, Option& on_option, Flag& on_flag)
+				: on_positional(on_positional), on_option(on_option), on_flag(on_flag) {}
+
+			void push(const ArgToken& token)
+			{
+				// Words and --key come first and inline; the rest is kept out of the common path.
+				const std::string_view text = token.text;
+				if (token.shape == ArgShape::word || terminated)
+				{
+					if (has_pending) { on_option(pending, text); has_pending = false; }
+					else on_positional(text);
+					return;
+				}
+
+				if (token.shape == ArgShape::long_key)
+				{
+					if (has_pending) on_flag(pending);
+					pending = text.substr(2);
+					has_pending = true;
+					return;
+				}
+				push_rare(token);
+			}
+
+			void finish()
+			{
+				if (has_pending) on_flag(pending);
+				has_pending = false;
+			}
+
+		private:
+			// --key=value, --, and bundles.
+			void push_rare(const ArgToken& token)
+			{
+				const std::string_view text = token.text;
+				finish();
+				if (token.shape == ArgShape::long_value) on_option(text.substr(2, token.equals - 2), text.substr(token.equals + 1));
+				else if (token.shape == ArgShape::terminator) terminated = true;
+				else push_bundle(text, token.shape == ArgShape::bundle_value ? token.equals : text.size());
+			}
+
+			// Letters before `end` are flags; with `-abc=value`, end is the '=' and c takes the value.
+			void push_bundle(std::string_view text, size_t end)
+			{
+				const size_t flags = end < text.size() ? end - 1 : end;
+				for (size_t idx = 1; idx < flags; ++idx) on_flag(text.substr(idx, 1));
+				if (end < text.size()) on_option(text.substr(end - 1, 1), text.substr(end + 1));
+			}
+
+			Positional& on_positional;
+			Option& on_option;
+			Flag& on_flag;
+			std::string_view pending;
+			bool has_pending = false;
+			bool terminated = false;
+		};
+	}
+}
+
+#endif // INCLUDE_CMDKIT_GRAMMAR
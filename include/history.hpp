@@ -0,0 +1,469 @@
+#ifndef INCLUDE_CMDKIT_HISTORY
+#define INCLUDE_CMDKIT_HISTORY
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "result.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cmdkit
+{
+	struct HistoryOptions
+	{
+		// When the log grows past this, a background thread drops the oldest entries (and older
+		// copies of repeated lines) until it is half this size. The log is compacted on open as
+		// well. The file is mapped at twice this size up front and trimmed when it is closed.
+		size_t max_bytes = 16 << 20;
+		// Skips a line equal to the one recorded just before it.
+		bool ignore_duplicates = true;
+	};
+
+	namespace detail
+	{
+		// Read-write shared mapping of a file, sized when it is opened. The file is locked for the
+		// lifetime of the object, so only one process appends to it.
+		class LogFile
+		{
+		public:
+			LogFile() = default;
+			~LogFile() { release(); }
+
+			LogFile(const LogFile&) = delete;
+			LogFile& operator=(const LogFile&) = delete;
+
+		public:
+			Result<void, std::string> open(const std::string& path, size_t min_capacity)
+			{
+				using R = Result<void, std::string>;
+#if defined(_WIN32)
+				handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (handle == INVALID_HANDLE_VALUE) return R::err("Can't open history file: " + path);
+
+				LARGE_INTEGER size;
+				if (!GetFileSizeEx(handle, &size)) return R::err("Can't stat history file: " + path);
+				file_size = size_t(size.QuadPart);
+#else
+				fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+				if (fd < 0) return R::err("Can't open history file: " + path);
+				if (::flock(fd, LOCK_EX | LOCK_NB) != 0) return R::err("Can't lock history file, another process is using it: " + path);
+
+				struct stat info;
+				if (fstat(fd, &info) != 0) return R::err("Can't stat history file: " + path);
+				file_size = size_t(info.st_size);
+#endif
+				return map(std::max(file_size, min_capacity)) ? R::ok() : R::err("Can't map history file: " + path);
+			}
+
+			// Trims the file to size bytes and closes it. A file that was never mapped is left alone.
+			void close(size_t size)
+			{
+				if (!data) { release(); return; }
+				unmap();
+#if defined(_WIN32)
+				LARGE_INTEGER end;
+				end.QuadPart = LONGLONG(size);
+				if (SetFilePointerEx(handle, end, nullptr, FILE_BEGIN)) SetEndOfFile(handle);
+#else
+				[[maybe_unused]] const int truncated = ::ftruncate(fd, off_t(size));
+#endif
+				release();
+			}
+
+			// Asks the OS to write the first size bytes back to disk.
+			bool sync(size_t size)
+			{
+				if (!data || !size) return true;
+#if defined(_WIN32)
+				return FlushViewOfFile(data, size) != 0;
+#else
+				return msync(data, size, MS_SYNC) == 0;
+#endif
+			}
+
+			char* get_data() const { return data; }
+			size_t get_capacity() const { return capacity; }
+			// Size of the file when it was opened, including any zero tail left by a crash.
+			size_t get_file_size() const { return file_size; }
+
+		private:
+			void release()
+			{
+				unmap();
+#if defined(_WIN32)
+				if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+				handle = INVALID_HANDLE_VALUE;
+#else
+				if (fd >= 0) ::close(fd);
+				fd = -1;
+#endif
+			}
+
+			bool map(size_t size)
+			{
+				size = std::max<size_t>(size, 4096);
+#if defined(_WIN32)
+				mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size & 0xffffffffu), nullptr);
+				if (!mapping) return false;
+				data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+				if (!data) { CloseHandle(mapping); mapping = nullptr; return false; }
+#else
+				if (size > file_size && ::ftruncate(fd, off_t(size)) != 0) return false;
+				file_size = std::max(file_size, size);
+				void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				if (ptr == MAP_FAILED) return false;
+				data = static_cast<char*>(ptr);
+#endif
+				capacity = size;
+				return true;
+			}
+
+			void unmap()
+			{
+				if (!data) return;
+#if defined(_WIN32)
+				UnmapViewOfFile(data);
+				CloseHandle(mapping);
+				mapping = nullptr;
+#else
+				munmap(data, capacity);
+#endif
+				data = nullptr;
+				capacity = 0;
+			}
+
+		private:
+#if defined(_WIN32)
+			HANDLE handle = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#else
+			int fd = -1;
+#endif
+			char* data = nullptr;
+			size_t capacity = 0;
+			size_t file_size = 0;
+		};
+	}
+
+	// Command history kept in an append-only text file, one line per entry, oldest first. The
+	// file is mapped at twice max_bytes when it is opened, so recording a line is a copy into
+	// the mapping and an index update; the OS writes the pages back. Compaction runs on a
+	// background thread, which record wakes once each time the log passes max_bytes, and
+	// record waits for it only if lines come faster than it frees space. In memory there is an offset
+	// per entry and, per block of 64 entries, a 2048-bit signature of the bigrams and trigrams
+	// in them. Searches walk the blocks from newest to oldest and skip any whose signature
+	// lacks one of the needle's trigrams (or its bigram, for two characters), so a search for a
+	// rare string reads only a few blocks. Signatures are brought up to date by the next search
+	// rather than by record, which keeps recording off the dispatch path's profile.
+	// Entries are numbered from 0, the oldest. Safe to use from several threads.
+	class CommandHistory
+	{
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		static Result<std::shared_ptr<CommandHistory>, std::string> open(const std::string& path, HistoryOptions options = {})
+		{
+			using R = Result<std::shared_ptr<CommandHistory>, std::string>;
+			std::shared_ptr<CommandHistory> history(new CommandHistory(options));
+			if (auto opened = history->file.open(path, 2 * options.max_bytes); opened.is_err()) return R::err(std::move(opened).unwrap_err());
+
+			history->load();
+			if (history->used > options.max_bytes) history->rewrite();
+			history->sign();
+			history->compactor = std::thread([raw = history.get()]() { raw->compact_loop(); });
+			return R::ok(std::move(history));
+		}
+
+		~CommandHistory()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			if (compactor.joinable()) compactor.join();
+			file.close(used);
+		}
+
+		CommandHistory(const CommandHistory&) = delete;
+		CommandHistory& operator=(const CommandHistory&) = delete;
+
+	public:
+		// Appends line; blank lines are skipped, and newlines in it become spaces.
+		void record(std::string_view line)
+		{
+			while (!line.empty() && is_blank(line.back())) line.remove_suffix(1);
+			while (!line.empty() && is_blank(line.front())) line.remove_prefix(1);
+			if (line.empty()) return;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (options.ignore_duplicates && !offsets.empty() && entry_view(offsets.size() - 1) == line) return;
+
+			// A line that doesn't fit once the compactor is done is dropped.
+			const size_t size = line.size() + 1;
+			if (used + size > file.get_capacity()) room.wait(lock, [this, size]() { return used + size <= file.get_capacity() || !compaction_due; });
+			if (used + size > file.get_capacity()) return;
+
+			char* dst = file.get_data() + used;
+			std::memcpy(dst, line.data(), line.size());
+			if (std::memchr(dst, '\n', line.size())) std::replace(dst, dst + line.size(), '\n', ' ');
+			dst[line.size()] = '\n';
+			offsets.push_back(used);
+			used += size;
+
+			if (used > options.max_bytes && !compaction_due)
+			{
+				compaction_due = true;
+				wake.notify_one();
+			}
+		}
+
+		size_t size() const { std::lock_guard<std::mutex> lock(mutex); return offsets.size(); }
+
+		// Bytes of the log in use.
+		size_t bytes() const { std::lock_guard<std::mutex> lock(mutex); return used; }
+
+		std::string entry(size_t idx) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return idx < offsets.size() ? std::string(entry_view(idx)) : std::string();
+		}
+
+		// The newest entry before `before` that contains needle, as Ctrl-R finds it; pass the
+		// previous hit as `before` to continue further back.
+		std::optional<size_t> search(std::string_view needle, size_t before = npos) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return find_back(needle, before, [needle](std::string_view text) { return text.find(needle) != std::string_view::npos; });
+		}
+
+		// The newest entry before `before` that starts with prefix.
+		std::optional<size_t> search_prefix(std::string_view prefix, size_t before = npos) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return find_back(prefix, before, [prefix](std::string_view text) { return text.substr(0, prefix.size()) == prefix; });
+		}
+
+		// Rewrites the log with the newest entries that fit in half of max_bytes, keeping only
+		// the latest copy of each line. The background thread does this on its own; calling it
+		// is only needed to shrink the log sooner.
+		void compact()
+		{
+			rewrite();
+			std::lock_guard<std::mutex> lock(mutex);
+			if (used <= options.max_bytes) compaction_due = false;
+			room.notify_all();
+		}
+
+		// Flushes the log to disk. Without this, recorded lines survive a crash of the process
+		// but not of the machine.
+		Result<void, std::string> sync()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (file.sync(used)) return Result<void, std::string>::ok();
+			return Result<void, std::string>::err("Can't sync history file");
+		}
+
+	private:
+		static constexpr size_t block_size = 64;
+		static constexpr size_t signature_bits = 2048;
+
+		using Signature = std::array<uint64_t, signature_bits / 64>;
+
+		explicit CommandHistory(HistoryOptions options) : options(options) {}
+
+		static bool is_blank(char ch) { return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'; }
+
+		// Signature bit of the bigram or trigram at text; the top byte keeps the two apart.
+		static size_t gram(const char* text, size_t length)
+		{
+			uint32_t key = uint32_t(uint8_t(text[0])) | uint32_t(uint8_t(text[1])) << 8;
+			key |= length == 3 ? uint32_t(uint8_t(text[2])) << 16 : 0xff000000u;
+			return (key * 2654435761u) >> (32 - 11);
+		}
+
+		std::string_view entry_view(size_t idx) const
+		{
+			const char* begin = file.get_data() + offsets[idx];
+			const char* end = static_cast<const char*>(std::memchr(begin, '\n', used - offsets[idx]));
+			return std::string_view(begin, size_t(end - begin));
+		}
+
+		// Adds the entries recorded since the last search to their blocks' signatures.
+		void sign() const
+		{
+			for (; signed_entries < offsets.size(); ++signed_entries)
+			{
+				if (signed_entries % block_size == 0) signatures.emplace_back();
+				Signature& signature = signatures.back();
+				const std::string_view text = entry_view(signed_entries);
+				for (size_t pos = 0; pos + 2 <= text.size(); ++pos)
+				{
+					const size_t bigram = gram(text.data() + pos, 2);
+					signature[bigram / 64] |= uint64_t(1) << (bigram % 64);
+					if (pos + 3 > text.size()) continue;
+					const size_t trigram = gram(text.data() + pos, 3);
+					signature[trigram / 64] |= uint64_t(1) << (trigram % 64);
+				}
+			}
+		}
+
+		// Indexes the lines already in the file; blank lines are skipped. A crash can leave
+		// zeros after the last line (the file is grown ahead of the data) and a partly written
+		// line before them; both are cut off.
+		void load()
+		{
+			char* data = file.get_data();
+			size_t written = file.get_file_size();
+			while (written > 0 && data[written - 1] == '\0') written--;
+			used = written;
+			while (used > 0 && data[used - 1] != '\n') used--;
+
+			for (size_t pos = 0; pos < used;)
+			{
+				const char* newline = static_cast<const char*>(std::memchr(data + pos, '\n', used - pos));
+				const size_t length = size_t(newline - (data + pos));
+				if (length) offsets.push_back(pos);
+				pos += length + 1;
+			}
+			std::memset(data + used, 0, written - used);
+		}
+
+		template<typename Match>
+		std::optional<size_t> find_back(std::string_view needle, size_t before, Match&& match) const
+		{
+			size_t idx = std::min(before, offsets.size());
+			if (needle.empty()) return idx ? std::optional<size_t>(idx - 1) : std::nullopt;
+			sign();
+
+			// Up to 16 trigrams of a longer needle are plenty to rule a block out; a
+			// two-character needle is its own bigram.
+			std::array<size_t, 16> bits;
+			size_t count = 0;
+			for (size_t pos = 0; pos + 3 <= needle.size() && count < bits.size(); ++pos) bits[count++] = gram(needle.data() + pos, 3);
+			if (needle.size() == 2) bits[count++] = gram(needle.data(), 2);
+
+			while (idx > 0)
+			{
+				const size_t block = (idx - 1) / block_size;
+				const Signature& signature = signatures[block];
+				const bool candidate = std::all_of(bits.begin(), bits.begin() + count, [&signature](size_t bit) { return signature[bit / 64] >> (bit % 64) & 1; });
+				if (!candidate) { idx = block * block_size; continue; }
+
+				for (; idx > block * block_size; --idx)
+					if (match(entry_view(idx - 1))) return idx - 1;
+			}
+			return std::nullopt;
+		}
+
+		void compact_loop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;)
+			{
+				wake.wait(lock, [this]() { return stopping || compaction_due; });
+				if (stopping) return;
+				lock.unlock();
+				compact();
+				lock.lock();
+			}
+		}
+
+		// The kept lines are picked from the log without the lock: nothing below `used` changes
+		// until the next rewrite, and the mapping never moves. The lock is held only to copy
+		// them back, together with the lines recorded in the meantime.
+		void rewrite()
+		{
+			std::lock_guard<std::mutex> rewriting(compacting);
+			size_t end, count;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				end = used;
+				count = offsets.size();
+			}
+
+			char* data = file.get_data();
+			const size_t budget = options.max_bytes / 2;
+			std::vector<std::string_view> kept;
+			std::unordered_set<std::string_view> seen;
+			size_t total = 0;
+			for (size_t stop = end; stop > 0;)
+			{
+				size_t start = stop - 1;
+				while (start > 0 && data[start - 1] != '\n') start--;
+				const std::string_view text(data + start, stop - 1 - start);
+				stop = start;
+				if (text.empty()) continue;
+				if (total + text.size() + 1 > budget) break;
+				if (!seen.insert(text).second) continue;
+				kept.push_back(text);
+				total += text.size() + 1;
+			}
+
+			std::string content;
+			std::vector<uint64_t> kept_offsets;
+			content.reserve(total);
+			kept_offsets.reserve(kept.size());
+			for (auto it = kept.rbegin(); it != kept.rend(); ++it)
+			{
+				kept_offsets.push_back(content.size());
+				content.append(it->data(), it->size()).push_back('\n');
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			const size_t tail = used - end;
+			std::memmove(data + content.size(), data + end, tail);
+			std::memcpy(data, content.data(), content.size());
+			std::memset(data + content.size() + tail, 0, used - content.size() - tail);
+
+			for (size_t idx = count; idx < offsets.size(); ++idx) kept_offsets.push_back(offsets[idx] - end + content.size());
+			offsets.swap(kept_offsets);
+			signatures.clear();
+			signed_entries = 0;
+			used = content.size() + tail;
+		}
+
+	private:
+		HistoryOptions options;
+		detail::LogFile file;
+		mutable std::mutex mutex;
+		size_t used = 0;
+		std::vector<uint64_t> offsets;
+		mutable std::vector<Signature> signatures;
+		mutable size_t signed_entries = 0;
+
+		std::mutex compacting;
+		std::condition_variable wake;
+		std::condition_variable room;
+		bool compaction_due = false;
+		bool stopping = false;
+		std::thread compactor;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_HISTORY
@@ -0,0 +1,104 @@
+#ifndef INCLUDE_CMDKIT_MAPPED_FILE
+#define INCLUDE_CMDKIT_MAPPED_FILE
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "result.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cmdkit
+{
+	// Read-only memory mapping of a whole file.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(MappedFile&& other) noexcept { swap(other); }
+		MappedFile& operator=(MappedFile&& other) noexcept { MappedFile(std::move(other)).swap(*this); return *this; }
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	public:
+		static Result<MappedFile, std::string> open(const std::string& path)
+		{
+			MappedFile file;
+#if defined(_WIN32)
+			HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (handle == INVALID_HANDLE_VALUE) return Result<MappedFile, std::string>::err("Can't open file: " + path);
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(handle, &size)) { CloseHandle(handle); return Result<MappedFile, std::string>::err("Can't stat file: " + path); }
+
+			if (size.QuadPart > 0)
+			{
+				HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping) file.data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				if (mapping) CloseHandle(mapping);
+				if (!file.data) { CloseHandle(handle); return Result<MappedFile, std::string>::err("Can't map file: " + path); }
+				file.size = size_t(size.QuadPart);
+			}
+			CloseHandle(handle);
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return Result<MappedFile, std::string>::err("Can't open file: " + path);
+
+			struct stat info;
+			if (fstat(fd, &info) != 0) { ::close(fd); return Result<MappedFile, std::string>::err("Can't stat file: " + path); }
+
+			if (info.st_size > 0)
+			{
+				void* ptr = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (ptr == MAP_FAILED) { ::close(fd); return Result<MappedFile, std::string>::err("Can't map file: " + path); }
+				madvise(ptr, size_t(info.st_size), MADV_SEQUENTIAL);
+				file.data = static_cast<const char*>(ptr);
+				file.size = size_t(info.st_size);
+			}
+			::close(fd);
+#endif
+			return Result<MappedFile, std::string>::ok(std::move(file));
+		}
+
+		std::string_view view() const { return std::string_view(data, size); }
+
+		void close()
+		{
+			if (!data) return;
+#if defined(_WIN32)
+			UnmapViewOfFile(data);
+#else
+			munmap(const_cast<char*>(data), size);
+#endif
+			data = nullptr;
+			size = 0;
+		}
+
+	private:
+		void swap(MappedFile& other) noexcept
+		{
+			std::swap(data, other.data);
+			std::swap(size, other.size);
+		}
+
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_MAPPED_FILE
\ No newline at end of file
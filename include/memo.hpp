@@ -0,0 +1,205 @@
+#ifndef INCLUDE_CMDKIT_MEMO
+#define INCLUDE_CMDKIT_MEMO
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "command.hpp"
+
+namespace cmdkit
+{
+	struct MemoStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t expirations = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+
+		double hit_rate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+	};
+
+	// Bounded LRU of successful results, keyed on a command and the canonical hash of its
+	// arguments; entries are compared in full, so hash collisions cannot return a wrong
+	// result. Sizes are estimates of the heap an entry holds. A ttl of zero keeps entries
+	// until they are evicted or invalidated. All members are safe to call concurrently.
+	class MemoCache
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr size_t default_max_bytes = size_t(1) << 20;
+
+		explicit MemoCache(size_t max_bytes = default_max_bytes, Clock::duration ttl = Clock::duration::zero())
+			: max_bytes(max_bytes), ttl(ttl) {}
+
+		// A copy starts empty with the same limits.
+		MemoCache(const MemoCache& other) : MemoCache(other.get_max_bytes(), other.get_ttl()) {}
+		MemoCache& operator=(const MemoCache& other)
+		{
+			if (this == &other) return *this;
+			clear();
+			set_limits(other.get_max_bytes(), other.get_ttl());
+			return *this;
+		}
+
+	public:
+		void set_limits(size_t max_bytes_val, Clock::duration ttl_val = Clock::duration::zero())
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			max_bytes = max_bytes_val;
+			ttl = ttl_val;
+			shrink();
+		}
+
+		size_t get_max_bytes() const { std::lock_guard<std::mutex> lock(mutex); return max_bytes; }
+		Clock::duration get_ttl() const { std::lock_guard<std::mutex> lock(mutex); return ttl; }
+
+		template<typename Args>
+		std::optional<void*> find(const Command& cmd, const Args& args, uint64_t hash)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto [begin, end] = index.equal_range(hash);
+			for (auto it = begin; it != end; ++it)
+			{
+				const auto entry = it->second;
+				if (entry->command != &cmd || entry->args != args) continue;
+				if (entry->expires && *entry->expires <= Clock::now())
+				{
+					counters.expirations++;
+					erase(it);
+					break;
+				}
+				lru.splice(lru.begin(), lru, entry);
+				counters.hits++;
+				return entry->value;
+			}
+			counters.misses++;
+			return std::nullopt;
+		}
+
+		template<typename Args>
+		void insert(const Command& cmd, const Args& args, uint64_t hash, void* value)
+		{
+			CommandArgs owned = to_owned(args);
+			const size_t bytes = footprint(owned);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (bytes > max_bytes) return;
+
+			auto [begin, end] = index.equal_range(hash);
+			for (auto it = begin; it != end; ++it)
+			{
+				if (it->second->command == &cmd && it->second->args == owned) { erase(it); break; }
+			}
+
+			std::optional<Clock::time_point> expires;
+			if (ttl != Clock::duration::zero()) expires = Clock::now() + ttl;
+			lru.push_front(Entry{ &cmd, hash, std::move(owned), value, expires, bytes });
+			index.emplace(hash, lru.begin());
+			used += bytes;
+			shrink();
+		}
+
+		// Drops every entry of one command, e.g. after the state it reads has changed.
+		void invalidate(const Command& cmd)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = index.begin(); it != index.end();)
+			{
+				if (it->second->command == &cmd) it = erase(it);
+				else ++it;
+			}
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			index.clear();
+			lru.clear();
+			used = 0;
+		}
+
+		MemoStats stats() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			MemoStats result = counters;
+			result.entries = lru.size();
+			result.bytes = used;
+			return result;
+		}
+
+		void reset_stats()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			counters = MemoStats();
+		}
+
+	private:
+		struct Entry
+		{
+			const Command* command;
+			uint64_t hash;
+			CommandArgs args;
+			void* value;
+			std::optional<Clock::time_point> expires;
+			size_t bytes;
+		};
+
+		using List = std::list<Entry>;
+		using Index = std::unordered_multimap<uint64_t, List::iterator>;
+
+		static CommandArgs to_owned(const CommandArgs& args) { return args; }
+		static CommandArgs to_owned(const CommandArgsView& args) { return args.to_owned(); }
+
+		// An entry, its list node and index node, and the strings and hash nodes of its args.
+		static size_t footprint(const CommandArgs& args)
+		{
+			constexpr size_t node = 2 * sizeof(void*);
+			size_t bytes = sizeof(Entry) + node + sizeof(Index::value_type) + node;
+			for (const auto& arg : args.get_positional()) bytes += sizeof(std::string) + arg.size();
+			args.for_each_option([&bytes](std::string_view key, std::string_view val) { bytes += node + 2 * sizeof(std::string) + key.size() + val.size(); });
+			args.for_each_flag([&bytes](std::string_view name) { bytes += node + sizeof(std::string) + name.size(); });
+			return bytes;
+		}
+
+		Index::iterator erase(Index::iterator it)
+		{
+			used -= it->second->bytes;
+			lru.erase(it->second);
+			return index.erase(it);
+		}
+
+		void shrink()
+		{
+			while (used > max_bytes && !lru.empty())
+			{
+				const Entry& victim = lru.back();
+				auto [begin, end] = index.equal_range(victim.hash);
+				for (auto it = begin; it != end; ++it)
+				{
+					if (&*it->second == &victim) { erase(it); break; }
+				}
+				counters.evictions++;
+			}
+		}
+
+	private:
+		mutable std::mutex mutex;
+		List lru;
+		Index index;
+		size_t used = 0;
+		size_t max_bytes;
+		Clock::duration ttl;
+		MemoStats counters;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_MEMO
\ No newline at end of file
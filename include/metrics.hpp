@@ -0,0 +1,246 @@
+#ifndef INCLUDE_CMDKIT_METRICS
+#define INCLUDE_CMDKIT_METRICS
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Terminal records per-command metrics only when this is non-zero; otherwise the recording
+// code is compiled out and Command/Terminal carry no extra state.
+#ifndef CMDKIT_ENABLE_METRICS
+#define CMDKIT_ENABLE_METRICS 0
+#endif
+
+namespace cmdkit
+{
+	// Log-linear latency buckets: four per power of two from 64 ns up to ~137 s, so any
+	// recorded value is off by at most a quarter of its octave. Bucket 0 holds everything
+	// below 64 ns and the last bucket everything above the range.
+	struct LatencyBuckets
+	{
+		static constexpr unsigned sub_bits = 2;
+		static constexpr unsigned min_shift = 6;
+		static constexpr unsigned octaves = 31;
+		static constexpr size_t count = 1 + (size_t(octaves) << sub_bits);
+
+		static size_t index_of(uint64_t ns)
+		{
+			if (ns < (uint64_t(1) << min_shift)) return 0;
+			const unsigned log2 = floor_log2(ns);
+			const size_t sub = size_t(ns >> (log2 - sub_bits)) & ((1u << sub_bits) - 1);
+			return std::min(count - 1, 1 + (size_t(log2 - min_shift) << sub_bits) + sub);
+		}
+
+		static uint64_t lower_bound(size_t idx)
+		{
+			if (idx == 0) return 0;
+			const size_t octave = (idx - 1) >> sub_bits;
+			const size_t sub = (idx - 1) & ((1u << sub_bits) - 1);
+			return uint64_t((1u << sub_bits) + sub) << (octave + min_shift - sub_bits);
+		}
+
+		static uint64_t upper_bound(size_t idx) { return lower_bound(idx + 1); }
+
+		static unsigned floor_log2(uint64_t val)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return 63u - unsigned(__builtin_clzll(val));
+#elif defined(_MSC_VER) && defined(_M_X64)
+			unsigned long idx;
+			_BitScanReverse64(&idx, val);
+			return unsigned(idx);
+#else
+			unsigned log2 = 0;
+			while (val >>= 1) log2++;
+			return log2;
+#endif
+		}
+	};
+
+	struct CommandStats
+	{
+		std::string name;
+		uint64_t calls = 0;
+		uint64_t ok = 0;
+		uint64_t err = 0;
+		uint64_t total_ns = 0;
+		uint64_t max_ns = 0;
+		std::array<uint64_t, LatencyBuckets::count> histogram{};
+
+		double mean_ns() const { return calls ? double(total_ns) / double(calls) : 0.0; }
+		double error_rate() const { return calls ? double(err) / double(calls) : 0.0; }
+
+		// Upper edge of the bucket holding the q-th quantile (0 < q <= 1), capped at max_ns.
+		uint64_t percentile_ns(double q) const
+		{
+			const uint64_t rank = uint64_t(q * double(calls) + 0.5);
+			uint64_t seen = 0;
+			for (size_t idx = 0; idx < histogram.size(); ++idx)
+			{
+				seen += histogram[idx];
+				if (seen >= std::max<uint64_t>(rank, 1)) return std::min(max_ns, LatencyBuckets::upper_bound(idx));
+			}
+			return max_ns;
+		}
+	};
+
+	struct MetricsSnapshot
+	{
+		std::vector<CommandStats> commands;
+
+		std::string to_text() const
+		{
+			std::string out;
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-24s %10s %10s %10s %12s %12s %12s %12s\n", "command", "calls", "ok", "err", "mean_ns", "p50_ns", "p99_ns", "max_ns");
+			out += line;
+			for (const auto& stats : commands)
+			{
+				std::snprintf(line, sizeof(line), "%-24s %10llu %10llu %10llu %12.0f %12llu %12llu %12llu\n", stats.name.c_str(),
+					(unsigned long long)stats.calls, (unsigned long long)stats.ok, (unsigned long long)stats.err, stats.mean_ns(),
+					(unsigned long long)stats.percentile_ns(0.5), (unsigned long long)stats.percentile_ns(0.99), (unsigned long long)stats.max_ns);
+				out += line;
+			}
+			return out;
+		}
+
+		// Histograms are exported sparsely as [upper_bound_ns, count] pairs.
+		std::string to_json() const
+		{
+			std::string out = "{\"commands\":[";
+			for (size_t pos = 0; pos < commands.size(); ++pos)
+			{
+				const auto& stats = commands[pos];
+				if (pos) out += ',';
+				out += "{\"name\":\"";
+				for (char ch : stats.name)
+				{
+					if (ch == '"' || ch == '\\') out += '\\';
+					out += ch;
+				}
+				out += "\",\"calls\":" + std::to_string(stats.calls) + ",\"ok\":" + std::to_string(stats.ok) + ",\"err\":" + std::to_string(stats.err)
+					+ ",\"total_ns\":" + std::to_string(stats.total_ns) + ",\"max_ns\":" + std::to_string(stats.max_ns)
+					+ ",\"p50_ns\":" + std::to_string(stats.percentile_ns(0.5)) + ",\"p90_ns\":" + std::to_string(stats.percentile_ns(0.9))
+					+ ",\"p99_ns\":" + std::to_string(stats.percentile_ns(0.99)) + ",\"histogram\":[";
+				bool first = true;
+				for (size_t idx = 0; idx < stats.histogram.size(); ++idx)
+				{
+					if (!stats.histogram[idx]) continue;
+					if (!first) out += ',';
+					out += '[' + std::to_string(LatencyBuckets::upper_bound(idx)) + ',' + std::to_string(stats.histogram[idx]) + ']';
+					first = false;
+				}
+				out += "]}";
+			}
+			return out + "]}";
+		}
+	};
+
+	// Counters for one command, split into cache-line-sized shards that threads pick round-robin
+	// on first use, so concurrent invocations rarely write the same line. Recording is a handful
+	// of relaxed atomic adds (the call count is the histogram total); snapshots sum the shards.
+	class CommandMetrics
+	{
+	public:
+		static constexpr size_t shard_count = 4;
+
+		void record(uint64_t ns, bool ok)
+		{
+			Shard& shard = shards[shard_index()];
+			shard.buckets[LatencyBuckets::index_of(ns)].fetch_add(1, std::memory_order_relaxed);
+			shard.total_ns.fetch_add(ns, std::memory_order_relaxed);
+			if (!ok) shard.errors.fetch_add(1, std::memory_order_relaxed);
+
+			uint64_t max = shard.max_ns.load(std::memory_order_relaxed);
+			while (ns > max && !shard.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+		}
+
+		CommandStats snapshot(std::string name) const
+		{
+			CommandStats stats;
+			stats.name = std::move(name);
+			for (const Shard& shard : shards)
+			{
+				stats.err += shard.errors.load(std::memory_order_relaxed);
+				stats.total_ns += shard.total_ns.load(std::memory_order_relaxed);
+				stats.max_ns = std::max(stats.max_ns, shard.max_ns.load(std::memory_order_relaxed));
+				for (size_t idx = 0; idx < LatencyBuckets::count; ++idx) stats.histogram[idx] += shard.buckets[idx].load(std::memory_order_relaxed);
+			}
+			for (uint64_t count : stats.histogram) stats.calls += count;
+			stats.ok = stats.calls >= stats.err ? stats.calls - stats.err : 0;
+			return stats;
+		}
+
+		void reset()
+		{
+			for (Shard& shard : shards)
+			{
+				shard.errors.store(0, std::memory_order_relaxed);
+				shard.total_ns.store(0, std::memory_order_relaxed);
+				shard.max_ns.store(0, std::memory_order_relaxed);
+				for (auto& bucket : shard.buckets) bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> errors{ 0 };
+			std::atomic<uint64_t> total_ns{ 0 };
+			std::atomic<uint64_t> max_ns{ 0 };
+			std::array<std::atomic<uint64_t>, LatencyBuckets::count> buckets{};
+		};
+
+		static size_t shard_index()
+		{
+			static std::atomic<size_t> next{ 0 };
+			thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+			return index;
+		}
+
+		std::array<Shard, shard_count> shards;
+	};
+
+	namespace detail
+	{
+		// Owns a command's metrics, created on the first recorded call so idle commands cost one
+		// pointer. Moves are only expected while the command is not being invoked.
+		class MetricsSlot
+		{
+		public:
+			MetricsSlot() = default;
+			MetricsSlot(MetricsSlot&& other) noexcept : metrics(other.metrics.exchange(nullptr)) {}
+			MetricsSlot& operator=(MetricsSlot&& other) noexcept
+			{
+				if (this != &other) delete metrics.exchange(other.metrics.exchange(nullptr));
+				return *this;
+			}
+			~MetricsSlot() { delete metrics.load(); }
+
+			CommandMetrics* get() const { return metrics.load(std::memory_order_acquire); }
+
+			CommandMetrics& get_or_create() const
+			{
+				if (CommandMetrics* current = metrics.load(std::memory_order_acquire)) return *current;
+				CommandMetrics* created = new CommandMetrics();
+				CommandMetrics* expected = nullptr;
+				if (metrics.compare_exchange_strong(expected, created, std::memory_order_acq_rel)) return *created;
+				delete created;
+				return *expected;
+			}
+
+		private:
+			mutable std::atomic<CommandMetrics*> metrics{ nullptr };
+		};
+	}
+}
+
+#endif // INCLUDE_CMDKIT_METRICS
\ No newline at end of file
@@ -0,0 +1,167 @@
+#ifndef INCLUDE_CMDKIT_MIDDLEWARE
+#define INCLUDE_CMDKIT_MIDDLEWARE
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "command.hpp"
+#include "function.hpp"
+#include "result.hpp"
+
+namespace cmdkit
+{
+	// A middleware layer is any type with one or both of
+	//   Result<void, std::string> before(const Command& cmd, CommandArgsView& args) const;
+	//   void after(const Command& cmd, const CommandArgsView& args, Result<void*, std::string>& result) const;
+	// before() may also return void. It runs ahead of the handler and may rewrite args or
+	// stop the call by returning an error, which becomes the command's result. after() runs
+	// once a result exists and may replace it. Layers are entered in order and left in reverse
+	// order; a layer is left only if its own before() passed, so outer layers also see the
+	// errors of inner ones.
+	//
+	// Interceptor is the runtime form, for hooks added while the program runs. Either member
+	// may be empty.
+	struct Interceptor
+	{
+		using Before = InplaceFunction<Result<void, std::string>(const Command&, CommandArgsView&)>;
+		using After = InplaceFunction<void(const Command&, const CommandArgsView&, Result<void*, std::string>&)>;
+
+		Before before;
+		After after;
+	};
+
+	namespace detail
+	{
+		template<typename Layer, typename = void>
+		struct has_before : std::false_type {};
+
+		template<typename Layer>
+		struct has_before<Layer, std::void_t<decltype(std::declval<const Layer&>().before(std::declval<const Command&>(), std::declval<CommandArgsView&>()))>> : std::true_type {};
+
+		template<typename Layer, typename = void>
+		struct has_after : std::false_type {};
+
+		template<typename Layer>
+		struct has_after<Layer, std::void_t<decltype(std::declval<const Layer&>().after(std::declval<const Command&>(),
+			std::declval<const CommandArgsView&>(), std::declval<Result<void*, std::string>&>()))>> : std::true_type {};
+	}
+
+	// Compile-time layers followed by runtime interceptors. The layers are fixed by the type,
+	// so their hooks inline into the dispatch; with no layers and no interceptors, empty() is
+	// the only cost. Hooks are called through const references and may run concurrently from
+	// Terminal::invoke_batch.
+	template<typename... Middleware>
+	class MiddlewareChain
+	{
+		static_assert(((detail::has_before<Middleware>::value || detail::has_after<Middleware>::value) && ...),
+			"a middleware layer needs a before() or after() member");
+
+	public:
+		using R = Result<void*, std::string>;
+
+		MiddlewareChain() = default;
+
+		template<typename... Layers, std::enable_if_t<sizeof...(Layers) != 0 && std::is_constructible_v<std::tuple<Middleware...>, Layers&&...>, int> = 0>
+		explicit MiddlewareChain(Layers&&... middleware) : layers(std::forward<Layers>(middleware)...) {}
+
+		bool empty() const
+		{
+			if constexpr (sizeof...(Middleware) == 0) return interceptors.empty();
+			else return false;
+		}
+
+		void add(Interceptor hook) { interceptors.push_back(std::move(hook)); }
+		void clear() { interceptors.clear(); }
+		size_t interceptor_count() const { return interceptors.size(); }
+
+		template<size_t I>
+		auto& layer() { return std::get<I>(layers); }
+
+		template<size_t I>
+		const auto& layer() const { return std::get<I>(layers); }
+
+	public:
+		template<typename Invoke>
+		R run(const Command& cmd, CommandArgsView& args, Invoke&& invoke) const
+		{
+			std::optional<R> result;
+			const size_t entered = enter(cmd, args, result);
+			if (!result) result.emplace(invoke(static_cast<const CommandArgsView&>(args)));
+			leave(entered, cmd, args, *result);
+			return std::move(*result);
+		}
+
+		// The two halves of run(), for calls that complete later. Returns how many layers
+		// passed; a failing before() leaves its error in shortcut.
+		size_t enter(const Command& cmd, CommandArgsView& args, std::optional<R>& shortcut) const
+		{
+			size_t entered = 0;
+			if constexpr (sizeof...(Middleware) != 0)
+			{
+				auto step = [&](const auto& layer)
+					{
+						if (shortcut) return;
+						if (before(layer, cmd, args, shortcut)) ++entered;
+					};
+				std::apply([&step](const auto&... layer) { (step(layer), ...); }, layers);
+				if (shortcut) return entered;
+			}
+			for (const Interceptor& hook : interceptors)
+			{
+				if (hook.before)
+				{
+					Result<void, std::string> passed = hook.before(cmd, args);
+					if (passed.is_err()) { shortcut.emplace(R::err(std::move(passed).unwrap_err())); return entered; }
+				}
+				++entered;
+			}
+			return entered;
+		}
+
+		void leave(size_t entered, const Command& cmd, const CommandArgsView& args, R& result) const
+		{
+			constexpr size_t fixed = sizeof...(Middleware);
+			for (size_t idx = entered; idx > fixed; --idx)
+				if (const Interceptor::After& after = interceptors[idx - fixed - 1].after) after(cmd, args, result);
+			if constexpr (fixed != 0) leave_layers(entered, cmd, args, result, std::make_index_sequence<fixed>());
+		}
+
+	private:
+		template<typename Layer>
+		static bool before(const Layer& layer, const Command& cmd, CommandArgsView& args, std::optional<R>& shortcut)
+		{
+			if constexpr (!detail::has_before<Layer>::value) return true;
+			else if constexpr (std::is_void_v<decltype(layer.before(cmd, args))>) { layer.before(cmd, args); return true; }
+			else
+			{
+				Result<void, std::string> passed = layer.before(cmd, args);
+				if (passed.is_ok()) return true;
+				shortcut.emplace(R::err(std::move(passed).unwrap_err()));
+				return false;
+			}
+		}
+
+		template<size_t... I>
+		void leave_layers(size_t entered, const Command& cmd, const CommandArgsView& args, R& result, std::index_sequence<I...>) const
+		{
+			constexpr size_t last = sizeof...(I) - 1;
+			auto step = [&](const auto& layer, size_t idx)
+				{
+					using Layer = std::decay_t<decltype(layer)>;
+					if constexpr (detail::has_after<Layer>::value) if (idx < entered) layer.after(cmd, args, result);
+				};
+			(step(std::get<last - I>(layers), last - I), ...);
+		}
+
+	private:
+		std::tuple<Middleware...> layers;
+		std::vector<Interceptor> interceptors;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_MIDDLEWARE
\ No newline at end of file
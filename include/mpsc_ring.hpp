@@ -0,0 +1,129 @@
+#ifndef INCLUDE_CMDKIT_MPSC_RING
+#define INCLUDE_CMDKIT_MPSC_RING
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace cmdkit
+{
+	// Bounded ring for many producers and one consumer. Every cell carries a sequence number
+	// that says whose turn it is: producers claim a slot with one CAS on the tail and publish
+	// it by bumping the cell's sequence, and the consumer reads cells in order without any
+	// read-modify-write. No locks are taken, and a full ring makes try_push fail instead of
+	// waiting. close() marks the tail so that later pushes fail too; pushes that claimed a
+	// slot before it still land, and drained() tells the consumer when it has them all. The
+	// capacity is rounded up to a power of two.
+	template<typename T>
+	class MpscRing
+	{
+	public:
+		explicit MpscRing(size_t capacity)
+		{
+			size_t size = 2;
+			while (size < capacity) size *= 2;
+			mask = size - 1;
+			cells = std::make_unique<Cell[]>(size);
+			for (size_t idx = 0; idx < size; ++idx) cells[idx].sequence.store(idx, std::memory_order_relaxed);
+		}
+
+		~MpscRing() { while (try_pop([](T&&) {})) {} }
+
+		MpscRing(const MpscRing&) = delete;
+		MpscRing& operator=(const MpscRing&) = delete;
+
+	public:
+		// Moves from val only when it returns true. Fails when the ring is full or closed.
+		bool try_push(T& val)
+		{
+			size_t pos = tail.load(std::memory_order_relaxed);
+			Cell* cell;
+			while (true)
+			{
+				if (pos & closed_bit) return false;
+				cell = &cells[pos & mask];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+				if (diff == 0)
+				{
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				}
+				else if (diff < 0) return false;
+				else pos = tail.load(std::memory_order_relaxed);
+			}
+
+			::new (static_cast<void*>(cell->storage)) T(std::move(val));
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer only. Hands the oldest value to fn as an rvalue and frees its cell.
+		template<typename Fn>
+		bool try_pop(Fn&& fn)
+		{
+			Cell& cell = cells[head & mask];
+			if (cell.sequence.load(std::memory_order_acquire) != head + 1) return false;
+
+			T* val = std::launder(reinterpret_cast<T*>(cell.storage));
+			struct Release
+			{
+				Cell& cell;
+				T* val;
+				size_t next;
+				~Release()
+				{
+					val->~T();
+					cell.sequence.store(next, std::memory_order_release);
+				}
+			} release{ cell, val, head + mask + 1 };
+			++head;
+			fn(std::move(*val));
+			return true;
+		}
+
+		// Consumer only. Pops up to max values; returns how many.
+		template<typename Fn>
+		size_t drain(Fn&& fn, size_t max)
+		{
+			size_t count = 0;
+			while (count < max && try_pop(fn)) ++count;
+			return count;
+		}
+
+		// Consumer only: true when the next cell has not been published yet.
+		bool empty() const { return cells[head & mask].sequence.load(std::memory_order_acquire) != head + 1; }
+
+		void close() { tail.fetch_or(closed_bit); }
+
+		bool closed() const { return tail.load() & closed_bit; }
+
+		// Consumer only: closed, and every push that got in before close() has been popped.
+		bool drained() const
+		{
+			const size_t pos = tail.load();
+			return (pos & closed_bit) && head == (pos & ~closed_bit);
+		}
+
+		size_t capacity() const { return mask + 1; }
+
+	private:
+		static constexpr size_t closed_bit = ~(~size_t(0) >> 1);
+
+		// Cells sit on their own cache lines so producers filling neighbours do not contend.
+		struct alignas(64) Cell
+		{
+			std::atomic<size_t> sequence{ 0 };
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		size_t mask = 0;
+		alignas(64) std::atomic<size_t> tail{ 0 };
+		alignas(64) size_t head = 0;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_MPSC_RING
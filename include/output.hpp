@@ -0,0 +1,248 @@
+#ifndef INCLUDE_CMDKIT_OUTPUT
+#define INCLUDE_CMDKIT_OUTPUT
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "function.hpp"
+#include "result.hpp"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace cmdkit
+{
+	struct FlushPolicy
+	{
+		// Size of the reusable block; a write that does not fit flushes it first.
+		size_t buffer_size = 64 * 1024;
+		// Once this long has passed since the last flush, the block is flushed by the next write
+		// that ends a line or by the end of the next dispatch (an OutputSink::Scope); zero
+		// disables it. Output that waits for input should go through prompt().
+		std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100);
+	};
+
+	struct OutputStats
+	{
+		uint64_t bytes = 0;
+		uint64_t flushes = 0;
+	};
+
+	namespace detail
+	{
+		// Writes all parts to fd with as few writev calls as partial writes allow.
+		inline Result<void, std::string> write_fd(int fd, const std::string_view* parts, size_t count)
+		{
+			constexpr size_t batch = 16;
+			for (size_t first = 0; first < count; first += batch)
+			{
+				std::string_view pending[batch];
+				const size_t size = std::min(batch, count - first);
+				std::copy(parts + first, parts + first + size, pending);
+
+				for (size_t head = 0; head < size;)
+				{
+#if defined(_WIN32)
+					const unsigned chunk = unsigned(std::min<size_t>(pending[head].size(), INT_MAX));
+					const int written = chunk ? _write(fd, pending[head].data(), chunk) : 0;
+#else
+					struct iovec vec[batch];
+					for (size_t idx = head; idx < size; ++idx) vec[idx - head] = { const_cast<char*>(pending[idx].data()), pending[idx].size() };
+					const ssize_t written = ::writev(fd, vec, int(size - head));
+#endif
+					if (written < 0)
+					{
+						if (errno == EINTR) continue;
+						return Result<void, std::string>::err("Can't write output: " + std::string(std::strerror(errno)));
+					}
+
+					size_t left = size_t(written);
+					while (head < size && left >= pending[head].size()) left -= pending[head++].size();
+					if (head < size) pending[head].remove_prefix(left);
+				}
+			}
+			return Result<void, std::string>::ok();
+		}
+	}
+
+	// Buffers handler output in one reusable block and hands it to the target in batches:
+	// when the block fills, when the flush interval has passed (checked as a line ends and as
+	// a dispatch returns), on prompt(), and when
+	// Terminal finishes a script or batch. Writes at least half a block long skip the copy and
+	// go out together with the buffered bytes in one target call (a single writev for file
+	// descriptors). Writes are serialized by a lock, so one sink may be shared by
+	// Terminal::invoke_batch workers; output written straight to std::cout is not ordered
+	// with it.
+	class OutputSink
+	{
+	public:
+		// Receives the pieces to write, in order.
+		using Target = InplaceFunction<Result<void, std::string>(const std::string_view* parts, size_t count)>;
+
+		explicit OutputSink(int fd = 1, FlushPolicy policy = {})
+			: OutputSink(Target([fd](const std::string_view* parts, size_t count) { return detail::write_fd(fd, parts, count); }), policy) {}
+
+		explicit OutputSink(Target target, FlushPolicy policy = {})
+			: target(std::move(target)), policy(policy), last_flush(std::chrono::steady_clock::now())
+		{
+			buffer.reserve(policy.buffer_size);
+		}
+
+		~OutputSink() { flush(); }
+
+		OutputSink(const OutputSink&) = delete;
+		OutputSink& operator=(const OutputSink&) = delete;
+
+	public:
+		void write(std::string_view text)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (buffer.size() + text.size() > policy.buffer_size)
+			{
+				if (2 * text.size() >= policy.buffer_size) { emit(text); return; }
+				emit({});
+			}
+			buffer.insert(buffer.end(), text.begin(), text.end());
+			if (!text.empty() && text.back() == '\n' && due()) emit({});
+		}
+
+		OutputSink& operator<<(std::string_view text) { write(text); return *this; }
+		OutputSink& operator<<(const char* text) { write(text); return *this; }
+		OutputSink& operator<<(const std::string& text) { write(text); return *this; }
+		OutputSink& operator<<(char ch) { write(std::string_view(&ch, 1)); return *this; }
+
+		template<typename T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>, int> = 0>
+		OutputSink& operator<<(T val)
+		{
+			char text[64];
+			const auto [end, ec] = std::to_chars(text, text + sizeof(text), val);
+			write(std::string_view(text, ec == std::errc() ? size_t(end - text) : 0));
+			return *this;
+		}
+
+		OutputSink& operator<<(bool val) { write(val ? "true" : "false"); return *this; }
+
+	public:
+		// Hands the buffered bytes to the target. Returns the first error since the last flush.
+		Result<void, std::string> flush()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			emit({});
+			return take_error();
+		}
+
+		// Flushes the block only if the interval has passed since the last flush.
+		void flush_if_due()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (due()) emit({});
+		}
+
+		// Writes text and flushes, so it is visible before the program waits for input.
+		Result<void, std::string> prompt(std::string_view text)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			emit(text);
+			return take_error();
+		}
+
+		size_t buffered() const { std::lock_guard<std::mutex> lock(mutex); return buffer.size(); }
+
+		OutputStats stats() const { std::lock_guard<std::mutex> lock(mutex); return counters; }
+
+		const FlushPolicy& get_policy() const { return policy; }
+
+	public:
+		// The sink of the Terminal dispatching on this thread, or standard() outside of one.
+		static OutputSink& current()
+		{
+			OutputSink* sink = current_slot();
+			return sink ? *sink : standard();
+		}
+
+		// The sink installed on this thread by a Scope, if any.
+		static OutputSink* installed() { return current_slot(); }
+
+		// Buffered standard output, flushed at exit.
+		static OutputSink& standard() { static OutputSink sink(1); return sink; }
+
+		// Makes sink this thread's current() until the scope ends, and then flushes it if the
+		// interval is due, so a command's last words do not wait for someone else's newline.
+		class Scope
+		{
+		public:
+			explicit Scope(OutputSink& sink) : sink(sink), previous(current_slot()) { current_slot() = &sink; }
+			~Scope()
+			{
+				current_slot() = previous;
+				sink.flush_if_due();
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			OutputSink& sink;
+			OutputSink* previous;
+		};
+
+	private:
+		static OutputSink*& current_slot() { thread_local OutputSink* sink = nullptr; return sink; }
+
+		// Sends the block followed by extra in one target call. Called with the lock held.
+		void emit(std::string_view extra)
+		{
+			const std::string_view parts[] = { std::string_view(buffer.data(), buffer.size()), extra };
+			const size_t first = buffer.empty() ? 1 : 0;
+			const size_t count = extra.empty() ? 1 - first : 2 - first;
+			if (count == 0) return;
+			last_flush = std::chrono::steady_clock::now();
+
+			if (auto result = target(parts + first, count); result.is_err() && !error) error = std::move(result).unwrap_err();
+			counters.bytes += buffer.size() + extra.size();
+			counters.flushes++;
+			buffer.clear();
+		}
+
+		// Called with the lock held.
+		bool due() const
+		{
+			return policy.interval.count() > 0 && !buffer.empty() && std::chrono::steady_clock::now() - last_flush >= policy.interval;
+		}
+
+		Result<void, std::string> take_error()
+		{
+			if (!error) return Result<void, std::string>::ok();
+			Result<void, std::string> result = Result<void, std::string>::err(std::move(*error));
+			error.reset();
+			return result;
+		}
+
+	private:
+		Target target;
+		FlushPolicy policy;
+		mutable std::mutex mutex;
+		std::vector<char> buffer;
+		std::chrono::steady_clock::time_point last_flush;
+		std::optional<std::string> error;
+		OutputStats counters;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_OUTPUT
@@ -0,0 +1,89 @@
+#ifndef INCLUDE_CMDKIT_PAYLOAD
+#define INCLUDE_CMDKIT_PAYLOAD
+
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "function.hpp"
+#include "result.hpp"
+
+#ifndef CMDKIT_PAYLOAD_BUFFER_SIZE
+#define CMDKIT_PAYLOAD_BUFFER_SIZE 32
+#endif
+
+namespace cmdkit
+{
+	// Move-only value of any type, handed from one pipeline stage to the next. Values of up to
+	// CMDKIT_PAYLOAD_BUFFER_SIZE bytes are stored inline and larger ones on the heap; moving a
+	// payload moves the value (or just the pointer to it), never copies it. The storage is the
+	// one InplaceFunction uses (see function.hpp): types are told apart by its ops tables, and
+	// by typeid for values that cross a plugin boundary.
+	class Payload
+	{
+	public:
+		template<typename T>
+		static constexpr bool fits_inline = detail::InplaceStorage<CMDKIT_PAYLOAD_BUFFER_SIZE>::fits_inline<T>;
+
+		Payload() noexcept = default;
+
+		template<
+			typename T, typename D = std::decay_t<T>,
+			typename std::enable_if_t<!std::is_same_v<D, Payload> && !is_result<D>::value, int> = 0
+		>
+		Payload(T&& val) { emplace<D>(std::forward<T>(val)); }
+
+	public:
+		template<typename T, typename... Args>
+		static Payload make(Args&&... args)
+		{
+			Payload result;
+			result.emplace<T>(std::forward<Args>(args)...);
+			return result;
+		}
+
+		template<typename T, typename... Args>
+		T& emplace(Args&&... args)
+		{
+			static_assert(std::is_same_v<T, std::decay_t<T>>, "Payload holds values, not references");
+			return storage.emplace<T>(std::forward<Args>(args)...);
+		}
+
+		void reset() noexcept { storage.reset(); }
+
+	public:
+		bool has_value() const noexcept { return storage.has_value(); }
+		explicit operator bool() const noexcept { return has_value(); }
+
+		template<typename T>
+		bool is() const noexcept { return storage.holds<T>(); }
+
+		// Null when the payload is empty or holds another type.
+		template<typename T>
+		T* get() noexcept { return is<T>() ? static_cast<T*>(storage.get()) : nullptr; }
+
+		template<typename T>
+		const T* get() const noexcept { return is<T>() ? static_cast<const T*>(storage.get()) : nullptr; }
+
+		// Moves the value out and leaves the payload empty; nullopt if it holds no T.
+		template<typename T>
+		std::optional<T> take()
+		{
+			T* val = get<T>();
+			if (!val) return std::nullopt;
+			std::optional<T> result(std::move(*val));
+			reset();
+			return result;
+		}
+
+		// True when the value lives in the inline buffer (or there is none).
+		bool is_inline() const noexcept { return storage.is_inline(); }
+
+	private:
+		detail::InplaceStorage<CMDKIT_PAYLOAD_BUFFER_SIZE> storage;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_PAYLOAD
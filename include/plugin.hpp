@@ -0,0 +1,133 @@
+#ifndef INCLUDE_CMDKIT_PLUGIN
+#define INCLUDE_CMDKIT_PLUGIN
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "command.hpp"
+#include "result.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define CMDKIT_PLUGIN_EXPORT extern "C" __declspec(dllexport)
+#else
+#include <dlfcn.h>
+#define CMDKIT_PLUGIN_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// A plugin is a shared library built against the same cmdkit headers and settings as the
+// program loading it. It exports one entry point, which builds the command called name:
+//
+//     CMDKIT_PLUGIN_EXPORT bool cmdkit_make_command(const char* name, cmdkit::Command* out)
+//
+// and returns false for names it does not provide. See Terminal::register_plugin. Pipeline
+// payloads made on one side are recognized on the other only when RTTI is on.
+#define CMDKIT_PLUGIN_ENTRY "cmdkit_make_command"
+
+namespace cmdkit
+{
+	// A command a plugin provides, as registered before the plugin is loaded.
+	struct PluginCommand
+	{
+		std::string name;
+		std::string description;
+	};
+
+	// A loaded plugin library. Commands it made must be destroyed before it is.
+	class PluginLibrary
+	{
+	public:
+		using Entry = bool (*)(const char* name, Command* out);
+
+		~PluginLibrary()
+		{
+#if defined(_WIN32)
+			FreeLibrary(handle);
+#else
+			dlclose(handle);
+#endif
+		}
+
+		PluginLibrary(const PluginLibrary&) = delete;
+		PluginLibrary& operator=(const PluginLibrary&) = delete;
+
+	public:
+		static Result<std::shared_ptr<PluginLibrary>, std::string> open(const std::string& path)
+		{
+			using R = Result<std::shared_ptr<PluginLibrary>, std::string>;
+
+#if defined(_WIN32)
+			HMODULE handle = LoadLibraryA(path.c_str());
+			if (!handle) return R::err("Can't load plugin: " + path);
+			Entry entry = reinterpret_cast<Entry>(GetProcAddress(handle, CMDKIT_PLUGIN_ENTRY));
+			if (!entry) { FreeLibrary(handle); return R::err("Can't find " CMDKIT_PLUGIN_ENTRY " in plugin: " + path); }
+#else
+			void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+			if (!handle) return R::err(std::string("Can't load plugin: ") + dlerror());
+			Entry entry = reinterpret_cast<Entry>(dlsym(handle, CMDKIT_PLUGIN_ENTRY));
+			if (!entry) { dlclose(handle); return R::err("Can't find " CMDKIT_PLUGIN_ENTRY " in plugin: " + path); }
+#endif
+			return R::ok(std::shared_ptr<PluginLibrary>(new PluginLibrary(handle, entry)));
+		}
+
+		Result<Command, std::string> make_command(const std::string& name) const
+		{
+			Command cmd;
+			if (!entry(name.c_str(), &cmd)) return Result<Command, std::string>::err("Plugin has no command: " + name);
+			return Result<Command, std::string>::ok(std::move(cmd));
+		}
+
+	private:
+#if defined(_WIN32)
+		using Handle = HMODULE;
+#else
+		using Handle = void*;
+#endif
+
+		PluginLibrary(Handle handle, Entry entry) : handle(handle), entry(entry) {}
+
+	private:
+		Handle handle;
+		Entry entry;
+	};
+
+	namespace detail
+	{
+		// A plugin opened by the first of its commands to be dispatched. A plugin that fails to
+		// load is not retried; its commands report the error instead.
+		class LazyPlugin
+		{
+		public:
+			explicit LazyPlugin(std::string path) : path(std::move(path)) {}
+
+			Command make_command(const std::string& name, const std::string& description)
+			{
+				std::call_once(opened, [this]()
+					{
+						auto result = PluginLibrary::open(path);
+						if (result.is_ok()) library = std::move(result).unwrap();
+						else error = std::move(result).unwrap_err();
+					});
+
+				auto cmd = library ? library->make_command(name) : Result<Command, std::string>::err(error);
+				if (cmd.is_ok()) return std::move(cmd).unwrap();
+
+				using R = Result<void*, std::string>;
+				return Command(name, description, [message = std::move(cmd).unwrap_err()](const CommandArgsView&) { return R::err(message); });
+			}
+
+		private:
+			std::string path;
+			std::once_flag opened;
+			std::shared_ptr<PluginLibrary> library;
+			std::string error;
+		};
+	}
+}
+
+#endif // INCLUDE_CMDKIT_PLUGIN
@@ -3,7 +3,9 @@
 
 #include <type_traits>
 #include <stdexcept>
+#include <string>
 #include <variant>
+#include <functional>
 
 namespace cmdkit
 {
@@ -32,49 +34,53 @@ namespace cmdkit
 		using ErrType = E;
 
 	private:
-		bool ok_flag;
+		// The variant index is the only discriminant: 0 holds T, 1 holds E. Trivially copyable
+		// T and E keep the whole Result trivially copyable, so small results travel in registers.
 		std::variant<T, E> data;
 
-		Result(const T& val) : data(val), ok_flag(true) {}
-		Result(T&& val) noexcept : data(std::move(val)), ok_flag(true) {}
+		template<size_t I, typename... Args>
+		constexpr explicit Result(std::in_place_index_t<I> tag, Args&&... args) : data(tag, std::forward<Args>(args)...) {}
 
-		Result(const E& val) : data(val), ok_flag(false) {}
-		Result(E&& val) noexcept : data(std::move(val)), ok_flag(false) {}
+		template<typename, typename>
+		friend class Result;
 
 	public:
-		static Result<T, E> ok(const T& val) { return Result<T, E>(val); }
-		static Result<T, E> ok(T&& val) noexcept { return Result<T, E>(std::move(val)); }
+		static constexpr Result<T, E> ok(const T& val) { return Result<T, E>(std::in_place_index<0>, val); }
+		static constexpr Result<T, E> ok(T&& val) noexcept(std::is_nothrow_move_constructible_v<T>) { return Result<T, E>(std::in_place_index<0>, std::move(val)); }
 
-		static Result<T, E> err(const E& val) { return Result<T, E>(val); }
-		static Result<T, E> err(E&& val) noexcept { return Result<T, E>(std::move(val)); }
+		static constexpr Result<T, E> err(const E& val) { return Result<T, E>(std::in_place_index<1>, val); }
+		static constexpr Result<T, E> err(E&& val) noexcept(std::is_nothrow_move_constructible_v<E>) { return Result<T, E>(std::in_place_index<1>, std::move(val)); }
 
-		~Result() = default;
-
-	public:
-		Result& operator=(const Result& other) { ok_flag = other.ok_flag, data = other.data; return *this; }
+		// A Result<void, E> converts to a null pointer result, so handlers may return either.
+		template<typename U = T, typename std::enable_if_t<std::is_pointer_v<U>, int> = 0>
+		constexpr Result(Result<void, E> other) : Result(other.is_ok() ? ok(nullptr) : err(std::move(other).unwrap_err())) {}
 
-		Result& operator=(Result&& other) noexcept { ok_flag = other.ok_flag, data = std::move(other.data); return *this; }
+		Result(const Result&) = default;
+		Result(Result&&) = default;
+		Result& operator=(const Result&) = default;
+		Result& operator=(Result&&) = default;
+		~Result() = default;
 
 	public:
-		bool is_ok() const noexcept { return ok_flag; }
-		bool is_err() const noexcept { return !ok_flag; }
-		operator bool() const { return is_ok(); }
+		constexpr bool is_ok() const noexcept { return data.index() == 0; }
+		constexpr bool is_err() const noexcept { return data.index() == 1; }
+		constexpr operator bool() const { return is_ok(); }
 
 	public:
-		T& unwrap()& { if (is_ok()) return std::get<T>(data); else throw bad_result_access("unwrap called on an error Result"); }
-		const T& unwrap() const& { if (is_ok()) return std::get<T>(data); else throw bad_result_access("unwrap called on an error Result"); }
-		T unwrap()&& { if (is_ok()) return std::move(std::get<T>(data)); else throw bad_result_access("unwrap called on an error Result"); }
+		constexpr T& unwrap()& { if (is_ok()) return std::get<0>(data); else throw bad_result_access("unwrap called on an error Result"); }
+		constexpr const T& unwrap() const& { if (is_ok()) return std::get<0>(data); else throw bad_result_access("unwrap called on an error Result"); }
+		constexpr T unwrap()&& { if (is_ok()) return std::move(std::get<0>(data)); else throw bad_result_access("unwrap called on an error Result"); }
 
-		E& unwrap_err()& { if (is_err()) return std::get<E>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
-		const E& unwrap_err() const& { if (is_err()) return std::get<E>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
-		E unwrap_err()&& { if (is_err()) return std::move(std::get<E>(data)); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr E& unwrap_err()& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr const E& unwrap_err() const& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr E unwrap_err()&& { if (is_err()) return std::move(std::get<1>(data)); else throw bad_result_access("unwrap_err called on an okay Result"); }
 
 	public:
-		T& unwrap_or(const T& default_val) & noexcept { return is_ok() ? unwrap() : default_val; }
+		const T& unwrap_or(const T& default_val) & noexcept { return is_ok() ? unwrap() : default_val; }
 		const T& unwrap_or(const T& default_val) const& noexcept { return is_ok() ? unwrap() : default_val; }
 		T unwrap_or(T default_val) && noexcept { return is_ok() ? std::move(unwrap()) : default_val; }
 
-		E& unwrap_err_or(const E& default_val) & noexcept { return is_err() ? unwrap_err() : default_val; }
+		const E& unwrap_err_or(const E& default_val) & noexcept { return is_err() ? unwrap_err() : default_val; }
 		const E& unwrap_err_or(const E& default_val) const& noexcept { return is_err() ? unwrap_err() : default_val; }
 		E unwrap_err_or(E default_val) && noexcept { return is_err() ? std::move(unwrap_err()) : default_val; }
 
@@ -86,9 +92,10 @@ namespace cmdkit
 			Result<decltype(f(std::declval<const T&>())), E>
 			>
 		{
-			using U = decltype(f(std::declval<const T&&>()));
-			if (is_ok()) return Result<U, E>::ok(f(unwrap()));
-			else return Result<U, E>::err(std::move(unwrap_err()));
+			using U = decltype(f(std::declval<const T&>()));
+			if (is_err()) return Result<U, E>::err(unwrap_err());
+			if constexpr (std::is_void_v<U>) { f(unwrap()); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f(unwrap()));
 		}
 
 		template<typename F>
@@ -99,8 +106,9 @@ namespace cmdkit
 			>
 		{
 			using U = decltype(f(std::declval<T&&>()));
-			if (is_ok()) return Result<U, E>::ok(f(std::move(unwrap())));
-			else return Result<U, E>::err(std::move(unwrap_err()));
+			if (is_err()) return Result<U, E>::err(std::move(unwrap_err()));
+			if constexpr (std::is_void_v<U>) { f(std::move(unwrap())); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f(std::move(unwrap())));
 		}
 
 	public:
@@ -180,6 +188,152 @@ namespace cmdkit
 			else return std::invoke(std::forward<ErrFn>(err_func), std::move(unwrap_err()));
 		}
 	};
+
+	// Result of an operation that produces nothing on success.
+	template<typename E>
+	class Result<void, E>
+	{
+	public:
+		using OkType = void;
+		using ErrType = E;
+
+	private:
+		std::variant<std::monostate, E> data;
+
+		template<size_t I, typename... Args>
+		constexpr explicit Result(std::in_place_index_t<I> tag, Args&&... args) : data(tag, std::forward<Args>(args)...) {}
+
+	public:
+		static constexpr Result<void, E> ok() noexcept { return Result<void, E>(std::in_place_index<0>); }
+
+		static constexpr Result<void, E> err(const E& val) { return Result<void, E>(std::in_place_index<1>, val); }
+		static constexpr Result<void, E> err(E&& val) noexcept(std::is_nothrow_move_constructible_v<E>) { return Result<void, E>(std::in_place_index<1>, std::move(val)); }
+
+		Result(const Result&) = default;
+		Result(Result&&) = default;
+		Result& operator=(const Result&) = default;
+		Result& operator=(Result&&) = default;
+		~Result() = default;
+
+	public:
+		constexpr bool is_ok() const noexcept { return data.index() == 0; }
+		constexpr bool is_err() const noexcept { return data.index() == 1; }
+		constexpr operator bool() const { return is_ok(); }
+
+	public:
+		constexpr void unwrap() const { if (is_err()) throw bad_result_access("unwrap called on an error Result"); }
+
+		constexpr E& unwrap_err()& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr const E& unwrap_err() const& { if (is_err()) return std::get<1>(data); else throw bad_result_access("unwrap_err called on an okay Result"); }
+		constexpr E unwrap_err()&& { if (is_err()) return std::move(std::get<1>(data)); else throw bad_result_access("unwrap_err called on an okay Result"); }
+
+		const E& unwrap_err_or(const E& default_val) const& noexcept { return is_err() ? unwrap_err() : default_val; }
+		E unwrap_err_or(E default_val) && noexcept { return is_err() ? std::move(unwrap_err()) : default_val; }
+
+	public:
+		template<typename F>
+		auto map(F&& f) const& ->
+			std::enable_if_t<
+			std::is_invocable_v<F>,
+			Result<decltype(f()), E>
+			>
+		{
+			using U = decltype(f());
+			if (is_err()) return Result<U, E>::err(unwrap_err());
+			if constexpr (std::is_void_v<U>) { f(); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f());
+		}
+
+		template<typename F>
+		auto map(F&& f) && ->
+			std::enable_if_t<
+			std::is_invocable_v<F>,
+			Result<decltype(f()), E>
+			>
+		{
+			using U = decltype(f());
+			if (is_err()) return Result<U, E>::err(std::move(unwrap_err()));
+			if constexpr (std::is_void_v<U>) { f(); return Result<U, E>::ok(); }
+			else return Result<U, E>::ok(f());
+		}
+
+	public:
+		template<typename F>
+		auto map_err(F&& f) const& ->
+			std::enable_if_t<
+			std::is_invocable_v<F, const E&>,
+			Result<void, decltype(f(std::declval<const E&>()))>
+			>
+		{
+			using U = decltype(f(std::declval<const E&>()));
+			if (is_err()) return Result<void, U>::err(f(unwrap_err()));
+			else return Result<void, U>::ok();
+		}
+
+		template<typename F>
+		auto map_err(F&& f) && ->
+			std::enable_if_t<
+			std::is_invocable_v<F, E&&>,
+			Result<void, decltype(f(std::declval<E&&>()))>
+			>
+		{
+			using U = decltype(f(std::declval<E&&>()));
+			if (is_err()) return Result<void, U>::err(f(std::move(unwrap_err())));
+			else return Result<void, U>::ok();
+		}
+
+	public:
+		template<typename F>
+		auto and_then(F&& f) const& ->
+			std::enable_if_t<
+			is_result<std::invoke_result_t<F>>::value
+			&& std::is_same_v<E, typename std::invoke_result_t<F>::ErrType>,
+			std::invoke_result_t<F>
+			>
+		{
+			using Ret = std::invoke_result_t<F>;
+			if (is_ok()) return std::invoke(std::forward<F>(f));
+			else return Ret::err(unwrap_err());
+		}
+
+		template<typename F>
+		auto and_then(F&& f) && ->
+			std::enable_if_t<
+			is_result<std::invoke_result_t<F>>::value
+			&& std::is_same_v<E, typename std::invoke_result_t<F>::ErrType>,
+			std::invoke_result_t<F>
+			>
+		{
+			using Ret = std::invoke_result_t<F>;
+			if (is_ok()) return std::invoke(std::forward<F>(f));
+			else return Ret::err(std::move(unwrap_err()));
+		}
+
+	public:
+		template<
+			typename OkFn, typename ErrFn,
+			typename OkRet = std::invoke_result_t<OkFn>,
+			typename ErrRet = std::invoke_result_t<ErrFn, const E&>,
+			typename std::enable_if_t<std::is_same_v<OkRet, ErrRet>, int> = 0
+		>
+		decltype(auto) match(OkFn&& ok_func, ErrFn&& err_func) const&
+		{
+			if (is_ok()) return std::invoke(std::forward<OkFn>(ok_func));
+			else return std::invoke(std::forward<ErrFn>(err_func), unwrap_err());
+		}
+
+		template<
+			typename OkFn, typename ErrFn,
+			typename OkRet = std::invoke_result_t<OkFn>,
+			typename ErrRet = std::invoke_result_t<ErrFn, E&&>,
+			typename std::enable_if_t<std::is_same_v<OkRet, ErrRet>, int> = 0
+		>
+		decltype(auto) match(OkFn&& ok_func, ErrFn&& err_func)&&
+		{
+			if (is_ok()) return std::invoke(std::forward<OkFn>(ok_func));
+			else return std::invoke(std::forward<ErrFn>(err_func), std::move(unwrap_err()));
+		}
+	};
 }
 	
 #endif // INCLUDE_CMDKIT_RESULT
\ No newline at end of file
@@ -0,0 +1,201 @@
+#ifndef INCLUDE_CMDKIT_SCANNER
+#define INCLUDE_CMDKIT_SCANNER
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CMDKIT_SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CMDKIT_TARGET_AVX2
+#else
+#define CMDKIT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace cmdkit
+{
+	// One bit per byte of a 64-byte block, bit i describing block[i].
+	struct StructuralMasks
+	{
+		uint64_t whitespace = 0;
+		uint64_t dash = 0;
+		uint64_t quote = 0;
+		uint64_t equals = 0;
+		uint64_t escape = 0;
+	};
+
+	class StructuralScanner
+	{
+	public:
+		enum class Isa { scalar, sse2, avx2 };
+
+		static constexpr size_t block_size = 64;
+
+		using ScanFn = StructuralMasks(*)(const char*);
+
+		// Scans up to 64 bytes. Bytes past `size` are reported as whitespace.
+		static StructuralMasks scan(const char* block, size_t size) { return scan(active(), block, size); }
+
+		static StructuralMasks scan(ScanFn fn, const char* block, size_t size)
+		{
+			if (size >= block_size) return fn(block);
+
+			char padded[block_size] = {};
+			std::memcpy(padded, block, size);
+			StructuralMasks masks = fn(padded);
+			masks.whitespace |= ~0ull << size;
+			return masks;
+		}
+
+		static ScanFn active() { static const ScanFn fn = select(detected_isa()); return fn; }
+
+		static Isa detected_isa()
+		{
+#if CMDKIT_SCANNER_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuidex(info, 0, 0);
+			if (info[0] >= 7)
+			{
+				__cpuidex(info, 1, 0);
+				bool os_avx = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+				__cpuidex(info, 7, 0);
+				if (os_avx && (info[1] & (1 << 5))) return Isa::avx2;
+			}
+			return Isa::sse2;
+#else
+			return __builtin_cpu_supports("avx2") ? Isa::avx2 : Isa::sse2;
+#endif
+#else
+			return Isa::scalar;
+#endif
+		}
+
+		static ScanFn select(Isa isa)
+		{
+#if CMDKIT_SCANNER_X86
+			if (isa == Isa::avx2) return &scan_avx2;
+			if (isa == Isa::sse2) return &scan_sse2;
+#endif
+			return &scan_scalar;
+		}
+
+	public:
+		static StructuralMasks scan_scalar(const char* block)
+		{
+			StructuralMasks masks;
+			for (size_t idx = 0; idx < block_size; ++idx)
+			{
+				const unsigned char ch = static_cast<unsigned char>(block[idx]);
+				const uint64_t bit = 1ull << idx;
+				if (ch == ' ' || unsigned(ch - '\t') <= unsigned('\r' - '\t')) masks.whitespace |= bit;
+				else if (ch == '-') masks.dash |= bit;
+				else if (ch == '"' || ch == '\'') masks.quote |= bit;
+				else if (ch == '=') masks.equals |= bit;
+				else if (ch == '\\') masks.escape |= bit;
+			}
+			return masks;
+		}
+
+#if CMDKIT_SCANNER_X86
+		static StructuralMasks scan_sse2(const char* block)
+		{
+			StructuralMasks masks;
+			for (size_t idx = 0; idx < block_size; idx += 16)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + idx));
+				const __m128i control = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+				const __m128i ws = _mm_or_si128(
+					_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+					_mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control));
+				const __m128i quote = _mm_or_si128(
+					_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+					_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\'')));
+
+				masks.whitespace |= uint64_t(uint16_t(_mm_movemask_epi8(ws))) << idx;
+				masks.dash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('-'))))) << idx;
+				masks.quote |= uint64_t(uint16_t(_mm_movemask_epi8(quote))) << idx;
+				masks.equals |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('='))))) << idx;
+				masks.escape |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))))) << idx;
+			}
+			return masks;
+		}
+
+		CMDKIT_TARGET_AVX2 static StructuralMasks scan_avx2(const char* block)
+		{
+			StructuralMasks masks;
+			for (size_t idx = 0; idx < block_size; idx += 32)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + idx));
+				const __m256i control = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+				const __m256i ws = _mm256_or_si256(
+					_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+					_mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control));
+				const __m256i quote = _mm256_or_si256(
+					_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+					_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\'')));
+
+				masks.whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << idx;
+				masks.dash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('-'))))) << idx;
+				masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(quote))) << idx;
+				masks.equals |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('='))))) << idx;
+				masks.escape |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))))) << idx;
+			}
+			return masks;
+		}
+#endif
+	};
+
+	namespace detail
+	{
+		inline unsigned count_trailing_zeros(uint64_t val)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long idx;
+			_BitScanForward64(&idx, val);
+			return unsigned(idx);
+#else
+			return unsigned(__builtin_ctzll(val));
+#endif
+		}
+
+		// Splits on whitespace using the scanner's bitmap: token boundaries are the edges of the
+		// non-whitespace mask, visited with count-trailing-zeros instead of a per-byte loop.
+		template<typename Fn>
+		void tokenize(std::string_view args_str, StructuralScanner::ScanFn scan_fn, Fn&& on_token)
+		{
+			const char* data = args_str.data();
+			const size_t size = args_str.size();
+
+			uint64_t carry = 0; // 1 if the previous block ended inside a token
+			size_t start = 0;
+			for (size_t base = 0; base < size; base += StructuralScanner::block_size)
+			{
+				const uint64_t word = ~StructuralScanner::scan(scan_fn, data + base, size - base).whitespace;
+				const uint64_t shifted = (word << 1) | carry;
+				uint64_t events = (word & ~shifted) | (~word & shifted);
+				carry = word >> 63;
+
+				while (events)
+				{
+					const unsigned bit = count_trailing_zeros(events);
+					if (word >> bit & 1) start = base + bit;
+					else on_token(std::string_view(data + start, base + bit - start));
+					events &= events - 1;
+				}
+			}
+			if (carry) on_token(std::string_view(data + start, size - start));
+		}
+
+		template<typename Fn>
+		void tokenize(std::string_view args_str, Fn&& on_token) { tokenize(args_str, StructuralScanner::active(), std::forward<Fn>(on_token)); }
+	}
+}
+
+#endif // INCLUDE_CMDKIT_SCANNER
\ No newline at end of file
@@ -0,0 +1,430 @@
+#ifndef INCLUDE_CMDKIT_SERVER
+#define INCLUDE_CMDKIT_SERVER
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "output.hpp"
+#include "result.hpp"
+#include "terminal.hpp"
+
+// epoll is Linux-only; elsewhere TerminalServer is not available.
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace cmdkit
+{
+	struct ServerLimits
+	{
+		// A request line longer than this closes its connection.
+		size_t max_line = 64 * 1024;
+		// A connection stops being read once this much output is queued for it, and resumes
+		// when the queue drains below low_watermark.
+		size_t high_watermark = 1 << 20;
+		size_t low_watermark = 64 * 1024;
+		// Clients accepted beyond this are closed at once.
+		size_t max_connections = 4096;
+	};
+
+	struct ServerStats
+	{
+		uint64_t accepted = 0;
+		uint64_t closed = 0;
+		uint64_t requests = 0;
+		uint64_t errors = 0;
+		uint64_t paused = 0;
+		size_t connections = 0;
+	};
+
+	// Serves a terminal to stdin and to any number of Unix-domain socket clients from one
+	// epoll loop. Each request is a line; its reply is whatever the handler wrote to
+	// OutputSink::current() followed by a status line, `ok` or `err <message>`. Blank lines get
+	// no reply. Clients may pipeline requests: lines are run in order as they arrive and the
+	// replies queue in a per-connection buffer. A client whose queue passes the high watermark
+	// is not read from until it drains, so a slow reader cannot grow the server's memory.
+	// Commands run on the loop thread, one at a time. TerminalT is a BasicTerminal.
+	template<typename TerminalT>
+	class TerminalServer
+	{
+	public:
+		explicit TerminalServer(const TerminalT& terminal, ServerLimits limits = {}) : terminal(terminal), limits(limits) {}
+
+		~TerminalServer()
+		{
+			for (auto& [fd, conn] : connections) close_connection(*conn);
+			if (listener >= 0) { ::close(listener); ::unlink(socket_path.c_str()); }
+			if (wakeup >= 0) ::close(wakeup);
+			if (poller >= 0) ::close(poller);
+		}
+
+		TerminalServer(const TerminalServer&) = delete;
+		TerminalServer& operator=(const TerminalServer&) = delete;
+
+	public:
+		// Listens on a Unix-domain socket at path, replacing a stale socket file.
+		Result<void, std::string> listen(const std::string& path)
+		{
+			using R = Result<void, std::string>;
+			if (auto ready = init(); ready.is_err()) return ready;
+			if (listener >= 0) return R::err("Server is already listening on " + socket_path);
+
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			if (path.size() >= sizeof(address.sun_path)) return R::err("Socket path too long: " + path);
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+			const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0) return R::err("Can't create socket: " + std::string(std::strerror(errno)));
+
+			::unlink(path.c_str());
+			if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0)
+			{
+				const int error = errno;
+				::close(fd);
+				return R::err("Can't listen on " + path + ": " + std::strerror(error));
+			}
+			if (!watch(fd, EPOLLIN))
+			{
+				::close(fd);
+				return R::err("Can't poll socket: " + std::string(std::strerror(errno)));
+			}
+
+			listener = fd;
+			socket_path = path;
+			return R::ok();
+		}
+
+		// Reads requests from fd 0 and writes replies to fd 1. Replies to stdin are written
+		// with blocking writes; stdin must be pollable (a terminal or a pipe, not a file).
+		Result<void, std::string> serve_stdin()
+		{
+			using R = Result<void, std::string>;
+			if (auto ready = init(); ready.is_err()) return ready;
+			if (connections.count(0)) return R::err("Server already reads stdin");
+			if (!watch(0, EPOLLIN)) return R::err("Can't poll stdin: " + std::string(std::strerror(errno)));
+			add_connection(0, 1);
+			return R::ok();
+		}
+
+		// Serves until stop() is called, or until stdin closes when there is no listener.
+		Result<void, std::string> run()
+		{
+			using R = Result<void, std::string>;
+			if (auto ready = init(); ready.is_err()) return ready;
+
+			epoll_event events[64];
+			while (!stopping && (listener >= 0 || !connections.empty()))
+			{
+				const int count = ::epoll_wait(poller, events, 64, -1);
+				if (count < 0)
+				{
+					if (errno == EINTR) continue;
+					return R::err("epoll_wait failed: " + std::string(std::strerror(errno)));
+				}
+
+				for (int idx = 0; idx < count; ++idx)
+				{
+					const int fd = events[idx].data.fd;
+					if (fd == wakeup) { drain_wakeup(); continue; }
+					if (fd == listener) { accept_clients(); continue; }
+
+					auto it = connections.find(fd);
+					if (it == connections.end()) continue;
+					Connection& conn = *it->second;
+					if (events[idx].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) send(conn);
+					if (!conn.closed && (events[idx].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !conn.paused) receive(conn);
+					if (conn.closed) erase(fd);
+				}
+			}
+			stopping = false;
+			return R::ok();
+		}
+
+		// Makes run() return after the current event; safe from any thread and from handlers.
+		void stop()
+		{
+			stopping = true;
+			if (wakeup >= 0)
+			{
+				const uint64_t one = 1;
+				[[maybe_unused]] const ssize_t written = ::write(wakeup, &one, sizeof(one));
+			}
+		}
+
+		ServerStats stats() const
+		{
+			ServerStats result = counters;
+			result.connections = connections.size();
+			return result;
+		}
+
+		const std::string& get_socket_path() const { return socket_path; }
+
+	private:
+		struct Connection
+		{
+			int in_fd;
+			int out_fd;
+			std::string input;
+			std::string output;
+			size_t sent = 0;
+			bool eof = false;
+			bool paused = false;
+			bool closed = false;
+			uint32_t interest = EPOLLIN;
+			// Handler output and status lines land in output through this sink.
+			std::unique_ptr<OutputSink> sink;
+
+			size_t queued() const { return output.size() - sent; }
+		};
+
+		Result<void, std::string> init()
+		{
+			if (poller >= 0) return Result<void, std::string>::ok();
+			poller = ::epoll_create1(EPOLL_CLOEXEC);
+			if (poller < 0) return Result<void, std::string>::err("Can't create epoll: " + std::string(std::strerror(errno)));
+			wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (wakeup < 0 || !watch(wakeup, EPOLLIN)) return Result<void, std::string>::err("Can't create eventfd: " + std::string(std::strerror(errno)));
+			return Result<void, std::string>::ok();
+		}
+
+		bool watch(int fd, uint32_t events)
+		{
+			epoll_event event{};
+			event.events = events;
+			event.data.fd = fd;
+			return ::epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) == 0;
+		}
+
+		void drain_wakeup()
+		{
+			uint64_t count;
+			while (::read(wakeup, &count, sizeof(count)) > 0) {}
+		}
+
+		Connection& add_connection(int in_fd, int out_fd)
+		{
+			auto conn = std::make_unique<Connection>();
+			conn->in_fd = in_fd;
+			conn->out_fd = out_fd;
+			Connection* raw = conn.get();
+			conn->sink = std::make_unique<OutputSink>(OutputSink::Target([raw](const std::string_view* parts, size_t count)
+				{
+					for (size_t idx = 0; idx < count; ++idx) raw->output.append(parts[idx]);
+					return Result<void, std::string>::ok();
+				}), FlushPolicy{ 16 * 1024, {} });
+			return *connections.emplace(in_fd, std::move(conn)).first->second;
+		}
+
+		void accept_clients()
+		{
+			while (true)
+			{
+				const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+				if (fd < 0)
+				{
+					if (errno == EINTR || errno == ECONNABORTED) continue;
+					return;
+				}
+				counters.accepted++;
+				if (connections.size() >= limits.max_connections || !watch(fd, EPOLLIN))
+				{
+					::close(fd);
+					counters.closed++;
+					continue;
+				}
+				add_connection(fd, fd);
+			}
+		}
+
+		// Reads one chunk per event so that busy clients take turns, then runs every complete
+		// line it finished.
+		void receive(Connection& conn)
+		{
+			char chunk[64 * 1024];
+			const ssize_t size = ::read(conn.in_fd, chunk, sizeof(chunk));
+			if (size < 0 && (errno == EAGAIN || errno == EINTR)) return;
+			if (size <= 0) conn.eof = true;
+			else conn.input.append(chunk, size_t(size));
+			process(conn);
+		}
+
+		// Runs complete lines until the output queue reaches the high watermark, and keeps going
+		// for as long as the socket drains it below the low one.
+		void process(Connection& conn)
+		{
+			while (!conn.closed)
+			{
+				run_lines(conn);
+				if (conn.closed || !transmit(conn)) return;
+				if (!conn.paused || conn.queued() >= limits.low_watermark) break;
+				conn.paused = false;
+			}
+			settle(conn);
+		}
+
+		void run_lines(Connection& conn)
+		{
+			size_t consumed = 0;
+			while (true)
+			{
+				if (conn.queued() >= limits.high_watermark)
+				{
+					conn.paused = true;
+					counters.paused++;
+					break;
+				}
+
+				const size_t newline = conn.input.find('\n', consumed);
+				if (newline == std::string::npos)
+				{
+					if (conn.input.size() - consumed > limits.max_line) { close_connection(conn); return; }
+					if (conn.eof && consumed < conn.input.size()) { handle(conn, std::string_view(conn.input).substr(consumed)); consumed = conn.input.size(); }
+					break;
+				}
+
+				std::string_view line = std::string_view(conn.input).substr(consumed, newline - consumed);
+				if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+				handle(conn, line);
+				consumed = newline + 1;
+				conn.sink->flush();
+			}
+			conn.input.erase(0, consumed);
+			conn.sink->flush();
+		}
+
+		void handle(Connection& conn, std::string_view line)
+		{
+			using R = Result<void*, std::string>;
+			if (line.find_first_not_of(" \t\r\n\v\f") == std::string_view::npos) return;
+			counters.requests++;
+
+			OutputSink::Scope redirect(*conn.sink);
+			R result = R::ok(nullptr);
+			try
+			{
+				if (detail::find_pipe(line) != std::string_view::npos)
+				{
+					auto piped = terminal.pipe(line);
+					if (piped.is_err()) result = R::err(std::move(piped).unwrap_err());
+				}
+				else
+				{
+					ParseContext& context = ParseContext::local();
+					ParseContext::Scope scope(context);
+					result = terminal.invoke(context.parse(line), []() {});
+				}
+			}
+			catch (const std::exception& e) { result = R::err(e.what()); }
+			catch (...) { result = R::err("Unknown exception"); }
+
+			if (result.is_ok()) { conn.sink->write("ok\n"); return; }
+
+			counters.errors++;
+			std::string message = std::move(result).unwrap_err();
+			for (char& ch : message) if (ch == '\n' || ch == '\r') ch = ' ';
+			*conn.sink << "err " << message << '\n';
+		}
+
+		// Called when the socket is writable again.
+		void send(Connection& conn)
+		{
+			if (conn.closed || !transmit(conn)) return;
+			if (conn.paused && conn.queued() < limits.low_watermark)
+			{
+				conn.paused = false;
+				process(conn);
+				return;
+			}
+			settle(conn);
+		}
+
+		// Writes queued output without blocking (stdin's stdout excepted). Returns false if the
+		// connection failed and was closed.
+		bool transmit(Connection& conn)
+		{
+			if (conn.in_fd == 0)
+			{
+				const std::string_view pending = std::string_view(conn.output).substr(conn.sent);
+				if (!pending.empty()) detail::write_fd(conn.out_fd, &pending, 1);
+				conn.sent = conn.output.size();
+			}
+			while (conn.queued() > 0)
+			{
+				const ssize_t written = ::send(conn.out_fd, conn.output.data() + conn.sent, conn.queued(), MSG_NOSIGNAL);
+				if (written < 0)
+				{
+					if (errno == EINTR) continue;
+					if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+					close_connection(conn);
+					return false;
+				}
+				conn.sent += size_t(written);
+			}
+
+			if (conn.queued() == 0) { conn.output.clear(); conn.sent = 0; }
+			else if (conn.sent >= limits.low_watermark) { conn.output.erase(0, conn.sent); conn.sent = 0; }
+			return true;
+		}
+
+		// Closes a connection whose client is done and fully answered; otherwise polls it for
+		// input unless paused, and for output while some is queued.
+		void settle(Connection& conn)
+		{
+			if (conn.eof && !conn.paused && conn.queued() == 0 && conn.input.empty()) { close_connection(conn); return; }
+			update_interest(conn);
+		}
+
+		void update_interest(Connection& conn)
+		{
+			if (conn.in_fd == 0) return;
+			const uint32_t wanted = (conn.paused || conn.eof ? 0u : uint32_t(EPOLLIN)) | (conn.queued() > 0 ? uint32_t(EPOLLOUT) : 0u);
+			if (wanted == conn.interest) return;
+
+			epoll_event event{};
+			event.events = wanted;
+			event.data.fd = conn.in_fd;
+			::epoll_ctl(poller, EPOLL_CTL_MOD, conn.in_fd, &event);
+			conn.interest = wanted;
+		}
+
+		// Marks the connection closed; run() erases it once its event is handled.
+		void close_connection(Connection& conn)
+		{
+			if (conn.closed) return;
+			conn.closed = true;
+			counters.closed++;
+			::epoll_ctl(poller, EPOLL_CTL_DEL, conn.in_fd, nullptr);
+			if (conn.in_fd != 0) ::close(conn.in_fd);
+		}
+
+		void erase(int fd) { connections.erase(fd); }
+
+	private:
+		const TerminalT& terminal;
+		ServerLimits limits;
+		int poller = -1;
+		int wakeup = -1;
+		int listener = -1;
+		std::string socket_path;
+		std::unordered_map<int, std::unique_ptr<Connection>> connections;
+		ServerStats counters;
+		std::atomic<bool> stopping{ false };
+	};
+}
+#endif
+
+#endif // INCLUDE_CMDKIT_SERVER
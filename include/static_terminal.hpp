@@ -0,0 +1,195 @@
+#ifndef INCLUDE_CMDKIT_STATIC_TERMINAL
+#define INCLUDE_CMDKIT_STATIC_TERMINAL
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
+
+#include "command.hpp"
+
+namespace cmdkit
+{
+	// A command whose name and handler are known at compile time. Handlers are plain function
+	// pointers, so captureless lambdas convert to them in constant expressions.
+	class StaticCommand
+	{
+	public:
+		using Handler = Result<void*, std::string>(*)(const CommandArgs&);
+		using ViewHandler = Result<void*, std::string>(*)(const CommandArgsView&);
+
+		constexpr StaticCommand(std::string_view name, Handler handler) : name(name), handler(handler) {}
+		constexpr StaticCommand(std::string_view name, std::string_view description, Handler handler) : name(name), description(description), handler(handler) {}
+		constexpr StaticCommand(std::string_view name, ViewHandler handler) : name(name), view_handler(handler) {}
+		constexpr StaticCommand(std::string_view name, std::string_view description, ViewHandler handler) : name(name), description(description), view_handler(handler) {}
+
+	public:
+		Result<void*, std::string> invoke(const CommandArgs& args) const { return handler ? handler(args) : view_handler(args.view()); }
+		Result<void*, std::string> invoke(const CommandArgsView& args) const { return view_handler ? view_handler(args) : handler(args.to_owned()); }
+
+	public:
+		constexpr std::string_view get_name() const { return name; }
+		constexpr std::string_view get_description() const { return description; }
+
+	private:
+		std::string_view name;
+		std::string_view description;
+		Handler handler = nullptr;
+		ViewHandler view_handler = nullptr;
+	};
+
+	namespace detail
+	{
+		constexpr size_t next_pow2(size_t val)
+		{
+			size_t result = 1;
+			while (result < val) result <<= 1;
+			return result;
+		}
+	}
+
+	// Hash-and-displace perfect hash over the command names, built during constant evaluation.
+	// A name hashes once: the high half picks a bucket, whose displacement remixes the same hash
+	// into a slot that no other name occupies. Lookup is then one hash and one compare.
+	template<size_t N>
+	class StaticCommandTable
+	{
+	public:
+		static constexpr size_t slot_count = detail::next_pow2(N * 2 > 0 ? N * 2 : 1);
+		static constexpr size_t bucket_count = N / 2 > 0 ? N / 2 : 1;
+		static constexpr uint32_t empty_slot = ~uint32_t(0);
+
+		constexpr explicit StaticCommandTable(const std::array<StaticCommand, N>& cmds) : commands(cmds)
+		{
+			std::array<uint64_t, N> hashes{};
+			std::array<size_t, bucket_count> bucket_sizes{};
+			size_t max_bucket = 0;
+
+			for (size_t idx = 0; idx < N; ++idx)
+			{
+				for (size_t other = 0; other < idx; ++other)
+					if (commands[other].get_name() == commands[idx].get_name()) throw std::logic_error("StaticCommandTable: duplicate command name");
+
+				hashes[idx] = detail::fnv1a(commands[idx].get_name());
+				size_t& bucket_size = bucket_sizes[bucket_of(hashes[idx])];
+				if (++bucket_size > max_bucket) max_bucket = bucket_size;
+			}
+
+			for (auto& slot : slots) slot = empty_slot;
+
+			// Largest buckets first, while the table is still sparse.
+			for (size_t size = max_bucket; size > 0; --size)
+				for (size_t bucket = 0; bucket < bucket_count; ++bucket)
+					if (bucket_sizes[bucket] == size) place(bucket, hashes);
+		}
+
+		constexpr const StaticCommand* find(std::string_view name) const
+		{
+			const uint64_t hash = detail::fnv1a(name);
+			const uint32_t idx = slots[slot_of(hash, displacements[bucket_of(hash)])];
+			return idx != empty_slot && commands[idx].get_name() == name ? &commands[idx] : nullptr;
+		}
+
+		constexpr size_t size() const { return N; }
+		constexpr const StaticCommand* begin() const { return commands.data(); }
+		constexpr const StaticCommand* end() const { return commands.data() + N; }
+
+	private:
+		static constexpr size_t bucket_of(uint64_t hash) { return size_t(hash >> 32) % bucket_count; }
+		static constexpr size_t slot_of(uint64_t hash, uint32_t displacement) { return size_t(detail::mix64(hash ^ (displacement * 0x9e3779b97f4a7c15ull))) & (slot_count - 1); }
+
+		constexpr void place(size_t bucket, const std::array<uint64_t, N>& hashes)
+		{
+			for (uint32_t displacement = 0; displacement < (1u << 20); ++displacement)
+			{
+				bool fits = true;
+				for (size_t idx = 0; idx < N && fits; ++idx)
+				{
+					if (bucket_of(hashes[idx]) != bucket) continue;
+					const size_t slot = slot_of(hashes[idx], displacement);
+					if (slots[slot] != empty_slot) fits = false;
+					else slots[slot] = uint32_t(idx);
+				}
+
+				if (fits) { displacements[bucket] = displacement; return; }
+
+				for (size_t idx = 0; idx < N; ++idx)
+					if (bucket_of(hashes[idx]) == bucket && slots[slot_of(hashes[idx], displacement)] == idx)
+						slots[slot_of(hashes[idx], displacement)] = empty_slot;
+			}
+			throw std::logic_error("StaticCommandTable: no perfect hash found");
+		}
+
+	private:
+		std::array<StaticCommand, N> commands;
+		std::array<uint32_t, bucket_count> displacements{};
+		std::array<uint32_t, slot_count> slots{};
+	};
+
+	template<typename... Cmds>
+	constexpr StaticCommandTable<sizeof...(Cmds)> make_static_commands(const Cmds&... cmds)
+	{
+		return StaticCommandTable<sizeof...(Cmds)>(std::array<StaticCommand, sizeof...(Cmds)>{ StaticCommand(cmds)... });
+	}
+
+	// Terminal over a command table fixed at compile time. Usage:
+	//   static constexpr auto commands = make_static_commands(StaticCommand("print", handler), ...);
+	//   StaticTerminal<commands> terminal;
+	template<const auto& Table>
+	class StaticTerminal
+	{
+	public:
+		Result<void*, std::string> invoke(const CommandArgs& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgsView& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgsView& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const std::string& command, Fn&& not_find_callback) const
+		{
+			ParseContext& context = ParseContext::local();
+			ParseContext::Scope scope(context);
+			return invoke(context.parse(command), not_find_callback);
+		}
+
+		Result<void*, std::string> invoke(const std::string& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+	public:
+		static constexpr const StaticCommand* find(std::string_view name) { return Table.find(name); }
+
+	private:
+		template<typename Args, typename Fn>
+		Result<void*, std::string> dispatch(const Args& command, Fn&& not_find_callback) const
+		{
+			const StaticCommand* cmd = command.get_positional().empty() ? nullptr : Table.find(command[0]);
+			if (cmd) return cmd->invoke(command);
+
+			std::invoke(std::forward<Fn>(not_find_callback));
+			return Result<void*, std::string>::err("Not find command!");
+		}
+	};
+}
+
+#endif // INCLUDE_CMDKIT_STATIC_TERMINAL
\ No newline at end of file
@@ -0,0 +1,342 @@
+#ifndef INCLUDE_CMDKIT_SUGGEST
+#define INCLUDE_CMDKIT_SUGGEST
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cmdkit
+{
+	struct Suggestion
+	{
+		std::string name;
+		size_t distance;
+	};
+
+	namespace detail
+	{
+		// Which of 64 character classes occur in text (byte value mod 64), and which of 64
+		// hashed classes of adjacent byte pairs. An edit adds at most one character class and
+		// removes at most one; for pairs it is two and two.
+		struct NameSignature
+		{
+			uint64_t chars = 0;
+			uint64_t bigrams = 0;
+
+			explicit NameSignature(std::string_view text)
+			{
+				for (size_t idx = 0; idx < text.size(); ++idx)
+				{
+					chars |= uint64_t(1) << (static_cast<unsigned char>(text[idx]) & 63);
+					if (idx + 1 == text.size()) break;
+					const uint32_t pair = uint32_t(static_cast<unsigned char>(text[idx])) | uint32_t(static_cast<unsigned char>(text[idx + 1])) << 8;
+					bigrams |= uint64_t(1) << ((pair * 2654435761u) >> 26);
+				}
+			}
+
+			// False when more than edits edits separate the two texts.
+			bool within(const NameSignature& other, size_t edits) const
+			{
+				// Each pair of counts is combined without a branch; most names fail on characters.
+				const bool chars_ok = (popcount(chars & ~other.chars) <= edits) & (popcount(other.chars & ~chars) <= edits);
+				if (!chars_ok) return false;
+				return (popcount(bigrams & ~other.bigrams) <= 2 * edits) & (popcount(other.bigrams & ~bigrams) <= 2 * edits);
+			}
+
+			// Inline even where the compiler would call a library routine for __builtin_popcountll.
+			static size_t popcount(uint64_t bits)
+			{
+#if defined(__POPCNT__) || (defined(_MSC_VER) && defined(__AVX__))
+				return size_t(__builtin_popcountll(bits));
+#else
+				bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+				bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+				bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+				return size_t((bits * 0x0101010101010101ull) >> 56);
+#endif
+			}
+		};
+
+		inline size_t common_prefix(std::string_view lhs, std::string_view rhs)
+		{
+			const size_t size = std::min(lhs.size(), rhs.size());
+			size_t pos = 0;
+			while (pos < size && lhs[pos] == rhs[pos]) pos++;
+			return pos;
+		}
+
+		// Levenshtein distance from a fixed pattern to many texts. Patterns of up to 64 bytes use
+		// Myers' bit-parallel algorithm (in Hyyrö's formulation): one column of the DP matrix is
+		// a pair of bit vectors, advanced by a dozen word operations per text byte. Longer
+		// patterns fall back to the two-row DP.
+		class EditDistance
+		{
+		public:
+			explicit EditDistance(std::string_view pattern) : pattern(pattern)
+			{
+				if (pattern.size() > 64) return;
+				for (size_t idx = 0; idx < pattern.size(); ++idx) peq[static_cast<unsigned char>(pattern[idx])] |= uint64_t(1) << idx;
+			}
+
+			// The distance, or a value above limit once it is certain to exceed it.
+			size_t operator()(std::string_view text, size_t limit) const
+			{
+				const size_t size = pattern.size();
+				if (size == 0) return text.size();
+				if (size > 64) return dynamic(text);
+
+				const uint64_t last = uint64_t(1) << (size - 1);
+				uint64_t pv = ~uint64_t(0);
+				uint64_t mv = 0;
+				size_t score = size;
+				for (size_t idx = 0; idx < text.size(); ++idx)
+				{
+					const uint64_t eq = peq[static_cast<unsigned char>(text[idx])];
+					const uint64_t xv = eq | mv;
+					const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+					uint64_t ph = mv | ~(xh | pv);
+					uint64_t mh = pv & xh;
+					if (ph & last) score++;
+					else if (mh & last) score--;
+
+					// Each remaining byte lowers the score by one at most.
+					if (score > limit + (text.size() - idx - 1)) return limit + 1;
+
+					ph = (ph << 1) | 1;
+					mh <<= 1;
+					pv = mh | ~(xv | ph);
+					mv = ph & xv;
+				}
+				return score;
+			}
+
+		private:
+			size_t dynamic(std::string_view text) const
+			{
+				std::vector<size_t> row(text.size() + 1);
+				for (size_t col = 0; col <= text.size(); ++col) row[col] = col;
+				for (size_t line = 1; line <= pattern.size(); ++line)
+				{
+					size_t diagonal = row[0];
+					row[0] = line;
+					for (size_t col = 1; col <= text.size(); ++col)
+					{
+						const size_t above = row[col];
+						row[col] = std::min({ above + 1, row[col - 1] + 1, diagonal + (pattern[line - 1] == text[col - 1] ? 0 : 1) });
+						diagonal = above;
+					}
+				}
+				return row[text.size()];
+			}
+
+		private:
+			std::string_view pattern;
+			std::array<uint64_t, 256> peq{};
+		};
+	}
+
+	// Names for completion and "did you mean" suggestions, grouped by length. Each length keeps
+	// its names back to back in one pool, next to a signature of the characters and character
+	// pairs in each. Once there are enough names, every bigram and trigram also gets a posting
+	// list of the names containing it. Adding a name appends to its group and its postings, so
+	// the index is never rebuilt.
+	//
+	// A suggestion query cuts the query into one piece more than the edits allowed; a name
+	// within that many edits contains at least one piece unchanged, so it is in the posting
+	// list of that piece's rarest gram. Only those names are candidates (short queries scan
+	// their length groups instead). Candidates whose length or signature shows more edits
+	// than allowed are dropped before the edit distance runs.
+	class NameIndex
+	{
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		// The caller keeps names unique.
+		void add(std::string_view name)
+		{
+			if (name.size() >= groups.size()) groups.resize(name.size() + 1);
+			Group& group = groups[name.size()];
+			locations.push_back(Location{ uint32_t(name.size()), uint32_t(group.signatures.size()) });
+			group.pool.append(name);
+			group.signatures.emplace_back(name);
+
+			if (!postings.empty()) post(uint32_t(locations.size() - 1));
+			else if (locations.size() == posting_threshold)
+			{
+				postings.resize(posting_buckets);
+				for (uint32_t id = 0; id < locations.size(); ++id) post(id);
+			}
+		}
+
+		size_t size() const { return locations.size(); }
+
+		// Up to limit names starting with prefix, shortest first, then in byte order.
+		std::vector<std::string> complete(std::string_view prefix, size_t limit = 10) const
+		{
+			std::vector<std::string> result;
+			std::vector<std::string_view> found;
+			for (size_t length = prefix.size(); length < groups.size() && result.size() < limit; ++length)
+			{
+				const Group& group = groups[length];
+				found.clear();
+				for (size_t idx = 0; idx < group.signatures.size(); ++idx)
+				{
+					const std::string_view name(group.pool.data() + idx * length, length);
+					if (name.compare(0, prefix.size(), prefix) == 0) found.push_back(name);
+				}
+				std::sort(found.begin(), found.end());
+				for (size_t idx = 0; idx < found.size() && result.size() < limit; ++idx) result.emplace_back(found[idx]);
+			}
+			return result;
+		}
+
+		// Up to limit names within max_distance edits of query, closest first; ties prefer a
+		// longer common prefix, then a length nearer to the query's. By default a third of the
+		// query's length is allowed, between one and three edits.
+		std::vector<Suggestion> suggest(std::string_view query, size_t limit = 3, size_t max_distance = npos) const
+		{
+			if (limit == 0) return {};
+			if (max_distance == npos) max_distance = std::clamp<size_t>(query.size() / 3, 1, 3);
+
+			std::vector<Candidate> best;
+			const detail::EditDistance distance(query);
+			const detail::NameSignature query_signature(query);
+			auto consider = [&](size_t length, size_t idx)
+				{
+					// Once the list is full, only names that can beat its last entry are worth a look.
+					const size_t allowed = best.size() < limit ? max_distance : best.back().distance;
+					const size_t length_gap = length > query.size() ? length - query.size() : query.size() - length;
+					if (length_gap > allowed || !groups[length].signatures[idx].within(query_signature, allowed)) return;
+
+					const std::string_view name(groups[length].pool.data() + idx * length, length);
+					const size_t dist = distance(name, allowed);
+					if (dist > allowed) return;
+
+					const Candidate candidate{ name, dist, detail::common_prefix(query, name), length_gap };
+					if (best.size() == limit && !(candidate < best.back())) return;
+					if (best.size() == limit) best.pop_back();
+					best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+				};
+
+			std::vector<const std::vector<uint32_t>*> lists;
+			if (select_postings(query, max_distance, lists)) merge(lists, [&](uint32_t id) { consider(locations[id].length, locations[id].index); });
+			else
+			{
+				const size_t shortest = query.size() > max_distance ? query.size() - max_distance : 0;
+				for (size_t length = shortest; length < groups.size() && length <= query.size() + max_distance; ++length)
+					for (size_t idx = 0; idx < groups[length].signatures.size(); ++idx) consider(length, idx);
+			}
+
+			std::vector<Suggestion> result;
+			result.reserve(best.size());
+			for (const Candidate& candidate : best) result.push_back(Suggestion{ std::string(candidate.name), candidate.distance });
+			return result;
+		}
+
+	private:
+		static constexpr size_t posting_threshold = 256;
+		static constexpr size_t posting_buckets = 1 << 14;
+
+		struct Group
+		{
+			std::string pool;
+			std::vector<detail::NameSignature> signatures;
+		};
+
+		struct Location
+		{
+			uint32_t length;
+			uint32_t index;
+		};
+
+		struct Candidate
+		{
+			std::string_view name;
+			size_t distance;
+			size_t prefix;
+			size_t length_gap;
+
+			bool operator<(const Candidate& other) const
+			{
+				if (distance != other.distance) return distance < other.distance;
+				if (prefix != other.prefix) return prefix > other.prefix;
+				if (length_gap != other.length_gap) return length_gap < other.length_gap;
+				return name < other.name;
+			}
+		};
+
+		// Posting bucket of the bigram (size 2) or trigram (size 3) at text.
+		static size_t bucket_of(const char* text, size_t size)
+		{
+			uint32_t key = uint32_t(static_cast<unsigned char>(text[0])) | uint32_t(static_cast<unsigned char>(text[1])) << 8;
+			key |= size == 3 ? uint32_t(static_cast<unsigned char>(text[2])) << 16 : 0xff000000u;
+			return (key * 2654435761u) >> (32 - 14);
+		}
+
+		// Lists are in id order, so a name seen twice is at the back of the list already.
+		void post(uint32_t id)
+		{
+			const Location location = locations[id];
+			const char* name = groups[location.length].pool.data() + size_t(location.index) * location.length;
+			for (size_t pos = 0; pos + 2 <= location.length; ++pos)
+				for (size_t size = 2; size <= 3 && pos + size <= location.length; ++size)
+				{
+					std::vector<uint32_t>& list = postings[bucket_of(name + pos, size)];
+					if (list.empty() || list.back() != id) list.push_back(id);
+				}
+		}
+
+		// For each of the max_distance + 1 pieces of query, the shortest posting list among its
+		// grams. False when there are no postings or a piece is shorter than two bytes.
+		bool select_postings(std::string_view query, size_t max_distance, std::vector<const std::vector<uint32_t>*>& lists) const
+		{
+			const size_t pieces = max_distance + 1;
+			const size_t piece = query.size() / pieces;
+			if (postings.empty() || piece < 2) return false;
+
+			for (size_t idx = 0; idx < pieces; ++idx)
+			{
+				const size_t begin = idx * piece;
+				const size_t end = idx + 1 == pieces ? query.size() : begin + piece;
+				const size_t size = end - begin >= 3 ? 3 : 2;
+				const std::vector<uint32_t>* shortest = nullptr;
+				for (size_t pos = begin; pos + size <= end; ++pos)
+				{
+					const std::vector<uint32_t>& list = postings[bucket_of(query.data() + pos, size)];
+					if (!shortest || list.size() < shortest->size()) shortest = &list;
+				}
+				lists.push_back(shortest);
+			}
+			return true;
+		}
+
+		// Visits the union of the sorted lists in id order, each id once.
+		template<typename Fn>
+		static void merge(const std::vector<const std::vector<uint32_t>*>& lists, Fn&& fn)
+		{
+			std::vector<size_t> cursors(lists.size(), 0);
+			while (true)
+			{
+				uint32_t next = UINT32_MAX;
+				for (size_t idx = 0; idx < lists.size(); ++idx)
+					if (cursors[idx] < lists[idx]->size()) next = std::min(next, (*lists[idx])[cursors[idx]]);
+				if (next == UINT32_MAX) return;
+
+				fn(next);
+				for (size_t idx = 0; idx < lists.size(); ++idx)
+					if (cursors[idx] < lists[idx]->size() && (*lists[idx])[cursors[idx]] == next) cursors[idx]++;
+			}
+		}
+
+	private:
+		std::vector<Group> groups;
+		std::vector<Location> locations;
+		std::vector<std::vector<uint32_t>> postings;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_SUGGEST
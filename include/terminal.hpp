@@ -1,50 +1,713 @@
 #ifndef INCLUDE_CMDKIT_TERMINAL
 #define INCLUDE_CMDKIT_TERMINAL
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <stdexcept>
 #include <type_traits>
+#include <unordered_map>
 
 #include "command.hpp"
+#include "history.hpp"
+#include "mapped_file.hpp"
+#include "memo.hpp"
+#include "middleware.hpp"
+#include "output.hpp"
+#include "plugin.hpp"
+#include "thread_pool.hpp"
+#include "trie.hpp"
 
 namespace cmdkit
 {
-	class Terminal
+	enum class ScriptPolicy { stop_on_error, continue_on_error };
+
+	struct ScriptError
+	{
+		size_t line;
+		std::string message;
+	};
+
+	struct ScriptReport
+	{
+		size_t lines = 0;
+		size_t executed = 0;
+		std::vector<ScriptError> errors;
+
+		bool ok() const { return errors.empty(); }
+	};
+
+	// Terminal whose dispatch runs through the given compile-time middleware layers (see
+	// middleware.hpp). Terminal itself has none; runtime interceptors work on either.
+	template<typename... Middleware>
+	class BasicTerminal
 	{
 	public:
-		void register_command(const std::string& name, Command cmd) { command_table[name] = cmd; }
-		void register_command(Command cmd) { command_table[cmd.get_name()] = cmd; }
+		BasicTerminal() = default;
+
+		template<typename... Layers, std::enable_if_t<sizeof...(Layers) != 0 && std::is_constructible_v<MiddlewareChain<Middleware...>, Layers&&...>, int> = 0>
+		explicit BasicTerminal(Layers&&... middleware) : chain(std::forward<Layers>(middleware)...) {}
 
+		void register_command(const std::string& name, Command cmd)
+		{
+			if (const Command* old = command_table.find(name); old && !lazy.empty())
+				if (auto entry = lazy.find(old); entry != lazy.end()) entry->second.built = true;
+			insert(name, std::move(cmd));
+		}
 
-		void invoke(const CommandArgs& command) const
+		void register_command(Command cmd)
 		{
-			invoke(command, []() { throw std::runtime_error("Not find command!"); } );
+			const std::string name = cmd.get_name();
+			register_command(name, std::move(cmd));
+		}
+
+		// Registers a placeholder with the name and description only; factory builds the real
+		// command when the name is first looked up for dispatch, and it replaces the placeholder
+		// in place, keeping the placeholder's description if it has none. Listings show the
+		// placeholder until then. If the factory throws, the next lookup calls it again.
+		void register_lazy_command(const std::string& name, const std::string& description, CommandFactory factory)
+		{
+			Command stub;
+			stub.get_name(name);
+			stub.get_description(description);
+			Command& slot = insert(name, std::move(stub));
+			lazy.insert_or_assign(&slot, LazyCommand{ &slot, std::move(factory), false });
+		}
+
+		// Registers the commands of a plugin library (see plugin.hpp) without loading it. The
+		// library is opened when one of them is first dispatched, and stays loaded for the
+		// lifetime of the terminal. If it can't be loaded, its commands fail with the reason.
+		void register_plugin(const std::string& path, const std::vector<PluginCommand>& commands)
+		{
+			auto plugin = std::make_shared<detail::LazyPlugin>(path);
+			for (const PluginCommand& command : commands)
+				register_lazy_command(command.name, command.description, [plugin, command]() { return plugin->make_command(command.name, command.description); });
+		}
+
+		// When enabled, a name that is not registered resolves to the only command it is a prefix of.
+		void set_abbreviation(bool enabled) { abbreviation = enabled; }
+		bool get_abbreviation() const { return abbreviation; }
+
+
+		Result<void*, std::string> invoke(const CommandArgs& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); } );
 		}
 		
 		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
-		void invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		Result<void*, std::string> invoke(const CommandArgs& command, Fn&& not_find_callback) const
+		{
+			return dispatch(command, std::forward<Fn>(not_find_callback));
+		}
+
+		Result<void*, std::string> invoke(const CommandArgsView& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
+		Result<void*, std::string> invoke(const CommandArgsView& command, Fn&& not_find_callback) const
 		{
-			auto it = command_table.find(command[0]);
-			if (it != command_table.end()) (it->second).invoke(command);
-			else std::invoke(std::forward<Fn>(not_find_callback));
+			return dispatch(command, std::forward<Fn>(not_find_callback));
 		}
 
+		// A line with a standalone `|` runs as a pipeline (see pipe); its result is the last
+		// stage's value if that is a void*, and null otherwise.
 		template<typename Fn, std::enable_if_t<std::is_invocable_v<Fn>, int> = 0>
-		void invoke(const std::string& command, Fn&& not_find_callback) const
+		Result<void*, std::string> invoke(const std::string& command, Fn&& not_find_callback) const
+		{
+			if (history) history->record(command);
+			if (detail::find_pipe(command) != std::string::npos)
+			{
+				auto result = run_pipeline(command, std::forward<Fn>(not_find_callback));
+				if (result.is_err()) return Result<void*, std::string>::err(std::move(result).unwrap_err());
+				void* const* ptr = result.unwrap().template get<void*>();
+				return Result<void*, std::string>::ok(ptr ? *ptr : nullptr);
+			}
+
+			const Command* cmd = find_first_token(command);
+			if (!cmd)
+			{
+				std::invoke(std::forward<Fn>(not_find_callback));
+				return Result<void*, std::string>::err("Not find command!");
+			}
+
+			ParseContext& context = ParseContext::local();
+			ParseContext::Scope scope(context);
+			CommandArgsView args = cmd->parse_args(command, context.resource());
+			OutputSink::Scope redirect(dispatch_output());
+			return execute(*cmd, args);
+		}
+
+		Result<void*, std::string> invoke(const std::string& command) const
+		{
+			return invoke(command, []() { throw std::runtime_error("Not find command!"); });
+		}
+
+	public:
+		// Runs `cmdA args | cmdB args | ...`: each stage's value is moved into the next stage
+		// (see Command::PipeHandler), and the first error ends the pipeline. Stages are parsed
+		// and run one at a time, each in a fresh scope of the parse context, so a payload must
+		// not borrow from its stage's arguments other than the line itself. A single stage
+		// without `|` is a pipeline of one.
+		Result<Payload, std::string> pipe(std::string_view line) const
+		{
+			return run_pipeline(line, []() {});
+		}
+
+	public:
+		// Runs one command per line of a memory-mapped file. Blank lines and lines starting
+		// with '#' are skipped; failures are collected with their 1-based line numbers.
+		Result<ScriptReport, std::string> run_script(const std::string& path, ScriptPolicy policy = ScriptPolicy::stop_on_error) const
+		{
+			auto file = MappedFile::open(path);
+			if (file.is_err()) return Result<ScriptReport, std::string>::err(std::move(file).unwrap_err());
+			return Result<ScriptReport, std::string>::ok(run_lines(file.unwrap().view(), policy));
+		}
+
+		ScriptReport run_lines(std::string_view script, ScriptPolicy policy = ScriptPolicy::stop_on_error) const
+		{
+			OutputSink& sink = dispatch_output();
+			OutputSink::Scope redirect(sink);
+			ScriptReport report;
+			std::string unquoted;
+			size_t pos = 0;
+			while (pos < script.size())
+			{
+				const char* newline = static_cast<const char*>(std::memchr(script.data() + pos, '\n', script.size() - pos));
+				const size_t end = newline ? size_t(newline - script.data()) : script.size();
+				const std::string_view line = script.substr(pos, end - pos);
+				pos = end + 1;
+				report.lines++;
+
+				const std::optional<std::string_view> first = detail::first_arg(line, unquoted);
+				if (!first || first->substr(0, 1) == "#") continue;
+
+				const Command* cmd = find(*first);
+				report.executed++;
+
+				std::optional<std::string> error;
+				if (!cmd) error = not_found(*first);
+				else
+				{
+					ParseContext& context = ParseContext::local();
+					ParseContext::Scope scope(context);
+					CommandArgsView args = cmd->parse_args(line, context.resource());
+					if (auto result = execute(*cmd, args); result.is_err()) error = std::move(result).unwrap_err();
+				}
+
+				if (!error) continue;
+				report.errors.push_back(ScriptError{ report.lines, std::move(*error) });
+				if (policy == ScriptPolicy::stop_on_error) break;
+			}
+			sink.flush();
+			return report;
+		}
+
+	public:
+		// Runs independent commands on the thread pool and returns their results in input order.
+		// Parallel-safe commands are spread across workers; once they have all finished, the
+		// others run one at a time, in input order, on the calling thread, so they never overlap
+		// with a parallel one. Exceptions from handlers become error results.
+		std::vector<Result<void*, std::string>> invoke_batch(const std::vector<std::string>& lines) const
+		{
+			return run_batch(lines.size(), [this, &lines](size_t idx) { return find_first_token(lines[idx]); },
+				[this, &lines](const Command& cmd, size_t idx)
+				{
+					ParseContext& local = ParseContext::local();
+					ParseContext::Scope scope(local);
+					CommandArgsView args = cmd.parse_args(lines[idx], local.resource());
+					return execute(cmd, args);
+				});
+		}
+
+		std::vector<Result<void*, std::string>> invoke_batch(const std::vector<CommandArgs>& commands) const
+		{
+			return run_batch(commands.size(),
+				[this, &commands](size_t idx) { return commands[idx].get_positional().empty() ? nullptr : find(commands[idx][0]); },
+				[this, &commands](const Command& cmd, size_t idx) { return execute(cmd, commands[idx]); });
+		}
+
+		void set_thread_pool(std::shared_ptr<WorkStealingPool> val) { pool = std::move(val); }
+		const std::shared_ptr<WorkStealingPool>& get_thread_pool() const { if (!pool) pool = std::make_shared<WorkStealingPool>(); return pool; }
+
+	public:
+		// Queues the line on the terminal's event loop; it is parsed and dispatched by run().
+		// Async commands interleave on the loop thread, synchronous ones complete in place.
+		void invoke_async(const std::string& command, Command::Completion done) const
+		{
+			EventLoop& loop = get_event_loop();
+			loop.post([this, &loop, command, done = std::move(done)]() mutable
+				{
+					OutputSink::Scope redirect(dispatch_output());
+					CommandArgs args = CommandArgs::parse(command);
+					const Command* cmd = args.get_positional().empty() ? nullptr : find(args[0]);
+					if (!cmd) done(Result<void*, std::string>::err("Not find command!"));
+					else if (chain.empty()) cmd->invoke_async(std::move(args), loop, measured_completion(*cmd, std::move(done)));
+					else execute_async(*cmd, args, loop, std::move(done));
+				});
+		}
+
+		size_t run() const { return get_event_loop().run(); }
+
+		EventLoop& get_event_loop() const { if (!event_loop) event_loop = std::make_shared<EventLoop>(); return *event_loop; }
+
+	public:
+		// Where handlers write: OutputSink::current() is this sink while the terminal dispatches
+		// on a thread, including batch workers, unless the caller installed one first (as
+		// TerminalServer does per connection). Scripts and batches flush it when they finish;
+		// a REPL should ask for input through prompt(). Defaults to OutputSink::standard().
+		// Async handlers that resume later should hold on to get_output() themselves.
+		void set_output(std::shared_ptr<OutputSink> val) { output = std::move(val); }
+		OutputSink& get_output() const { return output ? *output : OutputSink::standard(); }
+
+		Result<void, std::string> prompt(std::string_view text) const { return get_output().prompt(text); }
+
+	public:
+		// Lines passed to invoke(std::string) are recorded here before they run, whether or not
+		// they succeed; script lines and pre-parsed CommandArgs are not. Off (null) by default.
+		void set_history(std::shared_ptr<CommandHistory> val) { history = std::move(val); }
+		const std::shared_ptr<CommandHistory>& get_history() const { return history; }
+
+	private:
+		OutputSink& dispatch_output() const
+		{
+			OutputSink* installed = OutputSink::installed();
+			return installed ? *installed : get_output();
+		}
+
+	public:
+		// Completes the last word of line: a command name when it is the first word (of the
+		// last pipeline stage), or a declared --option of that stage's command. Returns whole
+		// words, shortest first.
+		std::vector<std::string> complete(std::string_view line, size_t limit = 10) const
+		{
+			for (size_t bar; (bar = detail::find_pipe(line)) != std::string_view::npos;) line.remove_prefix(bar + 1);
+
+			size_t word = line.size();
+			while (word > 0 && !detail::is_space(line[word - 1])) word--;
+			const std::string_view prefix = line.substr(word);
+
+			size_t first = 0;
+			while (first < word && detail::is_space(line[first])) first++;
+			if (first == word) return command_names.complete(prefix, limit);
+
+			size_t first_end = first;
+			while (first_end < word && !detail::is_space(line[first_end])) first_end++;
+			const Command* cmd = prefix.empty() || prefix[0] != '-' ? nullptr : find(line.substr(first, first_end - first));
+			if (!cmd || !cmd->get_schema()) return {};
+
+			std::vector<std::string> words = cmd->get_schema()->get_names().complete(prefix.substr(prefix.size() > 1 && prefix[1] == '-' ? 2 : 1), limit);
+			for (std::string& name : words) name.insert(0, "--");
+			return words;
+		}
+
+		// Registered commands within a few edits of name, closest first, for "did you mean".
+		std::vector<Suggestion> suggest(std::string_view name, size_t limit = 3) const { return command_names.suggest(name, limit); }
+
+	public:
+		// Builds the command first if it was registered lazily.
+		const Command* find(std::string_view name) const
+		{
+			const Command* cmd = command_table.find(name);
+			if (!cmd && abbreviation) cmd = command_table.find_unique_prefix(name);
+			return cmd && !cmd->has_handler() ? materialize(*cmd) : cmd;
+		}
+
+		const Command* resolve(std::string_view prefix) const
+		{
+			const Command* cmd = command_table.find_unique_prefix(prefix);
+			return cmd && !cmd->has_handler() ? materialize(*cmd) : cmd;
+		}
+
+		std::vector<std::string> list_commands(std::string_view prefix = {}) const
 		{
-			return invoke(CommandArgs::parse(command), not_find_callback);
+			std::vector<std::string> names;
+			for_each_command(prefix, [&names](std::string_view name, const Command&) { names.emplace_back(name); });
+			return names;
 		}
 
-		void invoke(const std::string& command) const
+		template<typename Fn>
+		void for_each_command(std::string_view prefix, Fn&& fn) const { command_table.for_each_prefix(prefix, std::forward<Fn>(fn)); }
+
+		size_t size() const { return command_table.size(); }
+
+	public:
+		// Runtime middleware, run after the compile-time layers. Like register_command, these
+		// are not synchronized with dispatch and belong to setup.
+		void add_interceptor(Interceptor hook) { chain.add(std::move(hook)); }
+		void clear_interceptors() { chain.clear(); }
+		size_t interceptor_count() const { return chain.interceptor_count(); }
+
+		template<size_t I>
+		auto& middleware() { return chain.template layer<I>(); }
+
+		template<size_t I>
+		const auto& middleware() const { return chain.template layer<I>(); }
+
+	public:
+		// Results of idempotent commands, reused while their arguments compare equal. Only
+		// synchronous dispatch is memoized, and only successful results; a hit still passes
+		// through the middleware chain but skips the handler and its metrics.
+		void set_memo_limits(size_t max_bytes, MemoCache::Clock::duration ttl = MemoCache::Clock::duration::zero()) { memo.set_limits(max_bytes, ttl); }
+
+		bool invalidate(std::string_view name)
+		{
+			const Command* cmd = command_table.find(name);
+			if (cmd) memo.invalidate(*cmd);
+			return cmd != nullptr;
+		}
+
+		void invalidate_all() { memo.clear(); }
+
+		MemoStats memo_stats() const { return memo.stats(); }
+		void reset_memo_stats() { memo.reset_stats(); }
+
+	public:
+		// Per-command call counts, ok/err counts and latency histograms, recorded around every
+		// dispatch when built with CMDKIT_ENABLE_METRICS. Without it these are no-ops and
+		// the snapshot is empty.
+		void set_metrics_enabled([[maybe_unused]] bool enabled)
+		{
+#if CMDKIT_ENABLE_METRICS
+			metrics_enabled = enabled;
+#endif
+		}
+
+		bool get_metrics_enabled() const
+		{
+#if CMDKIT_ENABLE_METRICS
+			return metrics_enabled;
+#else
+			return false;
+#endif
+		}
+
+		// Commands that have been called at least once, in name order.
+		MetricsSnapshot metrics() const
+		{
+			MetricsSnapshot snapshot;
+			command_table.for_each([&snapshot](std::string_view name, const Command& cmd)
+				{
+					if (const CommandMetrics* stats = cmd.get_metrics()) snapshot.commands.push_back(stats->snapshot(std::string(name)));
+				});
+			return snapshot;
+		}
+
+		void reset_metrics()
 		{
-			return invoke(CommandArgs::parse(command), []() { throw std::runtime_error("Not find command!"); });
+			command_table.for_each([](std::string_view, const Command& cmd) { cmd.reset_metrics(); });
 		}
 
 	private:
-		std::map<std::string, Command> command_table;
+		template<typename Fn>
+		std::invoke_result_t<Fn> measured([[maybe_unused]] const Command& cmd, Fn&& fn) const
+		{
+#if CMDKIT_ENABLE_METRICS
+			if (metrics_enabled)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				auto elapsed = [&start]() { return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()); };
+				try
+				{
+					std::invoke_result_t<Fn> result = fn();
+					cmd.record_call(elapsed(), result.is_ok());
+					return result;
+				}
+				catch (...)
+				{
+					cmd.record_call(elapsed(), false);
+					throw;
+				}
+			}
+#endif
+			return fn();
+		}
+
+		// Async commands are timed from dispatch to completion.
+		Command::Completion measured_completion([[maybe_unused]] const Command& cmd, Command::Completion done) const
+		{
+#if CMDKIT_ENABLE_METRICS
+			if (metrics_enabled)
+			{
+				return [&cmd, start = std::chrono::steady_clock::now(), done = std::move(done)](Result<void*, std::string> result)
+					{
+						cmd.record_call(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), result.is_ok());
+						done(std::move(result));
+					};
+			}
+#endif
+			return done;
+		}
+
+		// Middleware works on a mutable view. Views the terminal parsed itself are passed as is;
+		// a caller's args are copied into the thread's parse context first, and only when the
+		// chain is not empty. Commands with a schema are bound before the chain so that
+		// rewrites land in their slots; args that fail validation go through unbound and the
+		// command reports the error.
+		Result<void*, std::string> execute(const Command& cmd, CommandArgsView& args) const
+		{
+			if (chain.empty()) return call(cmd, static_cast<const CommandArgsView&>(args));
+
+			return with_schema(cmd, args, [this, &cmd](CommandArgsView& view)
+				{
+					return chain.run(cmd, view, [this, &cmd](const CommandArgsView& rewritten) { return call(cmd, rewritten); });
+				});
+		}
+
+		template<typename Run>
+		static auto with_schema(const Command& cmd, CommandArgsView& args, Run&& run)
+		{
+			if (const ArgSchema* schema = cmd.get_schema(); schema && args.get_schema() != schema)
+			{
+				if (auto bound = cmd.bind_schema(args); bound.is_ok())
+				{
+					CommandArgsView view = std::move(bound).unwrap();
+					return run(view);
+				}
+			}
+			return run(args);
+		}
+
+		// A stage passes through the middleware chain like a command. after() hooks see its
+		// result as a null pointer or the error; one that turns it into an error stops the
+		// pipeline, one that clears an error passes on an empty payload. Stages are not memoized.
+		Result<Payload, std::string> execute_stage(const Command& cmd, CommandArgsView& args, Payload&& input) const
+		{
+			using P = Result<Payload, std::string>;
+			if (chain.empty()) return measured(cmd, [&]() { return cmd.pipe(args, std::move(input)); });
+
+			return with_schema(cmd, args, [this, &cmd, &input](CommandArgsView& view)
+				{
+					std::optional<Result<void*, std::string>> status;
+					std::optional<P> result;
+					const size_t entered = chain.enter(cmd, view, status);
+					if (!status)
+					{
+						result.emplace(measured(cmd, [&]() { return cmd.pipe(view, std::move(input)); }));
+						status.emplace(result->is_ok() ? Result<void*, std::string>::ok(nullptr) : Result<void*, std::string>::err(result->unwrap_err()));
+					}
+					chain.leave(entered, cmd, view, *status);
+
+					if (status->is_err()) return P::err(std::move(*status).unwrap_err());
+					return result && result->is_ok() ? std::move(*result) : P::ok(Payload());
+				});
+		}
+
+		template<typename Fn>
+		Result<Payload, std::string> run_pipeline(std::string_view line, Fn&& not_find_callback) const
+		{
+			using P = Result<Payload, std::string>;
+
+			OutputSink::Scope redirect(dispatch_output());
+			Payload value;
+			std::string unquoted;
+			for (size_t pos = 0;;)
+			{
+				const size_t bar = detail::find_pipe(line, pos);
+				const std::string_view stage = line.substr(pos, bar == std::string_view::npos ? bar : bar - pos);
+
+				const std::optional<std::string_view> first = detail::first_arg(stage, unquoted);
+				if (!first) return P::err("Empty pipeline stage");
+
+				const Command* cmd = find(*first);
+				if (!cmd)
+				{
+					std::invoke(not_find_callback);
+					return P::err(not_found(*first));
+				}
+
+				ParseContext& context = ParseContext::local();
+				ParseContext::Scope scope(context);
+				CommandArgsView args = cmd->parse_args(stage, context.resource());
+				P result = execute_stage(*cmd, args, std::move(value));
+				if (result.is_err() || bar == std::string_view::npos) return result;
+				value = std::move(result).unwrap();
+				pos = bar + 1;
+			}
+		}
+
+		template<typename Args>
+		Result<void*, std::string> execute(const Command& cmd, const Args& args) const
+		{
+			if (chain.empty()) return call(cmd, args);
+
+			ParseContext& local = ParseContext::local();
+			ParseContext::Scope scope(local);
+			CommandArgsView view = copy_view(args, local.resource());
+			return execute(cmd, view);
+		}
+
+		template<typename Args>
+		Result<void*, std::string> call(const Command& cmd, const Args& args) const
+		{
+			if (!cmd.is_idempotent()) return measured(cmd, [&]() { return cmd.invoke(args); });
+
+			const uint64_t key = args.hash();
+			if (std::optional<void*> hit = memo.find(cmd, args, key)) return Result<void*, std::string>::ok(*hit);
+			Result<void*, std::string> result = measured(cmd, [&]() { return cmd.invoke(args); });
+			if (result.is_ok()) memo.insert(cmd, args, key, result.unwrap());
+			return result;
+		}
+
+		static CommandArgsView copy_view(const CommandArgs& args, std::pmr::memory_resource* resource) { return args.view(resource); }
+		static CommandArgsView copy_view(const CommandArgsView& args, std::pmr::memory_resource* resource) { return CommandArgsView(args, resource); }
+
+		// Async commands leave the chain when they complete, with the args as rewritten on entry.
+		void execute_async(const Command& cmd, const CommandArgs& args, EventLoop& loop, Command::Completion done) const
+		{
+			ParseContext& local = ParseContext::local();
+			ParseContext::Scope scope(local);
+			CommandArgsView view = args.view(local.resource());
+
+			std::optional<Result<void*, std::string>> shortcut;
+			const size_t entered = chain.enter(cmd, view, shortcut);
+			if (shortcut)
+			{
+				chain.leave(entered, cmd, view, *shortcut);
+				done(std::move(*shortcut));
+				return;
+			}
+
+			auto rewritten = std::make_shared<const CommandArgs>(view.to_owned());
+			cmd.invoke_async(*rewritten, loop, measured_completion(cmd, [this, &cmd, entered, rewritten, done = std::move(done)](Result<void*, std::string> result)
+				{
+					ParseContext& local = ParseContext::local();
+					ParseContext::Scope scope(local);
+					chain.leave(entered, cmd, rewritten->view(local.resource()), result);
+					done(std::move(result));
+				}));
+		}
+
+		template<typename Args, typename Fn>
+		Result<void*, std::string> dispatch(Args& command, Fn&& not_find_callback) const
+		{
+			const Command* cmd = command.get_positional().empty() ? nullptr : find(command[0]);
+			if (cmd)
+			{
+				OutputSink::Scope redirect(dispatch_output());
+				return execute(*cmd, command);
+			}
+
+			std::invoke(std::forward<Fn>(not_find_callback));
+			return Result<void*, std::string>::err("Not find command!");
+		}
+
+		Command& insert(const std::string& name, Command cmd)
+		{
+			// The replacement takes over the old command's address, so its results must go.
+			if (const Command* old = command_table.find(name)) memo.invalidate(*old);
+			else command_names.add(name);
+			return command_table.insert_or_assign(name, std::move(cmd));
+		}
+
+		// Like dispatch, this is not synchronized: lookups from several threads at once must not
+		// race on a command that is still a placeholder.
+		const Command* materialize(const Command& stub) const
+		{
+			auto entry = lazy.find(&stub);
+			if (entry == lazy.end() || entry->second.built) return &stub;
+
+			LazyCommand& lazy_command = entry->second;
+			Command cmd = lazy_command.factory();
+			cmd.get_name(stub.get_name());
+			if (cmd.get_description().empty()) cmd.get_description(stub.get_description());
+			*lazy_command.slot = std::move(cmd);
+			lazy_command.built = true;
+			return lazy_command.slot;
+		}
+
+		std::string not_found(std::string_view name) const
+		{
+			std::string message = "Not find command: " + std::string(name);
+			if (auto near = command_names.suggest(name, 1); !near.empty()) message += ", did you mean " + near.front().name + "?";
+			return message;
+		}
+
+		// Lines are dispatched on their first token, which is all that is lexed to find the command.
+		const Command* find_first_token(std::string_view line) const
+		{
+			std::string unquoted;
+			const std::optional<std::string_view> first = detail::first_arg(line, unquoted);
+			return first ? find(*first) : nullptr;
+		}
+
+		template<typename FindFn, typename RunFn>
+		std::vector<Result<void*, std::string>> run_batch(size_t count, FindFn&& find_command, RunFn&& run) const
+		{
+			using R = Result<void*, std::string>;
+
+			std::vector<const Command*> targets(count);
+			std::vector<size_t> parallel, serial;
+			for (size_t idx = 0; idx < count; ++idx)
+			{
+				targets[idx] = find_command(idx);
+				if (targets[idx]) (targets[idx]->is_parallel_safe() ? parallel : serial).push_back(idx);
+			}
+
+			std::vector<std::optional<R>> slots(count);
+			auto execute = [&](size_t idx)
+				{
+					try { slots[idx].emplace(measured(*targets[idx], [&]() { return run(*targets[idx], idx); })); }
+					catch (const std::exception& e) { slots[idx].emplace(R::err(e.what())); }
+					catch (...) { slots[idx].emplace(R::err("Unknown exception")); }
+				};
+
+			OutputSink& sink = dispatch_output();
+			WorkStealingPool& workers = *get_thread_pool();
+			WorkStealingPool::TaskGroup group;
+			const size_t chunk = std::max<size_t>(1, parallel.size() / (workers.size() * 4));
+			for (size_t begin = 0; begin < parallel.size(); begin += chunk)
+			{
+				const size_t end = std::min(parallel.size(), begin + chunk);
+				workers.submit(group, [&, begin, end]() { OutputSink::Scope redirect(sink); for (size_t pos = begin; pos < end; ++pos) execute(parallel[pos]); });
+			}
+			workers.wait(group);
+
+			if (!serial.empty())
+			{
+				OutputSink::Scope redirect(sink);
+				for (size_t idx : serial) execute(idx);
+			}
+			sink.flush();
+
+			std::vector<R> results;
+			results.reserve(count);
+			for (auto& slot : slots) results.push_back(slot ? std::move(*slot) : R::err("Not find command!"));
+			return results;
+		}
+
+	private:
+		struct LazyCommand
+		{
+			Command* slot;
+			CommandFactory factory;
+			bool built;
+		};
+
+		// Keyed by the placeholder's slot in the table. Declared before the table so that
+		// factories, and the plugin libraries they hold, outlive the commands they built.
+		mutable std::unordered_map<const Command*, LazyCommand> lazy;
+		RadixTree<Command> command_table;
+		NameIndex command_names;
+		bool abbreviation = false;
+		MiddlewareChain<Middleware...> chain;
+		mutable MemoCache memo;
+#if CMDKIT_ENABLE_METRICS
+		bool metrics_enabled = true;
+#endif
+		mutable std::shared_ptr<WorkStealingPool> pool;
+		mutable std::shared_ptr<EventLoop> event_loop;
+		std::shared_ptr<OutputSink> output;
+		std::shared_ptr<CommandHistory> history;
 	};
+
+	using Terminal = BasicTerminal<>;
 }
 
 #endif // INCLUDE_CMDKIT_TERMINAL
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef INCLUDE_CMDKIT_THREAD_POOL
+#define INCLUDE_CMDKIT_THREAD_POOL
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cmdkit
+{
+	// Fixed-size pool where each worker owns a deque: it pops its own newest task and, when
+	// empty, steals the oldest task of another worker. Threads waiting on a TaskGroup run
+	// queued tasks instead of sleeping, so nested batches never starve the pool.
+	class WorkStealingPool
+	{
+	public:
+		class TaskGroup
+		{
+		public:
+			bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+		private:
+			std::atomic<size_t> pending{ 0 };
+			friend class WorkStealingPool;
+		};
+
+		explicit WorkStealingPool(size_t thread_count = std::thread::hardware_concurrency())
+		{
+			if (thread_count == 0) thread_count = 1;
+			for (size_t idx = 0; idx < thread_count; ++idx) queues.push_back(std::make_unique<Queue>());
+			for (size_t idx = 0; idx < thread_count; ++idx) workers.emplace_back([this, idx]() { worker_loop(idx); });
+		}
+
+		~WorkStealingPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (auto& worker : workers) worker.join();
+		}
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	public:
+		size_t size() const { return workers.size(); }
+
+		void submit(std::function<void()> task)
+		{
+			const size_t home = current_pool == this ? current_worker : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+			{
+				std::lock_guard<std::mutex> lock(queues[home]->mutex);
+				queues[home]->tasks.push_back(std::move(task));
+			}
+			queued.fetch_add(1, std::memory_order_release);
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+			}
+			wake.notify_one();
+		}
+
+		void submit(TaskGroup& group, std::function<void()> task)
+		{
+			group.pending.fetch_add(1, std::memory_order_relaxed);
+			submit([this, &group, task = std::move(task)]()
+				{
+					struct Done
+					{
+						WorkStealingPool& pool;
+						TaskGroup& group;
+						~Done() { if (group.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) pool.notify_all(); }
+					} done{ *this, group };
+					task();
+				});
+		}
+
+		// Runs queued tasks on the calling thread until every task of the group has finished.
+		void wait(TaskGroup& group)
+		{
+			const size_t home = current_pool == this ? current_worker : 0;
+			while (!group.done())
+			{
+				if (try_run_one(home)) continue;
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				wake.wait_for(lock, std::chrono::milliseconds(1), [&]() { return queued.load(std::memory_order_acquire) > 0 || group.done(); });
+			}
+		}
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void notify_all()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+			}
+			wake.notify_all();
+		}
+
+		bool try_run_one(size_t home)
+		{
+			std::function<void()> task;
+			if (!pop(home, task))
+			{
+				bool stolen = false;
+				for (size_t offset = 1; offset < queues.size() && !stolen; ++offset) stolen = steal((home + offset) % queues.size(), task);
+				if (!stolen) return false;
+			}
+
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			task();
+			return true;
+		}
+
+		bool pop(size_t idx, std::function<void()>& task)
+		{
+			std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+			if (queues[idx]->tasks.empty()) return false;
+			task = std::move(queues[idx]->tasks.back());
+			queues[idx]->tasks.pop_back();
+			return true;
+		}
+
+		bool steal(size_t idx, std::function<void()>& task)
+		{
+			std::unique_lock<std::mutex> lock(queues[idx]->mutex, std::try_to_lock);
+			if (!lock.owns_lock() || queues[idx]->tasks.empty()) return false;
+			task = std::move(queues[idx]->tasks.front());
+			queues[idx]->tasks.pop_front();
+			return true;
+		}
+
+		void worker_loop(size_t idx)
+		{
+			current_pool = this;
+			current_worker = idx;
+			while (true)
+			{
+				if (try_run_one(idx)) continue;
+
+				std::unique_lock<std::mutex> lock(sleep_mutex);
+				wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+				if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+			}
+		}
+
+	private:
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> queued{ 0 };
+		std::atomic<size_t> next_queue{ 0 };
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		static inline thread_local WorkStealingPool* current_pool = nullptr;
+		static inline thread_local size_t current_worker = 0;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_THREAD_POOL
\ No newline at end of file
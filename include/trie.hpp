@@ -0,0 +1,202 @@
+#ifndef INCLUDE_CMDKIT_TRIE
+#define INCLUDE_CMDKIT_TRIE
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cmdkit
+{
+	// Compact radix tree keyed by strings. Edge labels live in one shared pool (a split only
+	// re-slices it), nodes link to their first child and next sibling in byte order, and values
+	// sit in a deque so their addresses stay stable while the tree grows.
+	template<typename V>
+	class RadixTree
+	{
+	public:
+		V* find(std::string_view key) { return value_at(find_node(key, false).node); }
+		const V* find(std::string_view key) const { return value_at(find_node(key, false).node); }
+
+		// The exact match if there is one, otherwise the only value whose key starts with prefix.
+		const V* find_unique_prefix(std::string_view prefix) const
+		{
+			const Position pos = find_node(prefix, true);
+			uint32_t node = pos.node;
+			if (node == npos) return nullptr;
+			if (!pos.partial && nodes[node].value != npos) return &values[nodes[node].value];
+			if (nodes[node].count != 1) return nullptr;
+
+			while (nodes[node].value == npos) node = nodes[node].first_child;
+			return &values[nodes[node].value];
+		}
+
+		// Visits (key, value) for every key starting with prefix, in lexicographic order.
+		template<typename Fn>
+		void for_each_prefix(std::string_view prefix, Fn&& fn) const
+		{
+			const Position pos = find_node(prefix, true);
+			if (pos.node == npos) return;
+
+			std::string key(prefix.substr(0, prefix.size() - pos.consumed));
+			visit(pos.node, key, fn);
+		}
+
+		template<typename Fn>
+		void for_each(Fn&& fn) const { for_each_prefix({}, std::forward<Fn>(fn)); }
+
+		size_t size() const { return nodes[root].count; }
+		bool empty() const { return size() == 0; }
+
+		V& insert_or_assign(std::string_view key, V value)
+		{
+			if (V* existing = find(key)) return *existing = std::move(value);
+
+			uint32_t node = root;
+			size_t pos = 0;
+			nodes[node].count++;
+			while (pos < key.size())
+			{
+				uint32_t child = find_child(node, key[pos]);
+				if (child == npos)
+				{
+					child = make_node(uint32_t(labels.size()), uint32_t(key.size() - pos), key[pos]);
+					labels.append(key.substr(pos));
+					link_child(node, child);
+					node = child;
+					nodes[node].count++;
+					break;
+				}
+
+				const std::string_view label = label_of(child);
+				const std::string_view rest = key.substr(pos);
+				size_t common = 0;
+				while (common < label.size() && common < rest.size() && label[common] == rest[common]) common++;
+
+				if (common < label.size()) child = split(node, child, uint32_t(common));
+				node = child;
+				nodes[node].count++;
+				pos += common;
+			}
+
+			nodes[node].value = uint32_t(values.size());
+			values.push_back(std::move(value));
+			return values.back();
+		}
+
+	private:
+		static constexpr uint32_t npos = ~uint32_t(0);
+		static constexpr uint32_t root = 0;
+
+		struct Node
+		{
+			uint32_t label_offset;
+			uint32_t label_length;
+			uint32_t first_child;
+			uint32_t next_sibling;
+			uint32_t value;
+			uint32_t count; // values in this subtree
+			char first;
+		};
+
+		std::string_view label_of(uint32_t node) const { return std::string_view(labels).substr(nodes[node].label_offset, nodes[node].label_length); }
+
+		V* value_at(uint32_t node) { return node != npos && nodes[node].value != npos ? &values[nodes[node].value] : nullptr; }
+		const V* value_at(uint32_t node) const { return node != npos && nodes[node].value != npos ? &values[nodes[node].value] : nullptr; }
+
+		uint32_t make_node(uint32_t offset, uint32_t length, char first)
+		{
+			nodes.push_back(Node{ offset, length, npos, npos, npos, 0, first });
+			return uint32_t(nodes.size() - 1);
+		}
+
+		uint32_t find_child(uint32_t node, char ch) const
+		{
+			for (uint32_t child = nodes[node].first_child; child != npos; child = nodes[child].next_sibling)
+				if (nodes[child].first == ch) return child;
+			return npos;
+		}
+
+		void link_child(uint32_t parent, uint32_t child)
+		{
+			const unsigned char ch = static_cast<unsigned char>(nodes[child].first);
+			uint32_t* link = &nodes[parent].first_child;
+			while (*link != npos && static_cast<unsigned char>(nodes[*link].first) < ch) link = &nodes[*link].next_sibling;
+			nodes[child].next_sibling = *link;
+			*link = child;
+		}
+
+		// Inserts a node holding the first `common` bytes of child's label between parent and child.
+		uint32_t split(uint32_t parent, uint32_t child, uint32_t common)
+		{
+			const Node old = nodes[child];
+			const uint32_t mid = make_node(old.label_offset, common, old.first);
+			nodes[mid].count = old.count;
+			nodes[mid].first_child = child;
+			nodes[mid].next_sibling = old.next_sibling;
+
+			nodes[child].label_offset += common;
+			nodes[child].label_length -= common;
+			nodes[child].first = labels[nodes[child].label_offset];
+			nodes[child].next_sibling = npos;
+
+			uint32_t* link = &nodes[parent].first_child;
+			while (*link != child) link = &nodes[*link].next_sibling;
+			*link = mid;
+			return mid;
+		}
+
+		struct Position
+		{
+			uint32_t node;
+			size_t consumed; // bytes of the node's own label covered by the key
+			bool partial; // the key ended inside the node's label
+		};
+
+		// Walks key from the root. With allow_partial the key may end inside an edge, in which
+		// case the node below that edge is returned.
+		Position find_node(std::string_view key, bool allow_partial) const
+		{
+			Position result{ root, 0, false };
+			size_t pos = 0;
+			while (pos < key.size())
+			{
+				result.node = find_child(result.node, key[pos]);
+				if (result.node == npos) return result;
+
+				const std::string_view label = label_of(result.node);
+				const std::string_view rest = key.substr(pos);
+				if (rest.size() < label.size())
+				{
+					if (!allow_partial || label.substr(0, rest.size()) != rest) return Position{ npos, 0, false };
+					result.consumed = rest.size();
+					result.partial = true;
+					return result;
+				}
+				if (rest.substr(0, label.size()) != label) return Position{ npos, 0, false };
+				result.consumed = label.size();
+				pos += label.size();
+			}
+			return result;
+		}
+
+		template<typename Fn>
+		void visit(uint32_t node, std::string& key, Fn& fn) const
+		{
+			const size_t length = key.size();
+			if (node != root) key.append(label_of(node));
+			if (nodes[node].value != npos) fn(std::string_view(key), values[nodes[node].value]);
+			for (uint32_t child = nodes[node].first_child; child != npos; child = nodes[child].next_sibling) visit(child, key, fn);
+			key.resize(length);
+		}
+
+	private:
+		std::vector<Node> nodes{ Node{ 0, 0, npos, npos, npos, 0, '\0' } };
+		std::string labels;
+		std::deque<V> values;
+	};
+}
+
+#endif // INCLUDE_CMDKIT_TRIE
\ No newline at end of file
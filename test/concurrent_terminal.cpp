@@ -0,0 +1,93 @@
+#include "concurrent_terminal.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+// Registers commands while several threads invoke them. A command registered before an
+// invoke started must be found and must run its own handler; "base", re-registered all
+// along, must always run one of its two versions. Build with CMDKIT_TEST_SANITIZER=thread
+// to have the snapshot reclamation checked too. Usage: cmdkit_concurrent_terminal [commands] [threads]
+namespace
+{
+	size_t failures = 0;
+
+	void expect(bool condition, const char* what)
+	{
+		if (condition) return;
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t commands = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+	const size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+
+	// A command's result points at its own tag, so a wrong handler is caught.
+	std::vector<int> tags(commands);
+	int base_tags[2] = {};
+	auto make_command = [](const std::string& name, int* tag) { return Command(name, [tag](const CommandArgsView&) { return R::ok(tag); }); };
+
+	ConcurrentTerminal terminal;
+	terminal.register_command(make_command("base", &base_tags[0]));
+
+	std::atomic<size_t> published{ 0 };
+	std::atomic<bool> done{ false };
+	std::atomic<size_t> wrong{ 0 }, missing{ 0 }, invoked{ 0 };
+
+	std::vector<std::thread> invokers;
+	for (size_t idx = 0; idx < threads; ++idx)
+		invokers.emplace_back([&, idx]()
+			{
+				std::mt19937 rng(unsigned(idx + 1));
+				size_t count = 0;
+				while (!done.load())
+				{
+					const size_t known = published.load();
+					R base = terminal.invoke(std::string("base --verbose"), []() {});
+					if (base.is_err() || (base.unwrap() != &base_tags[0] && base.unwrap() != &base_tags[1])) wrong++;
+					if (known == 0) continue;
+
+					const size_t pick = rng() % known;
+					R result = terminal.invoke("cmd" + std::to_string(pick) + " arg", []() {});
+					if (result.is_err()) missing++;
+					else if (result.unwrap() != &tags[pick]) wrong++;
+					count++;
+				}
+				invoked += count;
+			});
+
+	for (size_t idx = 0; idx < commands; ++idx)
+	{
+		terminal.register_command(make_command("cmd" + std::to_string(idx), &tags[idx]));
+		published.store(idx + 1);
+		if (idx % 16 == 0) terminal.register_command(make_command("base", &base_tags[idx / 16 % 2]));
+	}
+	done.store(true);
+	for (auto& thread : invokers) thread.join();
+
+	expect(wrong == 0, "every invoke ran the handler registered under its name");
+	expect(missing == 0, "a command registered before an invoke is found");
+	expect(terminal.size() == commands + 1, "size counts every command once");
+	expect(terminal.list_commands("cmd").size() == commands, "list_commands sees every command");
+
+	size_t found = 0;
+	for (size_t idx = 0; idx < commands; ++idx)
+	{
+		R result = terminal.invoke("cmd" + std::to_string(idx));
+		found += result.is_ok() && result.unwrap() == &tags[idx];
+	}
+	expect(found == commands, "every command is found after registration ends");
+
+	std::printf("%zu commands, %zu threads, %zu invokes: %zu failures\n", commands, threads, invoked.load(), failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include "dispatcher.hpp"
+#include "terminal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+// Producers submit numbered commands while the dispatcher is stopped under them. Every
+// submission must be completed exactly once: with the command's result if it ran, with
+// "Dispatcher is stopped" if it did not, and a command must run only for the former.
+// Usage: cmdkit_dispatcher [rounds] [producers] [per producer]
+namespace
+{
+	size_t failures = 0;
+
+	void expect(bool condition, const char* what)
+	{
+		if (condition) return;
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+
+	R parse_id(const CommandArgsView& args, std::vector<int>& runs)
+	{
+		auto id = parse_value<size_t>(args[1]);
+		if (id.is_err() || id.unwrap() >= runs.size()) return R::err("bad id");
+		runs[id.unwrap()]++;
+		return R::ok(nullptr);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20;
+	const size_t producers = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+	const size_t per_producer = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+	const size_t total = producers * per_producer;
+
+	size_t ran_total = 0, stopped_total = 0;
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		// Only the dispatcher thread runs commands, and stop() joins it before runs is read.
+		std::vector<int> runs(total);
+		Terminal terminal;
+		terminal.set_output(std::make_shared<OutputSink>(OutputSink::Target([](const std::string_view*, size_t) { return Result<void, std::string>::ok(); })));
+		terminal.register_command(Command("run", [&runs](const CommandArgsView& args) { return parse_id(args, runs); }));
+
+		std::vector<std::atomic<int>> completions(total);
+		std::vector<std::atomic<int>> outcomes(total);
+		enum { ran = 1, stopped = 2, other = 3 };
+
+		// A small ring, so that producers also wait for room.
+		auto dispatcher = std::make_unique<TerminalDispatcher<Terminal>>(terminal, 64, 8);
+		std::vector<std::thread> threads;
+		for (size_t producer = 0; producer < producers; ++producer)
+			threads.emplace_back([&, producer]()
+				{
+					for (size_t idx = 0; idx < per_producer; ++idx)
+					{
+						const size_t id = producer * per_producer + idx;
+						auto done = [&completions, &outcomes, id](R result)
+							{
+								completions[id]++;
+								if (result.is_ok()) outcomes[id] = ran;
+								else outcomes[id] = result.unwrap_err() == "Dispatcher is stopped" ? stopped : other;
+							};
+						// Every other producer submits pre-parsed arguments.
+						if (producer % 2) dispatcher->submit(CommandArgs::parse("run " + std::to_string(id)), std::move(done));
+						else dispatcher->submit("run " + std::to_string(id), std::move(done));
+					}
+				});
+
+		std::this_thread::sleep_for(std::chrono::microseconds(200 * (round % 5)));
+		dispatcher->stop();
+		for (auto& thread : threads) thread.join();
+
+		size_t once = 0, consistent = 0;
+		for (size_t id = 0; id < total; ++id)
+		{
+			once += completions[id] == 1;
+			consistent += (outcomes[id] == ran && runs[id] == 1) || (outcomes[id] == stopped && runs[id] == 0);
+			ran_total += outcomes[id] == ran;
+			stopped_total += outcomes[id] == stopped;
+		}
+		expect(once == total, "every submission is completed exactly once");
+		expect(consistent == total, "a command runs once if it completed ok, and not at all if it was stopped");
+
+		std::future<R> late = dispatcher->submit(std::string("run 0"));
+		expect(late.wait_for(std::chrono::seconds(0)) == std::future_status::ready && late.get().is_err(), "a submission after stop() fails at once");
+		expect(dispatcher->stats().dispatched == size_t(std::count(runs.begin(), runs.end(), 1)), "stats count the dispatched entries");
+	}
+
+	std::printf("%zu rounds of %zu submissions, %zu ran, %zu stopped: %zu failures\n", rounds, total, ran_total, stopped_total, failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
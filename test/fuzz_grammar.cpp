@@ -0,0 +1,223 @@
+#include "command.hpp"
+#include "grammar.hpp"
+#include "scanner.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace cmdkit;
+
+// Differential fuzz of the argument grammar: random lines are split and classified by a
+// naive reference written from the rules in README.md, and the result is compared with
+// CommandArgs::parse, CommandArgsView::parse and detail::lex_args on every scanner the
+// machine supports. Usage: cmdkit_fuzz_grammar [iterations] [seed]
+namespace
+{
+	// Arguments as the reference sees them, with the members detail::args_equal reads.
+	struct Expected
+	{
+		std::vector<std::string> positional;
+		std::map<std::string, std::string> options;
+		std::set<std::string> flags;
+
+		const std::vector<std::string>& get_positional() const { return positional; }
+
+		std::optional<std::string_view> find_option(std::string_view key) const
+		{
+			auto it = options.find(std::string(key));
+			if (it == options.end()) return std::nullopt;
+			return std::string_view(it->second);
+		}
+
+		bool has_flag(const std::string& name) const { return flags.count(name); }
+
+		template<typename Fn>
+		void for_each_option(Fn&& fn) const { for (const auto& [k, v] : options) fn(std::string_view(k), std::string_view(v)); }
+
+		template<typename Fn>
+		void for_each_flag(Fn&& fn) const { for (const auto& flag : flags) fn(std::string_view(flag)); }
+	};
+
+	bool is_space(char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); }
+
+	// Shell word splitting, one character at a time. Returns false on an unterminated quote.
+	bool split(const std::string& line, std::vector<std::string>& words)
+	{
+		enum { none, single, dbl } quote = none;
+		std::string word;
+		bool in_word = false;
+		for (size_t idx = 0; idx < line.size(); ++idx)
+		{
+			const char ch = line[idx];
+			const bool last = idx + 1 == line.size();
+			if (quote == single)
+			{
+				if (ch == '\'') quote = none;
+				else word += ch;
+			}
+			else if (quote == dbl)
+			{
+				if (ch == '"') quote = none;
+				else if (ch == '\\' && !last && (line[idx + 1] == '"' || line[idx + 1] == '\\')) word += line[++idx];
+				else if (ch != '\\' || !last) word += ch;
+			}
+			else if (is_space(ch))
+			{
+				if (in_word) words.push_back(word);
+				word.clear();
+				in_word = false;
+			}
+			else
+			{
+				in_word = true;
+				if (ch == '\'') quote = single;
+				else if (ch == '"') quote = dbl;
+				else if (ch == '\\' && !last) word += line[++idx];
+				else word += ch;
+			}
+		}
+		if (in_word) words.push_back(word);
+		return quote == none;
+	}
+
+	// GNU classification: --key value, --key=value, -abc, -abc=value and --.
+	Expected classify(const std::vector<std::string>& words)
+	{
+		Expected args;
+		std::string pending;
+		bool has_pending = false, terminated = false;
+		auto flush = [&]() { if (has_pending) args.flags.insert(pending); has_pending = false; };
+
+		for (const std::string& word : words)
+		{
+			const bool numeric = word.size() > 1 && ((word[1] >= '0' && word[1] <= '9') || word[1] == '.');
+			const bool long_opt = word.size() > 2 && word.compare(0, 2, "--") == 0 && word[2] != '=';
+			const bool bundle = word.size() > 1 && word[0] == '-' && word[1] != '-' && word[1] != '=' && !numeric;
+
+			if (terminated || (!long_opt && !bundle && word != "--"))
+			{
+				if (has_pending) args.options[pending] = word;
+				else args.positional.push_back(word);
+				has_pending = false;
+				continue;
+			}
+
+			flush();
+			if (word == "--") { terminated = true; continue; }
+
+			const size_t equals = word.find('=', long_opt ? 3 : 2);
+			if (long_opt && equals == std::string::npos) { pending = word.substr(2); has_pending = true; }
+			else if (long_opt) args.options[word.substr(2, equals - 2)] = word.substr(equals + 1);
+			else
+			{
+				const size_t end = equals == std::string::npos ? word.size() : equals - 1;
+				for (size_t idx = 1; idx < end; ++idx) args.flags.insert(word.substr(idx, 1));
+				if (equals != std::string::npos) args.options[word.substr(equals - 1, 1)] = word.substr(equals + 1);
+			}
+		}
+		flush();
+		return args;
+	}
+
+	// Runs lex_args with one scanner and classifies its tokens into the same shape as the reference.
+	Expected lex(const std::string& line, StructuralScanner::ScanFn scan_fn, bool& closed, std::vector<std::string>& tokens)
+	{
+		Expected args;
+		std::vector<std::string> stored;
+		stored.reserve(line.size() + 1);
+		auto on_positional = [&args](std::string_view arg) { args.positional.emplace_back(arg); };
+		auto on_option = [&args](std::string_view key, std::string_view val) { args.options[std::string(key)] = std::string(val); };
+		auto on_flag = [&args](std::string_view key) { args.flags.emplace(key); };
+
+		detail::ArgClassifier classifier(on_positional, on_option, on_flag);
+		closed = detail::lex_args(line, scan_fn,
+			[&stored](std::string_view text) { return std::string_view(stored.emplace_back(text)); },
+			[&](const detail::ArgToken& token) { tokens.emplace_back(token.text); classifier.push(token); });
+		classifier.finish();
+		return args;
+	}
+
+	std::string printable(const std::string& line)
+	{
+		std::string out;
+		for (char ch : line)
+		{
+			if (ch == '\t') out += "\\t";
+			else if (ch == '\n') out += "\\n";
+			else if (ch == '\\') out += "\\\\";
+			else out += ch;
+		}
+		return out;
+	}
+
+	bool check(const std::string& line, const std::vector<StructuralScanner::ScanFn>& scanners)
+	{
+		std::vector<std::string> words;
+		const bool closed = split(line, words);
+		const Expected expected = classify(words);
+
+		const char* failure = nullptr;
+		if (!detail::args_equal(expected, CommandArgs::parse(line))) failure = "CommandArgs::parse(string)";
+		else if (!detail::args_equal(expected, CommandArgs::parse(words))) failure = "CommandArgs::parse(vector)";
+
+		std::pmr::monotonic_buffer_resource arena;
+		if (!failure && !detail::args_equal(expected, CommandArgsView::parse(line, &arena))) failure = "CommandArgsView::parse";
+
+		for (size_t idx = 0; !failure && idx < scanners.size(); ++idx)
+		{
+			bool lexed_closed = true;
+			std::vector<std::string> tokens;
+			const Expected lexed = lex(line, scanners[idx], lexed_closed, tokens);
+			if (tokens != words || lexed_closed != closed || !detail::args_equal(expected, lexed)) failure = "detail::lex_args";
+		}
+
+		if (failure) std::printf("mismatch in %s on [%s]\n", failure, printable(line).c_str());
+		return !failure;
+	}
+
+	std::string random_line(std::mt19937& rng, size_t max_size)
+	{
+		// Letters, dashes and '=' most of the time, so option shapes come up often.
+		static const char common[] = "ab-=";
+		static const char rare[] = "1. \t'\"\\|x";
+		std::string line(rng() % (max_size + 1), ' ');
+		for (char& ch : line) ch = rng() % 2 ? common[rng() % 4] : rare[rng() % 9];
+		return line;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	const unsigned seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1;
+
+	std::vector<StructuralScanner::ScanFn> scanners{ &StructuralScanner::scan_scalar };
+#if CMDKIT_SCANNER_X86
+	scanners.push_back(&StructuralScanner::scan_sse2);
+	if (StructuralScanner::detected_isa() == StructuralScanner::Isa::avx2) scanners.push_back(&StructuralScanner::scan_avx2);
+#endif
+
+	static const char* corpus[] = {
+		"", " ", "\"\" x", "''", "a\\", "\"a\\", "'unterminated", "--", "-- --x", "--=x", "-=x", "-1 -.5",
+		"--key=value", "--key value", "--key --flag", "-abc", "-abc=value", "-a=", "--a=b=c",
+		"deploy --region \"eu west 1\" --name='my app' -vf path/to/my\\ file.txt --retries=3",
+	};
+	size_t failures = 0;
+	for (const char* line : corpus) failures += !check(line, scanners);
+
+	// One in ten lines is long enough to cross several 64-byte scanner windows.
+	std::mt19937 rng(seed);
+	for (size_t it = 0; it < iterations && failures < 10; ++it)
+		failures += !check(random_line(rng, it % 10 == 0 ? 300 : 40), scanners);
+
+	std::printf("%zu lines, %zu scanners, seed %u: %zu mismatches\n", iterations, scanners.size(), seed, failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include "history.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace cmdkit;
+
+// Records many more lines than the log holds while another thread searches it, so the
+// background compactor runs several times. Afterwards the log must hold the newest entries
+// that fit, in order, and a reverse search must find each of them where it is (and none of
+// the dropped ones), also after reopening the file. Usage: cmdkit_history [lines]
+namespace
+{
+	constexpr size_t max_bytes = 64 << 10;
+
+	size_t failures = 0;
+
+	void expect(bool condition, const char* what)
+	{
+		if (condition) return;
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+
+	// Fixed width, so the number of entries that fit is known.
+	std::string line(size_t idx)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "deploy --build %08zu", idx);
+		return text;
+	}
+
+	void check(const CommandHistory& history, size_t lines, const char* when)
+	{
+		const size_t size = history.size();
+		const size_t keep = max_bytes / 2 / (line(0).size() + 1);
+		std::printf("%s: %zu entries, %zu bytes\n", when, size, history.bytes());
+		expect(size == keep, "compaction keeps the newest entries that fit in half of max_bytes");
+		if (size == 0) return;
+
+		size_t in_order = 0, found = 0, found_by_prefix = 0;
+		for (size_t idx = 0; idx < size; ++idx)
+		{
+			const std::string expected = line(lines - size + idx);
+			in_order += history.entry(idx) == expected;
+			found += history.search(expected.substr(15)) == std::optional<size_t>(idx);
+			found_by_prefix += history.search_prefix(expected) == std::optional<size_t>(idx);
+		}
+		expect(in_order == size, "the kept entries are the newest ones, oldest first");
+		expect(found == size, "reverse search finds every kept entry");
+		expect(found_by_prefix == size, "prefix search finds every kept entry");
+		expect(!history.search(line(lines - size - 1).substr(15)), "reverse search finds no dropped entry");
+		expect(history.search("deploy") == std::optional<size_t>(size - 1), "reverse search starts from the newest entry");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+	const std::string path = (std::filesystem::temp_directory_path() / ("cmdkit_test_history_" + std::to_string(::getpid()) + ".log")).string();
+
+	HistoryOptions options;
+	options.max_bytes = max_bytes;
+	{
+		auto history = CommandHistory::open(path, options).unwrap();
+
+		std::atomic<bool> done{ false };
+		// Races with the compactor for the sanitizers; indices shift under it, so hits are not checked.
+		std::thread searcher([&]() { while (!done.load()) history->search("--build 0"); });
+		for (size_t idx = 0; idx < lines; ++idx) history->record(line(idx));
+		done.store(true);
+		searcher.join();
+
+		history->compact();
+		check(*history, lines, "after recording");
+	}
+	{
+		auto history = CommandHistory::open(path, options).unwrap();
+		check(*history, lines, "after reopening");
+	}
+	std::filesystem::remove(path);
+
+	std::printf("%zu lines: %zu failures\n", lines, failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
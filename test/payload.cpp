@@ -0,0 +1,61 @@
+#include "payload.hpp"
+#include "terminal.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace cmdkit;
+using R = Result<void*, std::string>;
+
+// Payloads crossing into and out of a plugin loaded with RTLD_LOCAL, which has its own copy
+// of the storage's ops tables: the types must still be recognized, and still be told apart.
+// Usage: cmdkit_payload [plugin path]
+namespace
+{
+	size_t failures = 0;
+
+	void expect(bool condition, const char* what)
+	{
+		if (condition) return;
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string plugin = argc > 1 ? argv[1] : CMDKIT_TEST_PLUGIN;
+
+	Payload text(std::string("local"));
+	expect(text.is<std::string>() && !text.is<std::array<char, 64>>() && !text.is<std::vector<int>>(), "types are told apart in one module");
+
+	std::string taken_text;
+	char taken_block = 0;
+	size_t taken_size = 0;
+
+	Terminal terminal;
+	terminal.register_plugin(plugin, { { "plugin_text", "" }, { "plugin_block", "" }, { "plugin_length", "" } });
+	terminal.register_command(Command("host_text", make_stage<void>([](const CommandArgsView& args) { return std::string(args[1]); })));
+	terminal.register_command(Command("host_take_text", make_stage<std::string>([&taken_text](const CommandArgsView&, std::string val) { taken_text = std::move(val); return R::ok(nullptr); })));
+	terminal.register_command(Command("host_take_block", make_stage<std::array<char, 64>>([&taken_block](const CommandArgsView&, std::array<char, 64> val) { taken_block = val[0]; return R::ok(nullptr); })));
+	terminal.register_command(Command("host_take_size", make_stage<size_t>([&taken_size](const CommandArgsView&, size_t val) { taken_size = val; return R::ok(nullptr); })));
+	terminal.register_command(Command("host_take_list", make_stage<std::vector<int>>([](const CommandArgsView&, std::vector<int>) { return R::ok(nullptr); })));
+
+	R inline_value = terminal.invoke("plugin_text hello | host_take_text");
+	expect(inline_value.is_ok() && taken_text == "hello", "an inline value from the plugin");
+
+	R heap_value = terminal.invoke("plugin_block | host_take_block");
+	expect(heap_value.is_ok() && taken_block == 'p', "a heap value from the plugin");
+
+	R round_trip = terminal.invoke("host_text abc | plugin_length | host_take_size");
+	expect(round_trip.is_ok() && taken_size == 3, "a value into the plugin and back");
+
+	R mismatch = terminal.invoke("plugin_text hi | host_take_list");
+	expect(mismatch.is_err() && mismatch.unwrap_err() == "Pipeline stage got an unexpected payload type", "another type from the plugin is rejected");
+
+	std::printf("%zu failures\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+#include "command.hpp"
+#include "plugin.hpp"
+
+#include <array>
+#include <string>
+
+using namespace cmdkit;
+
+// The plugin cmdkit_plugin_payload loads. Its stages make and take payloads of types the
+// program also uses, one that fits inline and one that does not.
+CMDKIT_PLUGIN_EXPORT bool cmdkit_make_command(const char* name, Command* out)
+{
+	const std::string wanted = name;
+	if (wanted == "plugin_text") *out = Command(wanted, make_stage<void>([](const CommandArgsView& args) { return std::string(args[1]); }));
+	else if (wanted == "plugin_block") *out = Command(wanted, make_stage<void>([](const CommandArgsView&) { std::array<char, 64> block{}; block[0] = 'p'; return block; }));
+	else if (wanted == "plugin_length") *out = Command(wanted, make_stage<std::string>([](const CommandArgsView&, std::string text) { return text.size(); }));
+	else return false;
+	return true;
+}
@@ -0,0 +1,74 @@
+#include "result.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+using namespace cmdkit;
+
+// Layout checks: one discriminant, no padding beyond the variant, and triviality carried
+// through so that small results are returned in registers. The runtime part checks that
+// trivially copyable results survive a byte copy and that moves and errors behave.
+namespace
+{
+	static_assert(sizeof(Result<void*, std::string>) == sizeof(std::variant<void*, std::string>));
+	static_assert(sizeof(Result<int, unsigned>) == 2 * sizeof(int));
+	static_assert(sizeof(Result<void, int>) == 2 * sizeof(int));
+	static_assert(sizeof(Result<void*, int>) <= 2 * sizeof(void*));
+
+	static_assert(std::is_trivially_copyable_v<Result<int, unsigned>>);
+	static_assert(std::is_trivially_copyable_v<Result<void*, int>>);
+	static_assert(std::is_trivially_copyable_v<Result<void, int>>);
+	static_assert(std::is_trivially_destructible_v<Result<void*, int>>);
+	static_assert(!std::is_trivially_copyable_v<Result<void*, std::string>>);
+
+	static_assert(std::is_nothrow_move_constructible_v<Result<void*, std::string>>);
+	static_assert(std::is_nothrow_move_assignable_v<Result<void*, std::string>>);
+	static_assert(std::is_nothrow_move_constructible_v<Result<void, std::string>>);
+
+	static_assert(Result<int, unsigned>::ok(3).is_ok() && Result<int, unsigned>::ok(3).unwrap() == 3);
+	static_assert(Result<int, unsigned>::err(4u).is_err() && Result<int, unsigned>::err(4u).unwrap_err() == 4u);
+	static_assert(Result<void, int>::ok().is_ok() && Result<void, int>::err(1).unwrap_err() == 1);
+	static_assert(Result<void*, int>(Result<void, int>::ok()).unwrap() == nullptr);
+	static_assert(Result<void*, int>(Result<void, int>::err(5)).unwrap_err() == 5);
+
+	size_t failures = 0;
+
+	void expect(bool condition, const char* what)
+	{
+		if (condition) return;
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+
+	template<typename R>
+	R byte_copy(const R& result)
+	{
+		R copy = R::err({});
+		std::memcpy(static_cast<void*>(&copy), &result, sizeof(R));
+		return copy;
+	}
+}
+
+int main()
+{
+	expect(byte_copy(Result<int, unsigned>::ok(7)).unwrap() == 7, "byte copy of ok(7)");
+	expect(byte_copy(Result<int, unsigned>::err(9u)).unwrap_err() == 9u, "byte copy of err(9)");
+	expect(byte_copy(Result<void, int>::err(2)).unwrap_err() == 2, "byte copy of void err(2)");
+
+	Result<void*, std::string> failed = Result<void*, std::string>::err(std::string(64, 'x'));
+	Result<void*, std::string> moved = std::move(failed);
+	expect(moved.is_err() && moved.unwrap_err().size() == 64, "move keeps the error");
+
+	bool threw = false;
+	try { moved.unwrap(); }
+	catch (const bad_result_access&) { threw = true; }
+	expect(threw, "unwrap on an error throws bad_result_access");
+
+	std::printf("%zu failures\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}